@@ -70,6 +70,12 @@ undolog_desc(StringInfo buf, XLogReaderState *record)
 		appendStringInfo(buf, "logno %u insert " UndoLogOffsetFormat " prevlen %d",
 						 xlrec->logno, xlrec->insert, xlrec->prevlen);
 	}
+	else if (info == XLOG_UNDOLOG_DROP)
+	{
+		xl_undolog_drop *xlrec = (xl_undolog_drop *) rec;
+
+		appendStringInfo(buf, "logno %u", xlrec->logno);
+	}
 
 }
 
@@ -98,6 +104,9 @@ undolog_identify(uint8 info)
 		case XLOG_UNDOLOG_REWIND:
 			id = "REWIND";
 			break;
+		case XLOG_UNDOLOG_DROP:
+			id = "DROP";
+			break;
 	}
 
 	return id;
@@ -116,6 +116,33 @@ zheap2_desc(StringInfo buf, XLogReaderState *record)
 		appendStringInfo(buf, "cutoff xid %u flags %d",
 						 xlrec->cutoff_xid, xlrec->flags);
 	}
+	else if (info == XLOG_ZHEAP_MULTI_DELETE)
+	{
+		xl_undo_header *xlundohdr = (xl_undo_header *) rec;
+		xl_zheap_multi_delete *xlrec = (xl_zheap_multi_delete *) ((char *) xlundohdr + SizeOfUndoHeader);
+
+		appendStringInfo(buf, "%u tuples, trans_slot %u, hasUndoTuple: %c, blkprev %lu",
+						 xlrec->ntuples, xlrec->trans_slot_id,
+						 (xlrec->flags & XLZ_HAS_MULTI_DELETE_UNDOTUPLES) ? 'T' : 'F',
+						 xlundohdr->blkprev);
+	}
+	else if (info == XLOG_ZHEAP_RELFILENODE)
+	{
+		xl_undo_header *xlundohdr = (xl_undo_header *) rec;
+		xl_zheap_relfilenode *xlrec = (xl_zheap_relfilenode *) ((char *) xlundohdr + SizeOfUndoHeader);
+
+		appendStringInfo(buf, "rel %u/%u, reloid %u, action %u, old relfilenode %u",
+						 xlundohdr->tsid, xlundohdr->relfilenode,
+						 xlrec->reloid, xlrec->action, xlrec->old_relfilenode);
+	}
+	else if (info == XLOG_ZHEAP_META_STATS)
+	{
+		xl_zheap_meta_stats *xlrec = (xl_zheap_meta_stats *) rec;
+
+		appendStringInfo(buf, "active_frac %g, undo_depth %g, tpd_frac %g",
+						 xlrec->active_frac, xlrec->undo_depth,
+						 xlrec->tpd_frac);
+	}
 }
 
 const char *
@@ -179,6 +206,15 @@ zheap2_identify(uint8 info)
 		case XLOG_ZHEAP_VISIBLE:
 			id = "VISIBLE";
 			break;
+		case XLOG_ZHEAP_MULTI_DELETE:
+			id = "MULTI_DELETE";
+			break;
+		case XLOG_ZHEAP_RELFILENODE:
+			id = "RELFILENODE";
+			break;
+		case XLOG_ZHEAP_META_STATS:
+			id = "META_STATS";
+			break;
 	}
 
 	return id;
@@ -7249,6 +7249,9 @@ StartupXLOG(void)
 				/* Handle interrupt signals of startup process */
 				HandleStartupProcInterrupts();
 
+				/* Apply deferred undo discards that are no longer needed. */
+				UndoLogApplyDeferredDiscards();
+
 				/*
 				 * Pause WAL replay, if requested by a hot-standby session via
 				 * SetRecoveryPause().
@@ -9899,8 +9902,7 @@ xlog_redo(XLogReaderState *record)
 		MultiXactAdvanceOldest(checkPoint.oldestMulti,
 							   checkPoint.oldestMultiDB);
 
-		pg_atomic_write_u64(&ProcGlobal->oldestXidWithEpochHavingUndo,
-							checkPoint.oldestXidWithEpochHavingUndo);
+		UndoLogReplayOldestXidHavingUndo(checkPoint.oldestXidWithEpochHavingUndo);
 
 		/*
 		 * No need to set oldestClogXid here as well; it'll be set when we
@@ -12379,6 +12381,12 @@ WaitForWALToBecomeAvailable(XLogRecPtr RecPtr, bool randAccess,
 		 * process.
 		 */
 		HandleStartupProcInterrupts();
+
+		/*
+		 * Standby queries may have gone away while we waited, so deferred
+		 * undo discards may be applicable now.
+		 */
+		UndoLogApplyDeferredDiscards();
 	}
 
 	return false;				/* not reached */
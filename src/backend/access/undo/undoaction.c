@@ -20,11 +20,13 @@
 #include "access/visibilitymap.h"
 #include "access/xact.h"
 #include "access/zheap.h"
+#include "catalog/storage.h"
 #include "nodes/pg_list.h"
 #include "postmaster/undoloop.h"
 #include "storage/block.h"
 #include "storage/buf.h"
 #include "storage/bufmgr.h"
+#include "storage/smgr.h"
 #include "utils/relfilenodemap.h"
 #include "miscadmin.h"
 #include "storage/shmem.h"
@@ -33,11 +35,25 @@
 
 #define ROLLBACK_HT_SIZE	1024
 
+/*
+ * Rollbacks of a backend's own undo smaller than this take the lightweight
+ * path in execute_undo_actions_small.
+ */
+#define SMALL_ROLLBACK_UNDO_SIZE	(4 * BLCKSZ)
+
+static void execute_undo_actions_small(UndoRecPtr from_urecptr,
+					 UndoRecPtr to_urecptr, bool nopartial, bool rellock);
 static bool execute_undo_actions_page(List *luinfo, UndoRecPtr urec_ptr,
 					 Oid reloid, TransactionId xid, BlockNumber blkno,
 					 bool blk_chain_complete, bool norellock, int options);
+static bool apply_undo_actions_page(List *luinfo, UndoRecPtr urec_ptr,
+					 Relation rel, TransactionId xid, BlockNumber blkno,
+					 bool blk_chain_complete, int options);
 static inline void undo_action_insert(Relation rel, Page page, OffsetNumber off,
 									  TransactionId xid);
+static void undo_action_restore_tuple(UnpackedUndoRecord *uur, Buffer buffer,
+						  Page page, char *tpd_offset_map);
+static void undo_action_relfilenode(UnpackedUndoRecord *uur);
 
 /* This is the hash table to store all the rollabck requests. */
 static HTAB *RollbackHT;
@@ -49,6 +65,25 @@ typedef struct UndoRecInfo
 	UnpackedUndoRecord	*uur;	/* actual undo record. */
 } UndoRecInfo;
 
+/* the undo records of one page, for execute_undo_actions_small */
+typedef struct UndoActionPage
+{
+	Oid			reloid;
+	ForkNumber	fork;
+	BlockNumber	blkno;
+	TransactionId xid;
+	List	   *luinfo;		/* undo records, latest first. */
+	UndoRecPtr	blkprev;	/* blkprev of the oldest undo record. */
+	int			options;
+} UndoActionPage;
+
+/* a relation opened by execute_undo_actions_small */
+typedef struct UndoActionRel
+{
+	Relation	rel;
+	BlockNumber	nblocks;
+} UndoActionRel;
+
 /*
  * execute_undo_actions - Execute the undo actions
  *
@@ -99,6 +134,19 @@ execute_undo_actions(UndoRecPtr from_urecptr, UndoRecPtr to_urecptr,
 		to_urecptr = UndoLogGetLastXactStartPoint(logno);
 	}
 
+	/*
+	 * A backend rolling back a little of its own undo, typically for ROLLBACK
+	 * TO SAVEPOINT after a failed statement, can do it more cheaply.
+	 */
+	if (rewind &&
+		UndoRecPtrGetLogNo(from_urecptr) == UndoRecPtrGetLogNo(to_urecptr) &&
+		from_urecptr - to_urecptr < SMALL_ROLLBACK_UNDO_SIZE)
+	{
+		execute_undo_actions_small(from_urecptr, to_urecptr, nopartial,
+								   rellock);
+		return;
+	}
+
 	save_urec_ptr = urec_ptr = from_urecptr;
 
 	prev_urec_ptr = InvalidUndoRecPtr;
@@ -115,17 +163,11 @@ execute_undo_actions(UndoRecPtr from_urecptr, UndoRecPtr to_urecptr,
 		uur = UndoFetchRecord(urec_ptr, InvalidBlockNumber,
 						 InvalidOffsetNumber, InvalidTransactionId, NULL, NULL);
 
-		if (uur != NULL)
-			reloid = RelidByRelfilenode(uur->uur_tsid, uur->uur_relfilenode);
-
 		/*
-		 * If the record is already discarded by undo worker or if the relation
-		 * is dropped or truncated, then we cannot fetch record successfully.
-		 * Hence, exit quietly.
-		 *
-		 * Note: reloid remains InvalidOid for a discarded record.
+		 * If the record is already discarded by undo worker, then we cannot
+		 * fetch record successfully.  Hence, exit quietly.
 		 */
-		if (!OidIsValid(reloid))
+		if (uur == NULL)
 		{
 			/* release the undo records for which action has been replayed */
 			while (luinfo)
@@ -137,13 +179,37 @@ execute_undo_actions(UndoRecPtr from_urecptr, UndoRecPtr to_urecptr,
 				luinfo = list_delete_first(luinfo);
 			}
 
-			/* Release the just-fetched record */
-			if (uur != NULL)
-				UndoRecordRelease(uur);
-
 			return;
 		}
 
+		if (uur->uur_type != UNDO_RELFILENODE)
+			reloid = RelidByRelfilenode(uur->uur_tsid, uur->uur_relfilenode);
+
+		/*
+		 * A relation-level record doesn't belong to any page, so apply it on
+		 * its own.  If no relation uses the storage a record is about, the
+		 * storage was created by the transaction being rolled back, or the
+		 * relation has been dropped or truncated since, and there is nothing
+		 * to undo in it.  Either way, go on with the older records: they may
+		 * belong to other relations, whose changes would otherwise never be
+		 * rolled back.
+		 */
+		if (!OidIsValid(reloid))
+		{
+			if (uur->uur_type == UNDO_RELFILENODE)
+				undo_action_relfilenode(uur);
+
+			urec_prevlen = uur->uur_prevlen;
+			UndoRecordRelease(uur);
+
+			if (urec_prevlen > 0 && urec_ptr != to_urecptr)
+			{
+				urec_ptr = UndoGetPrevUndoRecptr(urec_ptr, urec_prevlen);
+				continue;
+			}
+			break;
+		}
+
 		xid = uur->uur_xid;
 
 		/* Collect the undo records that belong to the same page. */
@@ -294,6 +360,211 @@ execute_undo_actions(UndoRecPtr from_urecptr, UndoRecPtr to_urecptr,
 	}
 }
 
+/*
+ * execute_undo_actions_small - Execute a small number of our own undo actions
+ *
+ * This is execute_undo_actions for a backend rolling back a little of its own
+ * undo, with rewind implied.  Rather than applying the undo records a run of
+ * consecutive records of the same page at a time, we collect them all first,
+ * grouped by page, so that each page is locked and logged only once however
+ * the statement interleaved its changes.  We also open each relation and look
+ * up its size only once, remember the last relfilenode we mapped, and reuse
+ * the first undo record of the range for rewinding rather than fetching it
+ * again.
+ */
+static void
+execute_undo_actions_small(UndoRecPtr from_urecptr, UndoRecPtr to_urecptr,
+						   bool nopartial, bool rellock)
+{
+	UnpackedUndoRecord *uur;
+	UnpackedUndoRecord *first_uur = NULL;
+	UndoRecPtr	urec_ptr = from_urecptr;
+	List	   *pages = NIL;
+	List	   *rels = NIL;
+	ListCell   *lc;
+	Oid			last_tsid = InvalidOid;
+	Oid			last_relfilenode = InvalidOid;
+	Oid			last_reloid = InvalidOid;
+	bool		complete = true;
+
+	/* Collect the undo records, grouped by page. */
+	for (;;)
+	{
+		UndoActionPage *pageinfo = NULL;
+		UndoRecInfo *urec_info;
+		Oid			reloid = InvalidOid;
+
+		uur = UndoFetchRecord(urec_ptr, InvalidBlockNumber,
+							  InvalidOffsetNumber, InvalidTransactionId,
+							  NULL, NULL);
+
+		/*
+		 * As in execute_undo_actions, stop quietly if the record has been
+		 * discarded.
+		 */
+		if (uur == NULL)
+		{
+			complete = false;
+			break;
+		}
+
+		if (uur->uur_type != UNDO_RELFILENODE)
+		{
+			if (OidIsValid(last_reloid) &&
+				uur->uur_tsid == last_tsid &&
+				uur->uur_relfilenode == last_relfilenode)
+				reloid = last_reloid;
+			else
+			{
+				reloid = RelidByRelfilenode(uur->uur_tsid,
+											uur->uur_relfilenode);
+				last_tsid = uur->uur_tsid;
+				last_relfilenode = uur->uur_relfilenode;
+				last_reloid = reloid;
+			}
+		}
+
+		/*
+		 * As in execute_undo_actions, apply a relation-level record on its
+		 * own, and skip the records of storage no relation uses any more.
+		 */
+		if (!OidIsValid(reloid))
+		{
+			bool		last = (urec_ptr == to_urecptr ||
+								uur->uur_prevlen == 0);
+			uint16		prevlen = uur->uur_prevlen;
+
+			if (uur->uur_type == UNDO_RELFILENODE)
+				undo_action_relfilenode(uur);
+			UndoRecordRelease(uur);
+
+			if (last)
+				break;
+			urec_ptr = UndoGetPrevUndoRecptr(urec_ptr, prevlen);
+			continue;
+		}
+
+		foreach(lc, pages)
+		{
+			UndoActionPage *p = (UndoActionPage *) lfirst(lc);
+
+			if (p->reloid == reloid && p->fork == uur->uur_fork &&
+				p->blkno == uur->uur_block)
+			{
+				pageinfo = p;
+				break;
+			}
+		}
+		if (pageinfo == NULL)
+		{
+			pageinfo = palloc0(sizeof(UndoActionPage));
+			pageinfo->reloid = reloid;
+			pageinfo->fork = uur->uur_fork;
+			pageinfo->blkno = uur->uur_block;
+			pages = lappend(pages, pageinfo);
+		}
+
+		urec_info = palloc(sizeof(UndoRecInfo));
+		urec_info->urp = urec_ptr;
+		urec_info->uur = uur;
+		pageinfo->luinfo = lappend(pageinfo->luinfo, urec_info);
+		pageinfo->xid = uur->uur_xid;
+		pageinfo->blkprev = uur->uur_blkprev;
+		if (uur->uur_info & UREC_INFO_PAYLOAD_CONTAINS_SLOT)
+			pageinfo->options |= UNDO_ACTION_UPDATE_TPD;
+
+		if (urec_ptr == to_urecptr)
+		{
+			first_uur = uur;
+			break;
+		}
+		if (uur->uur_prevlen == 0)
+			break;
+		urec_ptr = UndoGetPrevUndoRecptr(urec_ptr, uur->uur_prevlen);
+	}
+
+	/* Apply them one page at a time. */
+	foreach(lc, pages)
+	{
+		UndoActionPage *pageinfo = (UndoActionPage *) lfirst(lc);
+		UndoActionRel *relinfo = NULL;
+		ListCell   *lc2;
+
+		foreach(lc2, rels)
+		{
+			UndoActionRel *r = (UndoActionRel *) lfirst(lc2);
+
+			if (RelationGetRelid(r->rel) == pageinfo->reloid)
+			{
+				relinfo = r;
+				break;
+			}
+		}
+		if (relinfo == NULL)
+		{
+			/* See execute_undo_actions_page about the locking. */
+			relinfo = palloc(sizeof(UndoActionRel));
+			relinfo->rel = heap_open(pageinfo->reloid,
+									 rellock ? RowExclusiveLock : NoLock);
+
+			/* Once we hold the lock, the relation can't be truncated. */
+			relinfo->nblocks = RelationGetNumberOfBlocks(relinfo->rel);
+			rels = lappend(rels, relinfo);
+		}
+
+		if (pageinfo->blkno < relinfo->nblocks)
+			apply_undo_actions_page(pageinfo->luinfo, pageinfo->blkprev,
+									relinfo->rel, pageinfo->xid,
+									pageinfo->blkno,
+									(nopartial && complete) ||
+									!UndoRecPtrIsValid(pageinfo->blkprev),
+									pageinfo->options);
+	}
+
+	/* Rewind the insert location, as execute_undo_actions does. */
+	if (complete)
+	{
+		if (first_uur != NULL)
+			UndoLogRewind(to_urecptr, first_uur->uur_prevlen);
+		else
+		{
+			uur = UndoFetchRecord(to_urecptr, InvalidBlockNumber,
+								  InvalidOffsetNumber, InvalidTransactionId,
+								  NULL, NULL);
+			if (uur != NULL)
+			{
+				UndoLogRewind(to_urecptr, uur->uur_prevlen);
+				UndoRecordRelease(uur);
+			}
+		}
+	}
+
+	/* Release the undo records and relations. */
+	foreach(lc, pages)
+	{
+		UndoActionPage *pageinfo = (UndoActionPage *) lfirst(lc);
+		ListCell   *lc2;
+
+		foreach(lc2, pageinfo->luinfo)
+		{
+			UndoRecInfo *urec_info = (UndoRecInfo *) lfirst(lc2);
+
+			UndoRecordRelease(urec_info->uur);
+			pfree(urec_info);
+		}
+		list_free(pageinfo->luinfo);
+	}
+	list_free_deep(pages);
+
+	foreach(lc, rels)
+	{
+		UndoActionRel *relinfo = (UndoActionRel *) lfirst(lc);
+
+		heap_close(relinfo->rel, NoLock);
+	}
+	list_free_deep(rels);
+}
+
 /*
  * process_and_execute_undo_actions_page
  *
@@ -485,6 +756,178 @@ undo_action_insert(Relation rel, Page page, OffsetNumber off,
 	ZPageSetPrunable(page, xid);
 }
 
+/*
+ * undo_action_restore_tuple - perform the undo action for delete or update
+ *
+ *	This copies the previous version of the tuple back from the undo record.
+ */
+static void
+undo_action_restore_tuple(UnpackedUndoRecord *uur, Buffer buffer, Page page,
+						  char *tpd_offset_map)
+{
+	ItemId		lp;
+	ZHeapTupleHeader zhtup;
+	TransactionId	slot_xid;
+	Size		offset = 0;
+	uint32		undo_tup_len;
+	int			trans_slot;
+	uint16		infomask;
+
+	/* Copy the entire tuple from undo. */
+	lp = PageGetItemId(page, uur->uur_offset);
+	Assert(ItemIdIsNormal(lp));
+	zhtup = (ZHeapTupleHeader) PageGetItem(page, lp);
+	infomask = zhtup->t_infomask;
+	trans_slot = ZHeapTupleHeaderGetXactSlot(zhtup);
+
+	undo_tup_len = *((uint32 *) &uur->uur_tuple.data[offset]);
+	ItemIdChangeLen(lp, undo_tup_len);
+	/* skip ctid and tableoid stored in undo tuple */
+	offset += sizeof(uint32) + sizeof(ItemPointerData) + sizeof(Oid);
+	memcpy(zhtup,
+		   (ZHeapTupleHeader) &uur->uur_tuple.data[offset],
+		   undo_tup_len);
+
+	/*
+	 * If the previous version of the tuple points to a TPD
+	 * slot then we need to update the slot in the offset map
+	 * of the TPD entry.  But, only if we still have a valid
+	 * TPD entry for the page otherwise the old tuple version
+	 * must be all visible and we can mark the slot as frozen.
+	 */
+	if (uur->uur_info & UREC_INFO_PAYLOAD_CONTAINS_SLOT &&
+		tpd_offset_map)
+	{
+		int prev_trans_slot;
+
+		/* Fetch TPD slot from the undo. */
+		if (uur->uur_type == UNDO_UPDATE)
+			prev_trans_slot = *(int *) ((char *) uur->uur_payload.data +
+								sizeof(ItemPointerData));
+		else
+			prev_trans_slot = *(int *) uur->uur_payload.data;
+
+		TPDPageSetOffsetMapSlot(buffer, prev_trans_slot,
+								uur->uur_offset);
+	}
+	else if (uur->uur_info & UREC_INFO_PAYLOAD_CONTAINS_SLOT)
+	{
+		ZHeapTupleHeaderSetXactSlot(zhtup, ZHTUP_SLOT_FROZEN);
+	}
+
+	/*
+	 * We always need to retain the strongest locker
+	 * information on the the tuple (as part of infomask and
+	 * infomask2), if there are multiple lockers on a tuple.
+	 * This is because the conflict detection mechanism works
+	 * based on strongest locker.  See
+	 * zheap_update/zheap_delete.  We have allowed to override
+	 * the transaction slot information with whatever is
+	 * present in undo as we have taken care during DO
+	 * operation that it contains previous strongest locker
+	 * information.  See compute_new_xid_infomask.
+	 */
+	if (ZHeapTupleHasMultiLockers(infomask))
+	{
+		/* ZHeapTupleHeaderSetXactSlot(zhtup, trans_slot); */
+		zhtup->t_infomask |= ZHEAP_MULTI_LOCKERS;
+		zhtup->t_infomask &= ~(zhtup->t_infomask & ZHEAP_LOCK_MASK);
+		zhtup->t_infomask |= infomask & ZHEAP_LOCK_MASK;
+
+		/*
+		 * If the tuple originally has INVALID_XACT_SLOT set,
+		 * then we need to retain it as that must be the information
+		 * of strongest locker.
+		 */
+		if (ZHeapTupleHasInvalidXact(infomask))
+			zhtup->t_infomask |= ZHEAP_INVALID_XACT_SLOT;
+	}
+
+	trans_slot = GetTransactionSlotInfo(buffer,
+										uur->uur_offset,
+										trans_slot,
+										NULL,
+										&slot_xid,
+										NULL,
+										false,
+										false);
+
+	if (TransactionIdEquals(uur->uur_prevxid,
+							FrozenTransactionId))
+	{
+		/*
+		 * If the previous xid is frozen, then we can safely
+		 * mark the tuple as frozen.
+		 */
+		ZHeapTupleHeaderSetXactSlot(zhtup, ZHTUP_SLOT_FROZEN);
+	}
+	else if (trans_slot != ZHTUP_SLOT_FROZEN &&
+				uur->uur_prevxid != slot_xid)
+	{
+		/*
+		 * If the transaction slot to which tuple point got reused
+		 * by this time, then we need to mark the tuple with a
+		 * special flag.  See comments atop PageFreezeTransSlots.
+		 */
+		zhtup->t_infomask |= ZHEAP_INVALID_XACT_SLOT;
+	}
+}
+
+/*
+ * undo_action_relfilenode - perform the undo action for new storage
+ *
+ *	The storage an UNDO_RELFILENODE record is about was created by the
+ *	transaction being rolled back.  Normally the pending-delete machinery
+ *	dropped it when the transaction aborted, leaving at most an empty first
+ *	segment until the next checkpoint (see mdunlink), and there is nothing to
+ *	do.  But nobody did for a transaction that was in progress at a crash, so
+ *	if the storage is still there, we drop it when our own transaction
+ *	commits.  We do that only when no relation uses the storage, and, if it
+ *	replaced the old storage of a relation, only when the relation is back on
+ *	its old storage.
+ *
+ *	As with mdunlink, this relies on the relfilenode not being reused by
+ *	another relation before the undo is applied, which can happen only after
+ *	OID wraparound.
+ */
+static void
+undo_action_relfilenode(UnpackedUndoRecord *uur)
+{
+	UndoRecordRelfilenode relundo;
+	RelFileNode rnode;
+	SMgrRelation reln;
+	bool		drop;
+
+	Assert(uur->uur_payload.len == SizeOfUndoRecordRelfilenode);
+
+	/* the payload is not aligned, so copy it */
+	memcpy(&relundo, uur->uur_payload.data, SizeOfUndoRecordRelfilenode);
+
+	if (OidIsValid(RelidByRelfilenode(uur->uur_tsid, uur->uur_relfilenode)))
+		return;
+
+	if (relundo.action == UNDO_RELFILENODE_RESTORE &&
+		RelidByRelfilenode(uur->uur_tsid,
+						   relundo.old_relfilenode) != relundo.reloid)
+		return;
+
+	rnode.spcNode = uur->uur_tsid;
+	rnode.dbNode = MyDatabaseId;
+	rnode.relNode = uur->uur_relfilenode;
+
+	reln = smgropen(rnode, InvalidBackendId);
+	drop = smgrexists(reln, MAIN_FORKNUM) &&
+		smgrnblocks(reln, MAIN_FORKNUM) > 0;
+	smgrclose(reln);
+
+	if (drop)
+	{
+		/* The commit record must list the storage, so we need an xid. */
+		(void) GetTopTransactionId();
+		RelFileNodeDropStorage(rnode);
+	}
+}
+
 /*
  * execute_undo_actions_page - Execute the undo actions for a page
  *
@@ -521,18 +964,8 @@ execute_undo_actions_page(List *luinfo, UndoRecPtr urec_ptr, Oid reloid,
 						  TransactionId xid, BlockNumber blkno,
 						  bool blk_chain_complete, bool rellock, int options)
 {
-	ListCell   *l_iter;
 	Relation	rel;
-	Buffer		buffer;
-	Page		page;
-	UndoRecPtr	slot_urec_ptr;
-	uint32		epoch;
-	int			slot_no = 0;
-	int			tpd_map_size = 0;
-	char	   *tpd_offset_map = NULL;
-	UndoRecInfo *urec_info = (UndoRecInfo *) linitial(luinfo);
-	Buffer		vmbuffer = InvalidBuffer;
-	bool		need_init = false;
+	bool		result;
 
 	/*
 	 * FIXME: If reloid is not valid then we have nothing to do. In future,
@@ -564,6 +997,37 @@ execute_undo_actions_page(List *luinfo, UndoRecPtr urec_ptr, Oid reloid,
 		return false;
 	}
 
+	result = apply_undo_actions_page(luinfo, urec_ptr, rel, xid, blkno,
+									 blk_chain_complete, options);
+
+	heap_close(rel, NoLock);
+
+	return result;
+}
+
+/*
+ * apply_undo_actions_page - Apply the undo actions of one page
+ *
+ * Like execute_undo_actions_page, but the caller has already opened the
+ * relation and made sure that the block exists.
+ */
+static bool
+apply_undo_actions_page(List *luinfo, UndoRecPtr urec_ptr, Relation rel,
+						TransactionId xid, BlockNumber blkno,
+						bool blk_chain_complete, int options)
+{
+	ListCell   *l_iter;
+	Buffer		buffer;
+	Page		page;
+	UndoRecPtr	slot_urec_ptr;
+	uint32		epoch;
+	int			slot_no = 0;
+	int			tpd_map_size = 0;
+	char	   *tpd_offset_map = NULL;
+	UndoRecInfo *urec_info = (UndoRecInfo *) linitial(luinfo);
+	Buffer		vmbuffer = InvalidBuffer;
+	bool		need_init = false;
+
 	buffer = ReadBuffer(rel, blkno);
 
 	/*
@@ -610,7 +1074,6 @@ execute_undo_actions_page(List *luinfo, UndoRecPtr urec_ptr, Oid reloid,
 		slot_urec_ptr <= urec_ptr))
 	{
 		UnlockReleaseBuffer(buffer);
-		heap_close(rel, NoLock);
 		return false;
 	}
 
@@ -696,113 +1159,16 @@ execute_undo_actions_page(List *luinfo, UndoRecPtr urec_ptr, Oid reloid,
 			case UNDO_DELETE:
 			case UNDO_UPDATE:
 			case UNDO_INPLACE_UPDATE:
+				undo_action_restore_tuple(uur, buffer, page, tpd_offset_map);
+				break;
+			case UNDO_MULTI_DELETE:
 				{
-					ItemId		lp;
-					ZHeapTupleHeader zhtup;
-					TransactionId	slot_xid;
-					Size		offset = 0;
-					uint32		undo_tup_len;
-					int			trans_slot;
-					uint16		infomask;
+					UnpackedUndoRecord delrec;
+					Size		pos = 0;
 
-					/* Copy the entire tuple from undo. */
-					lp = PageGetItemId(page, uur->uur_offset);
-					Assert(ItemIdIsNormal(lp));
-					zhtup = (ZHeapTupleHeader) PageGetItem(page, lp);
-					infomask = zhtup->t_infomask;
-					trans_slot = ZHeapTupleHeaderGetXactSlot(zhtup);
-
-					undo_tup_len = *((uint32 *) &uur->uur_tuple.data[offset]);
-					ItemIdChangeLen(lp, undo_tup_len);
-					/* skip ctid and tableoid stored in undo tuple */
-					offset += sizeof(uint32) + sizeof(ItemPointerData) + sizeof(Oid);
-					memcpy(zhtup,
-						   (ZHeapTupleHeader) &uur->uur_tuple.data[offset],
-						   undo_tup_len);
-
-					/*
-					 * If the previous version of the tuple points to a TPD
-					 * slot then we need to update the slot in the offset map
-					 * of the TPD entry.  But, only if we still have a valid
-					 * TPD entry for the page otherwise the old tuple version
-					 * must be all visible and we can mark the slot as frozen.
-					 */
-					if (uur->uur_info & UREC_INFO_PAYLOAD_CONTAINS_SLOT &&
-						tpd_offset_map)
-					{
-						int prev_trans_slot;
-
-						/* Fetch TPD slot from the undo. */
-						if (uur->uur_type == UNDO_UPDATE)
-							prev_trans_slot = *(int *) ((char *) uur->uur_payload.data +
-												sizeof(ItemPointerData));
-						else
-							prev_trans_slot = *(int *) uur->uur_payload.data;
-
-						TPDPageSetOffsetMapSlot(buffer, prev_trans_slot,
-												uur->uur_offset);
-					}
-					else if (uur->uur_info & UREC_INFO_PAYLOAD_CONTAINS_SLOT)
-					{
-						ZHeapTupleHeaderSetXactSlot(zhtup, ZHTUP_SLOT_FROZEN);
-					}
-
-					/*
-					 * We always need to retain the strongest locker
-					 * information on the the tuple (as part of infomask and
-					 * infomask2), if there are multiple lockers on a tuple.
-					 * This is because the conflict detection mechanism works
-					 * based on strongest locker.  See
-					 * zheap_update/zheap_delete.  We have allowed to override
-					 * the transaction slot information with whatever is
-					 * present in undo as we have taken care during DO
-					 * operation that it contains previous strongest locker
-					 * information.  See compute_new_xid_infomask.
-					 */
-					if (ZHeapTupleHasMultiLockers(infomask))
-					{
-						/* ZHeapTupleHeaderSetXactSlot(zhtup, trans_slot); */
-						zhtup->t_infomask |= ZHEAP_MULTI_LOCKERS;
-						zhtup->t_infomask &= ~(zhtup->t_infomask & ZHEAP_LOCK_MASK);
-						zhtup->t_infomask |= infomask & ZHEAP_LOCK_MASK;
-
-						/*
-						 * If the tuple originally has INVALID_XACT_SLOT set,
-						 * then we need to retain it as that must be the information
-						 * of strongest locker.
-						 */
-						if (ZHeapTupleHasInvalidXact(infomask))
-							zhtup->t_infomask |= ZHEAP_INVALID_XACT_SLOT;
-					}
-
-					trans_slot = GetTransactionSlotInfo(buffer,
-														uur->uur_offset,
-														trans_slot,
-														NULL,
-														&slot_xid,
-														NULL,
-														false,
-														false);
-
-					if (TransactionIdEquals(uur->uur_prevxid,
-											FrozenTransactionId))
-					{
-						/*
-						 * If the previous xid is frozen, then we can safely
-						 * mark the tuple as frozen.
-						 */
-						ZHeapTupleHeaderSetXactSlot(zhtup, ZHTUP_SLOT_FROZEN);
-					}
-					else if (trans_slot != ZHTUP_SLOT_FROZEN &&
-								uur->uur_prevxid != slot_xid)
-					{
-						/*
-						 * If the transaction slot to which tuple point got reused
-						 * by this time, then we need to mark the tuple with a
-						 * special flag.  See comments atop PageFreezeTransSlots.
-						 */
-						zhtup->t_infomask |= ZHEAP_INVALID_XACT_SLOT;
-					}
+					while (ZHeapUndoMultiDeleteNext(uur, &pos, &delrec))
+						undo_action_restore_tuple(&delrec, buffer, page,
+												  tpd_offset_map);
 				}
 				break;
 			case UNDO_XID_LOCK_ONLY:
@@ -1024,8 +1390,6 @@ execute_undo_actions_page(List *luinfo, UndoRecPtr urec_ptr, Oid reloid,
 	UnlockReleaseBuffer(buffer);
 	UnlockReleaseTPDBuffers();
 
-	heap_close(rel, NoLock);
-
 	return true;
 }
 
@@ -13,7 +13,9 @@
 
 #include "postgres.h"
 
+#include "access/transam.h"
 #include "access/xact.h"
+#include "access/xlog.h"
 #include "access/undolog.h"
 #include "access/undodiscard.h"
 #include "catalog/pg_tablespace.h"
@@ -23,9 +25,45 @@
 #include "storage/bufmgr.h"
 #include "storage/shmem.h"
 #include "storage/proc.h"
+#include "storage/procarray.h"
+#include "storage/spin.h"
+#include "storage/standby.h"
 #include "utils/resowner.h"
+#include "utils/timestamp.h"
 #include "postmaster/undoloop.h"
 
+/*
+ * Number of (time, xid) samples kept to translate undo_retention into an xid
+ * horizon, and to translate flashback timestamps into xids.
+ */
+#define UNDO_RETENTION_SAMPLES	1024
+
+typedef struct UndoRetentionSample
+{
+	TimestampTz	time;		/* when the sample was taken */
+	uint64		next_xid;	/* epoch-qualified next xid at that time */
+	uint64		oldest_xid;	/* epoch-qualified oldest running xid */
+	int			xcnt;		/* # of xids in xip[], or -1 if too many */
+	TransactionId xip[UNDO_RETENTION_MAX_RUNNING];	/* running xids */
+} UndoRetentionSample;
+
+/*
+ * Ring of samples taken by the undo worker.  Samples are ordered by time,
+ * oldest first starting at 'head'.
+ */
+typedef struct UndoRetentionData
+{
+	slock_t		mutex;		/* protects all the fields below */
+	int			head;		/* index of the oldest sample */
+	int			count;		/* number of valid samples */
+	UndoRetentionSample samples[UNDO_RETENTION_SAMPLES];
+} UndoRetentionData;
+
+static UndoRetentionData *UndoRetention = NULL;
+
+/* GUC variable */
+int			undo_retention = 0;
+
 static UndoRecPtr FetchLatestUndoPtrForXid(UndoRecPtr urecptr,
 										   UnpackedUndoRecord *uur_start,
 										   UndoLogControl *log);
@@ -266,6 +304,9 @@ UndoDiscard(TransactionId oldestXmin, bool *hibernate)
 			oldest_xid = UndoDiscardOneLog(log, oldestXmin, hibernate);
 		}
 
+		/* Drop the undo log if it's exhausted and now entirely discarded. */
+		UndoLogDropExhausted(log);
+
 		if (TransactionIdIsValid(oldest_xid) &&
 			TransactionIdPrecedes(oldest_xid, oldestXidHavingUndo))
 		{
@@ -413,3 +454,225 @@ TempUndoDiscard(UndoLogNumber logno)
 	UndoLogDiscard(MakeUndoRecPtr(log->logno, log->meta.insert),
 				   InvalidTransactionId);
 }
+
+/*
+ * Report shared-memory space needed by UndoRetentionShmemInit.
+ */
+Size
+UndoRetentionShmemSize(void)
+{
+	return sizeof(UndoRetentionData);
+}
+
+/*
+ * Allocate and initialize the undo retention sample ring.
+ */
+void
+UndoRetentionShmemInit(void)
+{
+	bool		found;
+
+	UndoRetention = (UndoRetentionData *)
+		ShmemInitStruct("undo retention samples",
+						UndoRetentionShmemSize(),
+						&found);
+	if (!found)
+	{
+		SpinLockInit(&UndoRetention->mutex);
+		UndoRetention->head = 0;
+		UndoRetention->count = 0;
+	}
+}
+
+/*
+ * Remember which transactions were running at the current time, so that later
+ * we can tell which transactions started within the last undo_retention
+ * seconds, and rebuild the snapshot of that time for flashback queries.
+ *
+ * This is called by the undo worker on each cycle.  Samples are taken at
+ * most once a second, and less often for long retention periods so that the
+ * ring always spans the whole retention period.  Nothing is sampled while
+ * undo_retention is disabled.  If more than UNDO_RETENTION_MAX_RUNNING
+ * transactions are running, only the horizon is kept, and flashback queries
+ * use an older sample.
+ */
+void
+UndoRetentionRecordXid(void)
+{
+	UndoRetentionSample sample;
+	RunningTransactions running;
+	TimestampTz	now;
+	int64		interval_ms;
+	int			newest;
+
+	if (undo_retention <= 0)
+		return;
+
+	now = GetCurrentTimestamp();
+	interval_ms = Max((int64) 1000,
+					  (int64) undo_retention * 1000 / (UNDO_RETENTION_SAMPLES - 1));
+
+	SpinLockAcquire(&UndoRetention->mutex);
+	if (UndoRetention->count > 0)
+	{
+		newest = (UndoRetention->head + UndoRetention->count - 1) %
+			UNDO_RETENTION_SAMPLES;
+		if (!TimestampDifferenceExceeds(UndoRetention->samples[newest].time,
+										now, (int) interval_ms))
+		{
+			SpinLockRelease(&UndoRetention->mutex);
+			return;
+		}
+	}
+	SpinLockRelease(&UndoRetention->mutex);
+
+	/*
+	 * Only top-level xids are needed, as zheap stores those in its
+	 * transaction slots.  They come first in the running xids array.
+	 */
+	running = GetRunningTransactionData();
+	sample.time = now;
+	sample.next_xid = MakeEpochXid((uint64) GetEpochForXid(running->nextXid),
+								   running->nextXid);
+	sample.oldest_xid =
+		MakeEpochXid((uint64) GetEpochForXid(running->oldestRunningXid),
+					 running->oldestRunningXid);
+	if (running->xcnt <= UNDO_RETENTION_MAX_RUNNING)
+	{
+		sample.xcnt = running->xcnt;
+		memcpy(sample.xip, running->xids,
+			   running->xcnt * sizeof(TransactionId));
+	}
+	else
+		sample.xcnt = -1;
+	LWLockRelease(XidGenLock);
+	LWLockRelease(ProcArrayLock);
+
+	SpinLockAcquire(&UndoRetention->mutex);
+	if (UndoRetention->count < UNDO_RETENTION_SAMPLES)
+		UndoRetention->count++;
+	else
+		UndoRetention->head = (UndoRetention->head + 1) % UNDO_RETENTION_SAMPLES;
+	newest = (UndoRetention->head + UndoRetention->count - 1) %
+		UNDO_RETENTION_SAMPLES;
+	UndoRetention->samples[newest] = sample;
+	SpinLockRelease(&UndoRetention->mutex);
+}
+
+/*
+ * Find the newest sample taken at or before 'time' and before 'epoch_xid' was
+ * assigned.
+ *
+ * Returns the position of the sample counting from the oldest one, or -1 if
+ * there is no such sample.  Caller must hold the mutex.
+ */
+static int
+UndoRetentionFindSample(TimestampTz time, uint64 epoch_xid)
+{
+	int			low = 0;
+	int			high = UndoRetention->count - 1;
+	int			found = -1;
+
+	/* Samples are ordered by both time and xid, so binary search the ring. */
+	while (low <= high)
+	{
+		int			mid = low + (high - low) / 2;
+		int			idx = (UndoRetention->head + mid) % UNDO_RETENTION_SAMPLES;
+
+		if (UndoRetention->samples[idx].time <= time &&
+			UndoRetention->samples[idx].next_xid <= epoch_xid)
+		{
+			found = mid;
+			low = mid + 1;
+		}
+		else
+			high = mid - 1;
+	}
+
+	return found;
+}
+
+/*
+ * Compute the xid below which undo may be discarded.
+ *
+ * Normally that's oldestXmin.  With undo_retention set, undo of transactions
+ * that were running within the last undo_retention seconds is kept as well,
+ * so that flashback queries can reconstruct the old tuple versions.  If the
+ * samples don't reach back that far yet, we keep everything since the oldest
+ * sample.
+ */
+TransactionId
+UndoRetentionGetDiscardHorizon(TransactionId oldestXmin)
+{
+	int			pos;
+	uint64		oldest_xid;
+	TransactionId retained_xid;
+
+	if (undo_retention <= 0 || !TransactionIdIsNormal(oldestXmin))
+		return oldestXmin;
+
+	SpinLockAcquire(&UndoRetention->mutex);
+	if (UndoRetention->count == 0)
+	{
+		SpinLockRelease(&UndoRetention->mutex);
+		return oldestXmin;
+	}
+	pos = UndoRetentionFindSample(
+				TimestampTzPlusMilliseconds(GetCurrentTimestamp(),
+											-((int64) undo_retention * 1000)),
+				PG_UINT64_MAX);
+	if (pos < 0)
+		pos = 0;
+	oldest_xid = UndoRetention->samples[(UndoRetention->head + pos) %
+										UNDO_RETENTION_SAMPLES].oldest_xid;
+	SpinLockRelease(&UndoRetention->mutex);
+
+	retained_xid = GetXidFromEpochXid(oldest_xid);
+	if (TransactionIdIsNormal(retained_xid) &&
+		TransactionIdPrecedes(retained_xid, oldestXmin))
+		return retained_xid;
+
+	return oldestXmin;
+}
+
+/*
+ * Rebuild the snapshot of a past point in time, for flashback queries.
+ *
+ * This uses the newest sample taken at or before 'time' and before
+ * 'epoch_xid' was assigned, skipping samples that had too many transactions
+ * running, so it reflects a point in time no later than the requested one.
+ * The xmin, xmax and xip fields of 'snapshot' are set; xip must have room
+ * for UNDO_RETENTION_MAX_RUNNING xids.  The epoch-qualified xmin is returned
+ * in *epoch_xmin, as the undo of transactions from there on is needed to
+ * scan with the snapshot.  Returns false if no sample is that old.
+ */
+bool
+UndoRetentionGetSnapshot(TimestampTz time, uint64 epoch_xid,
+						 Snapshot snapshot, uint64 *epoch_xmin)
+{
+	int			pos;
+	bool		found = false;
+
+	SpinLockAcquire(&UndoRetention->mutex);
+	for (pos = UndoRetentionFindSample(time, epoch_xid); pos >= 0; pos--)
+	{
+		UndoRetentionSample *sample;
+
+		sample = &UndoRetention->samples[(UndoRetention->head + pos) %
+										 UNDO_RETENTION_SAMPLES];
+		if (sample->xcnt < 0)
+			continue;
+
+		snapshot->xmin = GetXidFromEpochXid(sample->oldest_xid);
+		snapshot->xmax = GetXidFromEpochXid(sample->next_xid);
+		snapshot->xcnt = sample->xcnt;
+		memcpy(snapshot->xip, sample->xip,
+			   sample->xcnt * sizeof(TransactionId));
+		*epoch_xmin = sample->oldest_xid;
+		found = true;
+		break;
+	}
+	SpinLockRelease(&UndoRetention->mutex);
+
+	return found;
+}
@@ -99,6 +99,13 @@ static int	max_prepare_undo = MAX_PREPARED_UNDO;
 static UndoRecPtr	multi_prep_urp = InvalidUndoRecPtr;
 static bool	update_prev_header = false;
 
+/*
+ * Number of undo records read by UndoFetchRecord in this backend.  Callers
+ * that know the relation the records are fetched for, such as zheap scans,
+ * attribute the difference to it in the table statistics.
+ */
+uint64		UndoRecordsFetched = 0;
+
 /*
  * By default prepared_undo and undo_buffer points to the static memory.
  * In case caller wants to support more than default max_prepared undo records
@@ -1038,6 +1045,7 @@ UndoFetchRecord(UndoRecPtr urp, BlockNumber blkno, OffsetNumber offset,
 		/* Fetch the current undo record. */
 		urec = UndoGetOneRecord(urec, urp, rnode, log->meta.persistence);
 		LWLockRelease(&log->discard_lock);
+		UndoRecordsFetched++;
 
 		if (blkno == InvalidBlockNumber)
 			break;
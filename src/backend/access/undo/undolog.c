@@ -38,6 +38,7 @@
 #include "storage/fd.h"
 #include "storage/ipc.h"
 #include "storage/lwlock.h"
+#include "storage/proc.h"
 #include "storage/procarray.h"
 #include "storage/shmem.h"
 #include "storage/standby.h"
@@ -45,6 +46,7 @@
 #include "utils/builtins.h"
 #include "utils/guc.h"
 #include "utils/memutils.h"
+#include "utils/timestamp.h"
 #include "utils/varlena.h"
 
 #include <sys/stat.h>
@@ -92,11 +94,20 @@
 typedef struct UndoLogSharedData
 {
 	UndoLogNumber free_lists[UndoPersistenceLevels];
+	int num_free[UndoPersistenceLevels]; /* length of each free list */
+	int num_attached[UndoPersistenceLevels]; /* undo logs attached to backends */
 	int low_bankno; /* the lowest bank */
 	int high_bankno; /* one past the highest bank */
 	UndoLogNumber low_logno; /* the lowest logno */
 	UndoLogNumber high_logno; /* one past the highest logno */
 
+	/*
+	 * The undo checkpoint file most recently written (or read at startup),
+	 * and the number of files in its chain.  Protected by UndoCheckPointLock.
+	 */
+	XLogRecPtr	checkpoint_redo;
+	int			checkpoint_chain_length;
+
 	/*
 	 * Array of DSM handles pointing to the arrays of UndoLogControl objects.
 	 * We don't expect there to be many banks active at a time -- usually 1 or
@@ -159,11 +170,26 @@ struct
 
 /* GUC variables */
 char	   *undo_tablespaces = NULL;
+int			max_standby_undo_discard_delay = 30 * 1000;
+int			max_active_undo_logs = 0;
+
+/*
+ * Startup process state for discards deferred on a hot standby, and the
+ * oldest xid having undo held back while they are.
+ */
+static bool have_deferred_discards = false;
+static uint64 deferred_oldest_xid_having_undo = InvalidTransactionId;
+static TimestampTz deferred_last_check = 0;
+
+/* How often the startup process rechecks deferred discards, in ms. */
+#define UNDO_DEFERRED_DISCARD_CHECK_INTERVAL	100
 
 static UndoLogControl *get_undo_log_by_number(UndoLogNumber logno);
 static void ensure_undo_log_number(UndoLogNumber logno);
 static void attach_undo_log(UndoPersistence level, Oid tablespace);
 static void detach_current_undo_log(UndoPersistence level, bool exhausted);
+static void release_undo_log(UndoLogControl *log, UndoPersistence persistence);
+static void drop_undo_log(UndoLogControl *log);
 static void extend_undo_log(UndoLogNumber logno, UndoLogOffset new_end);
 static void undo_log_before_exit(int code, Datum value);
 static void forget_undo_buffers(int logno, UndoLogOffset old_discard,
@@ -174,6 +200,7 @@ static void undolog_xid_map_gc(void);
 static void undolog_bank_gc(void);
 
 PG_FUNCTION_INFO_V1(pg_stat_get_undo_logs);
+PG_FUNCTION_INFO_V1(pg_stat_get_undo_deferred_discard);
 
 /*
  * Return the amount of traditional smhem required for undo log management.
@@ -451,19 +478,87 @@ detach_current_undo_log(UndoPersistence persistence, bool exhausted)
 	MyUndoLogState.logs[persistence] = NULL;
 
 	LWLockAcquire(&log->mutex, LW_EXCLUSIVE);
+	if (log->pid != MyProcPid)
+	{
+		/* DROP TABLESPACE has already detached us forcibly. */
+		LWLockRelease(&log->mutex);
+		return;
+	}
 	log->pid = InvalidPid;
 	log->xid = InvalidTransactionId;
 	if (exhausted)
 		log->meta.status = UNDO_LOG_STATUS_EXHAUSTED;
 	LWLockRelease(&log->mutex);
 
-	/* Push back onto the appropriate freelist. */
-	if (!exhausted)
+	if (exhausted)
 	{
 		LWLockAcquire(UndoLogLock, LW_EXCLUSIVE);
+		--shared->num_attached[persistence];
+		LWLockRelease(UndoLogLock);
+	}
+	else
+		release_undo_log(log, persistence);
+}
+
+/*
+ * Give back an undo log that has just been detached from a backend.
+ *
+ * Normally it goes back onto the free list for its persistence level, so
+ * that the next backend to attach can carry on filling it.  But if that
+ * would leave more than max_active_undo_logs undo logs of this persistence
+ * level attached or free, it is retired instead: it is marked exhausted so
+ * that no one attaches to it again, and the undo worker drops it once all of
+ * its undo has been discarded.  Temporary undo logs are never retired, since
+ * undo workers can't discard them.
+ */
+static void
+release_undo_log(UndoLogControl *log, UndoPersistence persistence)
+{
+	UndoLogSharedData *shared = MyUndoLogState.shared;
+	bool	retire;
+
+	LWLockAcquire(UndoLogLock, LW_EXCLUSIVE);
+	--shared->num_attached[persistence];
+	retire = max_active_undo_logs > 0 && persistence != UNDO_TEMP &&
+		shared->num_attached[persistence] + shared->num_free[persistence] >=
+		max_active_undo_logs;
+	if (!retire)
+	{
 		log->next_free = shared->free_lists[persistence];
 		shared->free_lists[persistence] = log->logno;
-		LWLockRelease(UndoLogLock);
+		++shared->num_free[persistence];
+	}
+	LWLockRelease(UndoLogLock);
+
+	/* No one else can see this undo log now, so there's no race here. */
+	if (retire)
+	{
+		LWLockAcquire(&log->mutex, LW_EXCLUSIVE);
+		log->meta.status = UNDO_LOG_STATUS_EXHAUSTED;
+		LWLockRelease(&log->mutex);
+	}
+}
+
+/*
+ * Called when a backend goes idle between transactions.  If undo log pooling
+ * is enabled with max_active_undo_logs, detach from our undo logs so that
+ * other backends can reuse them; this way the number of undo logs follows
+ * the number of concurrently writing transactions rather than the number of
+ * sessions.  Temporary undo logs stay attached, because their buffers are
+ * local to this backend.
+ */
+void
+UndoLogDetachIdle(void)
+{
+	int		i;
+
+	if (max_active_undo_logs == 0)
+		return;
+
+	for (i = 0; i < UndoPersistenceLevels; ++i)
+	{
+		if (i != UNDO_TEMP && MyUndoLogState.logs[i] != NULL)
+			detach_current_undo_log(i, false);
 	}
 }
 
@@ -485,7 +580,7 @@ undo_log_before_exit(int code, Datum arg)
  */
 static void
 allocate_empty_undo_segment(UndoLogNumber logno, Oid tablespace,
-							UndoLogOffset end)
+							UndoLogOffset end, bool skip_fsync)
 {
 	struct stat	stat_buffer;
 	off_t	size;
@@ -583,8 +678,11 @@ allocate_empty_undo_segment(UndoLogNumber logno, Oid tablespace,
 		size += written;
 	}
 
-	/* Flush the contents of the file to disk. */
-	if (pg_fsync(fd) != 0)
+	/*
+	 * Flush the contents of the file to disk, unless it belongs to a
+	 * temporary undo log whose contents don't need to survive a crash.
+	 */
+	if (!skip_fsync && pg_fsync(fd) != 0)
 		elog(ERROR, "cannot fsync file \"%s\": %m", path);
 	CloseTransientFile(fd);
 
@@ -600,7 +698,8 @@ void
 UndoLogNewSegment(UndoLogNumber logno, Oid tablespace, int segno)
 {
 	Assert(InRecovery);
-	allocate_empty_undo_segment(logno, tablespace, segno * UndoLogSegmentSize);
+	allocate_empty_undo_segment(logno, tablespace, segno * UndoLogSegmentSize,
+								false);
 }
 
 /*
@@ -613,6 +712,7 @@ extend_undo_log(UndoLogNumber logno, UndoLogOffset new_end)
 	UndoLogControl *log;
 	char		dir[MAXPGPATH];
 	size_t		end;
+	bool		temp;
 
 	log = get_undo_log_by_number(logno);
 
@@ -621,6 +721,8 @@ extend_undo_log(UndoLogNumber logno, UndoLogOffset new_end)
 	Assert(new_end % UndoLogSegmentSize == 0);
 	Assert(MyUndoLogState.logs[log->meta.persistence] == log || InRecovery);
 
+	temp = log->meta.persistence == UNDO_TEMP;
+
 	/*
 	 * Create all the segments needed to increase 'end' to the requested
 	 * size.  This is quite expensive, so we will try to avoid it completely
@@ -629,7 +731,8 @@ extend_undo_log(UndoLogNumber logno, UndoLogOffset new_end)
 	end = log->meta.end;
 	while (end < new_end)
 	{
-		allocate_empty_undo_segment(logno, log->meta.tablespace, end);
+		allocate_empty_undo_segment(logno, log->meta.tablespace, end,
+									temp);
 		end += UndoLogSegmentSize;
 	}
 
@@ -639,8 +742,11 @@ extend_undo_log(UndoLogNumber logno, UndoLogOffset new_end)
 	 * Flush the parent dir so that the directory metadata survives a crash
 	 * after this point.
 	 */
-	UndoLogDirectory(log->meta.tablespace, dir);
-	fsync_fname(dir, true);
+	if (!temp)
+	{
+		UndoLogDirectory(log->meta.tablespace, dir);
+		fsync_fname(dir, true);
+	}
 
 	/*
 	 * If we're not in recovery, we need to WAL-log the creation of the new
@@ -650,8 +756,12 @@ extend_undo_log(UndoLogNumber logno, UndoLogOffset new_end)
 	 * us to crash having made some or all of the filesystem changes but
 	 * before WAL logging, but in that case we'll eventually try to create the
 	 * same segment(s) again which is tolerated.
+	 *
+	 * Temporary undo logs are never WAL-logged beyond their creation: their
+	 * segment files are simply removed by ResetUndoLogs() after a crash, so
+	 * there is nothing for recovery to recreate.
 	 */
-	if (!InRecovery)
+	if (!InRecovery && !temp)
 	{
 		xl_undolog_extend xlrec;
 		XLogRecPtr	ptr;
@@ -774,6 +884,7 @@ UndoLogAllocate(size_t size, UndoPersistence persistence)
 		if (log->pid == InvalidPid)
 		{
 			LWLockRelease(&log->mutex);
+			MyUndoLogState.logs[persistence] = NULL;
 			log = NULL;
 			goto retry;
 		}
@@ -971,11 +1082,14 @@ UndoLogDiscard(UndoRecPtr discard_point, TransactionId xid)
 	int		segno;
 	int		new_segno;
 	bool		need_to_flush_wal = false;
+	bool		temp;
 
 	if (log == NULL)
 		elog(ERROR, "cannot advance discard pointer for unknown undo log %d",
 			 logno);
 
+	temp = log->meta.persistence == UNDO_TEMP;
+
 	LWLockAcquire(&log->mutex, LW_EXCLUSIVE);
 	if (discard > log->meta.insert)
 		elog(ERROR, "cannot move discard point past insert point");
@@ -1061,11 +1175,13 @@ UndoLogDiscard(UndoRecPtr discard_point, TransactionId xid)
 
 			/*
 			 * Before removing the file, make sure that undofile_sync knows
-			 * that it might be missing.
+			 * that it might be missing.  Temporary undo is never fsync'd, so
+			 * there can't be a request to forget.
 			 */
-			undofile_forgetsync(log->logno,
-								log->meta.tablespace,
-								pointer / UndoLogSegmentSize);
+			if (!temp)
+				undofile_forgetsync(log->logno,
+									log->meta.tablespace,
+									pointer / UndoLogSegmentSize);
 
 			UndoLogSegmentPath(logno, pointer / UndoLogSegmentSize,
 							   log->meta.tablespace, discard_path);
@@ -1104,7 +1220,13 @@ UndoLogDiscard(UndoRecPtr discard_point, TransactionId xid)
 		}
 	}
 
-	/* WAL log the discard. */
+	/*
+	 * WAL log the discard.  Temporary undo logs are discarded by their owner
+	 * at the end of each transaction; logging that would make otherwise
+	 * WAL-free transactions flush WAL at commit, and recovery has no use for
+	 * it since ResetUndoLogs() throws all temporary undo away.
+	 */
+	if (!temp)
 	{
 		xl_undolog_discard xlrec;
 		XLogRecPtr ptr;
@@ -1129,6 +1251,85 @@ UndoLogDiscard(UndoRecPtr discard_point, TransactionId xid)
 	LWLockRelease(&log->mutex);
 }
 
+/*
+ * Drop an exhausted undo log once all of its undo has been discarded,
+ * removing its remaining segment files.  This is how undo logs retired by
+ * release_undo_log() (or filled up entirely) go away, which in turn allows
+ * CheckPointUndoLogs() to forget about them.  Does nothing for other undo
+ * logs.
+ */
+void
+UndoLogDropExhausted(UndoLogControl *log)
+{
+	xl_undolog_drop xlrec;
+	XLogRecPtr	ptr;
+	bool		drop;
+
+	LWLockAcquire(&log->mutex, LW_SHARED);
+	drop = log->meta.status == UNDO_LOG_STATUS_EXHAUSTED &&
+		log->pid == InvalidPid &&
+		log->meta.discard == log->meta.insert;
+	LWLockRelease(&log->mutex);
+
+	if (!drop)
+		return;
+
+	/*
+	 * WAL-log the drop before removing any files, so that recovery never
+	 * expects the undo log to be usable once they're gone.
+	 */
+	xlrec.logno = log->logno;
+
+	XLogBeginInsert();
+	XLogRegisterData((char *) &xlrec, sizeof(xlrec));
+	ptr = XLogInsert(RM_UNDOLOG_ID, XLOG_UNDOLOG_DROP);
+	XLogFlush(ptr);
+
+	drop_undo_log(log);
+}
+
+/*
+ * Remove the segment files of an undo log whose undo has been entirely
+ * discarded, and mark it as discarded.
+ */
+static void
+drop_undo_log(UndoLogControl *log)
+{
+	UndoLogOffset discard;
+	UndoLogOffset end;
+	UndoLogOffset segment_begin;
+	char	dir[MAXPGPATH];
+
+	LWLockAcquire(&log->mutex, LW_SHARED);
+	discard = log->meta.discard;
+	end = log->meta.end;
+	LWLockRelease(&log->mutex);
+
+	/* The page holding the discard pointer is the only one left. */
+	forget_undo_buffers(log->logno, discard, discard, true);
+
+	for (segment_begin = discard - discard % UndoLogSegmentSize;
+		 segment_begin < end;
+		 segment_begin += UndoLogSegmentSize)
+	{
+		char	path[MAXPGPATH];
+
+		undofile_forgetsync(log->logno, log->meta.tablespace,
+							segment_begin / UndoLogSegmentSize);
+		UndoLogSegmentPath(log->logno, segment_begin / UndoLogSegmentSize,
+						   log->meta.tablespace, path);
+		if (unlink(path) != 0 && errno != ENOENT)
+			elog(LOG, "could not unlink \"%s\": %m", path);
+	}
+
+	UndoLogDirectory(log->meta.tablespace, dir);
+	fsync_fname(dir, true);
+
+	LWLockAcquire(&log->mutex, LW_EXCLUSIVE);
+	log->meta.status = UNDO_LOG_STATUS_DISCARDED;
+	LWLockRelease(&log->mutex);
+}
+
 Oid
 UndoRecPtrGetTablespace(UndoRecPtr ptr)
 {
@@ -1209,7 +1410,8 @@ UndoLogRewind(UndoRecPtr insert_urp, uint16 prevlen)
 	log->need_attach_wal_record = true;
 	LWLockRelease(&log->mutex);
 
-	/* WAL log the rewind. */
+	/* WAL log the rewind, unless temporary (see UndoLogDiscard()). */
+	if (log->meta.persistence != UNDO_TEMP)
 	{
 		xl_undolog_rewind xlrec;
 
@@ -1223,9 +1425,103 @@ UndoLogRewind(UndoRecPtr insert_urp, uint16 prevlen)
 	}
 }
 
+/*
+ * Undo checkpoint files.
+ *
+ * Each file starts with a header, followed by an entry for each undo log it
+ * covers and a CRC of the entries.  A full file has an entry for every undo
+ * log in [low_logno, high_logno).  A delta file only has entries for the undo
+ * logs whose meta data changed since the file it is based on, named by
+ * base_redo, which may in turn be a delta file.  The chain of delta files is
+ * bounded by writing a full file every UNDO_CHECKPOINT_MAX_CHAIN files, or
+ * whenever most of the logs have changed anyway.
+ */
+typedef struct UndoCheckPointHeader
+{
+	UndoLogNumber low_logno;
+	UndoLogNumber high_logno;
+	XLogRecPtr	base_redo;		/* InvalidXLogRecPtr for a full file */
+	uint32		num_entries;
+	pg_crc32c	crc;			/* CRC of the fields above */
+} UndoCheckPointHeader;
+
+typedef struct UndoCheckPointEntry
+{
+	UndoLogNumber logno;
+	UndoLogMetaData meta;
+} UndoCheckPointEntry;
+
+#define UNDO_CHECKPOINT_MAX_CHAIN	16
+
+/*
+ * Read the undo checkpoint file for the given redo point, and also its
+ * entries if entries is not NULL.  If missing_ok, return false if the file
+ * doesn't exist; any other problem is an error.
+ */
+static bool
+read_undo_checkpoint_file(XLogRecPtr redo, UndoCheckPointHeader *header,
+						  UndoCheckPointEntry **entries, bool missing_ok)
+{
+	char	path[MAXPGPATH];
+	int		fd;
+	pg_crc32c crc;
+
+	snprintf(path, MAXPGPATH, "pg_undo/%016" INT64_MODIFIER "X", redo);
+	pgstat_report_wait_start(WAIT_EVENT_UNDO_CHECKPOINT_READ);
+	fd = OpenTransientFile(path, O_RDONLY | PG_BINARY);
+	if (fd < 0)
+	{
+		pgstat_report_wait_end();
+		if (missing_ok && errno == ENOENT)
+			return false;
+		elog(ERROR, "cannot open undo checkpoint snapshot \"%s\": %m", path);
+	}
+
+	/* Read and verify the header. */
+	if (read(fd, header, sizeof(*header)) != sizeof(*header))
+		elog(ERROR, "pg_undo file \"%s\" is corrupted", path);
+	INIT_CRC32C(crc);
+	COMP_CRC32C(crc, header, offsetof(UndoCheckPointHeader, crc));
+	FIN_CRC32C(crc);
+	if (crc != header->crc)
+		elog(ERROR,
+			 "pg_undo file \"%s\" has incorrect checksum", path);
+	if (header->high_logno < header->low_logno ||
+		(header->base_redo == InvalidXLogRecPtr &&
+		 header->num_entries != header->high_logno - header->low_logno) ||
+		(header->base_redo != InvalidXLogRecPtr && header->base_redo >= redo))
+		elog(ERROR, "pg_undo file \"%s\" is corrupted", path);
+
+	/* Read and verify the entries. */
+	if (entries != NULL)
+	{
+		size_t	size = sizeof(UndoCheckPointEntry) * header->num_entries;
+		pg_crc32c	new_crc;
+
+		*entries = palloc(Max(size, 1));
+		if (read(fd, *entries, size) != size)
+			elog(ERROR, "corrupted pg_undo meta data in file \"%s\": %m",
+				 path);
+		if (read(fd, &crc, sizeof(crc)) != sizeof(crc))
+			elog(ERROR, "pg_undo file \"%s\" is corrupted", path);
+		INIT_CRC32C(new_crc);
+		COMP_CRC32C(new_crc, *entries, size);
+		FIN_CRC32C(new_crc);
+		if (crc != new_crc)
+			elog(ERROR,
+				 "pg_undo file \"%s\" has incorrect checksum", path);
+	}
+
+	CloseTransientFile(fd);
+	pgstat_report_wait_end();
+
+	return true;
+}
+
 /*
  * Delete unreachable files under pg_undo.  Any files corresponding to LSN
- * positions before the previous checkpoint are no longer needed.
+ * positions before the previous checkpoint are no longer needed, except for
+ * those that the previous checkpoint's file is based on.
  */
 static void
 CleanUpUndoCheckPointFiles(XLogRecPtr checkPointRedo)
@@ -1234,6 +1530,8 @@ CleanUpUndoCheckPointFiles(XLogRecPtr checkPointRedo)
 	struct dirent *de;
 	char	path[MAXPGPATH];
 	char	oldest_path[MAXPGPATH];
+	XLogRecPtr	oldest_redo = checkPointRedo;
+	int		i;
 
 	/*
 	 * If a base backup is in progress, we can't delete any checkpoint
@@ -1243,9 +1541,20 @@ CleanUpUndoCheckPointFiles(XLogRecPtr checkPointRedo)
 	if (BackupInProgress())
 		return;
 
-	/* Otherwise keep only those >= the previous checkpoint's redo point. */
+	/* Find the oldest file the previous checkpoint's file depends on. */
+	for (i = 0; i < UNDO_CHECKPOINT_MAX_CHAIN; ++i)
+	{
+		UndoCheckPointHeader header;
+
+		if (!read_undo_checkpoint_file(oldest_redo, &header, NULL, true) ||
+			header.base_redo == InvalidXLogRecPtr)
+			break;
+		oldest_redo = header.base_redo;
+	}
+
+	/* Otherwise keep only those >= that file. */
 	snprintf(oldest_path, MAXPGPATH, "%016" INT64_MODIFIER "X",
-			 checkPointRedo);
+			 oldest_redo);
 	dir = AllocateDir("pg_undo");
 	while ((de = ReadDir(dir, "pg_undo")) != NULL)
 	{
@@ -1273,22 +1582,37 @@ CleanUpUndoCheckPointFiles(XLogRecPtr checkPointRedo)
  * contents of undo logs is in shared buffers and therefore handled by
  * CheckPointBuffers(), but here we record the table of undo logs and their
  * properties.
+ *
+ * Usually only the logs whose meta data changed since the previous
+ * checkpoint are written, as a delta on the previous checkpoint's file.
  */
 void
 CheckPointUndoLogs(XLogRecPtr checkPointRedo, XLogRecPtr priorCheckPointRedo)
 {
 	UndoLogSharedData *shared = MyUndoLogState.shared;
-	UndoLogMetaData *serialized = NULL;
+	UndoCheckPointHeader header;
+	UndoCheckPointEntry *entries = NULL;
+	bool   *changed = NULL;
 	UndoLogNumber low_logno;
 	UndoLogNumber high_logno;
 	UndoLogNumber logno;
-	size_t	serialized_size = 0;
+	size_t	serialized_size;
 	char   *data;
 	char	path[MAXPGPATH];
 	int		num_logs;
+	int		num_changed = 0;
+	bool	full;
 	int		fd;
+	int		i;
 	pg_crc32c crc;
 
+	/*
+	 * During recovery, both the startup process (replaying checkpoints) and
+	 * the checkpointer (performing restartpoints) can get here.  Serialize
+	 * them, since each file may be based on the one written before it.
+	 */
+	LWLockAcquire(UndoCheckPointLock, LW_EXCLUSIVE);
+
 	/*
 	 * Take this opportunity to check if we can free up any DSM segments and
 	 * also some entries in the checkpoint file by forgetting about entirely
@@ -1314,78 +1638,117 @@ CheckPointUndoLogs(XLogRecPtr checkPointRedo, XLogRecPtr priorCheckPointRedo)
 
 		++shared->low_logno;
 	}
-	LWLockRelease(UndoLogLock);
-
-	/* Detach from any banks that we don't need if low_logno advanced. */
-	undolog_bank_gc();
 
 	/*
-	 * We acquire UndoLogLock to prevent any undo logs from being created or
-	 * discarded while we build a snapshot of them.  This isn't expected to
-	 * take long on a healthy system because the number of active logs should
-	 * be around the number of backends.  Holding this lock won't prevent
-	 * concurrent access to the undo log, except when segments need to be
-	 * added or removed.
+	 * Find the range of logs to write out.  We don't need to hold UndoLogLock
+	 * while we build a snapshot of them: only we advance low_logno, and logs
+	 * created after we've read high_logno will be recreated by replaying the
+	 * WAL that created them.
 	 */
-	LWLockAcquire(UndoLogLock, LW_SHARED);
-
 	low_logno = shared->low_logno;
 	high_logno = shared->high_logno;
+	LWLockRelease(UndoLogLock);
+
+	/* Detach from any banks that we don't need if low_logno advanced. */
+	undolog_bank_gc();
+
 	num_logs = high_logno - low_logno;
 
 	/*
-	 * Rather than doing the file IO while we hold the lock, we'll copy it
-	 * into a palloc'd buffer.
+	 * Rather than doing the file IO while we hold the per-log locks, we'll
+	 * copy the meta data into a palloc'd buffer, noting which logs have
+	 * changed since they were last written out.
 	 */
 	if (num_logs > 0)
 	{
-		serialized_size = sizeof(UndoLogMetaData) * num_logs;
-		serialized = (UndoLogMetaData *) palloc0(serialized_size);
+		entries = (UndoCheckPointEntry *)
+			palloc0(sizeof(UndoCheckPointEntry) * num_logs);
+		changed = (bool *) palloc0(sizeof(bool) * num_logs);
+	}
 
-		for (logno = low_logno; logno != high_logno; ++logno)
-		{
-			UndoLogControl *log;
+	for (logno = low_logno; logno != high_logno; ++logno)
+	{
+		UndoCheckPointEntry *entry = &entries[logno - low_logno];
+		UndoLogControl *log;
 
-			log = get_undo_log_by_number(logno);
-			if (log == NULL) /* XXX can this happen? */
-				continue;
+		entry->logno = logno;
 
-			/* Capture snapshot while holding the mutex. */
-			LWLockAcquire(&log->mutex, LW_EXCLUSIVE);
-			log->need_attach_wal_record = true;
-			memcpy(&serialized[logno], &log->meta, sizeof(UndoLogMetaData));
-			LWLockRelease(&log->mutex);
+		/*
+		 * Every log in the range exists: a log's bank is set up before
+		 * high_logno moves past it, and is given up only when low_logno
+		 * moves past it, which only we do.
+		 */
+		log = get_undo_log_by_number(logno);
+		Assert(log != NULL);
+
+		/* Capture snapshot while holding the mutex. */
+		LWLockAcquire(&log->mutex, LW_EXCLUSIVE);
+		log->need_attach_wal_record = true;
+		memcpy(&entry->meta, &log->meta, sizeof(UndoLogMetaData));
+		LWLockRelease(&log->mutex);
+
+		if (!log->meta_checkpointed ||
+			memcmp(&entry->meta, &log->checkpointed_meta,
+				   sizeof(UndoLogMetaData)) != 0)
+		{
+			changed[logno - low_logno] = true;
+			++num_changed;
 		}
 	}
 
-	LWLockRelease(UndoLogLock);
+	/*
+	 * Write a full file if there's no previous file to base a delta on, if
+	 * the chain has grown long, or if most logs have changed anyway.  We also
+	 * rewrite a file in full when replaying a checkpoint that we've already
+	 * written a file for, so that a file can never be based on itself.
+	 */
+	full = shared->checkpoint_chain_length == 0 ||
+		shared->checkpoint_chain_length >= UNDO_CHECKPOINT_MAX_CHAIN ||
+		shared->checkpoint_redo >= checkPointRedo ||
+		num_changed * 2 > num_logs;
+
+	memset(&header, 0, sizeof(header));
+	header.low_logno = low_logno;
+	header.high_logno = high_logno;
+	if (full)
+	{
+		header.base_redo = InvalidXLogRecPtr;
+		header.num_entries = num_logs;
+	}
+	else
+	{
+		/* Keep only the entries of the logs that changed. */
+		header.base_redo = shared->checkpoint_redo;
+		header.num_entries = 0;
+		for (i = 0; i < num_logs; ++i)
+		{
+			if (changed[i])
+				entries[header.num_entries++] = entries[i];
+		}
+	}
+	INIT_CRC32C(header.crc);
+	COMP_CRC32C(header.crc, &header, offsetof(UndoCheckPointHeader, crc));
+	FIN_CRC32C(header.crc);
 
 	/* Dump into a file under pg_undo. */
 	snprintf(path, MAXPGPATH, "pg_undo/%016" INT64_MODIFIER "X",
 			 checkPointRedo);
 	pgstat_report_wait_start(WAIT_EVENT_UNDO_CHECKPOINT_WRITE);
-	fd = OpenTransientFile(path, O_RDWR | O_CREAT | PG_BINARY);
+	fd = OpenTransientFile(path, O_RDWR | O_CREAT | O_TRUNC | PG_BINARY);
 	if (fd < 0)
 		ereport(ERROR,
 				(errcode_for_file_access(),
 				 errmsg("could not create file \"%s\": %m", path)));
 
-	/* Compute header checksum. */
-	INIT_CRC32C(crc);
-	COMP_CRC32C(crc, &low_logno, sizeof(low_logno));
-	COMP_CRC32C(crc, &high_logno, sizeof(high_logno));
-	FIN_CRC32C(crc);
-
-	/* Write out range of active log numbers + crc. */
-	if ((write(fd, &low_logno, sizeof(low_logno)) != sizeof(low_logno)) ||
-		(write(fd, &high_logno, sizeof(high_logno)) != sizeof(high_logno)) ||
-		(write(fd, &crc, sizeof(crc)) != sizeof(crc)))
+	/* Write out the header. */
+	if (write(fd, &header, sizeof(header)) != sizeof(header))
 		ereport(ERROR,
 				(errcode_for_file_access(),
 				 errmsg("could not write to file \"%s\": %m", path)));
 
-	/* Write out the meta data for all undo logs in that range. */
-	data = (char *) serialized;
+	/* Write out the meta data for the undo logs we've selected. */
+	serialized_size = sizeof(UndoCheckPointEntry) * header.num_entries;
+	data = (char *) entries;
 	INIT_CRC32C(crc);
 	while (serialized_size > 0)
 	{
@@ -1415,10 +1778,32 @@ CheckPointUndoLogs(XLogRecPtr checkPointRedo, XLogRecPtr priorCheckPointRedo)
 	fsync_fname("pg_undo", true);
 	pgstat_report_wait_end();
 
-	if (serialized)
-		pfree(serialized);
+	/*
+	 * Now that the file is safely on disk, remember what it contains so that
+	 * the next checkpoint can be written as a delta on it.
+	 */
+	for (i = 0; i < header.num_entries; ++i)
+	{
+		UndoLogControl *log = get_undo_log_by_number(entries[i].logno);
+
+		if (log == NULL)
+			continue;
+		memcpy(&log->checkpointed_meta, &entries[i].meta,
+			   sizeof(UndoLogMetaData));
+		log->meta_checkpointed = true;
+	}
+	shared->checkpoint_redo = checkPointRedo;
+	shared->checkpoint_chain_length =
+		full ? 1 : shared->checkpoint_chain_length + 1;
+
+	if (entries)
+		pfree(entries);
+	if (changed)
+		pfree(changed);
 
 	CleanUpUndoCheckPointFiles(priorCheckPointRedo);
+	LWLockRelease(UndoCheckPointLock);
+
 	undolog_xid_map_gc();
 }
 
@@ -1426,57 +1811,79 @@ void
 StartupUndoLogs(XLogRecPtr checkPointRedo)
 {
 	UndoLogSharedData *shared = MyUndoLogState.shared;
-	char	path[MAXPGPATH];
+	UndoCheckPointHeader headers[UNDO_CHECKPOINT_MAX_CHAIN];
+	UndoCheckPointEntry *entries[UNDO_CHECKPOINT_MAX_CHAIN];
+	UndoLogMetaData *metas;
+	bool   *present;
+	XLogRecPtr	redo = checkPointRedo;
+	int		chain_length = 0;
+	int		num_logs;
 	int		logno;
-	int		fd;
-	pg_crc32c crc;
-	pg_crc32c new_crc;
+	int		i;
+	int		j;
 
 	/* If initdb is calling, there is no file to read yet. */
 	if (IsBootstrapProcessingMode())
 		return;
 
-	/* Open the pg_undo file corresponding to the given checkpoint. */
-	snprintf(path, MAXPGPATH, "pg_undo/%016" INT64_MODIFIER "X",
-			 checkPointRedo);
-	pgstat_report_wait_start(WAIT_EVENT_UNDO_CHECKPOINT_READ);
-	fd = OpenTransientFile(path, O_RDONLY | PG_BINARY);
-	if (fd < 0)
-		elog(ERROR, "cannot open undo checkpoint snapshot \"%s\": %m", path);
+	/*
+	 * Read the pg_undo file corresponding to the given checkpoint, and the
+	 * files it is based on back to a full one.
+	 */
+	for (;;)
+	{
+		if (chain_length == UNDO_CHECKPOINT_MAX_CHAIN)
+			elog(ERROR, "chain of pg_undo files for checkpoint at %X/%X is too long",
+				 (uint32) (checkPointRedo >> 32), (uint32) checkPointRedo);
+		read_undo_checkpoint_file(redo, &headers[chain_length],
+								  &entries[chain_length], false);
+		redo = headers[chain_length++].base_redo;
+		if (redo == InvalidXLogRecPtr)
+			break;
+	}
 
-	/* Read the active log number range. */
-	if ((read(fd, &shared->low_logno, sizeof(shared->low_logno))
-		 != sizeof(shared->low_logno)) ||
-		(read(fd, &shared->high_logno, sizeof(shared->high_logno))
-		 != sizeof(shared->high_logno)) ||
-		(read(fd, &crc, sizeof(crc)) != sizeof(crc)))
-		elog(ERROR, "pg_undo file \"%s\" is corrupted", path);
+	/* The newest file tells us the active log number range. */
+	shared->low_logno = headers[0].low_logno;
+	shared->high_logno = headers[0].high_logno;
+	num_logs = shared->high_logno - shared->low_logno;
+	metas = (UndoLogMetaData *) palloc0(sizeof(UndoLogMetaData) * Max(num_logs, 1));
+	present = (bool *) palloc0(sizeof(bool) * Max(num_logs, 1));
 
-	/* Verify the header checksum. */
-	INIT_CRC32C(new_crc);
-	COMP_CRC32C(new_crc, &shared->low_logno, sizeof(shared->low_logno));
-	COMP_CRC32C(new_crc, &shared->high_logno, sizeof(shared->high_logno));
-	FIN_CRC32C(new_crc);
+	/* Apply the files from the full one onwards. */
+	for (i = chain_length - 1; i >= 0; --i)
+	{
+		for (j = 0; j < headers[i].num_entries; ++j)
+		{
+			UndoCheckPointEntry *entry = &entries[i][j];
 
-	if (crc != new_crc)
-		elog(ERROR,
-			 "pg_undo file \"%s\" has incorrect checksum", path);
+			if (entry->logno < shared->low_logno ||
+				entry->logno >= shared->high_logno)
+				continue;
+			memcpy(&metas[entry->logno - shared->low_logno], &entry->meta,
+				   sizeof(UndoLogMetaData));
+			present[entry->logno - shared->low_logno] = true;
+		}
+		pfree(entries[i]);
+	}
 
 	/* Initialize all the logs and set up the freelist. */
-	INIT_CRC32C(new_crc);
 	for (logno = shared->low_logno; logno < shared->high_logno; ++logno)
 	{
 		UndoLogControl *log;
 
+		if (!present[logno - shared->low_logno])
+			elog(ERROR, "pg_undo files for checkpoint at %X/%X have no meta data for undo log %d",
+				 (uint32) (checkPointRedo >> 32), (uint32) checkPointRedo,
+				 logno);
+
 		/* Get a zero-initialized control objects. */
 		ensure_undo_log_number(logno);
 		log = get_undo_log_by_number(logno);
 
-		/* Read in the meta data for this undo log. */
-		if (read(fd, &log->meta, sizeof(log->meta)) != sizeof(log->meta))
-			elog(ERROR, "corrupted pg_undo meta data in file \"%s\": %m",
-				 path);
-		COMP_CRC32C(new_crc, &log->meta, sizeof(log->meta));
+		memcpy(&log->meta, &metas[logno - shared->low_logno],
+			   sizeof(UndoLogMetaData));
+		memcpy(&log->checkpointed_meta, &log->meta, sizeof(UndoLogMetaData));
+		log->meta_checkpointed = true;
 
 		/*
 		 * At normal start-up, or during recovery, all active undo logs start
@@ -1488,19 +1895,15 @@ StartupUndoLogs(XLogRecPtr checkPointRedo)
 		{
 			log->next_free = shared->free_lists[log->meta.persistence];
 			shared->free_lists[log->meta.persistence] = logno;
+			++shared->num_free[log->meta.persistence];
 		}
 	}
-	FIN_CRC32C(new_crc);
 
-	/* Verify body checksum. */
-	if (read(fd, &crc, sizeof(crc)) != sizeof(crc))
-		elog(ERROR, "pg_undo file \"%s\" is corrupted", path);
-	if (crc != new_crc)
-		elog(ERROR,
-			 "pg_undo file \"%s\" has incorrect checksum", path);
+	shared->checkpoint_redo = checkPointRedo;
+	shared->checkpoint_chain_length = chain_length;
 
-	CloseTransientFile(fd);
-	pgstat_report_wait_end();
+	pfree(metas);
+	pfree(present);
 }
 
 /*
@@ -1696,6 +2099,7 @@ attach_undo_log(UndoPersistence persistence, Oid tablespace)
 			logno = *place;
 			log = candidate;
 			*place = candidate->next_free;
+			--shared->num_free[persistence];
 			break;
 		}
 		place = &candidate->next_free;
@@ -1764,6 +2168,7 @@ attach_undo_log(UndoPersistence persistence, Oid tablespace)
 		 * first one on demand.
 		 */
 	}
+	++shared->num_attached[persistence];
 	LWLockRelease(UndoLogLock);
 
 	LWLockAcquire(&log->mutex, LW_EXCLUSIVE);
@@ -2027,23 +2432,8 @@ choose_undo_tablespace(bool force_detach, Oid *tablespace)
 	{
 		for (i = 0; i < UndoPersistenceLevels; ++i)
 		{
-			UndoLogControl *log = MyUndoLogState.logs[i];
-			UndoLogSharedData *shared = MyUndoLogState.shared;
-
-			if (log != NULL)
-			{
-				LWLockAcquire(&log->mutex, LW_EXCLUSIVE);
-				log->pid = InvalidPid;
-				log->xid = InvalidTransactionId;
-				LWLockRelease(&log->mutex);
-
-				LWLockAcquire(UndoLogLock, LW_EXCLUSIVE);
-				log->next_free = shared->free_lists[i];
-				shared->free_lists[i] = log->logno;
-				LWLockRelease(UndoLogLock);
-
-				MyUndoLogState.logs[i] = NULL;
-			}
+			if (MyUndoLogState.logs[i] != NULL)
+				detach_current_undo_log(i, false);
 		}
 	}
 
@@ -2120,6 +2510,8 @@ DropUndoLogsInTablespace(Oid tablespace)
 			LWLockAcquire(UndoLogLock, LW_EXCLUSIVE);
 			log->next_free = shared->free_lists[log->meta.persistence];
 			shared->free_lists[log->meta.persistence] = logno;
+			++shared->num_free[log->meta.persistence];
+			--shared->num_attached[log->meta.persistence];
 			LWLockRelease(UndoLogLock);
 		}
 	}
@@ -2196,7 +2588,10 @@ DropUndoLogsInTablespace(Oid tablespace)
 		{
 			log = get_undo_log_by_number(*place);
 			if (log->meta.status == UNDO_LOG_STATUS_DISCARDED)
+			{
 				*place = log->next_free;
+				--shared->num_free[i];
+			}
 			else
 				place = &log->next_free;
 		}
@@ -2408,6 +2803,94 @@ pg_stat_get_undo_logs(PG_FUNCTION_ARGS)
 	return (Datum) 0;
 }
 
+/*
+ * Report the undo discards that a hot standby has deferred, one row per undo
+ * log, with the amount of undo kept around because of them.
+ */
+Datum
+pg_stat_get_undo_deferred_discard(PG_FUNCTION_ARGS)
+{
+#define PG_STAT_GET_UNDO_DEFERRED_DISCARD_COLS 6
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	TupleDesc	tupdesc;
+	Tuplestorestate *tupstore;
+	MemoryContext per_query_ctx;
+	MemoryContext oldcontext;
+	UndoLogNumber low_logno;
+	UndoLogNumber high_logno;
+	UndoLogNumber logno;
+	UndoLogSharedData *shared = MyUndoLogState.shared;
+
+	/* check to see if caller supports us returning a tuplestore */
+	if (rsinfo == NULL || !IsA(rsinfo, ReturnSetInfo))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("set-valued function called in context that cannot accept a set")));
+	if (!(rsinfo->allowedModes & SFRM_Materialize))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("materialize mode required, but it is not " \
+						"allowed in this context")));
+
+	/* Build a tuple descriptor for our result type */
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	per_query_ctx = rsinfo->econtext->ecxt_per_query_memory;
+	oldcontext = MemoryContextSwitchTo(per_query_ctx);
+
+	tupstore = tuplestore_begin_heap(true, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+
+	MemoryContextSwitchTo(oldcontext);
+
+	/* Find the range of active log numbers. */
+	LWLockAcquire(UndoLogLock, LW_SHARED);
+	low_logno = shared->low_logno;
+	high_logno = shared->high_logno;
+	LWLockRelease(UndoLogLock);
+
+	for (logno = low_logno; logno < high_logno; ++logno)
+	{
+		UndoLogControl *log = get_undo_log_by_number(logno);
+		char buffer[17];
+		Datum values[PG_STAT_GET_UNDO_DEFERRED_DISCARD_COLS];
+		bool nulls[PG_STAT_GET_UNDO_DEFERRED_DISCARD_COLS] = { false };
+
+		if (log == NULL)
+			continue;
+
+		LWLockAcquire(&log->mutex, LW_SHARED);
+
+		if (log->meta.status == UNDO_LOG_STATUS_DISCARDED ||
+			log->deferred_discard <= log->meta.discard)
+		{
+			LWLockRelease(&log->mutex);
+			continue;
+		}
+
+		values[0] = ObjectIdGetDatum((Oid) logno);
+		snprintf(buffer, sizeof(buffer), UndoRecPtrFormat,
+				 MakeUndoRecPtr(logno, log->meta.discard));
+		values[1] = CStringGetTextDatum(buffer);
+		snprintf(buffer, sizeof(buffer), UndoRecPtrFormat,
+				 MakeUndoRecPtr(logno, log->deferred_discard));
+		values[2] = CStringGetTextDatum(buffer);
+		values[3] = Int64GetDatum((int64) (log->deferred_discard -
+										   log->meta.discard));
+		values[4] = TransactionIdGetDatum(log->deferred_latestxid);
+		values[5] = TimestampTzGetDatum(log->deferred_since);
+		LWLockRelease(&log->mutex);
+
+		tuplestore_putvalues(tupstore, tupdesc, values, nulls);
+	}
+	tuplestore_donestoring(tupstore);
+
+	return (Datum) 0;
+}
+
 /*
  * replay the creation of a new undo log
  */
@@ -2518,13 +3001,32 @@ forget_undo_buffers(int logno, UndoLogOffset old_discard,
 }
 
 /*
- * replay an undo segment discard record
+ * Does any hot standby query have a snapshot that may still need the undo of
+ * transactions up to latestxid?
+ */
+static bool
+undolog_discard_conflicts(TransactionId latestxid)
+{
+	VirtualTransactionId *vxids;
+
+	vxids = GetConflictingVirtualXIDs(latestxid, InvalidOid);
+
+	return VirtualTransactionIdIsValid(*vxids);
+}
+
+/*
+ * Remove the undo of an undo log up to new_discard during recovery, and make
+ * sure that the log has segments up to new_end.  Segments that are no longer
+ * needed are recycled as new segments where possible.
+ *
+ * If cancel is true, hot standby queries that may need the undo are cancelled
+ * right away instead of after the usual max_standby_streaming_delay.
  */
 static void
-undolog_xlog_discard(XLogReaderState *record)
+undolog_apply_discard(UndoLogControl *log, UndoLogOffset new_discard,
+					  UndoLogOffset new_end, TransactionId latestxid,
+					  bool cancel)
 {
-	xl_undolog_discard *xlrec = (xl_undolog_discard *) XLogRecGetData(record);
-	UndoLogControl *log;
 	UndoLogOffset discard;
 	UndoLogOffset end;
 	UndoLogOffset old_segment_begin;
@@ -2532,10 +3034,6 @@ undolog_xlog_discard(XLogReaderState *record)
 	RelFileNode rnode = {0};
 	char	dir[MAXPGPATH];
 
-	log = get_undo_log_by_number(xlrec->logno);
-	if (log == NULL)
-		elog(ERROR, "unknown undo log %d", xlrec->logno);
-
 	/*
 	 * We're about to discard undologs. In Hot Standby mode, ensure that
 	 * there's no queries running which need to get tuple from discarded undo.
@@ -2544,8 +3042,13 @@ undolog_xlog_discard(XLogReaderState *record)
 	 * check conflict in all the backend regardless of which database the
 	 * backend is connected.
 	 */
-	if (InHotStandby && TransactionIdIsValid(xlrec->latestxid))
-		ResolveRecoveryConflictWithSnapshot(xlrec->latestxid, rnode);
+	if (InHotStandby && TransactionIdIsValid(latestxid))
+	{
+		if (cancel)
+			CancelRecoveryConflictWithSnapshot(latestxid, rnode);
+		else
+			ResolveRecoveryConflictWithSnapshot(latestxid, rnode);
+	}
 
 	/*
 	 * See if we need to unlink or rename any files, but don't consider it an
@@ -2561,11 +3064,11 @@ undolog_xlog_discard(XLogReaderState *record)
 	LWLockRelease(&log->mutex);
 
 	/* Drop buffers before we remove/recycle any files. */
-	forget_undo_buffers(xlrec->logno, discard, xlrec->discard, false);
+	forget_undo_buffers(log->logno, discard, new_discard, false);
 
 	/* Rewind to the start of the segment. */
 	old_segment_begin = discard - discard % UndoLogSegmentSize;
-	new_segment_begin = xlrec->discard - xlrec->discard % UndoLogSegmentSize;
+	new_segment_begin = new_discard - new_discard % UndoLogSegmentSize;
 
 	/* Unlink or rename segments that are no longer in range. */
 	while (old_segment_begin < new_segment_begin)
@@ -2580,15 +3083,15 @@ undolog_xlog_discard(XLogReaderState *record)
 							log->meta.tablespace,
 							old_segment_begin / UndoLogSegmentSize);
 
-		UndoLogSegmentPath(xlrec->logno, old_segment_begin / UndoLogSegmentSize,
+		UndoLogSegmentPath(log->logno, old_segment_begin / UndoLogSegmentSize,
 						   log->meta.tablespace, discard_path);
 
 		/* Can we recycle the oldest segment? */
-		if (end < xlrec->end)
+		if (end < new_end)
 		{
 			char	recycle_path[MAXPGPATH];
 
-			UndoLogSegmentPath(xlrec->logno, end / UndoLogSegmentSize,
+			UndoLogSegmentPath(log->logno, end / UndoLogSegmentSize,
 							   log->meta.tablespace, recycle_path);
 			if (rename(discard_path, recycle_path) == 0)
 			{
@@ -2612,9 +3115,10 @@ undolog_xlog_discard(XLogReaderState *record)
 	}
 
 	/* Create any further new segments that are needed the slow way. */
-	while (end < xlrec->end)
+	while (end < new_end)
 	{
-		allocate_empty_undo_segment(xlrec->logno, log->meta.tablespace, end);
+		allocate_empty_undo_segment(log->logno, log->meta.tablespace, end,
+									false);
 		end += UndoLogSegmentSize;
 	}
 
@@ -2624,11 +3128,234 @@ undolog_xlog_discard(XLogReaderState *record)
 
 	/* Update shmem. */
 	LWLockAcquire(&log->mutex, LW_EXCLUSIVE);
-	log->meta.discard = xlrec->discard;
+	log->meta.discard = new_discard;
 	log->meta.end = end;
 	LWLockRelease(&log->mutex);
 }
 
+/*
+ * Apply the discards that have been deferred on a hot standby, once no
+ * standby query needs the undo anymore or max_standby_undo_discard_delay has
+ * expired.  In the latter case the queries have had their delay already, so
+ * they are cancelled without waiting for max_standby_streaming_delay on top.
+ * If force is true, apply them all regardless.
+ *
+ * Once nothing is deferred anymore, also install the oldest xid having undo
+ * that we held back meanwhile.
+ */
+static void
+undolog_apply_deferred_discards(bool force)
+{
+	UndoLogSharedData *shared = MyUndoLogState.shared;
+	UndoLogNumber low_logno;
+	UndoLogNumber high_logno;
+	UndoLogNumber logno;
+	TimestampTz now = 0;
+	bool		any_deferred = false;
+
+	if (!have_deferred_discards)
+		return;
+
+	LWLockAcquire(UndoLogLock, LW_SHARED);
+	low_logno = shared->low_logno;
+	high_logno = shared->high_logno;
+	LWLockRelease(UndoLogLock);
+
+	for (logno = low_logno; logno < high_logno; ++logno)
+	{
+		UndoLogControl *log = get_undo_log_by_number(logno);
+		UndoLogOffset deferred_discard;
+		TransactionId latestxid;
+		TimestampTz since;
+		bool		pending;
+		bool		drop;
+		bool		expired = false;
+
+		if (log == NULL)
+			continue;
+
+		LWLockAcquire(&log->mutex, LW_SHARED);
+		deferred_discard = log->deferred_discard;
+		latestxid = log->deferred_latestxid;
+		since = log->deferred_since;
+		pending = deferred_discard > log->meta.discard;
+		drop = log->deferred_drop;
+		LWLockRelease(&log->mutex);
+
+		if (!pending)
+			continue;
+
+		if (!force && undolog_discard_conflicts(latestxid))
+		{
+			if (now == 0)
+				now = GetCurrentTimestamp();
+			if (max_standby_undo_discard_delay < 0 ||
+				!TimestampDifferenceExceeds(since, now,
+											max_standby_undo_discard_delay))
+			{
+				any_deferred = true;
+				continue;
+			}
+			expired = true;
+		}
+
+		undolog_apply_discard(log, deferred_discard, log->meta.end, latestxid,
+							  expired);
+
+		if (drop)
+		{
+			LWLockAcquire(&log->mutex, LW_EXCLUSIVE);
+			log->deferred_drop = false;
+			LWLockRelease(&log->mutex);
+
+			drop_undo_log(log);
+		}
+	}
+
+	if (!any_deferred)
+	{
+		have_deferred_discards = false;
+		if (deferred_oldest_xid_having_undo != InvalidTransactionId)
+		{
+			pg_atomic_write_u64(&ProcGlobal->oldestXidWithEpochHavingUndo,
+								deferred_oldest_xid_having_undo);
+			deferred_oldest_xid_having_undo = InvalidTransactionId;
+		}
+	}
+}
+
+/*
+ * Recheck the discards deferred on a hot standby.  The startup process calls
+ * this between WAL records and while it waits for more WAL, so that they're
+ * applied once the queries needing the undo are gone or their delay has
+ * expired, even if no further undo log records arrive.
+ */
+void
+UndoLogApplyDeferredDiscards(void)
+{
+	TimestampTz now;
+
+	if (!have_deferred_discards)
+		return;
+
+	/* Looking for conflicting queries isn't free, so don't do it too often. */
+	now = GetCurrentTimestamp();
+	if (!TimestampDifferenceExceeds(deferred_last_check, now,
+									UNDO_DEFERRED_DISCARD_CHECK_INTERVAL))
+		return;
+	deferred_last_check = now;
+
+	undolog_apply_deferred_discards(false);
+}
+
+/*
+ * replay an undo segment discard record
+ *
+ * On a hot standby, queries may still need the undo being discarded to build
+ * old tuple versions.  Rather than cancelling them right away, we remember
+ * the discard in the undo log and apply it later, when those queries are gone
+ * or after max_standby_undo_discard_delay; see
+ * undolog_apply_deferred_discards.  The segments needed for the undo that
+ * will be replayed after this record are created immediately in either case.
+ */
+static void
+undolog_xlog_discard(XLogReaderState *record)
+{
+	xl_undolog_discard *xlrec = (xl_undolog_discard *) XLogRecGetData(record);
+	UndoLogControl *log;
+	UndoLogOffset end;
+	bool		defer;
+
+	log = get_undo_log_by_number(xlrec->logno);
+	if (log == NULL)
+		elog(ERROR, "unknown undo log %d", xlrec->logno);
+
+	LWLockAcquire(&log->mutex, LW_SHARED);
+	defer = log->deferred_discard > log->meta.discard;
+	LWLockRelease(&log->mutex);
+
+	/*
+	 * If this log already has a deferred discard, this one must wait too.
+	 * Otherwise, defer it only if some query may need the undo.
+	 */
+	if (!defer)
+		defer = InHotStandby && max_standby_undo_discard_delay != 0 &&
+			TransactionIdIsValid(xlrec->latestxid) &&
+			undolog_discard_conflicts(xlrec->latestxid);
+
+	if (!defer)
+	{
+		undolog_apply_discard(log, xlrec->discard, xlrec->end,
+							  xlrec->latestxid, false);
+		return;
+	}
+
+	LWLockAcquire(&log->mutex, LW_EXCLUSIVE);
+	if (log->deferred_discard <= log->meta.discard)
+	{
+		log->deferred_latestxid = xlrec->latestxid;
+		log->deferred_since = GetCurrentTimestamp();
+	}
+	else if (TransactionIdFollows(xlrec->latestxid, log->deferred_latestxid))
+		log->deferred_latestxid = xlrec->latestxid;
+	log->deferred_discard = xlrec->discard;
+	end = log->meta.end;
+	LWLockRelease(&log->mutex);
+
+	have_deferred_discards = true;
+
+	/* Without recycling, the segments needed next must be created anew. */
+	if (end < xlrec->end)
+	{
+		char	dir[MAXPGPATH];
+
+		while (end < xlrec->end)
+		{
+			allocate_empty_undo_segment(xlrec->logno, log->meta.tablespace,
+										end, false);
+			end += UndoLogSegmentSize;
+		}
+
+		UndoLogDirectory(log->meta.tablespace, dir);
+		fsync_fname(dir, true);
+
+		LWLockAcquire(&log->mutex, LW_EXCLUSIVE);
+		log->meta.end = end;
+		LWLockRelease(&log->mutex);
+	}
+}
+
+/*
+ * replay the drop of an exhausted undo log
+ *
+ * If the discard that emptied the undo log has been deferred, the drop has to
+ * wait for it.
+ */
+static void
+undolog_xlog_drop(XLogReaderState *record)
+{
+	xl_undolog_drop *xlrec = (xl_undolog_drop *) XLogRecGetData(record);
+	UndoLogControl *log;
+	bool		pending;
+
+	/*
+	 * The undo log may already have been forgotten, if the checkpoint we
+	 * started from was taken after it was dropped.
+	 */
+	log = get_undo_log_by_number(xlrec->logno);
+	if (log == NULL)
+		return;
+
+	LWLockAcquire(&log->mutex, LW_EXCLUSIVE);
+	pending = log->deferred_discard > log->meta.discard;
+	if (pending)
+		log->deferred_drop = true;
+	LWLockRelease(&log->mutex);
+
+	if (!pending)
+		drop_undo_log(log);
+}
+
 /*
  * replay the rewind of a undo log
  */
@@ -2648,6 +3375,9 @@ undolog_redo(XLogReaderState *record)
 {
 	uint8		info = XLogRecGetInfo(record) & ~XLR_INFO_MASK;
 
+	/* See whether deferred discards can be applied by now. */
+	undolog_apply_deferred_discards(false);
+
 	switch (info)
 	{
 		case XLOG_UNDOLOG_CREATE:
@@ -2668,11 +3398,38 @@ undolog_redo(XLogReaderState *record)
 		case XLOG_UNDOLOG_META:
 			undolog_xlog_meta(record);
 			break;
+		case XLOG_UNDOLOG_DROP:
+			undolog_xlog_drop(record);
+			break;
 		default:
 			elog(PANIC, "undo_redo: unknown op code %u", info);
 	}
 }
 
+/*
+ * End of redo: apply any discards that are still deferred.
+ */
+void
+undolog_cleanup(void)
+{
+	undolog_apply_deferred_discards(true);
+}
+
+/*
+ * Install the oldest xid having undo from a replayed checkpoint.  While
+ * discards are deferred, hot standby queries may still need the undo of
+ * transactions older than that, so hold it back until they've been applied.
+ */
+void
+UndoLogReplayOldestXidHavingUndo(uint64 oldestXidWithEpochHavingUndo)
+{
+	if (have_deferred_discards)
+		deferred_oldest_xid_having_undo = oldestXidWithEpochHavingUndo;
+	else
+		pg_atomic_write_u64(&ProcGlobal->oldestXidWithEpochHavingUndo,
+							oldestXidWithEpochHavingUndo);
+}
+
 /*
  * For assertions only.
  */
@@ -25,6 +25,7 @@
  */
 #include "postgres.h"
 
+#include "access/undodiscard.h"
 #include "access/zheap.h"
 #include "access/zheapam_xlog.h"
 #include "access/zheaputils.h"
@@ -32,6 +33,7 @@
 #include "miscadmin.h"
 #include "pgstat.h"
 #include "storage/bufmgr.h"
+#include "storage/proc.h"
 #include "storage/procarray.h"
 
 /* Working data for zheap_page_prune and subroutines */
@@ -120,6 +122,8 @@ zheap_page_prune_opt(Relation relation, Buffer buffer)
 	else
 		OldestXmin = RecentGlobalDataXmin;
 
+	OldestXmin = ZHeapGetPruneHorizon(OldestXmin);
+
 	Assert(TransactionIdIsValid(OldestXmin));
 
 	/*
@@ -134,6 +138,33 @@ zheap_page_prune_opt(Relation relation, Buffer buffer)
 	(void) zheap_page_prune_guts(relation, buffer, OldestXmin, true, &ignore);
 }
 
+/*
+ * ZHeapGetPruneHorizon
+ *
+ * Return the cutoff XID to use for deciding which deleted tuples are DEAD.
+ *
+ * With undo_retention set, undo is kept longer than OldestXmin requires, so
+ * that flashback queries can see old tuple versions.  Tuples deleted by
+ * transactions whose undo is retained must then stay reachable from undo, so
+ * they are only pruned to deleted line pointers, not marked dead.
+ */
+TransactionId
+ZHeapGetPruneHorizon(TransactionId OldestXmin)
+{
+	TransactionId oldestXidHavingUndo;
+
+	if (undo_retention <= 0)
+		return OldestXmin;
+
+	oldestXidHavingUndo = GetXidFromEpochXid(
+						pg_atomic_read_u64(&ProcGlobal->oldestXidWithEpochHavingUndo));
+	if (TransactionIdIsNormal(oldestXidHavingUndo) &&
+		TransactionIdPrecedes(oldestXidHavingUndo, OldestXmin))
+		return oldestXidHavingUndo;
+
+	return OldestXmin;
+}
+
 /*
  * Prune and repair fragmentation in the specified page.
  *
@@ -276,6 +307,10 @@ zheap_page_prune_guts(Relation relation, Buffer buffer, TransactionId OldestXmin
 	if (report_stats && ndeleted > (prstate.ndead + prstate.ndeleted))
 		pgstat_update_heap_dead_tuples(relation, ndeleted - (prstate.ndead + prstate.ndeleted));
 
+	/* Also track how much opportunistic pruning gets out of each page. */
+	if (report_stats)
+		pgstat_count_zheap_prune(relation, ndeleted);
+
 	*latestRemovedXid = prstate.latestRemovedXid;
 
 	/*
@@ -0,0 +1,182 @@
+/*-------------------------------------------------------------------------
+ *
+ * rewritezheap.c
+ *	  Support functions to rewrite zheap tables.
+ *
+ * These functions provide a facility to completely rewrite a zheap, for
+ * CLUSTER and VACUUM FULL.  Unlike heap, zheap keeps only the latest version
+ * of each row in the table and the older ones in undo, so there are no
+ * update chains to preserve: the caller passes just the version of each row
+ * that is visible now, and it is written frozen.  Snapshots older than the
+ * rewrite therefore see the new contents, as after TRUNCATE.
+ *
+ * INTERFACE
+ *
+ * The caller is responsible for creating the new heap, all catalog
+ * changes, supplying the tuples to be written to the new heap, and
+ * rebuilding indexes.  The caller must hold AccessExclusiveLock on the
+ * target table, because we assume no one else is writing into it.
+ *
+ * To use the facility:
+ *
+ * begin_zheap_rewrite
+ * while (fetch next visible tuple)
+ * {
+ *	   // do any transformations here if required
+ *	   rewrite_zheap_tuple
+ * }
+ * end_zheap_rewrite
+ *
+ * The contents of the new relation shouldn't be relied on until after
+ * end_zheap_rewrite is called.
+ *
+ *
+ * IMPLEMENTATION
+ *
+ * The new relfilenode was created in the current transaction, so if we
+ * abort it just goes away and the tuples need no undo.  We insert them with
+ * HEAP_INSERT_FROZEN, which makes zheap skip transaction slots and undo
+ * altogether, so the new relation has no TPD pages either.  The tuples are
+ * buffered and written with zheap_multi_insert, a page's worth at a time,
+ * and when WAL isn't needed we skip it and sync the relation at the end.
+ *
+ * Portions Copyright (c) 1996-2018, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ * IDENTIFICATION
+ *	  src/backend/access/zheap/rewritezheap.c
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "access/heapam.h"
+#include "access/rewritezheap.h"
+#include "access/xact.h"
+#include "access/zheap.h"
+#include "access/zheaputils.h"
+#include "utils/memutils.h"
+#include "utils/rel.h"
+
+/*
+ * Limits on the tuples buffered before they are written out, the same as
+ * COPY uses for multi-inserts.
+ */
+#define MAX_BUFFERED_TUPLES		1000
+#define MAX_BUFFERED_BYTES		65535
+
+/*
+ * State associated with a rewrite operation.  This is opaque to the user
+ * of the rewrite facility.
+ */
+typedef struct ZRewriteStateData
+{
+	Relation	rs_new_rel;		/* destination heap */
+	int			rs_options;		/* zheap_multi_insert options */
+	bool		rs_use_wal;		/* must we WAL-log inserts? */
+	CommandId	rs_cid;			/* command id for the inserts */
+	BulkInsertState rs_bistate;	/* bulk insert state for the new heap */
+	MemoryContext rs_cxt;		/* for the buffered tuples */
+	ZHeapTuple	rs_buffered[MAX_BUFFERED_TUPLES];	/* tuples not written yet */
+	int			rs_nbuffered;	/* number of buffered tuples */
+	Size		rs_bufferedbytes;	/* total size of buffered tuples */
+} ZRewriteStateData;
+
+static void zheap_rewrite_flush(ZRewriteState state);
+
+/*
+ * Begin a rewrite of a table
+ *
+ * new_heap		new, locked heap relation to insert tuples to
+ * use_wal		should the inserts be WAL-logged?
+ *
+ * Returns an opaque ZRewriteState, allocated in current memory context
+ */
+ZRewriteState
+begin_zheap_rewrite(Relation new_heap, bool use_wal)
+{
+	ZRewriteState state;
+
+	Assert(RelationStorageIsZHeap(new_heap));
+
+	state = palloc0(sizeof(ZRewriteStateData));
+	state->rs_new_rel = new_heap;
+	state->rs_use_wal = use_wal;
+	state->rs_options = HEAP_INSERT_FROZEN | HEAP_INSERT_SKIP_FSM |
+		(use_wal ? 0 : HEAP_INSERT_SKIP_WAL);
+	state->rs_cid = GetCurrentCommandId(true);
+	state->rs_bistate = GetBulkInsertState();
+	state->rs_cxt = AllocSetContextCreate(CurrentMemoryContext,
+										  "Zheap table rewrite",
+										  ALLOCSET_DEFAULT_SIZES);
+
+	return state;
+}
+
+/*
+ * Add a tuple to the new heap.
+ *
+ * The tuple is copied, so the caller may free it right away.
+ */
+void
+rewrite_zheap_tuple(ZRewriteState state, ZHeapTuple tuple)
+{
+	MemoryContext old_cxt;
+
+	old_cxt = MemoryContextSwitchTo(state->rs_cxt);
+	state->rs_buffered[state->rs_nbuffered++] = zheap_copytuple(tuple);
+	MemoryContextSwitchTo(old_cxt);
+
+	state->rs_bufferedbytes += tuple->t_len;
+	if (state->rs_nbuffered == MAX_BUFFERED_TUPLES ||
+		state->rs_bufferedbytes >= MAX_BUFFERED_BYTES)
+		zheap_rewrite_flush(state);
+}
+
+/*
+ * Write the buffered tuples to the new heap.
+ */
+static void
+zheap_rewrite_flush(ZRewriteState state)
+{
+	MemoryContext old_cxt;
+
+	if (state->rs_nbuffered == 0)
+		return;
+
+	/* zheap_multi_insert leaks memory, so run it in our own context. */
+	old_cxt = MemoryContextSwitchTo(state->rs_cxt);
+	zheap_multi_insert(state->rs_new_rel, state->rs_buffered,
+					   state->rs_nbuffered, state->rs_cid,
+					   state->rs_options, state->rs_bistate);
+	MemoryContextSwitchTo(old_cxt);
+
+	MemoryContextReset(state->rs_cxt);
+	state->rs_nbuffered = 0;
+	state->rs_bufferedbytes = 0;
+}
+
+/*
+ * End a rewrite.
+ *
+ * state and any other resources are freed.
+ */
+void
+end_zheap_rewrite(ZRewriteState state)
+{
+	zheap_rewrite_flush(state);
+
+	FreeBulkInsertState(state->rs_bistate);
+
+	/*
+	 * If the rel is WAL-logged, must fsync before commit.  We skipped WAL
+	 * for the inserts, so the data must be on disk before we commit; see
+	 * the same logic in end_heap_rewrite.  heap_sync takes care of the
+	 * toast table as well.
+	 */
+	if (!state->rs_use_wal)
+		heap_sync(state->rs_new_rel);
+
+	MemoryContextDelete(state->rs_cxt);
+	pfree(state);
+}
@@ -37,11 +37,14 @@
 #include "access/zheap.h"
 #include "access/zheapam_xlog.h"
 #include "miscadmin.h"
+#include "pgstat.h"
 #include "storage/bufmgr.h"
 #include "storage/buf_internals.h"
 #include "storage/lmgr.h"
 #include "storage/proc.h"
+#include "utils/hsearch.h"
 #include "utils/lsyscache.h"
+#include "utils/memutils.h"
 #include "utils/relfilenodemap.h"
 
 /*
@@ -80,6 +83,78 @@ typedef enum
 	TPD_BUF_ENTER
 } TPDACTION;
 
+/*
+ * TPD free-space directory.
+ *
+ * For each relation, we remember a handful of TPD pages that were last seen
+ * with enough free space to hold a new TPD entry.  When the last used TPD
+ * page is full, we first try those pages, and then prune a few more TPD pages
+ * along the TPD page chain, before extending the relation.  Without this, the
+ * space freed by pruning the older TPD pages is never reused and the TPD
+ * pages keep on proliferating under sustained share-lock churn.
+ *
+ * The directory is backend-local and is just a hint; every candidate page is
+ * revalidated after acquiring the buffer lock.  We only ever take conditional
+ * locks on the candidate pages as the caller already holds the lock on heap
+ * page and possibly on other TPD pages.
+ */
+#define TPD_FSDIR_PAGES_PER_REL		8
+#define TPD_FSDIR_MAX_RELS			256
+
+/* Number of TPD pages we probe along the TPD page chain before extending. */
+#define TPD_PAGES_TO_PROBE			4
+
+/* Minimum free space that makes a TPD page worth remembering. */
+#define MinTPDEntrySpace \
+	(SizeofTPDEntryHeader + sizeof(ItemIdData) + \
+	 ADDITIONAL_MAP_ELEM_IN_TPD_ENTRY * sizeof(uint8) + \
+	 INITIAL_TRANS_SLOTS_IN_TPD_ENTRY * sizeof(TransInfo))
+
+typedef struct TPDFreeSpaceDirEntry
+{
+	RelFileNode	rnode;			/* hash key (must be first) */
+	BlockNumber	next_probe_blk;	/* TPD page from where to continue probing */
+	int			npages;			/* number of remembered pages */
+	BlockNumber	blkno[TPD_FSDIR_PAGES_PER_REL];
+	Size		freespace[TPD_FSDIR_PAGES_PER_REL];
+} TPDFreeSpaceDirEntry;
+
+static	HTAB *TPDFreeSpaceDir = NULL;
+
+/*
+ * TPD entry cache.
+ *
+ * Each visibility check of a tuple whose transaction slot lives in a TPD
+ * entry needs to read and lock the TPD buffer.  To avoid that for repeated
+ * lookups on the same heap page, each backend keeps a decoded copy of the
+ * recently used TPD entries, keyed by heap block and the TPD location stored
+ * in it.  A cached copy is used only if neither the heap page nor the TPD page
+ * has been modified since it was cached, which we detect by their LSNs.  As
+ * the LSN doesn't change for unlogged modifications, we cache the entries of
+ * WAL-logged relations only.
+ */
+#define TPD_ENTRY_CACHE_SIZE	64
+
+#define TPDEntryCacheIndex(rnode, heapblk) \
+	(((rnode).relNode ^ (heapblk)) % TPD_ENTRY_CACHE_SIZE)
+
+typedef struct TPDEntryCacheData
+{
+	RelFileNode	rnode;			/* heap relation */
+	ForkNumber	forknum;
+	BlockNumber	heapblk;		/* heap block to which the entry belongs */
+	BlockNumber	tpdblk;			/* TPD location as stored in heap page */
+	OffsetNumber tpdItemOff;
+	XLogRecPtr	heap_lsn;		/* heap page LSN when entry was cached */
+	XLogRecPtr	tpd_lsn;		/* TPD page LSN when entry was cached */
+	TPDEntryHeaderData tpd_e_hdr;
+	Size		size;			/* allocated size of tpd_entry_data */
+	char	   *tpd_entry_data;	/* offset-map followed by transaction slots */
+} TPDEntryCacheData;
+
+static	TPDEntryCacheData tpd_entry_cache[TPD_ENTRY_CACHE_SIZE];
+static	MemoryContext TPDEntryCacheContext = NULL;
+
 static	Buffer registered_tpd_buffers[MAX_TPD_BUFFERS];
 static	TPDBuffers tpd_buffers[MAX_TPD_BUFFERS];
 static	int tpd_buf_idx;
@@ -91,14 +166,22 @@ static void TPDEntryUpdate(Relation relation, Buffer tpd_buf,
 			   char *tpd_entry, Size size_tpd_entry);
 static void TPDAllocatePageAndAddEntry(Relation relation, Buffer metabuf,
 						Buffer pagebuf, Buffer old_tpd_buf,
-						OffsetNumber old_off_num, char *tpd_entry,
-						Size size_tpd_entry, bool add_new_tpd_page,
-						bool delete_old_entry);
+						OffsetNumber old_off_num, Buffer target_tpd_buf,
+						char *tpd_entry, Size size_tpd_entry,
+						bool add_new_tpd_page, bool delete_old_entry);
 static bool TPDBufferAlreadyRegistered(Buffer tpd_buf);
 static void ReleaseLastTPDBuffer(Buffer buf);
 static Size PageGetTPDFreeSpace(Page page);
 static void LogAndClearTPDLocation(Relation relation, Buffer heapbuf,
 								   bool *tpd_e_pruned);
+static TPDFreeSpaceDirEntry *TPDFreeSpaceDirGetEntry(Relation relation);
+static void TPDFreeSpaceDirRecord(Relation relation, BlockNumber blkno,
+					  Size freespace);
+static Buffer TPDLockPageIfFits(Relation relation, BlockNumber blkno,
+				  Size size_tpd_entry, BlockNumber nblocks,
+				  BlockNumber *nextblkno);
+static Buffer TPDGetPageWithFreeSpace(Relation relation, Size size_tpd_entry,
+						BlockNumber skip_blkno);
 
 /*
  * GetTPDBuffer - Get the tpd buffer corresponding to give block number.
@@ -220,6 +303,288 @@ ReleaseLastTPDBuffer(Buffer buf)
 	tpd_buf_idx--;
 }
 
+/*
+ * TPDFreeSpaceDirGetEntry - Get the free-space directory entry of relation.
+ *
+ * We don't bother to remove the entries of dropped relations, rather we start
+ * afresh once the directory has grown beyond TPD_FSDIR_MAX_RELS relations.
+ */
+static TPDFreeSpaceDirEntry *
+TPDFreeSpaceDirGetEntry(Relation relation)
+{
+	TPDFreeSpaceDirEntry *entry;
+	bool		found;
+
+	if (TPDFreeSpaceDir != NULL)
+	{
+		entry = (TPDFreeSpaceDirEntry *) hash_search(TPDFreeSpaceDir,
+													 (void *) &relation->rd_node,
+													 HASH_FIND, NULL);
+		if (entry)
+			return entry;
+
+		if (hash_get_num_entries(TPDFreeSpaceDir) >= TPD_FSDIR_MAX_RELS)
+		{
+			hash_destroy(TPDFreeSpaceDir);
+			TPDFreeSpaceDir = NULL;
+		}
+	}
+
+	if (TPDFreeSpaceDir == NULL)
+	{
+		HASHCTL		ctl;
+
+		MemSet(&ctl, 0, sizeof(ctl));
+		ctl.keysize = sizeof(RelFileNode);
+		ctl.entrysize = sizeof(TPDFreeSpaceDirEntry);
+		TPDFreeSpaceDir = hash_create("TPD free space directory",
+									  TPD_FSDIR_MAX_RELS, &ctl,
+									  HASH_ELEM | HASH_BLOBS);
+	}
+
+	entry = (TPDFreeSpaceDirEntry *) hash_search(TPDFreeSpaceDir,
+												 (void *) &relation->rd_node,
+												 HASH_ENTER, &found);
+	if (!found)
+	{
+		entry->next_probe_blk = InvalidBlockNumber;
+		entry->npages = 0;
+	}
+
+	return entry;
+}
+
+/*
+ * TPDFreeSpaceDirRecord - Remember the free space available on a TPD page.
+ *
+ * Pages that can't accommodate even a minimal TPD entry are forgotten.  If
+ * the directory entry of the relation is full, the page having least free
+ * space is replaced.
+ */
+static void
+TPDFreeSpaceDirRecord(Relation relation, BlockNumber blkno, Size freespace)
+{
+	TPDFreeSpaceDirEntry *entry;
+	int			i;
+
+	entry = TPDFreeSpaceDirGetEntry(relation);
+
+	for (i = 0; i < entry->npages; i++)
+	{
+		if (entry->blkno[i] == blkno)
+			break;
+	}
+
+	if (freespace < MinTPDEntrySpace)
+	{
+		if (i < entry->npages)
+		{
+			entry->npages--;
+			entry->blkno[i] = entry->blkno[entry->npages];
+			entry->freespace[i] = entry->freespace[entry->npages];
+		}
+		return;
+	}
+
+	if (i == entry->npages)
+	{
+		if (entry->npages < TPD_FSDIR_PAGES_PER_REL)
+			entry->npages++;
+		else
+		{
+			int		j;
+
+			for (i = 0, j = 1; j < entry->npages; j++)
+			{
+				if (entry->freespace[j] < entry->freespace[i])
+					i = j;
+			}
+
+			if (entry->freespace[i] >= freespace)
+				return;
+		}
+	}
+
+	entry->blkno[i] = blkno;
+	entry->freespace[i] = freespace;
+}
+
+/*
+ * TPDLockPageIfFits - Lock the TPD page if it can accommodate a TPD entry of
+ *		the given size.
+ *
+ * The page is pruned if it doesn't have enough space.  The free space found
+ * on the page is recorded in the free-space directory.  nextblkno returns the
+ * next page in the TPD page chain; it is set to blkno itself if we couldn't
+ * check the page, and to InvalidBlockNumber if it is not a TPD page anymore.
+ *
+ * Returns the buffer exclusively locked and remembered in the tpd buffers
+ * array, otherwise InvalidBuffer.
+ */
+static Buffer
+TPDLockPageIfFits(Relation relation, BlockNumber blkno, Size size_tpd_entry,
+				  BlockNumber nblocks, BlockNumber *nextblkno)
+{
+	TPDPageOpaque	tpdopaque;
+	Buffer		buf;
+	Page		page;
+	Size		freespace;
+	int			buf_idx;
+	bool		already_exists;
+
+	*nextblkno = InvalidBlockNumber;
+
+	/* The relation might have been truncated since we remembered the page. */
+	if (blkno == ZHEAP_METAPAGE || blkno >= nblocks)
+	{
+		TPDFreeSpaceDirRecord(relation, blkno, 0);
+		return InvalidBuffer;
+	}
+
+	/*
+	 * If we already hold the lock on this page, the caller has just looked at
+	 * it, so there is no point in pruning it again.
+	 */
+	buf_idx = GetTPDBuffer(NULL, blkno, InvalidBuffer, TPD_BUF_FIND,
+						   &already_exists);
+	if (buf_idx != -1)
+	{
+		buf = tpd_buffers[buf_idx].buf;
+		page = BufferGetPage(buf);
+		tpdopaque = (TPDPageOpaque) PageGetSpecialPointer(page);
+		*nextblkno = tpdopaque->tpd_nextblkno;
+
+		freespace = PageGetTPDFreeSpace(page);
+		TPDFreeSpaceDirRecord(relation, blkno, freespace);
+
+		return (freespace >= size_tpd_entry) ? buf : InvalidBuffer;
+	}
+
+	/* We can't lock more TPD buffers than we can remember. */
+	if (tpd_buf_idx >= MAX_TPD_BUFFERS)
+	{
+		*nextblkno = blkno;
+		return InvalidBuffer;
+	}
+
+	/*
+	 * We already hold the lock on heap page and possibly on other TPD pages,
+	 * so waiting here could lead to an undetected deadlock.
+	 */
+	buf = ReadBuffer(relation, blkno);
+	if (!ConditionalLockBuffer(buf))
+	{
+		ReleaseBuffer(buf);
+		*nextblkno = blkno;
+		return InvalidBuffer;
+	}
+
+	page = BufferGetPage(buf);
+	if (PageIsNew(page) ||
+		PageGetSpecialSize(page) != MAXALIGN(sizeof(TPDPageOpaqueData)))
+	{
+		UnlockReleaseBuffer(buf);
+		TPDFreeSpaceDirRecord(relation, blkno, 0);
+		return InvalidBuffer;
+	}
+
+	tpdopaque = (TPDPageOpaque) PageGetSpecialPointer(page);
+	*nextblkno = tpdopaque->tpd_nextblkno;
+
+	freespace = PageGetTPDFreeSpace(page);
+	if (freespace < size_tpd_entry && TPDPagePrune(relation, buf) > 0)
+		freespace = PageGetTPDFreeSpace(page);
+
+	TPDFreeSpaceDirRecord(relation, blkno, freespace);
+
+	if (freespace < size_tpd_entry)
+	{
+		UnlockReleaseBuffer(buf);
+		return InvalidBuffer;
+	}
+
+	/* Remember the buffer, so that it can be released along with others. */
+	GetTPDBuffer(relation, blkno, buf, TPD_BUF_FIND_OR_KNOWN_ENTER,
+				 &already_exists);
+
+	return buf;
+}
+
+/*
+ * TPDGetPageWithFreeSpace - Find an existing TPD page that can accommodate a
+ *		TPD entry of the given size.
+ *
+ * We first try the pages remembered in the free-space directory and then
+ * prune and check a few pages along the TPD page chain.  Each such probe
+ * continues from where the previous one left off, so that eventually all the
+ * TPD pages of the relation get pruned and their space reused.
+ *
+ * skip_blkno is the page which caller has already found to be full.
+ *
+ * Returns the buffer exclusively locked, or InvalidBuffer if no such page is
+ * found in which case caller is expected to extend the relation.
+ */
+static Buffer
+TPDGetPageWithFreeSpace(Relation relation, Size size_tpd_entry,
+						BlockNumber skip_blkno)
+{
+	TPDFreeSpaceDirEntry *entry;
+	BlockNumber	candidates[TPD_FSDIR_PAGES_PER_REL];
+	BlockNumber	nblocks;
+	BlockNumber	blkno;
+	BlockNumber	nextblkno;
+	Buffer		buf = InvalidBuffer;
+	int			ncandidates = 0;
+	int			i;
+
+	nblocks = RelationGetNumberOfBlocks(relation);
+	entry = TPDFreeSpaceDirGetEntry(relation);
+
+	/* Copy the candidates as the directory gets updated while we check them. */
+	for (i = 0; i < entry->npages; i++)
+	{
+		if (entry->blkno[i] != skip_blkno &&
+			entry->freespace[i] >= size_tpd_entry)
+			candidates[ncandidates++] = entry->blkno[i];
+	}
+
+	for (i = 0; i < ncandidates; i++)
+	{
+		buf = TPDLockPageIfFits(relation, candidates[i], size_tpd_entry,
+								nblocks, &nextblkno);
+		if (BufferIsValid(buf))
+			return buf;
+	}
+
+	/* Start probing from the first TPD page, if not already started. */
+	blkno = entry->next_probe_blk;
+	if (blkno == InvalidBlockNumber)
+	{
+		Buffer	metabuf;
+
+		metabuf = ReadBuffer(relation, ZHEAP_METAPAGE);
+		LockBuffer(metabuf, BUFFER_LOCK_SHARE);
+		blkno = ZHeapPageGetMeta(BufferGetPage(metabuf))->zhm_first_used_tpd_page;
+		UnlockReleaseBuffer(metabuf);
+	}
+
+	for (i = 0; i < TPD_PAGES_TO_PROBE && blkno != InvalidBlockNumber; i++)
+	{
+		buf = TPDLockPageIfFits(relation, blkno, size_tpd_entry, nblocks,
+								&nextblkno);
+
+		/* Stay on this page if it has space or we couldn't check it. */
+		if (BufferIsValid(buf) || nextblkno == blkno)
+			break;
+
+		blkno = nextblkno;
+	}
+
+	entry->next_probe_blk = blkno;
+
+	return buf;
+}
+
 /*
  * AllocateAndFormTPDEntry - Allocate and form the new TPD entry.
  *
@@ -386,6 +751,7 @@ ExtendTPDEntry(Relation relation, Buffer heapbuf, TransInfo *trans_slots,
 	Page		heappage;
 	Buffer		old_tpd_buf;
 	Buffer		metabuf = InvalidBuffer;
+	Buffer		reuse_tpd_buf = InvalidBuffer;
 	BlockNumber	tpdblk;
 	OffsetNumber	max_page_offnum;
 	Size		tpdpageFreeSpace;
@@ -402,6 +768,7 @@ ExtendTPDEntry(Relation relation, Buffer heapbuf, TransInfo *trans_slots,
 	int			max_reqd_slots = 0;
 	int			num_free_slots = 0;
 	int			slot_no;
+	int			num_tpd_bufs = 0;
 	uint16		tpd_e_offset;
 	char		*tpd_entry;
 	bool		already_exists;
@@ -531,17 +898,24 @@ ExtendTPDEntry(Relation relation, Buffer heapbuf, TransInfo *trans_slots,
 		if (entries_removed > 0)
 			tpdpageFreeSpace = PageGetTPDFreeSpace(old_tpd_page);
 
+		TPDFreeSpaceDirRecord(relation, BufferGetBlockNumber(old_tpd_buf),
+							  tpdpageFreeSpace);
+
 		if (tpdpageFreeSpace < new_size_tpd_entry)
 		{
 			/*
-			 * XXX Here, we can have an optimization such that instead of
-			 * allocating a new page, we can search other TPD pages starting
-			 * from the first_used_tpd_page till we reach last_used_tpd_page.
-			 * It is not clear whether such an optimization can help because
-			 * checking all the TPD pages isn't free either.
+			 * Before allocating a new page, try to move the entry to some
+			 * other existing TPD page that has enough space.
 			 */
-			metabuf = ReadBuffer(relation, ZHEAP_METAPAGE);
-			allocate_new_tpd_page = true;
+			num_tpd_bufs = tpd_buf_idx;
+			reuse_tpd_buf = TPDGetPageWithFreeSpace(relation,
+													new_size_tpd_entry,
+													BufferGetBlockNumber(old_tpd_buf));
+			if (!BufferIsValid(reuse_tpd_buf))
+			{
+				metabuf = ReadBuffer(relation, ZHEAP_METAPAGE);
+				allocate_new_tpd_page = true;
+			}
 		}
 		else
 			update_tpd_inplace = true;
@@ -580,6 +954,8 @@ ExtendTPDEntry(Relation relation, Buffer heapbuf, TransInfo *trans_slots,
 		*tpd_e_pruned = true;
 		if (metabuf != InvalidBuffer)
 			ReleaseBuffer(metabuf);
+		if (BufferIsValid(reuse_tpd_buf) && tpd_buf_idx > num_tpd_bufs)
+			ReleaseLastTPDBuffer(reuse_tpd_buf);
 		return;
 	}
 
@@ -682,14 +1058,16 @@ ExtendTPDEntry(Relation relation, Buffer heapbuf, TransInfo *trans_slots,
 	else
 	{
 		/*
-		 * Note that if we have to allocate a new page, we must delete the
-		 * old tpd entry in old tpd buffer.
+		 * Note that if we have to move the entry to a different page, we must
+		 * delete the old tpd entry in old tpd buffer.
 		 */
 		TPDAllocatePageAndAddEntry(relation, metabuf, heapbuf, old_tpd_buf,
-								   tpdItemOff, tpd_entry, new_size_tpd_entry,
-								   allocate_new_tpd_page,
-								   allocate_new_tpd_page);
+								   tpdItemOff, reuse_tpd_buf, tpd_entry,
+								   new_size_tpd_entry, allocate_new_tpd_page,
+								   allocate_new_tpd_page ||
+								   BufferIsValid(reuse_tpd_buf));
 	}
+	pgstat_count_zheap_tpd_entry_extended(relation);
 
 	/* Release the meta buffer. */
 	if (metabuf != InvalidBuffer)
@@ -1017,6 +1395,11 @@ TPDEntryUpdate(Relation relation, Buffer tpd_buf, uint16 tpd_e_offset,
  * entry in heap page. Finally write a WAL entry and corresponding replay
  * routine to cover all these operations and release all the buffers.
  *
+ * The new entry is added to target_tpd_buf if it is valid, otherwise to
+ * old_tpd_buf unless a new page is requested.  Caller must have locked
+ * target_tpd_buf which is always an existing TPD page found via free-space
+ * directory.
+ *
  * The other aspect this function needs to ensure is the buffer locking order
  * to avoid deadlocks.  We operate on four buffers: metapage buffer, old tpd
  * page buffer, last used tpd page buffer and new tpd page buffer.  The old
@@ -1031,8 +1414,9 @@ TPDEntryUpdate(Relation relation, Buffer tpd_buf, uint16 tpd_e_offset,
 static void
 TPDAllocatePageAndAddEntry(Relation relation, Buffer metabuf, Buffer pagebuf,
 						   Buffer old_tpd_buf, OffsetNumber old_off_num,
-						   char *tpd_entry, Size size_tpd_entry,
-						   bool add_new_tpd_page, bool delete_old_entry)
+						   Buffer target_tpd_buf, char *tpd_entry,
+						   Size size_tpd_entry, bool add_new_tpd_page,
+						   bool delete_old_entry)
 {
 	ZHeapMetaPage	metapage;
 	TPDPageOpaque	tpdopaque, last_tpdopaque;
@@ -1113,6 +1497,8 @@ recheck_meta:
 			}
 		}
 	}
+	else if (BufferIsValid(target_tpd_buf))
+		tpd_buf = target_tpd_buf;
 	else
 	{
 		/* old buffer must be valid */
@@ -1160,8 +1546,8 @@ recheck_meta:
 		Page	otpdpage;
 		ItemId	old_item_id;
 
-		/* We must be adding new TPD entry into a new page. */
-		Assert(add_new_tpd_page);
+		/* We must be adding new TPD entry into a different page. */
+		Assert(add_new_tpd_page || BufferIsValid(target_tpd_buf));
 		Assert(old_tpd_buf != tpd_buf);
 
 		otpdpage = BufferGetPage(old_tpd_buf);
@@ -1224,24 +1610,24 @@ recheck_meta:
 
 			if (BufferIsValid(last_used_tpd_buf))
 				XLogRegisterBuffer(3, last_used_tpd_buf, REGBUF_STANDARD);
+		}
 
-			/* The old entry is deleted only when new page is allocated. */
-			if (delete_old_entry)
+		/* The old entry is deleted only when entry is moved to other page. */
+		if (delete_old_entry)
+		{
+			/*
+			 * If the last tpd buffer and the old tpd buffer are same, we
+			 * don't need to register old_tpd_buf.
+			 */
+			if (add_new_tpd_page && last_used_tpd_buf == old_tpd_buf)
 			{
-				/*
-				 * If the last tpd buffer and the old tpd buffer are same, we
-				 * don't need to register old_tpd_buf.
-				 */
-				if (last_used_tpd_buf == old_tpd_buf)
-				{
-					xlrec.flags = XLOG_OLD_TPD_BUF_EQ_LAST_TPD_BUF;
-					XLogRegisterBufData(3, (char *) &old_off_num, sizeof(OffsetNumber));
-				}
-				else
-				{
-					XLogRegisterBuffer(4, old_tpd_buf, REGBUF_STANDARD);
-					XLogRegisterBufData(4, (char *) &old_off_num, sizeof(OffsetNumber));
-				}
+				xlrec.flags = XLOG_OLD_TPD_BUF_EQ_LAST_TPD_BUF;
+				XLogRegisterBufData(3, (char *) &old_off_num, sizeof(OffsetNumber));
+			}
+			else
+			{
+				XLogRegisterBuffer(4, old_tpd_buf, REGBUF_STANDARD);
+				XLogRegisterBufData(4, (char *) &old_off_num, sizeof(OffsetNumber));
 			}
 		}
 
@@ -1254,13 +1640,16 @@ recheck_meta:
 			PageSetLSN(metapage, recptr);
 			if (BufferIsValid(last_used_tpd_buf))
 				PageSetLSN(BufferGetPage(last_used_tpd_buf), recptr);
-			if (delete_old_entry)
-				PageSetLSN(BufferGetPage(old_tpd_buf), recptr);
 		}
+		if (delete_old_entry)
+			PageSetLSN(BufferGetPage(old_tpd_buf), recptr);
 	}
 
 	END_CRIT_SECTION();
 
+	TPDFreeSpaceDirRecord(relation, BufferGetBlockNumber(tpd_buf),
+						  PageGetTPDFreeSpace(tpdpage));
+
 	if (add_new_tpd_page)
 		LockBuffer(metabuf, BUFFER_LOCK_UNLOCK);
 	if (free_last_used_tpd_buf)
@@ -1356,18 +1745,22 @@ TPDAllocateAndReserveTransSlot(Relation relation, Buffer pagebuf,
 			if (entries_removed > 0)
 				tpdpageFreeSpace = PageGetTPDFreeSpace(BufferGetPage(tpd_buf));
 
+			TPDFreeSpaceDirRecord(relation, last_used_tpd_page,
+								  tpdpageFreeSpace);
+
 			if (tpdpageFreeSpace < size_tpd_entry)
 			{
-				/*
-				 * XXX Here, we can have an optimization such that instead of
-				 * allocating a new page, we can search other TPD pages starting
-				 * from the first_used_tpd_page till we reach last_used_tpd_page.
-				 * It is not clear whether such an optimization can help because
-				 * checking all the TPD pages isn't free either.
-				 */
 				if (!already_exists)
 					ReleaseLastTPDBuffer(tpd_buf);
-				allocate_new_tpd_page = true;
+
+				/*
+				 * Before allocating a new page, check whether some other
+				 * existing TPD page has enough space for the new entry.
+				 */
+				tpd_buf = TPDGetPageWithFreeSpace(relation, size_tpd_entry,
+												  last_used_tpd_page);
+				if (!BufferIsValid(tpd_buf))
+					allocate_new_tpd_page = true;
 			}
 		}
 	}
@@ -1386,8 +1779,9 @@ TPDAllocateAndReserveTransSlot(Relation relation, Buffer pagebuf,
 	Assert (tpd_entry != NULL);
 
 	TPDAllocatePageAndAddEntry(relation, metabuf, pagebuf, tpd_buf,
-							   InvalidOffsetNumber, tpd_entry, size_tpd_entry,
-							   update_meta, false);
+							   InvalidOffsetNumber, InvalidBuffer, tpd_entry,
+							   size_tpd_entry, update_meta, false);
+	pgstat_count_zheap_tpd_entry_allocated(relation);
 
 	ReleaseBuffer(metabuf);
 
@@ -1760,12 +2154,176 @@ TPDPageGetSlotIfExists(Relation relation, Buffer heapbuf, OffsetNumber offnum,
 	return result_slot_no;
 }
 
+/*
+ * TPDEntryGetTransSlotInfo - Get the required transaction information from
+ *		the contents of a TPD entry.
+ *
+ * tpd_entry_data points to the offset-map of the TPD entry which is followed
+ * by its transaction slots.  This is a helper routine for
+ * TPDPageGetTransactionSlotInfo which can get the entry either from TPD page
+ * or from TPD entry cache.
+ */
+static int
+TPDEntryGetTransSlotInfo(TPDEntryHeader tpd_e_hdr, char *tpd_entry_data,
+						 int trans_slot_id, OffsetNumber offset,
+						 uint32 *epoch, TransactionId *xid,
+						 UndoRecPtr *urec_ptr)
+{
+	TransInfo	trans_slot_info;
+	Size		size_tpd_e_map;
+	uint32	tpd_e_num_map_entries;
+	int		trans_slot_loc;
+
+	tpd_e_num_map_entries = tpd_e_hdr->tpe_num_map_entries;
+	if (tpd_e_hdr->tpe_flags & TPE_ONE_BYTE)
+		size_tpd_e_map = tpd_e_num_map_entries * sizeof(uint8);
+	else
+	{
+		Assert(tpd_e_hdr->tpe_flags & TPE_FOUR_BYTE);
+		size_tpd_e_map = tpd_e_num_map_entries * sizeof(uint32);
+	}
+
+	/*
+	 * If the caller has passed transaction slot number that belongs to TPD
+	 * entry, then we directly go and fetch the required info from the slot.
+	 */
+	if (offset != InvalidOffsetNumber)
+	{
+		/*
+		 * The item for which we want to get the transaction slot information
+		 * must be present in this TPD entry.
+		 */
+		Assert (offset <= tpd_e_num_map_entries);
+
+		/* Get TPD entry map */
+		if (tpd_e_hdr->tpe_flags & TPE_ONE_BYTE)
+		{
+			uint8	offset_tpd_e_loc;
+
+			/*
+			 * One byte access shouldn't cause unaligned access, but using memcpy
+			 * for the sake of consistency.
+			 */
+			memcpy((char *) &offset_tpd_e_loc, tpd_entry_data + (offset - 1),
+				   sizeof(uint8));
+			trans_slot_id = offset_tpd_e_loc;
+		}
+		else
+		{
+			uint32	offset_tpd_e_loc;
+
+			memcpy((char *) &offset_tpd_e_loc,
+				   tpd_entry_data + (sizeof(uint32) * (offset - 1)),
+				   sizeof(uint32));
+			trans_slot_id = offset_tpd_e_loc;
+		}
+	}
+
+	/* Transaction must belong to TPD entry. */
+	Assert(trans_slot_id > ZHEAP_PAGE_TRANS_SLOTS);
+
+	/* Get the required transaction slot information. */
+	trans_slot_loc = (trans_slot_id - ZHEAP_PAGE_TRANS_SLOTS - 1) *
+										sizeof(TransInfo);
+	memcpy((char *) &trans_slot_info,
+			tpd_entry_data + size_tpd_e_map + trans_slot_loc,
+			sizeof(TransInfo));
+
+	/* Update the required output */
+	if (epoch)
+		*epoch = trans_slot_info.xid_epoch;
+	if (xid)
+		*xid = trans_slot_info.xid;
+	if (urec_ptr)
+		*urec_ptr = trans_slot_info.urec_ptr;
+
+	return trans_slot_id;
+}
+
+/*
+ * TPDEntryCacheLookup - Find the cached copy of the TPD entry of a heap page.
+ *
+ * The entry is considered valid only if the heap page has not been modified
+ * since we cached it.  Caller must still verify the LSN of the TPD page, as
+ * pruning of TPD page doesn't modify the heap page.
+ */
+static TPDEntryCacheData *
+TPDEntryCacheLookup(RelFileNode rnode, ForkNumber forknum,
+					BlockNumber heapblk, BlockNumber tpdblk,
+					OffsetNumber tpdItemOff, XLogRecPtr heap_lsn)
+{
+	TPDEntryCacheData *cache;
+
+	cache = &tpd_entry_cache[TPDEntryCacheIndex(rnode, heapblk)];
+
+	if (cache->tpd_entry_data == NULL ||
+		!RelFileNodeEquals(cache->rnode, rnode) ||
+		cache->forknum != forknum ||
+		cache->heapblk != heapblk ||
+		cache->tpdblk != tpdblk ||
+		cache->tpdItemOff != tpdItemOff ||
+		cache->heap_lsn != heap_lsn)
+		return NULL;
+
+	return cache;
+}
+
+/*
+ * TPDEntryCacheInsert - Remember a copy of the TPD entry of a heap page.
+ *
+ * We replace whatever entry was cached at the same location.
+ */
+static void
+TPDEntryCacheInsert(RelFileNode rnode, ForkNumber forknum,
+					BlockNumber heapblk, BlockNumber tpdblk,
+					OffsetNumber tpdItemOff, XLogRecPtr heap_lsn,
+					XLogRecPtr tpd_lsn, TPDEntryHeader tpd_e_hdr,
+					char *tpd_entry_data, Size size_tpd_e_data)
+{
+	TPDEntryCacheData *cache;
+
+	if (TPDEntryCacheContext == NULL)
+		TPDEntryCacheContext = AllocSetContextCreate(TopMemoryContext,
+													 "TPD entry cache",
+													 ALLOCSET_SMALL_SIZES);
+
+	cache = &tpd_entry_cache[TPDEntryCacheIndex(rnode, heapblk)];
+
+	if (cache->tpd_entry_data != NULL && cache->size < size_tpd_e_data)
+	{
+		pfree(cache->tpd_entry_data);
+		cache->tpd_entry_data = NULL;
+	}
+
+	if (cache->tpd_entry_data == NULL)
+	{
+		cache->tpd_entry_data = MemoryContextAlloc(TPDEntryCacheContext,
+												   size_tpd_e_data);
+		cache->size = size_tpd_e_data;
+	}
+
+	cache->rnode = rnode;
+	cache->forknum = forknum;
+	cache->heapblk = heapblk;
+	cache->tpdblk = tpdblk;
+	cache->tpdItemOff = tpdItemOff;
+	cache->heap_lsn = heap_lsn;
+	cache->tpd_lsn = tpd_lsn;
+	memcpy(&cache->tpd_e_hdr, tpd_e_hdr, SizeofTPDEntryHeader);
+	memcpy(cache->tpd_entry_data, tpd_entry_data, size_tpd_e_data);
+}
+
 /*
  * TPDPageGetTransactionSlotInfo - Get the required transaction information from
  *		heap page's TPD entry.
  *
  * NoTPDBufLock - This indicates that caller doesn't have lock on required tpd
  * buffer in which case we need to read and lock the required buffer.
+ *
+ * When the caller doesn't hold the TPD buffer lock and doesn't want to retain
+ * it, we first consult the TPD entry cache, so that repeated lookups for the
+ * tuples of the same heap page need to only check the TPD page LSN rather
+ * than decode the entry all over again.
  */
 int
 TPDPageGetTransactionSlotInfo(Buffer heapbuf, int trans_slot,
@@ -1775,7 +2333,7 @@ TPDPageGetTransactionSlotInfo(Buffer heapbuf, int trans_slot,
 {
 	PageHeader	phdr PG_USED_FOR_ASSERTS_ONLY;
 	ZHeapPageOpaque	zopaque;
-	TransInfo	trans_slot_info, last_trans_slot_info;
+	TransInfo	last_trans_slot_info;
 	RelFileNode	rnode;
 	Buffer	tpdbuffer;
 	Page	tpdpage;
@@ -1783,15 +2341,13 @@ TPDPageGetTransactionSlotInfo(Buffer heapbuf, int trans_slot,
 	BlockNumber	tpdblk, heapblk;
 	ForkNumber forknum;
 	TPDEntryHeaderData	tpd_e_hdr;
-	Size		size_tpd_e_map;
-	uint32	tpd_e_num_map_entries;
-	int		trans_slot_loc;
+	TPDEntryCacheData *cache = NULL;
 	int		trans_slot_id = trans_slot;
 	char	*tpd_entry_data;
 	OffsetNumber	tpdItemOff;
 	ItemId	itemId;
 	uint16	tpd_e_offset;
-	char relpersistence;
+	char relpersistence = 0;
 
 	heappage = BufferGetPage(heapbuf);
 	phdr = (PageHeader) heappage;
@@ -1809,7 +2365,12 @@ TPDPageGetTransactionSlotInfo(Buffer heapbuf, int trans_slot,
 	{
 		BufferGetTag(heapbuf, &rnode, &forknum, &heapblk);
 
-		if (InRecovery)
+		if (!keepTPDBufLock)
+			cache = TPDEntryCacheLookup(rnode, forknum, heapblk, tpdblk,
+										tpdItemOff, PageGetLSN(heappage));
+
+		/* We only ever cache the entries of WAL-logged relations. */
+		if (InRecovery || cache != NULL)
 			relpersistence = RELPERSISTENCE_PERMANENT;
 		else
 		{
@@ -1821,10 +2382,27 @@ TPDPageGetTransactionSlotInfo(Buffer heapbuf, int trans_slot,
 
 		tpdbuffer = ReadBufferWithoutRelcache(rnode, forknum, tpdblk, RBM_NORMAL,
 											  NULL, relpersistence);
+
 		if (keepTPDBufLock)
 			LockBuffer(tpdbuffer, BUFFER_LOCK_EXCLUSIVE);
 		else
 			LockBuffer(tpdbuffer, BUFFER_LOCK_SHARE);
+
+		/*
+		 * Every change in the TPD page is WAL-logged, so if its LSN is same
+		 * as what we have seen while caching the entry, the entry can't have
+		 * changed.  The check must be done under the content lock, else the
+		 * page could change right after it.
+		 */
+		if (cache != NULL && PageGetLSN(BufferGetPage(tpdbuffer)) == cache->tpd_lsn)
+		{
+			trans_slot_id = TPDEntryGetTransSlotInfo(&cache->tpd_e_hdr,
+													 cache->tpd_entry_data,
+													 trans_slot_id, offset,
+													 epoch, xid, urec_ptr);
+			UnlockReleaseBuffer(tpdbuffer);
+			return trans_slot_id;
+		}
 	}
 	else
 	{
@@ -1876,72 +2454,21 @@ TPDPageGetTransactionSlotInfo(Buffer heapbuf, int trans_slot,
 	/* We should never access deleted entry. */
 	Assert(!TPDEntryIsDeleted(tpd_e_hdr));
 
-	tpd_e_num_map_entries = tpd_e_hdr.tpe_num_map_entries;
 	tpd_entry_data = tpdpage + tpd_e_offset + SizeofTPDEntryHeader;
-	if (tpd_e_hdr.tpe_flags & TPE_ONE_BYTE)
-		size_tpd_e_map = tpd_e_num_map_entries * sizeof(uint8);
-	else
-	{
-		Assert(tpd_e_hdr.tpe_flags & TPE_FOUR_BYTE);
-		size_tpd_e_map = tpd_e_num_map_entries * sizeof(uint32);
-	}
-
-	/*
-	 * If the caller has passed transaction slot number that belongs to TPD
-	 * entry, then we directly go and fetch the required info from the slot.
-	 */
-	if (offset != InvalidOffsetNumber)
-	{
-		/*
-		 * The item for which we want to get the transaction slot information
-		 * must be present in this TPD entry.
-		 */
-		Assert (offset <= tpd_e_num_map_entries);
-
-		/* Get TPD entry map */
-		if (tpd_e_hdr.tpe_flags & TPE_ONE_BYTE)
-		{
-			uint8	offset_tpd_e_loc;
-
-			/*
-			 * One byte access shouldn't cause unaligned access, but using memcpy
-			 * for the sake of consistency.
-			 */
-			memcpy((char *) &offset_tpd_e_loc, tpd_entry_data + (offset - 1),
-				   sizeof(uint8));
-			trans_slot_id = offset_tpd_e_loc;
-		}
-		else
-		{
-			uint32	offset_tpd_e_loc;
-
-			memcpy((char *) &offset_tpd_e_loc,
-				   tpd_entry_data + (sizeof(uint32) * (offset - 1)),
-				   sizeof(uint32));
-			trans_slot_id = offset_tpd_e_loc;
-		}
-	}
-
-	/* Transaction must belong to TPD entry. */
-	Assert(trans_slot_id > ZHEAP_PAGE_TRANS_SLOTS);
 
-	/* Get the required transaction slot information. */
-	trans_slot_loc = (trans_slot_id - ZHEAP_PAGE_TRANS_SLOTS - 1) *
-										sizeof(TransInfo);
-	memcpy((char *) &trans_slot_info,
-			tpd_entry_data + size_tpd_e_map + trans_slot_loc,
-			sizeof(TransInfo));
-
-	/* Update the required output */
-	if (epoch)
-		*epoch = trans_slot_info.xid_epoch;
-	if (xid)
-		*xid = trans_slot_info.xid;
-	if (urec_ptr)
-		*urec_ptr = trans_slot_info.urec_ptr;
+	trans_slot_id = TPDEntryGetTransSlotInfo(&tpd_e_hdr, tpd_entry_data,
+											 trans_slot_id, offset, epoch,
+											 xid, urec_ptr);
 
 	if (NoTPDBufLock && !keepTPDBufLock)
+	{
+		if (relpersistence == RELPERSISTENCE_PERMANENT)
+			TPDEntryCacheInsert(rnode, forknum, heapblk, tpdblk, tpdItemOff,
+								PageGetLSN(heappage), PageGetLSN(tpdpage),
+								&tpd_e_hdr, tpd_entry_data,
+								ItemIdGetLength(itemId) - SizeofTPDEntryHeader);
 		UnlockReleaseBuffer(tpdbuffer);
+	}
 
 	return trans_slot_id;
 
@@ -69,8 +69,13 @@ tpd_xlog_allocate_entry(XLogReaderState *record)
 		/* The TPD entry must be added at the provided offset. */
 		Assert(offnum == xlrec->offnum);
 
+		/*
+		 * The TPD page chain is modified only when the entry is added to a
+		 * new page; an existing page could be somewhere in the middle of it.
+		 */
 		tpdopaque = (TPDPageOpaque) PageGetSpecialPointer(tpdpage);
-		tpdopaque->tpd_prevblkno = xlrec->prevblk;
+		if (XLogRecGetInfo(record) & XLOG_TPD_INIT_PAGE)
+			tpdopaque->tpd_prevblkno = xlrec->prevblk;
 
 		MarkBufferDirty(tpdbuffer);
 		PageSetLSN(tpdpage, lsn);
@@ -84,7 +89,8 @@ tpd_xlog_allocate_entry(XLogReaderState *record)
 		tpdpage = BufferGetPage(tpdbuffer);
 
 		tpdopaque = (TPDPageOpaque) PageGetSpecialPointer(tpdpage);
-		tpdopaque->tpd_prevblkno = xlrec->prevblk;
+		if (XLogRecGetInfo(record) & XLOG_TPD_INIT_PAGE)
+			tpdopaque->tpd_prevblkno = xlrec->prevblk;
 
 		MarkBufferDirty(tpdbuffer);
 		PageSetLSN(tpdpage, lsn);
@@ -169,37 +175,38 @@ tpd_xlog_allocate_entry(XLogReaderState *record)
 				PageSetLSN(last_used_page, lsn);
 			}
 		}
+	}
 
-		/*
-		 * We can have reference of block 4, iff we have reference for block
-		 * 2.
-		 */
-		if (XLogRecHasBlockRef(record, 4))
-		{
-			TPDEntryHeader	old_tpd_entry;
-			Page	otpdpage;
-			char	*data;
-			OffsetNumber	*off_num;
-			Size	datalen PG_USED_FOR_ASSERTS_ONLY;
-			ItemId	old_item_id;
+	/*
+	 * We have a reference of block 4 when the entry is moved to a different
+	 * page, either a newly allocated one or an existing TPD page having
+	 * enough free space.
+	 */
+	if (XLogRecHasBlockRef(record, 4))
+	{
+		TPDEntryHeader	old_tpd_entry;
+		Page	otpdpage;
+		char	*data;
+		OffsetNumber	*off_num;
+		Size	datalen PG_USED_FOR_ASSERTS_ONLY;
+		ItemId	old_item_id;
 
-			action = XLogReadBufferForRedo(record, 4, &old_tpd_buf);
+		action = XLogReadBufferForRedo(record, 4, &old_tpd_buf);
 
-			if (action == BLK_NEEDS_REDO)
-			{
-				data = XLogRecGetBlockData(record, 4, &datalen);
+		if (action == BLK_NEEDS_REDO)
+		{
+			data = XLogRecGetBlockData(record, 4, &datalen);
 
-				off_num = (OffsetNumber *) data;
-				Assert(datalen == sizeof(OffsetNumber));
+			off_num = (OffsetNumber *) data;
+			Assert(datalen == sizeof(OffsetNumber));
 
-				otpdpage = BufferGetPage(old_tpd_buf);
-				old_item_id = PageGetItemId(otpdpage, *off_num);
-				old_tpd_entry = (TPDEntryHeader) PageGetItem(otpdpage, old_item_id);
-				old_tpd_entry->tpe_flags |= TPE_DELETED;
+			otpdpage = BufferGetPage(old_tpd_buf);
+			old_item_id = PageGetItemId(otpdpage, *off_num);
+			old_tpd_entry = (TPDEntryHeader) PageGetItem(otpdpage, old_item_id);
+			old_tpd_entry->tpe_flags |= TPE_DELETED;
 
-				MarkBufferDirty(old_tpd_buf);
-				PageSetLSN(BufferGetPage(old_tpd_buf), lsn);
-			}
+			MarkBufferDirty(old_tpd_buf);
+			PageSetLSN(BufferGetPage(old_tpd_buf), lsn);
 		}
 	}
 
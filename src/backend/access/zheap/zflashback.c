@@ -0,0 +1,284 @@
+/*-------------------------------------------------------------------------
+ *
+ * zflashback.c
+ *	  read zheap relations as of a past transaction or time
+ *
+ * Portions Copyright (c) 1996-2017, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994, Regents of the University of California
+ *
+ *
+ * IDENTIFICATION
+ *	  src/backend/access/zheap/zflashback.c
+ *
+ * NOTES
+ *	  zheap keeps the prior versions of modified tuples in undo, and the
+ *	  visibility routines walk the undo chain until they find the version
+ *	  that is visible to a snapshot.  A flashback query simply scans the
+ *	  relation with a snapshot taken in the past, so the same chain walk
+ *	  reconstructs the rows as they were back then.  The undo worker records
+ *	  the running transactions every so often while undo_retention is set,
+ *	  which is what such snapshots are rebuilt from.  This only works while
+ *	  the undo of the transactions not visible to the snapshot hasn't been
+ *	  discarded, and as long as the relation's storage hasn't been replaced
+ *	  since.
+ *
+ *-------------------------------------------------------------------------
+ */
+#include "postgres.h"
+
+#include "access/heapam.h"
+#include "access/htup_details.h"
+#include "access/transam.h"
+#include "access/undodiscard.h"
+#include "access/xact.h"
+#include "access/xlog.h"
+#include "access/zheap.h"
+#include "access/zheaputils.h"
+#include "catalog/pg_class.h"
+#include "funcapi.h"
+#include "miscadmin.h"
+#include "nodes/execnodes.h"
+#include "storage/proc.h"
+#include "utils/acl.h"
+#include "utils/builtins.h"
+#include "utils/lsyscache.h"
+#include "utils/rel.h"
+#include "utils/snapmgr.h"
+#include "utils/syscache.h"
+#include "utils/timestamp.h"
+#include "utils/tuplestore.h"
+
+static Datum zheap_flashback_guts(FunctionCallInfo fcinfo, TimestampTz time,
+					 uint64 epoch_xid);
+static void zheap_flashback_check_undo(uint64 epoch_xmin);
+
+/*
+ * Error out if the undo needed to scan with a snapshot whose xmin is
+ * epoch_xmin may already have been discarded.  Undo is discarded transaction
+ * by transaction in xid order, so it's enough that no transaction from
+ * epoch_xmin on has lost its undo.
+ */
+static void
+zheap_flashback_check_undo(uint64 epoch_xmin)
+{
+	if (epoch_xmin < pg_atomic_read_u64(&ProcGlobal->oldestXidWithEpochHavingUndo))
+		ereport(ERROR,
+				(errcode(ERRCODE_SNAPSHOT_TOO_OLD),
+				 errmsg("undo needed to flash back to transaction %u has been discarded",
+						GetXidFromEpochXid(epoch_xmin)),
+				 errhint("Increase undo_retention to keep undo for longer.")));
+}
+
+/*
+ * Scan the zheap relation whose row type is the type of the first argument,
+ * returning the rows that were visible at the newest undo retention sample
+ * taken at or before 'time' and before transaction epoch_xid started.
+ */
+static Datum
+zheap_flashback_guts(FunctionCallInfo fcinfo, TimestampTz time,
+					 uint64 epoch_xid)
+{
+	ReturnSetInfo *rsinfo = (ReturnSetInfo *) fcinfo->resultinfo;
+	Oid			argtype;
+	Oid			relid;
+	Relation	rel;
+	AclResult	aclresult;
+	TupleDesc	tupdesc;
+	Tuplestorestate *tupstore;
+	MemoryContext per_query_ctx;
+	MemoryContext oldcontext;
+	SnapshotData flashback_snapshot;
+	uint64		epoch_xmin;
+	HeapTuple	classtup;
+	TransactionId classxmin;
+	HeapScanDesc scan;
+	ZHeapTuple	ztuple;
+
+	/* check to see if caller supports us returning a tuplestore */
+	if (rsinfo == NULL || !IsA(rsinfo, ReturnSetInfo))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("set-valued function called in context that cannot accept a set")));
+	if (!(rsinfo->allowedModes & SFRM_Materialize))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("materialize mode required, but it is not " \
+						"allowed in this context")));
+
+	argtype = get_fn_expr_argtype(fcinfo->flinfo, 0);
+	relid = OidIsValid(argtype) ? get_typ_typrelid(argtype) : InvalidOid;
+	if (!OidIsValid(relid))
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("first argument of zheap_flashback must be the row type of a table")));
+
+	rel = heap_open(relid, AccessShareLock);
+
+	if ((rel->rd_rel->relkind != RELKIND_RELATION &&
+		 rel->rd_rel->relkind != RELKIND_MATVIEW) ||
+		!RelationStorageIsZHeap(rel))
+		ereport(ERROR,
+				(errcode(ERRCODE_WRONG_OBJECT_TYPE),
+				 errmsg("\"%s\" is not a zheap table",
+						RelationGetRelationName(rel))));
+
+	/* The undo of temporary relations is discarded at each commit. */
+	if (RelationUsesLocalBuffers(rel))
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("cannot flash back temporary table \"%s\"",
+						RelationGetRelationName(rel))));
+
+	aclresult = pg_class_aclcheck(relid, GetUserId(), ACL_SELECT);
+	if (aclresult != ACLCHECK_OK)
+		aclcheck_error(aclresult, get_relkind_objtype(rel->rd_rel->relkind),
+					   RelationGetRelationName(rel));
+
+	/*
+	 * Every transaction that had finished when the sample was taken is
+	 * considered finished, and every other one as not yet started, so tuples
+	 * modified since are replaced by their prior version from undo.  Our own
+	 * changes are treated the same way, by considering all our commands to
+	 * come after the scan.
+	 */
+	flashback_snapshot = *GetActiveSnapshot();
+	flashback_snapshot.xip = (TransactionId *)
+		palloc(UNDO_RETENTION_MAX_RUNNING * sizeof(TransactionId));
+	if (!UndoRetentionGetSnapshot(time, epoch_xid, &flashback_snapshot,
+								  &epoch_xmin))
+		ereport(ERROR,
+				(errcode(ERRCODE_SNAPSHOT_TOO_OLD),
+				 errmsg("no undo is retained as of the requested point in time"),
+				 errhint("Set undo_retention to keep undo for flashback queries.")));
+	flashback_snapshot.subxcnt = 0;
+	flashback_snapshot.suboverflowed = false;
+	flashback_snapshot.takenDuringRecovery = false;
+	flashback_snapshot.curcid = FirstCommandId;
+	flashback_snapshot.copied = false;
+	flashback_snapshot.active_count = 0;
+	flashback_snapshot.regd_count = 0;
+
+	zheap_flashback_check_undo(epoch_xmin);
+
+	/*
+	 * The undo chains don't lead past a TRUNCATE, CLUSTER or anything else
+	 * that gave the relation new storage, so refuse if that happened after
+	 * the snapshot.  Any such command updates the pg_class row, so it's
+	 * enough to check that the row is older than every transaction the
+	 * snapshot might consider running.  That also rejects some harmless
+	 * changes, like ALTER TABLE, which we don't try to tell apart.
+	 */
+	classtup = SearchSysCache1(RELOID, ObjectIdGetDatum(relid));
+	if (!HeapTupleIsValid(classtup))
+		elog(ERROR, "cache lookup failed for relation %u", relid);
+	classxmin = HeapTupleHeaderGetXmin(classtup->t_data);
+	ReleaseSysCache(classtup);
+	if (TransactionIdIsNormal(classxmin) &&
+		!TransactionIdPrecedes(classxmin, flashback_snapshot.xmin))
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				 errmsg("cannot flash back table \"%s\" past a change to its definition or storage",
+						RelationGetRelationName(rel))));
+
+	/* Build a tuple descriptor for our result type */
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	per_query_ctx = rsinfo->econtext->ecxt_per_query_memory;
+	oldcontext = MemoryContextSwitchTo(per_query_ctx);
+
+	tupstore = tuplestore_begin_heap(true, false, work_mem);
+	rsinfo->returnMode = SFRM_Materialize;
+	rsinfo->setResult = tupstore;
+	rsinfo->setDesc = tupdesc;
+
+	MemoryContextSwitchTo(oldcontext);
+
+	scan = zheap_beginscan(rel, &flashback_snapshot, 0, NULL);
+	while ((ztuple = zheap_getnext(scan, ForwardScanDirection)) != NULL)
+	{
+		HeapTuple	tuple;
+
+		CHECK_FOR_INTERRUPTS();
+
+		tuple = zheap_to_heap(ztuple, RelationGetDescr(rel));
+		tuplestore_puttuple(tupstore, tuple);
+		heap_freetuple(tuple);
+	}
+	heap_endscan(scan);
+
+	/*
+	 * The undo worker might have discarded undo we needed while we were
+	 * scanning, in which case the visibility checks have silently returned
+	 * the newer version of some tuples.  Don't return such a mix.
+	 */
+	zheap_flashback_check_undo(epoch_xmin);
+
+	tuplestore_donestoring(tupstore);
+
+	heap_close(rel, AccessShareLock);
+
+	return (Datum) 0;
+}
+
+/*
+ * zheap_flashback(anyelement, xid)
+ *
+ * Return the rows of a zheap table as they were before the given transaction
+ * started.  The table is identified by the type of the first argument, as in
+ * SELECT * FROM zheap_flashback(NULL::mytable, '1234').  The running
+ * transactions are only known at the times the undo worker sampled them, so
+ * the result is as of the last sample taken before the transaction started.
+ */
+Datum
+zheap_flashback_xid(PG_FUNCTION_ARGS)
+{
+	TransactionId xid;
+	TransactionId next_xid;
+	uint64		epoch_xid;
+
+	if (PG_ARGISNULL(1))
+		ereport(ERROR,
+				(errcode(ERRCODE_NULL_VALUE_NOT_ALLOWED),
+				 errmsg("transaction ID must not be null")));
+
+	xid = DatumGetTransactionId(PG_GETARG_DATUM(1));
+	if (!TransactionIdIsNormal(xid))
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("transaction ID %u is not a normal transaction ID", xid)));
+
+	epoch_xid = MakeEpochXid((uint64) GetEpochForXid(xid), xid);
+	next_xid = ReadNewTransactionId();
+	if (epoch_xid > MakeEpochXid((uint64) GetEpochForXid(next_xid), next_xid))
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("transaction ID %u is in the future", xid)));
+
+	return zheap_flashback_guts(fcinfo, DT_NOEND, epoch_xid);
+}
+
+/*
+ * zheap_flashback(anyelement, timestamptz)
+ *
+ * Like zheap_flashback_xid, for a point in time.  The time is likewise
+ * rounded down to the last sample taken by the undo worker.
+ */
+Datum
+zheap_flashback_timestamp(PG_FUNCTION_ARGS)
+{
+	TimestampTz	time;
+
+	if (PG_ARGISNULL(1))
+		ereport(ERROR,
+				(errcode(ERRCODE_NULL_VALUE_NOT_ALLOWED),
+				 errmsg("timestamp must not be null")));
+
+	time = PG_GETARG_TIMESTAMPTZ(1);
+	if (time > GetCurrentTimestamp())
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("cannot flash back to a time in the future")));
+
+	return zheap_flashback_guts(fcinfo, time, PG_UINT64_MAX);
+}
@@ -69,6 +69,7 @@
 #include "utils/expandeddatum.h"
 #include "utils/inval.h"
 #include "utils/memdebug.h"
+#include "utils/memutils.h"
 #include "utils/rel.h"
 #include "utils/tqual.h"
 
@@ -488,15 +489,20 @@ zheap_prepare_insert(Relation relation, ZHeapTuple tup, int options)
 {
 
 	/*
-	 * In zheap, we don't support the optimization for HEAP_INSERT_SKIP_WAL.
 	 * If we skip writing/using WAL, we must force the relation down to disk
-	 * (using heap_sync) before it's safe to commit the transaction. This
-	 * requires writing out any dirty buffers of that relation and then doing
-	 * a forced fsync. For zheap, we've to fsync the corresponding undo buffers
-	 * as well. It is difficult to keep track of dirty undo buffers and fsync
-	 * them at end of the operation in some function similar to heap_sync.
+	 * (using heap_sync) before it's safe to commit the transaction.  For
+	 * zheap, we'd have to fsync the corresponding undo buffers as well, and
+	 * it is difficult to keep track of dirty undo buffers.  So, we support
+	 * HEAP_INSERT_SKIP_WAL only for bulk loads into a relfilenode created in
+	 * the current subtransaction, where the tuples are inserted frozen and
+	 * no undo is written at all.
 	 */
-	Assert(!(options & HEAP_INSERT_SKIP_WAL));
+	Assert(!(options & HEAP_INSERT_SKIP_WAL) ||
+		   (options & HEAP_INSERT_FROZEN));
+
+	/* Speculative insertions need the undo record to store the token. */
+	Assert(!((options & HEAP_INSERT_FROZEN) &&
+			 (options & HEAP_INSERT_SPECULATIVE)));
 
 	/*
 	 * Parallel operations are required to be strictly read-only in a parallel
@@ -644,13 +650,24 @@ zheap_insert(Relation relation, ZHeapTuple tup, CommandId cid,
 	bool		all_visible_cleared = false;
 	int			trans_slot_id;
 	Page		page;
-	UndoRecPtr	urecptr, prev_urecptr;
+	UndoRecPtr	urecptr = InvalidUndoRecPtr,
+				prev_urecptr = InvalidUndoRecPtr;
 	xl_undolog_meta	undometa;
 	uint8		vm_status;
 	bool		lock_reacquired;
+	bool		needwal;
+	bool		skip_undo;
 
 	data_alignment_zheap = data_alignment;
 
+	needwal = !(options & HEAP_INSERT_SKIP_WAL) && RelationNeedsWAL(relation);
+
+	/*
+	 * We can skip inserting undo records if the tuples are to be marked
+	 * as frozen.
+	 */
+	skip_undo = (options & HEAP_INSERT_FROZEN);
+
 	/*
 	 * Assign an OID, and toast the tuple if necessary.
 	 *
@@ -676,41 +693,51 @@ reacquire_buffer:
 	page = BufferGetPage(buffer);
 
 	/*
-	 * The transaction information of tuple needs to be set in transaction
-	 * slot, so needs to reserve the slot before proceeding with the actual
-	 * operation.  It will be costly to wait for getting the slot, but we do
-	 * that by releasing the buffer lock.
-	 *
-	 * We don't yet know the offset number of the inserting tuple so just pass
-	 * the max offset number + 1 so that if it need to get slot from the TPD
-	 * it can ensure that the TPD has sufficient map entries.
-	 */
-	trans_slot_id = PageReserveTransactionSlot(relation,
-											   buffer,
-											   PageGetMaxOffsetNumber(page) + 1,
-											   epoch,
-											   xid,
-											   &prev_urecptr,
-											   &lock_reacquired);
-	if (lock_reacquired)
+	 * If we're not inserting an undo record, we don't have to reserve a
+	 * transaction slot as well.
+	 */
+	if (skip_undo)
+		trans_slot_id = ZHTUP_SLOT_FROZEN;
+	else
 	{
-		UnlockReleaseBuffer(buffer);
-		goto reacquire_buffer;
-	}
+		/*
+		 * The transaction information of tuple needs to be set in
+		 * transaction slot, so needs to reserve the slot before proceeding
+		 * with the actual operation.  It will be costly to wait for getting
+		 * the slot, but we do that by releasing the buffer lock.
+		 *
+		 * We don't yet know the offset number of the inserting tuple so just
+		 * pass the max offset number + 1 so that if it need to get slot from
+		 * the TPD it can ensure that the TPD has sufficient map entries.
+		 */
+		trans_slot_id = PageReserveTransactionSlot(relation,
+												   buffer,
+												   PageGetMaxOffsetNumber(page) + 1,
+												   epoch,
+												   xid,
+												   &prev_urecptr,
+												   &lock_reacquired);
+		if (lock_reacquired)
+		{
+			UnlockReleaseBuffer(buffer);
+			goto reacquire_buffer;
+		}
 
-	if (trans_slot_id == InvalidXactSlotId)
-	{
-		UnlockReleaseBuffer(buffer);
+		if (trans_slot_id == InvalidXactSlotId)
+		{
+			UnlockReleaseBuffer(buffer);
 
-		pgstat_report_wait_start(PG_WAIT_PAGE_TRANS_SLOT);
-		pg_usleep(10000L);	/* 10 ms */
-		pgstat_report_wait_end();
+			pgstat_count_zheap_trans_slot_wait(relation);
+			pgstat_report_wait_start(PG_WAIT_PAGE_TRANS_SLOT);
+			pg_usleep(10000L);	/* 10 ms */
+			pgstat_report_wait_end();
 
-		goto reacquire_buffer;
-	}
+			goto reacquire_buffer;
+		}
 
-	/* transaction slot must be reserved before adding tuple to page */
-	Assert(trans_slot_id != InvalidXactSlotId);
+		/* transaction slot must be reserved before adding tuple to page */
+		Assert(trans_slot_id != InvalidXactSlotId);
+	}
 
 	if (options & HEAP_INSERT_SPECULATIVE)
 	{
@@ -724,56 +751,63 @@ reacquire_buffer:
 	 */
 	CheckForSerializableConflictIn(relation, NULL, InvalidBuffer);
 
-	/*
-	 * Prepare an undo record.  Unlike other operations, insert operation
-	 * doesn't have a prior version to store in undo, so ideally, we don't
-	 * need to store any additional information like
-	 * UREC_INFO_PAYLOAD_CONTAINS_SLOT for TPD entries.  However, for the sake
-	 * of consistency with inserts via non-inplace updates, we keep the
-	 * additional information in this operation.  Also, we need such an
-	 * information in future where we need to know more information for undo
-	 * tuples and it would be good for forensic purpose as well.
-	 */
-	undorecord.uur_type = UNDO_INSERT;
-	undorecord.uur_info = 0;
-	undorecord.uur_prevlen = 0;
-	undorecord.uur_relfilenode = relation->rd_node.relNode;
-	undorecord.uur_prevxid = FrozenTransactionId;
-	undorecord.uur_xid = xid;
-	undorecord.uur_cid = cid;
-	undorecord.uur_tsid = relation->rd_node.spcNode;
-	undorecord.uur_fork = MAIN_FORKNUM;
-	undorecord.uur_blkprev = prev_urecptr;
-	undorecord.uur_block = BufferGetBlockNumber(buffer);
-	undorecord.uur_tuple.len = 0;
-
-	/*
-	 * Store the speculative insertion token in undo, so that we can retrieve
-	 * it during visibility check of the speculatively inserted tuples.
-	 *
-	 * Note that we don't need to WAL log this value as this is a temporary
-	 * information required only on master node to detect conflicts for
-	 * Insert .. On Conflict.
-	 */
-	if (options & HEAP_INSERT_SPECULATIVE)
+	if (!skip_undo)
 	{
-		uint32 specToken;
+		/*
+		 * Prepare an undo record.  Unlike other operations, insert operation
+		 * doesn't have a prior version to store in undo, so ideally, we don't
+		 * need to store any additional information like
+		 * UREC_INFO_PAYLOAD_CONTAINS_SLOT for TPD entries.  However, for the
+		 * sake of consistency with inserts via non-inplace updates, we keep
+		 * the additional information in this operation.  Also, we need such
+		 * an information in future where we need to know more information
+		 * for undo tuples and it would be good for forensic purpose as well.
+		 */
+		undorecord.uur_type = UNDO_INSERT;
+		undorecord.uur_info = 0;
+		undorecord.uur_prevlen = 0;
+		undorecord.uur_relfilenode = relation->rd_node.relNode;
+		undorecord.uur_prevxid = FrozenTransactionId;
+		undorecord.uur_xid = xid;
+		undorecord.uur_cid = cid;
+		undorecord.uur_tsid = relation->rd_node.spcNode;
+		undorecord.uur_fork = MAIN_FORKNUM;
+		undorecord.uur_blkprev = prev_urecptr;
+		undorecord.uur_block = BufferGetBlockNumber(buffer);
+		undorecord.uur_tuple.len = 0;
 
-		undorecord.uur_payload.len = sizeof(uint32);
-		specToken = GetSpeculativeInsertionToken();
-		initStringInfo(&undorecord.uur_payload);
-		appendBinaryStringInfo(&undorecord.uur_payload,
-							   (char *) &specToken,
-							   sizeof(uint32));
+		/*
+		 * Store the speculative insertion token in undo, so that we can
+		 * retrieve it during visibility check of the speculatively inserted
+		 * tuples.
+		 *
+		 * Note that we don't need to WAL log this value as this is a
+		 * temporary information required only on master node to detect
+		 * conflicts for Insert .. On Conflict.
+		 */
+		if (options & HEAP_INSERT_SPECULATIVE)
+		{
+			uint32 specToken;
+
+			undorecord.uur_payload.len = sizeof(uint32);
+			specToken = GetSpeculativeInsertionToken();
+			initStringInfo(&undorecord.uur_payload);
+			appendBinaryStringInfo(&undorecord.uur_payload,
+								   (char *) &specToken,
+								   sizeof(uint32));
+		}
+		else
+			undorecord.uur_payload.len = 0;
+
+		urecptr = PrepareUndoInsert(&undorecord,
+									UndoPersistenceForRelation(relation),
+									InvalidTransactionId,
+									&undometa);
+		pgstat_count_zheap_undo_bytes(relation, UndoRecordExpectedSize(&undorecord));
 	}
 	else
 		undorecord.uur_payload.len = 0;
 
-	urecptr = PrepareUndoInsert(&undorecord,
-								UndoPersistenceForRelation(relation),
-								InvalidTransactionId,
-								&undometa);
-
 	/*
 	 * If there is a valid vmbuffer get its status.  The vmbuffer will not
 	 * be valid if operated page is newly extended, see
@@ -802,16 +836,20 @@ reacquire_buffer:
 						vmbuffer, VISIBILITYMAP_VALID_BITS);
 	}
 
-	Assert(undorecord.uur_block == ItemPointerGetBlockNumber(&(zheaptup->t_self)));
-	undorecord.uur_offset = ItemPointerGetOffsetNumber(&(zheaptup->t_self));
-	InsertPreparedUndo();
-	PageSetUNDO(undorecord, buffer, trans_slot_id, true, epoch, xid,
-				urecptr, NULL, 0);
+	if (!skip_undo)
+	{
+		Assert(undorecord.uur_block ==
+			   ItemPointerGetBlockNumber(&(zheaptup->t_self)));
+		undorecord.uur_offset = ItemPointerGetOffsetNumber(&(zheaptup->t_self));
+		InsertPreparedUndo();
+		PageSetUNDO(undorecord, buffer, trans_slot_id, true, epoch, xid,
+					urecptr, NULL, 0);
+	}
 
 	MarkBufferDirty(buffer);
 
 	/* XLOG stuff */
-	if (RelationNeedsWAL(relation))
+	if (needwal)
 	{
 		xl_undo_header	xlundohdr;
 		xl_zheap_insert xlrec;
@@ -852,8 +890,8 @@ reacquire_buffer:
 		 * Store the information required to generate undo record during
 		 * replay.
 		 */
-		xlundohdr.relfilenode = undorecord.uur_relfilenode;
-		xlundohdr.tsid = undorecord.uur_tsid;
+		xlundohdr.relfilenode = relation->rd_node.relNode;
+		xlundohdr.tsid = relation->rd_node.spcNode;
 		xlundohdr.urec_ptr = urecptr;
 		xlundohdr.blkprev = prev_urecptr;
 
@@ -870,6 +908,8 @@ reacquire_buffer:
 			xlrec.flags |= XLZ_INSERT_ALL_VISIBLE_CLEARED;
 		if (options & HEAP_INSERT_SPECULATIVE)
 			xlrec.flags |= XLZ_INSERT_IS_SPECULATIVE;
+		if (skip_undo)
+			xlrec.flags |= XLZ_INSERT_IS_FROZEN;
 		Assert(ItemPointerGetBlockNumber(&zheaptup->t_self) == BufferGetBlockNumber(buffer));
 
 		/*
@@ -888,14 +928,16 @@ reacquire_buffer:
 
 prepare_xlog:
 		/* LOG undolog meta if this is the first WAL after the checkpoint. */
-		LogUndoMetaData(&undometa);
+		if (!skip_undo)
+			LogUndoMetaData(&undometa);
 
 		GetFullPageWriteInfo(&RedoRecPtr, &doPageWrites);
 
 		XLogBeginInsert();
 		XLogRegisterData((char *) &xlundohdr, SizeOfUndoHeader);
 		XLogRegisterData((char *) &xlrec, SizeOfZHeapInsert);
-		if (trans_slot_id > ZHEAP_PAGE_TRANS_SLOTS)
+		/* If we've skipped undo insertion, we don't need a slot in page. */
+		if (!skip_undo && trans_slot_id > ZHEAP_PAGE_TRANS_SLOTS)
 		{
 			xlrec.flags |= XLZ_INSERT_CONTAINS_TPD_SLOT;
 			XLogRegisterData((char *) &trans_slot_id, sizeof(trans_slot_id));
@@ -1523,6 +1565,7 @@ zheap_tuple_updated:
 	{
 		LockBuffer(buffer, BUFFER_LOCK_UNLOCK);
 
+		pgstat_count_zheap_trans_slot_wait(relation);
 		pgstat_report_wait_start(PG_WAIT_PAGE_TRANS_SLOT);
 		pg_usleep(10000L);	/* 10 ms */
 		pgstat_report_wait_end();
@@ -1664,6 +1707,7 @@ zheap_tuple_updated:
 								UndoPersistenceForRelation(relation),
 								InvalidTransactionId,
 								&undometa);
+	pgstat_count_zheap_undo_bytes(relation, UndoRecordExpectedSize(&undorecord));
 	/* We must have a valid vmbuffer. */
 	Assert(BufferIsValid(vmbuffer));
 	vm_status = visibilitymap_get_status(relation,
@@ -1829,6 +1873,376 @@ prepare_xlog:
 	return HeapTupleMayBeUpdated;
 }
 
+/*
+ * zheap_multi_delete - delete several tuples of the same page
+ *
+ * All the tids must be on the same block.  This deletes, under a single
+ * buffer lock and transaction slot, those of the tuples that the current
+ * transaction can delete right away, and sets deleted[i] for each of them.
+ * They share a single UNDO_MULTI_DELETE undo record and a single WAL record,
+ * rather than one each as zheap_delete writes.  Tuples that would need
+ * more work, such as waiting for a concurrent transaction or following an
+ * update, are left alone; the caller must delete them with zheap_delete,
+ * which also reports the outcome for them.  A transaction slot is reserved
+ * only once some tuple is known to qualify.  Returns the number of tuples
+ * deleted.
+ *
+ * There is no crosscheck snapshot, so this can't be used for RI checks in
+ * transaction-snapshot mode.
+ */
+int
+zheap_multi_delete(Relation relation, ItemPointer tids, int ntids,
+				   CommandId cid, Snapshot snapshot, bool *deleted)
+{
+	TransactionId xid = GetTopTransactionId();
+	TransactionId oldestXidHavingUndo;
+	uint32		epoch = GetEpochForXid(xid);
+	UndoPersistence persistence = UndoPersistenceForRelation(relation);
+	BlockNumber blkno;
+	Buffer		buffer;
+	Buffer		vmbuffer = InvalidBuffer;
+	Page		page;
+	ZHeapTupleData *zheaptups;
+	TransactionId *tup_xids;
+	int		   *tup_slots;
+	TransactionId *prevxids;
+	UnpackedUndoRecord undorecord;
+	xl_multi_delete_ztuple *xltuples;
+	OffsetNumber *usedoff;
+	UndoRecPtr	urecptr,
+				prev_urecptr;
+	int			trans_slot_id;
+	int			ncandidates;
+	int			ndeleted;
+	int			i;
+	bool		lock_reacquired;
+	bool		all_visible_cleared = false;
+	xl_undolog_meta undometa;
+	uint8		vm_status;
+
+	Assert(ntids > 0 && ntids <= MaxZHeapTuplesPerPage);
+
+	if (IsInParallelMode())
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_TRANSACTION_STATE),
+				 errmsg("cannot delete tuples during a parallel operation")));
+
+	blkno = ItemPointerGetBlockNumber(&tids[0]);
+	buffer = ReadBuffer(relation, blkno);
+	page = BufferGetPage(buffer);
+
+	/*
+	 * Before locking the buffer, pin the visibility map page mainly to avoid
+	 * doing I/O after locking the buffer.
+	 */
+	visibilitymap_pin(relation, blkno, &vmbuffer);
+
+	LockBuffer(buffer, BUFFER_LOCK_EXCLUSIVE);
+
+	tup_xids = palloc(ntids * sizeof(TransactionId));
+	tup_slots = palloc(ntids * sizeof(int));
+	zheaptups = palloc(ntids * sizeof(ZHeapTupleData));
+	prevxids = palloc(ntids * sizeof(TransactionId));
+	xltuples = palloc(ntids * sizeof(xl_multi_delete_ztuple));
+	usedoff = palloc(ntids * sizeof(OffsetNumber));
+
+check_tuples_satisfy_update:
+
+	/*
+	 * Find the tuples that can be deleted without waiting, before reserving
+	 * a transaction slot, so that we don't take one for nothing.
+	 */
+	ncandidates = 0;
+	for (i = 0; i < ntids; i++)
+	{
+		ZHeapTupleData zheaptup;
+		OffsetNumber offnum = ItemPointerGetOffsetNumber(&tids[i]);
+		ItemPointerData ctid;
+		ItemId		lp;
+		HTSU_Result result;
+		TransactionId single_locker_xid;
+		CommandId	tup_cid;
+		int			single_locker_trans_slot;
+		bool		in_place_updated_or_locked;
+
+		Assert(ItemPointerGetBlockNumber(&tids[i]) == blkno);
+		deleted[i] = false;
+
+		if (offnum > PageGetMaxOffsetNumber(page))
+			continue;
+		lp = PageGetItemId(page, offnum);
+		if (!ItemIdIsNormal(lp))
+			continue;
+
+		zheaptup.t_tableOid = RelationGetRelid(relation);
+		zheaptup.t_data = (ZHeapTupleHeader) PageGetItem(page, lp);
+		zheaptup.t_len = ItemIdGetLength(lp);
+		zheaptup.t_self = tids[i];
+
+		/* Tuples with lockers need the waiting logic of zheap_delete. */
+		if (ZHeapTupleHasMultiLockers(zheaptup.t_data->t_infomask) ||
+			ZHEAP_XID_IS_LOCKED_ONLY(zheaptup.t_data->t_infomask))
+			continue;
+
+		ctid = tids[i];
+		result = ZHeapTupleSatisfiesUpdate(relation, &zheaptup, cid, buffer,
+										   &ctid, &tup_slots[i], &tup_xids[i],
+										   &tup_cid, &single_locker_xid,
+										   &single_locker_trans_slot,
+										   false, false, snapshot,
+										   &in_place_updated_or_locked);
+		if (result != HeapTupleMayBeUpdated ||
+			TransactionIdIsValid(single_locker_xid))
+			continue;
+
+		/*
+		 * If the tuple's slot is in the TPD entry, the undo record has to
+		 * carry it; leave that to zheap_delete.
+		 */
+		if (ZHeapTupleHeaderGetXactSlot(zheaptup.t_data) != ZHTUP_SLOT_FROZEN &&
+			tup_slots[i] > ZHEAP_PAGE_TRANS_SLOTS)
+			continue;
+
+		deleted[i] = true;
+		ncandidates++;
+	}
+
+	if (ncandidates == 0)
+		goto nothing_deleted;
+
+	/*
+	 * Now reserve the transaction slot.  If that had to release the buffer
+	 * lock, the tuples may have changed meanwhile, so check them again.  If
+	 * no slot is free, leave it to zheap_delete to wait for one.
+	 */
+	trans_slot_id = PageReserveTransactionSlot(relation, buffer,
+											   PageGetMaxOffsetNumber(page),
+											   epoch, xid, &prev_urecptr,
+											   &lock_reacquired);
+	if (lock_reacquired)
+		goto check_tuples_satisfy_update;
+
+	if (trans_slot_id == InvalidXactSlotId)
+	{
+		memset(deleted, 0, ntids * sizeof(bool));
+		goto nothing_deleted;
+	}
+
+	oldestXidHavingUndo = GetXidFromEpochXid(
+						pg_atomic_read_u64(&ProcGlobal->oldestXidWithEpochHavingUndo));
+
+	ndeleted = 0;
+	for (i = 0; i < ntids; i++)
+	{
+		ZHeapTuple	zheaptup = &zheaptups[ndeleted];
+		OffsetNumber offnum = ItemPointerGetOffsetNumber(&tids[i]);
+		TransactionId tup_xid = tup_xids[i];
+		int			tup_trans_slot_id = tup_slots[i];
+		int			new_trans_slot_id;
+		uint16		new_infomask;
+
+		if (!deleted[i])
+			continue;
+
+		zheaptup->t_tableOid = RelationGetRelid(relation);
+		zheaptup->t_data = (ZHeapTupleHeader)
+			PageGetItem(page, PageGetItemId(page, offnum));
+		zheaptup->t_len = ItemIdGetLength(PageGetItemId(page, offnum));
+		zheaptup->t_self = tids[i];
+
+		/*
+		 * Reserving the slot may have frozen the tuple's slot, as in
+		 * zheap_delete.
+		 */
+		if (ZHeapTupleHeaderGetXactSlot(zheaptup->t_data) == ZHTUP_SLOT_FROZEN)
+		{
+			tup_trans_slot_id = ZHTUP_SLOT_FROZEN;
+			tup_xid = InvalidTransactionId;
+		}
+
+		compute_new_xid_infomask(zheaptup, buffer, tup_xid, tup_trans_slot_id,
+								 zheaptup->t_data->t_infomask, xid,
+								 trans_slot_id, InvalidTransactionId,
+								 LockTupleExclusive, true, &new_infomask,
+								 &new_trans_slot_id);
+		if (new_trans_slot_id != trans_slot_id)
+		{
+			deleted[i] = false;
+			continue;
+		}
+
+		/* See zheap_delete. */
+		if (TransactionIdPrecedes(tup_xid, oldestXidHavingUndo))
+			tup_xid = FrozenTransactionId;
+
+		CheckForSerializableConflictIn(relation, &(zheaptup->t_self), buffer);
+
+		prevxids[ndeleted] = tup_xid;
+		xltuples[ndeleted].prevxid = tup_xid;
+		xltuples[ndeleted].offnum = offnum;
+		xltuples[ndeleted].infomask = new_infomask;
+		usedoff[ndeleted] = offnum;
+		ndeleted++;
+	}
+
+	if (ndeleted == 0)
+		goto nothing_deleted;
+
+	/*
+	 * Prepare a single undo record for all the tuples, which saves repeating
+	 * the record header for each of them.
+	 */
+	undorecord.uur_info = 0;
+	undorecord.uur_prevlen = 0;
+	undorecord.uur_relfilenode = relation->rd_node.relNode;
+	undorecord.uur_xid = xid;
+	undorecord.uur_cid = cid;
+	undorecord.uur_tsid = relation->rd_node.spcNode;
+	undorecord.uur_fork = MAIN_FORKNUM;
+	undorecord.uur_blkprev = prev_urecptr;
+	undorecord.uur_block = blkno;
+	ZHeapUndoMultiDeleteForm(&undorecord, zheaptups, prevxids, ndeleted);
+
+	urecptr = PrepareUndoInsert(&undorecord, persistence,
+								InvalidTransactionId, &undometa);
+	pgstat_count_zheap_undo_bytes(relation,
+								  UndoRecordExpectedSize(&undorecord));
+
+	vm_status = visibilitymap_get_status(relation, blkno, &vmbuffer);
+
+	START_CRIT_SECTION();
+
+	if ((vm_status & VISIBILITYMAP_ALL_VISIBLE) ||
+		(vm_status & VISIBILITYMAP_POTENTIAL_ALL_VISIBLE))
+	{
+		all_visible_cleared = true;
+		visibilitymap_clear(relation, blkno, vmbuffer,
+							VISIBILITYMAP_VALID_BITS);
+	}
+
+	InsertPreparedUndo();
+	PageSetUNDO(undorecord, buffer, trans_slot_id, true, epoch,
+				xid, urecptr, usedoff, ndeleted);
+
+	/* See zheap_delete. */
+	ZPageSetPrunable(page, xid);
+
+	for (i = 0; i < ndeleted; i++)
+	{
+		ZHeapTupleHeader zhtuphdr = zheaptups[i].t_data;
+
+		ZHeapTupleHeaderSetXactSlot(zhtuphdr, trans_slot_id);
+		zhtuphdr->t_infomask &= ~ZHEAP_VIS_STATUS_MASK;
+		zhtuphdr->t_infomask |= ZHEAP_DELETED | xltuples[i].infomask;
+		xltuples[i].infomask = zhtuphdr->t_infomask;
+	}
+
+	MarkBufferDirty(buffer);
+
+	if (RelationNeedsWAL(relation))
+	{
+		xl_undo_header xlundohdr;
+		xl_zheap_multi_delete xlrec;
+		XLogRecPtr	recptr;
+		XLogRecPtr	RedoRecPtr;
+		bool		doPageWrites;
+
+		/* Store the information required to generate undo record during replay. */
+		xlundohdr.relfilenode = relation->rd_node.relNode;
+		xlundohdr.tsid = relation->rd_node.spcNode;
+		xlundohdr.urec_ptr = urecptr;
+		xlundohdr.blkprev = prev_urecptr;
+
+		xlrec.ntuples = ndeleted;
+		xlrec.trans_slot_id = trans_slot_id;
+
+prepare_xlog:
+		xlrec.flags = all_visible_cleared ? XLZ_MULTI_DELETE_ALL_VISIBLE_CLEARED : 0;
+
+		/* LOG undolog meta if this is the first WAL after the checkpoint. */
+		LogUndoMetaData(&undometa);
+
+		/*
+		 * As in zheap_delete, replay can regenerate the undo tuples from the
+		 * page unless the page image is included, and then we must store
+		 * them explicitly.  We store the tuple data of the undo record as it
+		 * is, which replay can use directly.
+		 */
+		GetFullPageWriteInfo(&RedoRecPtr, &doPageWrites);
+		if (!doPageWrites || XLogCheckBufferNeedsBackup(buffer))
+			xlrec.flags |= XLZ_HAS_MULTI_DELETE_UNDOTUPLES;
+
+		XLogBeginInsert();
+		XLogRegisterData((char *) &xlundohdr, SizeOfUndoHeader);
+		XLogRegisterData((char *) &xlrec, SizeOfZHeapMultiDelete);
+		XLogRegisterData((char *) xltuples,
+						 ndeleted * sizeof(xl_multi_delete_ztuple));
+		if (xlrec.flags & XLZ_HAS_MULTI_DELETE_UNDOTUPLES)
+			XLogRegisterData(undorecord.uur_tuple.data,
+							 undorecord.uur_tuple.len);
+
+		XLogRegisterBuffer(0, buffer, REGBUF_STANDARD);
+		if (trans_slot_id > ZHEAP_PAGE_TRANS_SLOTS)
+			(void) RegisterTPDBuffer(page, 1);
+
+		/* filtering by origin on a row level is much more efficient */
+		XLogSetRecordFlags(XLOG_INCLUDE_ORIGIN);
+
+		recptr = XLogInsertExtended(RM_ZHEAP2_ID, XLOG_ZHEAP_MULTI_DELETE,
+									RedoRecPtr, doPageWrites);
+		if (recptr == InvalidXLogRecPtr)
+			goto prepare_xlog;
+		PageSetLSN(page, recptr);
+		if (trans_slot_id > ZHEAP_PAGE_TRANS_SLOTS)
+			TPDPageSetLSN(page, recptr);
+	}
+
+	END_CRIT_SECTION();
+
+	LockBuffer(buffer, BUFFER_LOCK_UNLOCK);
+	ReleaseBuffer(vmbuffer);
+	UnlockReleaseUndoBuffers();
+
+	/* Delete the toasted out-of-line attributes; see zheap_delete. */
+	if (relation->rd_rel->relkind == RELKIND_RELATION ||
+		relation->rd_rel->relkind == RELKIND_MATVIEW)
+	{
+		for (i = 0; i < ndeleted; i++)
+		{
+			if (ZHeapTupleHasExternal(&zheaptups[i]))
+				ztoast_delete(relation, &zheaptups[i], false);
+		}
+	}
+
+	ReleaseBuffer(buffer);
+	UnlockReleaseTPDBuffers();
+
+	for (i = 0; i < ndeleted; i++)
+		pgstat_count_heap_delete(relation);
+	pfree(undorecord.uur_tuple.data);
+	pfree(zheaptups);
+	pfree(prevxids);
+	pfree(xltuples);
+	pfree(usedoff);
+	pfree(tup_xids);
+	pfree(tup_slots);
+
+	return ndeleted;
+
+nothing_deleted:
+	UnlockReleaseBuffer(buffer);
+	ReleaseBuffer(vmbuffer);
+	UnlockReleaseTPDBuffers();
+	pfree(zheaptups);
+	pfree(prevxids);
+	pfree(xltuples);
+	pfree(usedoff);
+	pfree(tup_xids);
+	pfree(tup_slots);
+
+	return 0;
+}
+
 /*
  * zheap_update - update a tuple
  *
@@ -2603,6 +3017,7 @@ zheap_tuple_updated:
 	{
 		LockBuffer(buffer, BUFFER_LOCK_UNLOCK);
 
+		pgstat_count_zheap_trans_slot_wait(relation);
 		pgstat_report_wait_start(PG_WAIT_PAGE_TRANS_SLOT);
 		pg_usleep(10000L);	/* 10 ms */
 		pgstat_report_wait_end();
@@ -2728,6 +3143,7 @@ zheap_tuple_updated:
 									UndoPersistenceForRelation(relation),
 									InvalidTransactionId,
 									&undometa);
+		pgstat_count_zheap_undo_bytes(relation, UndoRecordExpectedSize(&undorecord));
 
 		/*
 		 * If all the members were lockers and are all gone, we can do away
@@ -2995,6 +3411,7 @@ reacquire_buffer:
 			LockBuffer(buffer, BUFFER_LOCK_UNLOCK);
 			UnlockReleaseTPDBuffers();
 
+			pgstat_count_zheap_trans_slot_wait(relation);
 			pgstat_report_wait_start(PG_WAIT_PAGE_TRANS_SLOT);
 			pg_usleep(10000L);	/* 10 ms */
 			pgstat_report_wait_end();
@@ -3098,6 +3515,7 @@ reacquire_buffer:
 									UndoPersistenceForRelation(relation),
 									InvalidTransactionId,
 									&undometa);
+		pgstat_count_zheap_undo_bytes(relation, UndoRecordExpectedSize(&undorecord));
 	}
 	else
 	{
@@ -3157,6 +3575,7 @@ reacquire_buffer:
 									UndoPersistenceForRelation(relation),
 									InvalidTransactionId,
 									NULL);
+		pgstat_count_zheap_undo_bytes(relation, UndoRecordExpectedSize(&undorecord));
 
 		initStringInfo(&undorecord.uur_payload);
 
@@ -3172,6 +3591,7 @@ reacquire_buffer:
 										UndoPersistenceForRelation(relation),
 										InvalidTransactionId,
 										NULL);
+		pgstat_count_zheap_undo_bytes(relation, UndoRecordExpectedSize(&new_undorecord));
 	}
 
 	/*
@@ -4613,6 +5033,7 @@ failed:
 	{
 		LockBuffer(*buffer, BUFFER_LOCK_UNLOCK);
 
+		pgstat_count_zheap_trans_slot_wait(relation);
 		pgstat_report_wait_start(PG_WAIT_PAGE_TRANS_SLOT);
 		pg_usleep(10000L);	/* 10 ms */
 		pgstat_report_wait_end();
@@ -5061,6 +5482,7 @@ lock_tuple:
 		{
 			LockBuffer(buf, BUFFER_LOCK_UNLOCK);
 
+			pgstat_count_zheap_trans_slot_wait(rel);
 			pgstat_report_wait_start(PG_WAIT_PAGE_TRANS_SLOT);
 			pg_usleep(10000L);	/* 10 ms */
 			pgstat_report_wait_end();
@@ -5249,6 +5671,7 @@ zheap_lock_tuple_guts(Relation rel, Buffer buf, ZHeapTuple zhtup,
 								UndoPersistenceForRelation(rel),
 								InvalidTransactionId,
 								&undometa);
+	pgstat_count_zheap_undo_bytes(rel, UndoRecordExpectedSize(&undorecord));
 
 
 	START_CRIT_SECTION();
@@ -7118,6 +7541,116 @@ GetCompletedSlotOffsets(Page page, int nCompletedXactSlots,
 	*numOffsets = noffsets;
 }
 
+/*
+ * PageFreezeFrozenSlots - Clear the given transaction slots whose
+ *		transactions are all-visible and mark the tuples pointing to them as
+ *		frozen.
+ *
+ * All the slots of a page are cleared under a single WAL record.  Caller
+ * must have an exclusive lock on the buffer and, for TPD slots, on the
+ * corresponding TPD buffer.
+ */
+static void
+PageFreezeFrozenSlots(Relation relation, Buffer buf, TransInfo *transinfo,
+					  int *frozen_slots, int nFrozenSlots, bool TPDSlot)
+{
+	TransactionId	latestxid = InvalidTransactionId;
+	Page	page = BufferGetPage(buf);
+	int		i;
+	int		slot_no;
+
+	START_CRIT_SECTION();
+
+	/* clear the transaction slot info on tuples */
+	zheap_freeze_or_invalidate_tuples(buf, nFrozenSlots, frozen_slots,
+									  true, TPDSlot);
+
+	/* Initialize the frozen slots. */
+	if (TPDSlot)
+	{
+		for (i = 0; i < nFrozenSlots; i++)
+		{
+			int	tpd_slot_id;
+
+			slot_no = frozen_slots[i];
+
+			/* Remember the latest xid. */
+			if (TransactionIdFollows(transinfo[slot_no].xid, latestxid))
+				latestxid = transinfo[slot_no].xid;
+
+			/* Calculate the actual slot no. */
+			tpd_slot_id = slot_no + ZHEAP_PAGE_TRANS_SLOTS + 1;
+
+			/* Initialize the TPD slot. */
+			TPDPageSetTransactionSlotInfo(buf, tpd_slot_id, 0,
+										  InvalidTransactionId,
+										  InvalidUndoRecPtr);
+		}
+	}
+	else
+	{
+		for (i = 0; i < nFrozenSlots; i++)
+		{
+			slot_no = frozen_slots[i];
+
+			/* Remember the latest xid. */
+			if (TransactionIdFollows(transinfo[slot_no].xid, latestxid))
+				latestxid = transinfo[slot_no].xid;
+
+			transinfo[slot_no].xid_epoch = 0;
+			transinfo[slot_no].xid = InvalidTransactionId;
+			transinfo[slot_no].urec_ptr = InvalidUndoRecPtr;
+		}
+	}
+
+	MarkBufferDirty(buf);
+
+	/*
+	 * Xlog Stuff
+	 *
+	 * Log all the frozen_slots number for which we need to clear the
+	 * transaction slot information.  Also, note down the latest xid
+	 * corresponding to the frozen slots. This is required to ensure that
+	 * no standby query conflicts with the frozen xids.
+	 */
+	if (RelationNeedsWAL(relation))
+	{
+		xl_zheap_freeze_xact_slot xlrec = {0};
+		XLogRecPtr	recptr;
+
+		XLogBeginInsert();
+
+		xlrec.nFrozen = nFrozenSlots;
+		xlrec.lastestFrozenXid = latestxid;
+
+		XLogRegisterData((char *) &xlrec, SizeOfZHeapFreezeXactSlot);
+
+		/*
+		 * Ideally we need the frozen slots information when WAL needs to be
+		 * applied on the page, but in case of the TPD slots freeze we need
+		 * the frozen slot information for both heap page as well as for the
+		 * TPD page.  So the problem is that if we register with any one of
+		 * the buffer it might happen that the data did not registered due
+		 * to fpw of that buffer but we need that data for another buffer.
+		 */
+		XLogRegisterData((char *) frozen_slots, nFrozenSlots * sizeof(int));
+		XLogRegisterBuffer(0, buf, REGBUF_STANDARD);
+		if (TPDSlot)
+		{
+			RegisterTPDBuffer(page, 1);
+			xlrec.flags |= XLZ_FREEZE_TPD_SLOT;
+		}
+
+		recptr = XLogInsert(RM_ZHEAP_ID, XLOG_ZHEAP_FREEZE_XACT_SLOT);
+		PageSetLSN(page, recptr);
+
+		if (TPDSlot)
+			TPDPageSetLSN(page, recptr);
+	}
+
+	END_CRIT_SECTION();
+}
+
 /*
  * PageFreezeTransSlots - Make the transaction slots available for reuse.
  *
@@ -7186,6 +7719,8 @@ PageFreezeTransSlots(Relation relation, Buffer buf, bool *lock_reacquired,
 	Page	page;
 	bool	result = false;
 
+	pgstat_count_zheap_trans_slot_freeze(relation);
+
 	page = BufferGetPage(buf);
 
 	/*
@@ -7216,134 +7751,41 @@ PageFreezeTransSlots(Relation relation, Buffer buf, bool *lock_reacquired,
 
 	oldestXidWithEpochHavingUndo = pg_atomic_read_u64(&ProcGlobal->oldestXidWithEpochHavingUndo);
 
-	frozen_slots = palloc0(num_slots * sizeof(int));
-
-	/*
-	 * Clear the slot information from tuples.  The basic idea is to collect
-	 * all the transaction slots that can be cleared.  Then traverse the page
-	 * to see if any tuple has marking for any of the slots, if so, just clear
-	 * the slot information from the tuple.
-	 *
-	 * For temp relations, we can freeze the first slot since no other backend
-	 * can access the same relation.
-	 */
-	if (RELATION_IS_LOCAL(relation))
-		frozen_slots[nFrozenSlots++] = 0;
-	else
-	{
-		for (slot_no = 0; slot_no < num_slots; slot_no++)
-		{
-			uint64	slot_xid_epoch = transinfo[slot_no].xid_epoch;
-			TransactionId	slot_xid = transinfo[slot_no].xid;
-
-			/*
-			 * Transaction slot can be considered frozen if it belongs to previous
-			 * epoch or transaction id is old enough that it is all visible.
-			 */
-			slot_xid_epoch = MakeEpochXid(slot_xid_epoch, slot_xid);
-
-			if (slot_xid_epoch < oldestXidWithEpochHavingUndo)
-				frozen_slots[nFrozenSlots++] = slot_no;
-		}
-	}
-
-	if (nFrozenSlots > 0)
-	{
-		TransactionId	latestxid = InvalidTransactionId;
-		int		i;
-		int		slot_no;
-
-
-		START_CRIT_SECTION();
-
-		/* clear the transaction slot info on tuples */
-		zheap_freeze_or_invalidate_tuples(buf, nFrozenSlots, frozen_slots,
-										  true, TPDSlot);
-
-		/* Initialize the frozen slots. */
-		if (TPDSlot)
-		{
-			for (i = 0; i < nFrozenSlots; i++)
-			{
-				int	tpd_slot_id;
-
-				slot_no = frozen_slots[i];
-
-				/* Remember the latest xid. */
-				if (TransactionIdFollows(transinfo[slot_no].xid, latestxid))
-					latestxid = transinfo[slot_no].xid;
-
-				/* Calculate the actual slot no. */
-				tpd_slot_id = slot_no + ZHEAP_PAGE_TRANS_SLOTS + 1;
-
-				/* Initialize the TPD slot. */
-				TPDPageSetTransactionSlotInfo(buf, tpd_slot_id, 0,
-											  InvalidTransactionId,
-											  InvalidUndoRecPtr);
-			}
-		}
-		else
-		{
-			for (i = 0; i < nFrozenSlots; i++)
-			{
-				slot_no = frozen_slots[i];
-
-				/* Remember the latest xid. */
-				if (TransactionIdFollows(transinfo[slot_no].xid, latestxid))
-					latestxid = transinfo[slot_no].xid;
-
-				transinfo[slot_no].xid_epoch = 0;
-				transinfo[slot_no].xid = InvalidTransactionId;
-				transinfo[slot_no].urec_ptr = InvalidUndoRecPtr;
-			}
-		}
-
-		MarkBufferDirty(buf);
-
-		/*
-		 * Xlog Stuff
-		 *
-		 * Log all the frozen_slots number for which we need to clear the
-		 * transaction slot information.  Also, note down the latest xid
-		 * corresponding to the frozen slots. This is required to ensure that
-		 * no standby query conflicts with the frozen xids.
-		 */
-		if (RelationNeedsWAL(relation))
-		{
-			xl_zheap_freeze_xact_slot xlrec = {0};
-			XLogRecPtr	recptr;
-
-			XLogBeginInsert();
-
-			xlrec.nFrozen = nFrozenSlots;
-			xlrec.lastestFrozenXid = latestxid;
+	frozen_slots = palloc0(num_slots * sizeof(int));
 
-			XLogRegisterData((char *) &xlrec, SizeOfZHeapFreezeXactSlot);
+	/*
+	 * Clear the slot information from tuples.  The basic idea is to collect
+	 * all the transaction slots that can be cleared.  Then traverse the page
+	 * to see if any tuple has marking for any of the slots, if so, just clear
+	 * the slot information from the tuple.
+	 *
+	 * For temp relations, we can freeze the first slot since no other backend
+	 * can access the same relation.
+	 */
+	if (RELATION_IS_LOCAL(relation))
+		frozen_slots[nFrozenSlots++] = 0;
+	else
+	{
+		for (slot_no = 0; slot_no < num_slots; slot_no++)
+		{
+			uint64	slot_xid_epoch = transinfo[slot_no].xid_epoch;
+			TransactionId	slot_xid = transinfo[slot_no].xid;
 
 			/*
-			 * Ideally we need the frozen slots information when WAL needs to be
-			 * applied on the page, but in case of the TPD slots freeze we need
-			 * the frozen slot information for both heap page as well as for the
-			 * TPD page.  So the problem is that if we register with any one of
-			 * the buffer it might happen that the data did not registered due
-			 * to fpw of that buffer but we need that data for another buffer.
+			 * Transaction slot can be considered frozen if it belongs to previous
+			 * epoch or transaction id is old enough that it is all visible.
 			 */
-			XLogRegisterData((char *) frozen_slots, nFrozenSlots * sizeof(int));
-			XLogRegisterBuffer(0, buf, REGBUF_STANDARD);
-			if (TPDSlot)
-			{
-				RegisterTPDBuffer(page, 1);
-				xlrec.flags |= XLZ_FREEZE_TPD_SLOT;
-			}
-
-			recptr = XLogInsert(RM_ZHEAP_ID, XLOG_ZHEAP_FREEZE_XACT_SLOT);
-			PageSetLSN(page, recptr);
+			slot_xid_epoch = MakeEpochXid(slot_xid_epoch, slot_xid);
 
-			if (TPDSlot)
-				TPDPageSetLSN(page, recptr);
+			if (slot_xid_epoch < oldestXidWithEpochHavingUndo)
+				frozen_slots[nFrozenSlots++] = slot_no;
 		}
+	}
 
-		END_CRIT_SECTION();
+	if (nFrozenSlots > 0)
+	{
+		PageFreezeFrozenSlots(relation, buf, transinfo, frozen_slots,
+							  nFrozenSlots, TPDSlot);
 
 		result = true;
 		goto cleanup;
@@ -7514,6 +7956,120 @@ cleanup:
 	return result;
 }
 
+/*
+ * ZPageGetFrozenSlots - Collect the page's transaction slots that are used
+ *		by all-visible transactions.
+ *
+ * Returns the number of such slots and stores them in frozen_slots, or
+ * returns 0 if the page still has a free transaction slot, as there is no
+ * pressing need to free up a slot in that case.  Only the slots on the heap
+ * page are considered; the TPD slot, if any, is skipped.
+ */
+static int
+ZPageGetFrozenSlots(Page page, uint64 oldestXidWithEpochHavingUndo,
+					int *frozen_slots)
+{
+	ZHeapPageOpaque	opaque;
+	int		num_slots;
+	int		nFrozenSlots = 0;
+	int		slot_no;
+
+	opaque = (ZHeapPageOpaque) PageGetSpecialPointer(page);
+
+	if (ZHeapPageHasTPDSlot((PageHeader) page))
+		num_slots = ZHEAP_PAGE_TRANS_SLOTS - 1;
+	else
+		num_slots = ZHEAP_PAGE_TRANS_SLOTS;
+
+	for (slot_no = 0; slot_no < num_slots; slot_no++)
+	{
+		TransInfo	*slot = &opaque->transinfo[slot_no];
+
+		if (!TransactionIdIsValid(slot->xid))
+			return 0;
+
+		if (MakeEpochXid((uint64) slot->xid_epoch, slot->xid) <
+			oldestXidWithEpochHavingUndo)
+			frozen_slots[nFrozenSlots++] = slot_no;
+	}
+
+	return nFrozenSlots;
+}
+
+/*
+ * zheap_page_freeze_slots_opt - Opportunistically freeze the transaction
+ *		slots of a page that are used by all-visible transactions.
+ *
+ * This is called while reading a page (much like heap_page_prune_opt for
+ * heap) so that the writers who later need a transaction slot on the page
+ * are less likely to find all the slots occupied and have to pay for
+ * PageFreezeTransSlots or for extending the page into a TPD entry.  All the
+ * slots that can be frozen are cleared under a single WAL record.
+ *
+ * We only deal with the slots that can be frozen without consulting undo:
+ * committed transactions that are not yet all-visible, aborted transactions
+ * and the slots in the TPD entry are left for the writer to handle.  We also
+ * give up if we can't get the exclusive lock on the buffer immediately, as
+ * this is purely an optimization.
+ *
+ * Caller must have a pin on the buffer, but no lock.
+ */
+void
+zheap_page_freeze_slots_opt(Relation relation, Buffer buffer)
+{
+	Page	page = BufferGetPage(buffer);
+	uint64	oldestXidWithEpochHavingUndo;
+	int		frozen_slots[ZHEAP_PAGE_TRANS_SLOTS];
+	int		nFrozenSlots;
+
+	/* We can't write WAL in recovery mode. */
+	if (RecoveryInProgress())
+		return;
+
+	/*
+	 * Temporary relations reuse the slots blindly in PageFreezeTransSlots, so
+	 * there is nothing to gain here.
+	 */
+	if (RELATION_IS_LOCAL(relation))
+		return;
+
+	if (BufferGetBlockNumber(buffer) == ZHEAP_METAPAGE)
+		return;
+
+	oldestXidWithEpochHavingUndo =
+		pg_atomic_read_u64(&ProcGlobal->oldestXidWithEpochHavingUndo);
+
+	/*
+	 * Let's see if we really need to freeze anything.  We do this without a
+	 * lock, so the answer might be stale; it is rechecked below after
+	 * acquiring the lock.  Skip new pages, and TPD pages, which are the only
+	 * other pages of a zheap relation whose special space differs in size.
+	 */
+	if (PageIsNew(page) ||
+		PageGetSpecialSize(page) != MAXALIGN(SizeOfZHeapPageOpaqueData))
+		return;
+
+	if (ZPageGetFrozenSlots(page, oldestXidWithEpochHavingUndo,
+							frozen_slots) == 0)
+		return;
+
+	if (!ConditionalLockBuffer(buffer))
+		return;
+
+	nFrozenSlots = ZPageGetFrozenSlots(page, oldestXidWithEpochHavingUndo,
+									   frozen_slots);
+	if (nFrozenSlots > 0)
+	{
+		ZHeapPageOpaque	opaque;
+
+		opaque = (ZHeapPageOpaque) PageGetSpecialPointer(page);
+		PageFreezeFrozenSlots(relation, buffer, opaque->transinfo,
+							  frozen_slots, nFrozenSlots, false);
+	}
+
+	LockBuffer(buffer, BUFFER_LOCK_UNLOCK);
+}
+
 /*
  * ZHeapTupleGetCid - Retrieve command id from tuple's undo record.
  *
@@ -8094,6 +8650,9 @@ zheap_init_meta_page(Buffer metabuf, BlockNumber first_blkno,
 	metap->zhm_version = ZHEAP_VERSION;
 	metap->zhm_first_used_tpd_page = InvalidBlockNumber;
 	metap->zhm_last_used_tpd_page = InvalidBlockNumber;
+	metap->zhm_active_frac = 0;
+	metap->zhm_undo_depth = 0;
+	metap->zhm_tpd_frac = 0;
 
 	/*
 	 * Set pd_lower just past the end of the metadata.  This is essential,
@@ -8139,6 +8698,207 @@ ZheapInitMetaPage(Relation rel, ForkNumber forkNum)
 	UnlockReleaseBuffer(buf);
 }
 
+/*
+ * zheap_update_meta_stats - Store the statistics gathered by ANALYZE.
+ *
+ * These are kept in the metapage rather than in pg_class, as no other
+ * storage has any use for them.  Like the btree cleanup info, they are
+ * overwritten in place and WAL-logged, so that standbys plan alike.
+ */
+void
+zheap_update_meta_stats(Relation rel, float4 active_frac, float4 undo_depth,
+						float4 tpd_frac)
+{
+	Buffer		metabuf;
+	Page		page;
+	ZHeapMetaPage metap;
+
+	metabuf = ReadBuffer(rel, ZHEAP_METAPAGE);
+	LockBuffer(metabuf, BUFFER_LOCK_EXCLUSIVE);
+	page = BufferGetPage(metabuf);
+	metap = ZHeapPageGetMeta(page);
+
+	if (metap->zhm_active_frac == active_frac &&
+		metap->zhm_undo_depth == undo_depth &&
+		metap->zhm_tpd_frac == tpd_frac)
+	{
+		UnlockReleaseBuffer(metabuf);
+		return;
+	}
+
+	START_CRIT_SECTION();
+
+	metap->zhm_active_frac = active_frac;
+	metap->zhm_undo_depth = undo_depth;
+	metap->zhm_tpd_frac = tpd_frac;
+
+	/* Metapages written before the statistics existed end earlier. */
+	((PageHeader) page)->pd_lower =
+		((char *) metap + sizeof(ZHeapMetaPageData)) - (char *) page;
+
+	MarkBufferDirty(metabuf);
+
+	if (RelationNeedsWAL(rel))
+	{
+		xl_zheap_meta_stats xlrec;
+		XLogRecPtr	recptr;
+
+		xlrec.active_frac = active_frac;
+		xlrec.undo_depth = undo_depth;
+		xlrec.tpd_frac = tpd_frac;
+
+		XLogBeginInsert();
+		XLogRegisterBuffer(0, metabuf, REGBUF_STANDARD);
+		XLogRegisterData((char *) &xlrec, SizeOfZHeapMetaStats);
+
+		recptr = XLogInsert(RM_ZHEAP2_ID, XLOG_ZHEAP_META_STATS);
+		PageSetLSN(page, recptr);
+	}
+
+	END_CRIT_SECTION();
+
+	UnlockReleaseBuffer(metabuf);
+
+	/* Make other backends drop the copy zheap_get_meta_stats cached. */
+	CacheInvalidateRelcache(rel);
+}
+
+/*
+ * zheap_get_meta_stats - Get the statistics stored by ANALYZE.
+ *
+ * The planner asks for these for every query, so the metapage contents are
+ * cached in rd_amcache, like btree does.  The cache goes away with the
+ * relcache entry, on the invalidation sent by zheap_update_meta_stats.
+ */
+void
+zheap_get_meta_stats(Relation rel, double *active_frac, double *undo_depth,
+					 double *tpd_frac)
+{
+	ZHeapMetaPage metad;
+
+	if (rel->rd_amcache == NULL)
+	{
+		Buffer		metabuf;
+		ZHeapMetaPageData metacopy;
+
+		/* A relation that hasn't got its metapage yet has no statistics. */
+		if (RelationGetNumberOfBlocks(rel) <= ZHEAP_METAPAGE)
+		{
+			*active_frac = *undo_depth = *tpd_frac = 0;
+			return;
+		}
+
+		metabuf = ReadBuffer(rel, ZHEAP_METAPAGE);
+		LockBuffer(metabuf, BUFFER_LOCK_SHARE);
+		memcpy(&metacopy, ZHeapPageGetMeta(BufferGetPage(metabuf)),
+			   sizeof(ZHeapMetaPageData));
+		UnlockReleaseBuffer(metabuf);
+
+		rel->rd_amcache = MemoryContextAlloc(CacheMemoryContext,
+											 sizeof(ZHeapMetaPageData));
+		memcpy(rel->rd_amcache, &metacopy, sizeof(ZHeapMetaPageData));
+	}
+
+	metad = (ZHeapMetaPage) rel->rd_amcache;
+	*active_frac = metad->zhm_active_frac;
+	*undo_depth = metad->zhm_undo_depth;
+	*tpd_frac = metad->zhm_tpd_frac;
+}
+
+/*
+ * ZheapInsertRelfilenodeUndo - Write the undo for new storage of a relation.
+ *
+ * Called when a zheap relation gets a new relfilenode, either because it was
+ * just created (UNDO_RELFILENODE_DROP) or because it replaces old_relfilenode
+ * for TRUNCATE or a table rewrite (UNDO_RELFILENODE_RESTORE).  If the old
+ * storage was created by the same transaction, a crash leaves the relation
+ * nothing to go back to, so the caller asks for UNDO_RELFILENODE_DROP.  When
+ * the transaction aborts, the pending-delete machinery drops the new
+ * storage, but nothing does that for a transaction that was in progress at a
+ * crash; this single relation-level record lets the rollback of such a
+ * transaction drop it, however much undo was written for its pages.
+ *
+ * Only permanent relations need this: a crash removes temporary relations
+ * anyway, and the undo of unlogged ones doesn't survive it.
+ */
+void
+ZheapInsertRelfilenodeUndo(Relation rel, uint8 action, Oid old_relfilenode)
+{
+	UnpackedUndoRecord undorecord;
+	UndoRecordRelfilenode relundo;
+	xl_undolog_meta undometa;
+	xl_undo_header xlundohdr;
+	xl_zheap_relfilenode xlrec;
+	UndoRecPtr	urecptr;
+	TransactionId xid;
+	XLogRecPtr	RedoRecPtr;
+	bool		doPageWrites;
+	XLogRecPtr	recptr;
+
+	if (rel->rd_rel->relpersistence != RELPERSISTENCE_PERMANENT)
+		return;
+
+	xid = GetTopTransactionId();
+
+	relundo.action = action;
+	relundo.reloid = RelationGetRelid(rel);
+	relundo.old_relfilenode = old_relfilenode;
+
+	undorecord.uur_type = UNDO_RELFILENODE;
+	undorecord.uur_info = 0;
+	undorecord.uur_prevlen = 0;
+	undorecord.uur_relfilenode = rel->rd_node.relNode;
+	undorecord.uur_prevxid = InvalidTransactionId;
+	undorecord.uur_xid = xid;
+	undorecord.uur_cid = GetCurrentCommandId(false);
+	undorecord.uur_tsid = rel->rd_node.spcNode;
+	undorecord.uur_fork = MAIN_FORKNUM;
+	undorecord.uur_blkprev = InvalidUndoRecPtr;
+	undorecord.uur_block = InvalidBlockNumber;
+	undorecord.uur_offset = 0;
+	undorecord.uur_tuple.len = 0;
+	initStringInfo(&undorecord.uur_payload);
+	appendBinaryStringInfo(&undorecord.uur_payload, (char *) &relundo,
+						   SizeOfUndoRecordRelfilenode);
+
+	urecptr = PrepareUndoInsert(&undorecord, UNDO_PERMANENT,
+								InvalidTransactionId, &undometa);
+
+	START_CRIT_SECTION();
+
+	InsertPreparedUndo();
+
+	/* The record is regenerated from WAL, like all the other undo. */
+	xlundohdr.relfilenode = rel->rd_node.relNode;
+	xlundohdr.tsid = rel->rd_node.spcNode;
+	xlundohdr.urec_ptr = urecptr;
+	xlundohdr.blkprev = InvalidUndoRecPtr;
+
+	xlrec.reloid = relundo.reloid;
+	xlrec.old_relfilenode = old_relfilenode;
+	xlrec.action = action;
+
+prepare_xlog:
+	/* LOG undolog meta if this is the first WAL after the checkpoint. */
+	LogUndoMetaData(&undometa);
+
+	GetFullPageWriteInfo(&RedoRecPtr, &doPageWrites);
+
+	XLogBeginInsert();
+	XLogRegisterData((char *) &xlundohdr, SizeOfUndoHeader);
+	XLogRegisterData((char *) &xlrec, SizeOfZHeapRelfilenode);
+
+	recptr = XLogInsertExtended(RM_ZHEAP2_ID, XLOG_ZHEAP_RELFILENODE,
+								RedoRecPtr, doPageWrites);
+	if (recptr == InvalidXLogRecPtr)
+		goto prepare_xlog;
+
+	END_CRIT_SECTION();
+
+	pfree(undorecord.uur_payload.data);
+	UnlockReleaseUndoBuffers();
+}
+
 /*
  * -----------
  * Zheap scan related API's.
@@ -8442,6 +9202,8 @@ zheapgetpage(HeapScanDesc scan, BlockNumber page)
 	bool		all_visible;
 	uint8		vmstatus;
 	Buffer		vmbuffer = InvalidBuffer;
+	ZHeapPageVisibility vis;
+	uint64		undo_fetched = UndoRecordsFetched;
 
 	Assert(page < scan->rs_nblocks);
 	Assert(page != ZHEAP_METAPAGE);
@@ -8465,6 +9227,12 @@ zheapgetpage(HeapScanDesc scan, BlockNumber page)
 								RBM_NORMAL, scan->rs_strategy);
 	scan->rs_cblock = page;
 
+	/*
+	 * Free up the transaction slots of all-visible transactions, so that the
+	 * writers don't have to do it.
+	 */
+	zheap_page_freeze_slots_opt(scan->rs_rd, buffer);
+
 	/*
 	 * We must hold share lock on the buffer content while examining tuple
 	 * visibility.  Afterwards, however, the tuples we have found to be
@@ -8533,6 +9301,13 @@ zheapgetpage(HeapScanDesc scan, BlockNumber page)
 		vmbuffer = InvalidBuffer;
 	}
 
+	/*
+	 * The tuples of a page point to a handful of transaction slots, so
+	 * resolve the visibility of each slot only once.
+	 */
+	if (!all_visible)
+		ZHeapPageInitVisibility(&vis, buffer, snapshot);
+
 	for (lineoff = FirstOffsetNumber, lpp = PageGetItemId(dp, lineoff);
 		 lineoff <= lines;
 		 lineoff++, lpp++)
@@ -8556,8 +9331,7 @@ zheapgetpage(HeapScanDesc scan, BlockNumber page)
 				}
 				else
 				{
-					resulttup = ZHeapGetVisibleTuple(lineoff, snapshot, buffer,
-													 NULL);
+					resulttup = ZHeapGetVisibleTuplePage(lineoff, &vis);
 					valid = resulttup ? true : false;
 				}
 			}
@@ -8587,8 +9361,7 @@ zheapgetpage(HeapScanDesc scan, BlockNumber page)
 				}
 				else
 				{
-					resulttup = ZHeapTupleSatisfiesVisibility(loctup, snapshot,
-															  buffer, NULL);
+					resulttup = ZHeapTupleSatisfiesMVCCPage(loctup, &vis);
 					valid = resulttup ? true : false;
 				}
 			}
@@ -8612,6 +9385,9 @@ zheapgetpage(HeapScanDesc scan, BlockNumber page)
 
 	UnlockReleaseBuffer(buffer);
 
+	pgstat_count_zheap_undo_fetches(scan->rs_rd,
+									UndoRecordsFetched - undo_fetched);
+
 	Assert(ntup <= MaxZHeapTuplesPerPage);
 	scan->rs_ntuples = ntup;
 
@@ -8892,6 +9668,7 @@ zheapgettup(HeapScanDesc scan,
 	OffsetNumber lineoff;
 	int			linesleft;
 	ItemId		lpp;
+	uint64		undo_fetched;
 
 	/*
 	 * calculate next starting lineoff, given scan direction
@@ -9056,8 +9833,11 @@ get_next_tuple:
 			 */
 			memcpy(loctup->t_data, ((ZHeapTupleHeader) PageGetItem((Page) dp, lpp)), loctup->t_len);
 
+			undo_fetched = UndoRecordsFetched;
 			tuple = ZHeapTupleSatisfiesVisibility(loctup, snapshot, scan->rs_cbuf, NULL);
 			valid = tuple ? true : false;
+			pgstat_count_zheap_undo_fetches(scan->rs_rd,
+											UndoRecordsFetched - undo_fetched);
 
 			/*
 			 * If any prior version is visible, we pass latest visible as
@@ -9279,6 +10059,7 @@ zheap_search_buffer(ItemPointer tid, Relation relation, Buffer buffer,
 	ZHeapTupleData	loctup_tmp;
 	ZHeapTuple	resulttup = NULL;
 	Size		loctup_len;
+	uint64		undo_fetched;
 
 	if (all_dead)
 		*all_dead = false;
@@ -9326,7 +10107,10 @@ zheap_search_buffer(ItemPointer tid, Relation relation, Buffer buffer,
 		memcpy(loctup->t_data, ((ZHeapTupleHeader) PageGetItem((Page) dp, lp)), loctup->t_len);
 
 		/* If it's visible per the snapshot, we must return it */
+		undo_fetched = UndoRecordsFetched;
 		resulttup = ZHeapTupleSatisfiesVisibility(loctup, snapshot, buffer, NULL);
+		pgstat_count_zheap_undo_fetches(relation,
+										UndoRecordsFetched - undo_fetched);
 	}
 
 	if (resulttup)
@@ -9430,6 +10214,7 @@ zheap_fetch(Relation relation,
 	OffsetNumber offnum;
 	bool		valid;
 	ItemPointerData	ctid;
+	uint64		undo_fetched;
 
 	/*
 	 * Fetch and pin the appropriate page of the relation.
@@ -9519,8 +10304,11 @@ zheap_fetch(Relation relation,
 		/*
 		 * check time qualification of tuple, then release lock
 		 */
+		undo_fetched = UndoRecordsFetched;
 		resulttup = ZHeapTupleSatisfiesVisibility(*tuple, snapshot, buffer, &ctid);
 		valid = resulttup ? true : false;
+		pgstat_count_zheap_undo_fetches(relation,
+										UndoRecordsFetched - undo_fetched);
 	}
 
 	if (valid)
@@ -10316,7 +11104,7 @@ zheap_multi_insert(Relation relation, ZHeapTuple *tuples, int ntuples,
 	bool		lock_reacquired;
 	bool		skip_undo;
 
-	needwal = RelationNeedsWAL(relation);
+	needwal = !(options & HEAP_INSERT_SKIP_WAL) && RelationNeedsWAL(relation);
 	saveFreeSpace = RelationGetTargetPageFreeSpace(relation,
 												   HEAP_DEFAULT_FILLFACTOR);
 	/*
@@ -10428,6 +11216,7 @@ reacquire_buffer:
 			{
 				UnlockReleaseBuffer(buffer);
 
+				pgstat_count_zheap_trans_slot_wait(relation);
 				pgstat_report_wait_start(PG_WAIT_PAGE_TRANS_SLOT);
 				pg_usleep(10000L);	/* 10 ms */
 				pgstat_report_wait_end();
@@ -10476,6 +11265,8 @@ reacquire_buffer:
 				urecptr = PrepareUndoInsert(&undorecord[i],
 											UndoPersistenceForRelation(relation),
 											InvalidTransactionId, NULL);
+				pgstat_count_zheap_undo_bytes(relation,
+											  UndoRecordExpectedSize(&undorecord[i]));
 
 				initStringInfo(&undorecord[i].uur_payload);
 			}
@@ -10859,9 +11650,112 @@ zheap_mask(char *pagedata, BlockNumber blkno)
 	}
 }
 
+/*
+ * ZHeapUndoMultiDeleteNext - get the next tuple of an UNDO_MULTI_DELETE record
+ *
+ * For each tuple, the record holds the xid that modified the tuple before
+ * the delete, followed by what would be the tuple data of its UNDO_DELETE
+ * record.  *pos is the position in the record's tuple data where the next
+ * tuple starts, zero for the first one.  This fills *delrec with the
+ * UNDO_DELETE record zheap_delete would have written for that tuple and
+ * advances *pos, or returns false if there are no more tuples.  The tuple
+ * data of *delrec points into that of urec, so it must not be released.
+ */
+bool
+ZHeapUndoMultiDeleteNext(UnpackedUndoRecord *urec, Size *pos,
+						 UnpackedUndoRecord *delrec)
+{
+	char	   *data;
+	uint32		undo_tup_len;
+	ItemPointerData ctid;
+
+	Assert(urec->uur_type == UNDO_MULTI_DELETE);
+
+	if (*pos >= urec->uur_tuple.len)
+		return false;
+
+	data = urec->uur_tuple.data + *pos;
+
+	*delrec = *urec;
+	delrec->uur_type = UNDO_DELETE;
+	memcpy(&delrec->uur_prevxid, data, sizeof(TransactionId));
+	data += sizeof(TransactionId);
+
+	/* The rest is laid out as in zheap_delete: length, ctid, tableoid, tuple. */
+	memcpy(&undo_tup_len, data, sizeof(uint32));
+	memcpy(&ctid, data + sizeof(uint32), sizeof(ItemPointerData));
+	delrec->uur_offset = ItemPointerGetOffsetNumber(&ctid);
+	delrec->uur_tuple.data = data;
+	delrec->uur_tuple.len = sizeof(uint32) + sizeof(ItemPointerData) +
+		sizeof(Oid) + undo_tup_len;
+	delrec->uur_payload.data = NULL;
+	delrec->uur_payload.len = 0;
+
+	*pos += sizeof(TransactionId) + delrec->uur_tuple.len;
+
+	return true;
+}
+
+/*
+ * ZHeapUndoMultiDeleteForm - set up the undo record of zheap_multi_delete
+ *
+ * Fills in the type, offset, previous xid and tuple data of the record for
+ * deleting the given tuples of one page, which prevxids[i] last modified;
+ * the caller fills in the rest.  A single tuple gets the same UNDO_DELETE
+ * record as zheap_delete would write, since that's smaller.  This is also
+ * used during replay, which must reproduce the record exactly.
+ */
+void
+ZHeapUndoMultiDeleteForm(UnpackedUndoRecord *urec, ZHeapTupleData *tuples,
+						 TransactionId *prevxids, int ntuples)
+{
+	int			i;
+
+	Assert(ntuples > 0);
+
+	if (ntuples == 1)
+	{
+		urec->uur_type = UNDO_DELETE;
+		urec->uur_prevxid = prevxids[0];
+		urec->uur_offset = ItemPointerGetOffsetNumber(&tuples[0].t_self);
+	}
+	else
+	{
+		urec->uur_type = UNDO_MULTI_DELETE;
+		urec->uur_prevxid = InvalidTransactionId;
+		urec->uur_offset = 0;
+	}
+	urec->uur_payload.len = 0;
+
+	initStringInfo(&urec->uur_tuple);
+	for (i = 0; i < ntuples; i++)
+	{
+		if (ntuples > 1)
+			appendBinaryStringInfo(&urec->uur_tuple,
+								   (char *) &prevxids[i],
+								   sizeof(TransactionId));
+		appendBinaryStringInfo(&urec->uur_tuple,
+							   (char *) &tuples[i].t_len,
+							   sizeof(uint32));
+		appendBinaryStringInfo(&urec->uur_tuple,
+							   (char *) &tuples[i].t_self,
+							   sizeof(ItemPointerData));
+		appendBinaryStringInfo(&urec->uur_tuple,
+							   (char *) &tuples[i].t_tableOid,
+							   sizeof(Oid));
+		appendBinaryStringInfo(&urec->uur_tuple,
+							   (char *) tuples[i].t_data,
+							   tuples[i].t_len);
+	}
+}
+
 /*
  * Per-undorecord callback from UndoFetchRecord to check whether
  * an undorecord satisfies the given conditions.
+ *
+ * An UNDO_MULTI_DELETE record that covers the offset is turned into the
+ * UNDO_DELETE record of just that tuple, so that callers never see the
+ * former.
  */
 bool
 ZHeapSatisfyUndoRecord(UnpackedUndoRecord* urec, BlockNumber blkno,
@@ -10888,6 +11782,32 @@ ZHeapSatisfyUndoRecord(UnpackedUndoRecord* urec, BlockNumber blkno,
 					return true;
 			}
 			break;
+		case UNDO_MULTI_DELETE:
+			{
+				UnpackedUndoRecord delrec;
+				Size		pos = 0;
+
+				while (ZHeapUndoMultiDeleteNext(urec, &pos, &delrec))
+				{
+					if (delrec.uur_offset != offset)
+						continue;
+
+					/*
+					 * If the record was copied out of the undo buffers, the
+					 * tuple data is ours to move; otherwise it points into
+					 * the buffer, and we just point at the tuple instead.
+					 */
+					if (!BufferIsValid(urec->uur_buffer))
+					{
+						memmove(urec->uur_tuple.data, delrec.uur_tuple.data,
+								delrec.uur_tuple.len);
+						delrec.uur_tuple.data = urec->uur_tuple.data;
+					}
+					*urec = delrec;
+					return true;
+				}
+			}
+			break;
 		case UNDO_ITEMID_UNUSED:
 			{
 				/*
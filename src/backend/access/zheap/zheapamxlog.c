@@ -38,7 +38,7 @@ zheap_xlog_insert(XLogReaderState *record)
 	}			tbuf;
 	ZHeapTupleHeader zhtup;
 	UnpackedUndoRecord	undorecord;
-	UndoRecPtr	urecptr;
+	UndoRecPtr	urecptr = InvalidUndoRecPtr;
 	xl_zheap_header xlhdr;
 	uint32		newlen;
 	RelFileNode target_node;
@@ -48,8 +48,10 @@ zheap_xlog_insert(XLogReaderState *record)
 	int			*tpd_trans_slot_id = NULL;
 	TransactionId	xid = XLogRecGetXid(record);
 	uint32	xid_epoch = GetEpochForXid(xid);
+	bool		skip_undo;
 
 	xlrec = (xl_zheap_insert *) ((char *) xlundohdr + SizeOfUndoHeader);
+	skip_undo = (xlrec->flags & XLZ_INSERT_IS_FROZEN);
 	if (xlrec->flags & XLZ_INSERT_CONTAINS_TPD_SLOT)
 		tpd_trans_slot_id = (int *) ((char *) xlrec + SizeOfZHeapInsert);
 
@@ -72,54 +74,61 @@ zheap_xlog_insert(XLogReaderState *record)
 		FreeFakeRelcacheEntry(reln);
 	}
 
-	/* prepare an undo record */
-	undorecord.uur_type = UNDO_INSERT;
-	undorecord.uur_info = 0;
-	undorecord.uur_prevlen = 0;
-	undorecord.uur_relfilenode = xlundohdr->relfilenode;
-	undorecord.uur_prevxid = FrozenTransactionId;
-	undorecord.uur_xid = xid;
-	undorecord.uur_cid = FirstCommandId;
-	undorecord.uur_tsid = xlundohdr->tsid;
-	undorecord.uur_fork = MAIN_FORKNUM;
-	undorecord.uur_blkprev = xlundohdr->blkprev;
-	undorecord.uur_block = ItemPointerGetBlockNumber(&target_tid);
-	undorecord.uur_offset = ItemPointerGetOffsetNumber(&target_tid);
-	undorecord.uur_payload.len = 0;
-	undorecord.uur_tuple.len = 0;
-
 	/*
-	 * For speculative insertions, we store the dummy speculative token in the
-	 * undorecord so that, the size of undorecord in DO function matches with
-	 * the size of undorecord in REDO function. This ensures that, for INSERT
-	 * ... ON CONFLICT statements, the assert condition used later in this
-	 * function to ensure that the undo pointer in DO and REDO function remains
-	 * the same is true. However, it might not be useful in the REDO function as
-	 * it is just required in the master node to detect conflicts for insert ...
-	 * on conflict.
+	 * We can skip inserting undo records if the tuple is to be marked as
+	 * frozen.
 	 */
-	if (xlrec->flags & XLZ_INSERT_IS_SPECULATIVE)
+	if (!skip_undo)
 	{
-		uint32 dummy_specToken = 1;
-
-		undorecord.uur_payload.len = sizeof(uint32);
-		initStringInfo(&undorecord.uur_payload);
-		appendBinaryStringInfo(&undorecord.uur_payload,
-							   (char *) &dummy_specToken,
-							   sizeof(uint32));
-	}
-	else
+		/* prepare an undo record */
+		undorecord.uur_type = UNDO_INSERT;
+		undorecord.uur_info = 0;
+		undorecord.uur_prevlen = 0;
+		undorecord.uur_relfilenode = xlundohdr->relfilenode;
+		undorecord.uur_prevxid = FrozenTransactionId;
+		undorecord.uur_xid = xid;
+		undorecord.uur_cid = FirstCommandId;
+		undorecord.uur_tsid = xlundohdr->tsid;
+		undorecord.uur_fork = MAIN_FORKNUM;
+		undorecord.uur_blkprev = xlundohdr->blkprev;
+		undorecord.uur_block = ItemPointerGetBlockNumber(&target_tid);
+		undorecord.uur_offset = ItemPointerGetOffsetNumber(&target_tid);
 		undorecord.uur_payload.len = 0;
+		undorecord.uur_tuple.len = 0;
 
-	urecptr = PrepareUndoInsert(&undorecord, UNDO_PERMANENT, xid, NULL);
-	InsertPreparedUndo();
+		/*
+		 * For speculative insertions, we store the dummy speculative token in
+		 * the undorecord so that, the size of undorecord in DO function
+		 * matches with the size of undorecord in REDO function. This ensures
+		 * that, for INSERT ... ON CONFLICT statements, the assert condition
+		 * used later in this function to ensure that the undo pointer in DO
+		 * and REDO function remains the same is true. However, it might not
+		 * be useful in the REDO function as it is just required in the master
+		 * node to detect conflicts for insert ... on conflict.
+		 */
+		if (xlrec->flags & XLZ_INSERT_IS_SPECULATIVE)
+		{
+			uint32 dummy_specToken = 1;
 
-	/*
-	 * undo should be inserted at same location as it was during the actual
-	 * insert (DO operation).
-	 */
+			undorecord.uur_payload.len = sizeof(uint32);
+			initStringInfo(&undorecord.uur_payload);
+			appendBinaryStringInfo(&undorecord.uur_payload,
+								   (char *) &dummy_specToken,
+								   sizeof(uint32));
+		}
+		else
+			undorecord.uur_payload.len = 0;
 
-	Assert (urecptr == xlundohdr->urec_ptr);
+		urecptr = PrepareUndoInsert(&undorecord, UNDO_PERMANENT, xid, NULL);
+		InsertPreparedUndo();
+
+		/*
+		 * undo should be inserted at same location as it was during the actual
+		 * insert (DO operation).
+		 */
+
+		Assert (urecptr == xlundohdr->urec_ptr);
+	}
 
 	/*
 	 * If we inserted the first and only tuple on the page, re-initialize the
@@ -174,8 +183,9 @@ zheap_xlog_insert(XLogReaderState *record)
 		else
 			trans_slot_id = ZHeapTupleHeaderGetXactSlot(zhtup);
 		
-		PageSetUNDO(undorecord, buffer, trans_slot_id, false, xid_epoch,
-					xid, urecptr, NULL, 0);
+		if (!skip_undo)
+			PageSetUNDO(undorecord, buffer, trans_slot_id, false, xid_epoch,
+						xid, urecptr, NULL, 0);
 		PageSetLSN(page, lsn);
 
 		MarkBufferDirty(buffer);
@@ -1772,6 +1782,188 @@ zheap_xlog_confirm(XLogReaderState *record)
 		UnlockReleaseBuffer(buffer);
 }
 
+/*
+ * Handles XLOG_ZHEAP_MULTI_DELETE record type
+ */
+static void
+zheap_xlog_multi_delete(XLogReaderState *record)
+{
+	XLogRecPtr	lsn = record->EndRecPtr;
+	xl_undo_header	*xlundohdr = (xl_undo_header *) XLogRecGetData(record);
+	xl_zheap_multi_delete *xlrec;
+	xl_multi_delete_ztuple *xltuples;
+	Buffer		buffer;
+	Page		page;
+	UnpackedUndoRecord	undorecord;
+	OffsetNumber *usedoff;
+	UndoRecPtr	urecptr;
+	RelFileNode target_node;
+	BlockNumber blkno;
+	XLogRedoAction action;
+	Relation	reln;
+	TransactionId	xid = XLogRecGetXid(record);
+	uint32	xid_epoch = GetEpochForXid(xid);
+	int			i;
+
+	xlrec = (xl_zheap_multi_delete *) ((char *) xlundohdr + SizeOfUndoHeader);
+	xltuples = (xl_multi_delete_ztuple *) ((char *) xlrec + SizeOfZHeapMultiDelete);
+
+	XLogRecGetBlockTag(record, 0, &target_node, NULL, &blkno);
+
+	reln = CreateFakeRelcacheEntry(target_node);
+
+	/*
+	 * The visibility map may need to be fixed even if the heap page is
+	 * already up-to-date.
+	 */
+	if (xlrec->flags & XLZ_MULTI_DELETE_ALL_VISIBLE_CLEARED)
+	{
+		Buffer		vmbuffer = InvalidBuffer;
+
+		visibilitymap_pin(reln, blkno, &vmbuffer);
+		visibilitymap_clear(reln, blkno, vmbuffer, VISIBILITYMAP_VALID_BITS);
+		ReleaseBuffer(vmbuffer);
+	}
+
+	action = XLogReadBufferForRedo(record, 0, &buffer);
+	page = BufferGetPage(buffer);
+
+	usedoff = palloc(xlrec->ntuples * sizeof(OffsetNumber));
+	for (i = 0; i < xlrec->ntuples; i++)
+		usedoff[i] = xltuples[i].offnum;
+
+	undorecord.uur_info = 0;
+	undorecord.uur_prevlen = 0;
+	undorecord.uur_relfilenode = xlundohdr->relfilenode;
+	undorecord.uur_xid = xid;
+	undorecord.uur_cid = FirstCommandId;
+	undorecord.uur_tsid = xlundohdr->tsid;
+	undorecord.uur_fork = MAIN_FORKNUM;
+	undorecord.uur_blkprev = xlundohdr->blkprev;
+	undorecord.uur_block = blkno;
+
+	/*
+	 * Regenerate the undo record, from the tuples on the page unless the WAL
+	 * record carries its tuple data; see zheap_xlog_delete.
+	 */
+	if (xlrec->flags & XLZ_HAS_MULTI_DELETE_UNDOTUPLES)
+	{
+		char	   *undotupdata;
+
+		undotupdata = (char *) xltuples +
+			xlrec->ntuples * sizeof(xl_multi_delete_ztuple);
+
+		if (xlrec->ntuples == 1)
+		{
+			undorecord.uur_type = UNDO_DELETE;
+			undorecord.uur_prevxid = xltuples[0].prevxid;
+			undorecord.uur_offset = xltuples[0].offnum;
+		}
+		else
+		{
+			undorecord.uur_type = UNDO_MULTI_DELETE;
+			undorecord.uur_prevxid = InvalidTransactionId;
+			undorecord.uur_offset = 0;
+		}
+		undorecord.uur_payload.len = 0;
+
+		/* the undo tuple data is not aligned, so copy it */
+		initStringInfo(&undorecord.uur_tuple);
+		appendBinaryStringInfo(&undorecord.uur_tuple, undotupdata,
+							   XLogRecGetDataLen(record) -
+							   (undotupdata - XLogRecGetData(record)));
+	}
+	else
+	{
+		ZHeapTupleData *zheaptups;
+		TransactionId *prevxids;
+
+		zheaptups = palloc(xlrec->ntuples * sizeof(ZHeapTupleData));
+		prevxids = palloc(xlrec->ntuples * sizeof(TransactionId));
+		for (i = 0; i < xlrec->ntuples; i++)
+		{
+			ItemId		lp = NULL;
+			OffsetNumber offnum = xltuples[i].offnum;
+
+			if (PageGetMaxOffsetNumber(page) >= offnum)
+				lp = PageGetItemId(page, offnum);
+
+			if (PageGetMaxOffsetNumber(page) < offnum || !ItemIdIsNormal(lp))
+				elog(PANIC, "invalid lp");
+
+			zheaptups[i].t_tableOid = RelationGetRelid(reln);
+			ItemPointerSet(&zheaptups[i].t_self, blkno, offnum);
+			zheaptups[i].t_data = (ZHeapTupleHeader) PageGetItem(page, lp);
+			zheaptups[i].t_len = ItemIdGetLength(lp);
+			prevxids[i] = xltuples[i].prevxid;
+		}
+
+		ZHeapUndoMultiDeleteForm(&undorecord, zheaptups, prevxids,
+								 xlrec->ntuples);
+		pfree(zheaptups);
+		pfree(prevxids);
+	}
+
+	urecptr = PrepareUndoInsert(&undorecord, UNDO_PERMANENT, xid, NULL);
+	InsertPreparedUndo();
+
+	/*
+	 * undo should be inserted at same location as it was during the actual
+	 * delete (DO operation).
+	 */
+	Assert(urecptr == xlundohdr->urec_ptr);
+
+	if (action == BLK_NEEDS_REDO)
+	{
+		for (i = 0; i < xlrec->ntuples; i++)
+		{
+			ZHeapTupleHeader zhtuphdr;
+
+			zhtuphdr = (ZHeapTupleHeader)
+				PageGetItem(page, PageGetItemId(page, xltuples[i].offnum));
+			ZHeapTupleHeaderSetXactSlot(zhtuphdr, xlrec->trans_slot_id);
+			zhtuphdr->t_infomask = xltuples[i].infomask;
+		}
+
+		PageSetUNDO(undorecord, buffer, xlrec->trans_slot_id, false,
+					xid_epoch, xid, urecptr, NULL, 0);
+
+		/* Mark the page as a candidate for pruning */
+		ZPageSetPrunable(page, xid);
+
+		PageSetLSN(page, lsn);
+		MarkBufferDirty(buffer);
+	}
+	/* replay the record for tpd buffer */
+	if (XLogRecHasBlockRef(record, 1))
+	{
+		action = XLogReadTPDBuffer(record, 1);
+		if (action == BLK_NEEDS_REDO)
+		{
+			TPDPageSetUndo(buffer,
+						   xlrec->trans_slot_id,
+						   true,
+						   xid_epoch,
+						   xid,
+						   urecptr,
+						   usedoff,
+						   xlrec->ntuples);
+			TPDPageSetLSN(page, lsn);
+		}
+	}
+
+	if (BufferIsValid(buffer))
+		UnlockReleaseBuffer(buffer);
+
+	/* be tidy */
+	pfree(undorecord.uur_tuple.data);
+	pfree(usedoff);
+
+	UnlockReleaseUndoBuffers();
+	UnlockReleaseTPDBuffers();
+	FreeFakeRelcacheEntry(reln);
+}
+
 /*
  * Handles XLOG_ZHEAP_UNUSED record type
  */
@@ -1976,6 +2168,58 @@ zheap_xlog_visible(XLogReaderState *record)
 		UnlockReleaseBuffer(vmbuffer);
 }
 
+/*
+ * Handles XLOG_ZHEAP_RELFILENODE record type
+ *
+ * There is nothing to do but regenerate the undo record; the storage itself
+ * was created by an XLOG_SMGR_CREATE record.
+ */
+static void
+zheap_xlog_relfilenode(XLogReaderState *record)
+{
+	xl_undo_header	*xlundohdr = (xl_undo_header *) XLogRecGetData(record);
+	xl_zheap_relfilenode *xlrec;
+	UnpackedUndoRecord	undorecord;
+	UndoRecordRelfilenode relundo;
+	UndoRecPtr	urecptr;
+	TransactionId	xid = XLogRecGetXid(record);
+
+	xlrec = (xl_zheap_relfilenode *) ((char *) xlundohdr + SizeOfUndoHeader);
+
+	relundo.action = xlrec->action;
+	relundo.reloid = xlrec->reloid;
+	relundo.old_relfilenode = xlrec->old_relfilenode;
+
+	undorecord.uur_type = UNDO_RELFILENODE;
+	undorecord.uur_info = 0;
+	undorecord.uur_prevlen = 0;
+	undorecord.uur_relfilenode = xlundohdr->relfilenode;
+	undorecord.uur_prevxid = InvalidTransactionId;
+	undorecord.uur_xid = xid;
+	undorecord.uur_cid = FirstCommandId;
+	undorecord.uur_tsid = xlundohdr->tsid;
+	undorecord.uur_fork = MAIN_FORKNUM;
+	undorecord.uur_blkprev = xlundohdr->blkprev;
+	undorecord.uur_block = InvalidBlockNumber;
+	undorecord.uur_offset = 0;
+	undorecord.uur_tuple.len = 0;
+	initStringInfo(&undorecord.uur_payload);
+	appendBinaryStringInfo(&undorecord.uur_payload, (char *) &relundo,
+						   SizeOfUndoRecordRelfilenode);
+
+	urecptr = PrepareUndoInsert(&undorecord, UNDO_PERMANENT, xid, NULL);
+	InsertPreparedUndo();
+
+	/*
+	 * undo should be inserted at same location as it was when the storage
+	 * was created (DO operation).
+	 */
+	Assert(urecptr == xlundohdr->urec_ptr);
+
+	pfree(undorecord.uur_payload.data);
+	UnlockReleaseUndoBuffers();
+}
+
 void
 zheap_redo(XLogReaderState *record)
 {
@@ -2012,6 +2256,34 @@ zheap_redo(XLogReaderState *record)
 	}
 }
 
+/*
+ * Handles XLOG_ZHEAP_META_STATS record type
+ */
+static void
+zheap_xlog_meta_stats(XLogReaderState *record)
+{
+	XLogRecPtr	lsn = record->EndRecPtr;
+	xl_zheap_meta_stats *xlrec = (xl_zheap_meta_stats *) XLogRecGetData(record);
+	Buffer		metabuf;
+
+	if (XLogReadBufferForRedo(record, 0, &metabuf) == BLK_NEEDS_REDO)
+	{
+		Page		page = BufferGetPage(metabuf);
+		ZHeapMetaPage metap = ZHeapPageGetMeta(page);
+
+		metap->zhm_active_frac = xlrec->active_frac;
+		metap->zhm_undo_depth = xlrec->undo_depth;
+		metap->zhm_tpd_frac = xlrec->tpd_frac;
+		((PageHeader) page)->pd_lower =
+			((char *) metap + sizeof(ZHeapMetaPageData)) - (char *) page;
+
+		PageSetLSN(page, lsn);
+		MarkBufferDirty(metabuf);
+	}
+	if (BufferIsValid(metabuf))
+		UnlockReleaseBuffer(metabuf);
+}
+
 void
 zheap2_redo(XLogReaderState *record)
 {
@@ -2028,6 +2300,15 @@ zheap2_redo(XLogReaderState *record)
 		case XLOG_ZHEAP_VISIBLE:
 			zheap_xlog_visible(record);
 			break;
+		case XLOG_ZHEAP_MULTI_DELETE:
+			zheap_xlog_multi_delete(record);
+			break;
+		case XLOG_ZHEAP_RELFILENODE:
+			zheap_xlog_relfilenode(record);
+			break;
+		case XLOG_ZHEAP_META_STATS:
+			zheap_xlog_meta_stats(record);
+			break;
 		default:
 			elog(PANIC, "zheap2_redo: unknown op code %u", info);
 	}
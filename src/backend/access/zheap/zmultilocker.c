@@ -17,14 +17,234 @@
  */
 #include "postgres.h"
 
+#include "access/hash.h"
 #include "access/tpd.h"
 #include "access/xact.h"
 #include "access/zmultilocker.h"
 #include "storage/bufmgr.h"
 #include "storage/buf_internals.h"
 #include "storage/proc.h"
+#include "storage/shmem.h"
+#include "utils/ztqual.h"
+
+/*
+ * Shared cache of the lockers found by walking the undo chain of one
+ * transaction slot of a tuple in ZGetMultiLockMembers.  Many transactions
+ * checking for conflicts with the lockers of the same rows (think of foreign
+ * key checks taking KEY SHARE locks on the same parent rows) would otherwise
+ * fetch the same undo records over and over again.
+ *
+ * Undo records never change, so the lockers found from a given undo record
+ * pointer never change either and entries don't need to be invalidated.
+ * Lockers that have become all-visible since the entry was made are filtered
+ * out when it's used; a new walk wouldn't find them as their undo gets
+ * discarded.  The cache is a direct-mapped array; an entry is simply
+ * overwritten on collision.  The entries are spread over several partitions,
+ * each protected by its own LWLock, so that backends looking up different
+ * rows don't contend for a single lock.
+ */
+#define ZMULTILOCK_CACHE_SIZE			1024
+#define ZMULTILOCK_CACHE_PARTITIONS		16	/* must be a power of 2 */
+#define ZMULTILOCK_CACHE_MAX_MEMBERS	8
+
+typedef struct ZMultiLockCacheMember
+{
+	TransactionId xid;
+	int16		trans_slot_id;
+	uint8		mode;			/* LockTupleMode */
+} ZMultiLockCacheMember;
+
+typedef struct ZMultiLockCacheEntry
+{
+	/* key */
+	RelFileNode rnode;
+	ItemPointerData tid;
+	int16		trans_slot_id;
+	UndoRecPtr	urec_ptr;		/* InvalidUndoRecPtr if entry is unused */
+
+	/* lockers found on the undo chain */
+	int			nmembers;
+	ZMultiLockCacheMember members[ZMULTILOCK_CACHE_MAX_MEMBERS];
+} ZMultiLockCacheEntry;
+
+typedef struct ZMultiLockCacheData
+{
+	LWLockPadded locks[ZMULTILOCK_CACHE_PARTITIONS];
+	ZMultiLockCacheEntry entries[ZMULTILOCK_CACHE_SIZE];
+} ZMultiLockCacheData;
+
+static ZMultiLockCacheData *ZMultiLockCache = NULL;
 
 static bool IsZMultiLockListMember(List *members, ZMultiLockMember *mlmember);
+static ZMultiLockCacheEntry *ZMultiLockCacheGetEntry(Relation rel,
+						ItemPointer tid, int trans_slot_id,
+						UndoRecPtr urec_ptr, LWLock **lock);
+static bool ZMultiLockCacheLookup(Relation rel, ItemPointer tid,
+					  int trans_slot_id, UndoRecPtr urec_ptr,
+					  List **members);
+static void ZMultiLockCacheInsert(Relation rel, ItemPointer tid,
+					  int trans_slot_id, UndoRecPtr urec_ptr,
+					  List *members);
+
+/*
+ * Report shared-memory space needed by ZMultiLockCacheShmemInit.
+ */
+Size
+ZMultiLockCacheShmemSize(void)
+{
+	return sizeof(ZMultiLockCacheData);
+}
+
+/*
+ * Allocate and initialize the shared lock member cache.
+ */
+void
+ZMultiLockCacheShmemInit(void)
+{
+	bool		found;
+
+	ZMultiLockCache = (ZMultiLockCacheData *)
+		ShmemInitStruct("zheap lock member cache",
+						ZMultiLockCacheShmemSize(),
+						&found);
+	if (!found)
+	{
+		int			i;
+
+		for (i = 0; i < ZMULTILOCK_CACHE_PARTITIONS; i++)
+			LWLockInitialize(&ZMultiLockCache->locks[i].lock,
+							 LWTRANCHE_ZMULTILOCK_CACHE);
+		for (i = 0; i < ZMULTILOCK_CACHE_SIZE; i++)
+			ZMultiLockCache->entries[i].urec_ptr = InvalidUndoRecPtr;
+	}
+}
+
+/*
+ * Return the cache entry the given key maps to, and in *lock the lock of the
+ * partition it belongs to.
+ */
+static ZMultiLockCacheEntry *
+ZMultiLockCacheGetEntry(Relation rel, ItemPointer tid, int trans_slot_id,
+						UndoRecPtr urec_ptr, LWLock **lock)
+{
+	uint32		hash;
+	uint32		index;
+
+	hash = hash_uint32((uint32) urec_ptr ^ (uint32) (urec_ptr >> 32));
+	hash ^= hash_uint32(rel->rd_node.relNode ^
+						(ItemPointerGetBlockNumber(tid) << 8) ^
+						ItemPointerGetOffsetNumber(tid) ^
+						((uint32) trans_slot_id << 24));
+
+	index = hash % ZMULTILOCK_CACHE_SIZE;
+	*lock = &ZMultiLockCache->locks[index % ZMULTILOCK_CACHE_PARTITIONS].lock;
+
+	return &ZMultiLockCache->entries[index];
+}
+
+/*
+ * Append the cached lockers of the undo chain starting at urec_ptr to
+ * *members.  Returns false if the cache can't answer, in which case the
+ * caller has to walk the undo chain itself.
+ */
+static bool
+ZMultiLockCacheLookup(Relation rel, ItemPointer tid, int trans_slot_id,
+					  UndoRecPtr urec_ptr, List **members)
+{
+	ZMultiLockCacheEntry *entry;
+	LWLock	   *lock;
+	ZMultiLockCacheMember cached[ZMULTILOCK_CACHE_MAX_MEMBERS];
+	TransactionId oldestXidHavingUndo;
+	TransactionId topxid = GetTopTransactionIdIfAny();
+	int			nmembers = -1;
+	int			i;
+
+	if (ZMultiLockCache == NULL || RelationUsesLocalBuffers(rel))
+		return false;
+
+	entry = ZMultiLockCacheGetEntry(rel, tid, trans_slot_id, urec_ptr, &lock);
+
+	LWLockAcquire(lock, LW_SHARED);
+	if (entry->urec_ptr == urec_ptr &&
+		entry->trans_slot_id == trans_slot_id &&
+		RelFileNodeEquals(entry->rnode, rel->rd_node) &&
+		ItemPointerEquals(&entry->tid, tid))
+	{
+		nmembers = entry->nmembers;
+		memcpy(cached, entry->members,
+			   nmembers * sizeof(ZMultiLockCacheMember));
+	}
+	LWLockRelease(lock);
+
+	if (nmembers < 0)
+		return false;
+
+	/*
+	 * The walk skips the undo records of our own transaction, which can
+	 * change its outcome, so don't use an entry that includes them.
+	 */
+	for (i = 0; i < nmembers; i++)
+	{
+		if (TransactionIdIsValid(topxid) &&
+			TransactionIdEquals(cached[i].xid, topxid))
+			return false;
+	}
+
+	oldestXidHavingUndo = (TransactionId)
+		pg_atomic_read_u64(&ProcGlobal->oldestXidWithEpochHavingUndo);
+
+	for (i = 0; i < nmembers; i++)
+	{
+		ZMultiLockMember *mlmember;
+
+		if (TransactionIdPrecedes(cached[i].xid, oldestXidHavingUndo))
+			continue;
+
+		mlmember = (ZMultiLockMember *) palloc(sizeof(ZMultiLockMember));
+		mlmember->xid = cached[i].xid;
+		mlmember->trans_slot_id = cached[i].trans_slot_id;
+		mlmember->mode = (LockTupleMode) cached[i].mode;
+		*members = lappend(*members, mlmember);
+	}
+
+	return true;
+}
+
+/*
+ * Remember the lockers found on the undo chain starting at urec_ptr.
+ */
+static void
+ZMultiLockCacheInsert(Relation rel, ItemPointer tid, int trans_slot_id,
+					  UndoRecPtr urec_ptr, List *members)
+{
+	ZMultiLockCacheEntry *entry;
+	LWLock	   *lock;
+	ListCell   *lc;
+	int			i = 0;
+
+	if (ZMultiLockCache == NULL || RelationUsesLocalBuffers(rel) ||
+		list_length(members) > ZMULTILOCK_CACHE_MAX_MEMBERS)
+		return;
+
+	entry = ZMultiLockCacheGetEntry(rel, tid, trans_slot_id, urec_ptr, &lock);
+
+	LWLockAcquire(lock, LW_EXCLUSIVE);
+	entry->rnode = rel->rd_node;
+	entry->tid = *tid;
+	entry->trans_slot_id = trans_slot_id;
+	entry->urec_ptr = urec_ptr;
+	foreach(lc, members)
+	{
+		ZMultiLockMember *mlmember = (ZMultiLockMember *) lfirst(lc);
+
+		entry->members[i].xid = mlmember->xid;
+		entry->members[i].trans_slot_id = mlmember->trans_slot_id;
+		entry->members[i].mode = (uint8) mlmember->mode;
+		i++;
+	}
+	entry->nmembers = i;
+	LWLockRelease(lock);
+}
 
 /*
  * ZGetMultiLockMembersForCurrentXact - Return the strongest lock mode held by
@@ -62,6 +282,9 @@ ZGetMultiLockMembersForCurrentXact(ZHeapTuple zhtup, int trans_slot,
 
 		uur_type = urec->uur_type;
 
+		/* ZHeapSatisfyUndoRecord turns UNDO_MULTI_DELETE into UNDO_DELETE. */
+		Assert(uur_type != UNDO_MULTI_DELETE);
+
 		if (uur_type == UNDO_INSERT || uur_type == UNDO_MULTI_INSERT)
 		{
 			/*
@@ -172,6 +395,10 @@ ZGetMultiLockMembers(Relation rel, ZHeapTuple zhtup, Buffer buf,
 	int		slot_no;
 	int		total_trans_slots = 0;
 	bool	tpd_e_pruned;
+	List   *slot_members;
+	bool	own_undo_seen;
+	UndoRecPtr	start_urec_ptr;
+	int		start_trans_slot_id;
 
 	if (nobuflock)
 	{
@@ -276,6 +503,16 @@ ZGetMultiLockMembers(Relation rel, ZHeapTuple zhtup, Buffer buf,
 			trans_slot_id += 1;
 		}
 
+		/* See if somebody has already walked this undo chain. */
+		if (ZMultiLockCacheLookup(rel, &zhtup->t_self, trans_slot_id,
+								  urec_ptr, &multilockmembers))
+			continue;
+
+		slot_members = NIL;
+		own_undo_seen = false;
+		start_urec_ptr = urec_ptr;
+		start_trans_slot_id = trans_slot_id;
+
 		do
 		{
 			prev_trans_slot_id = trans_slot_id;
@@ -295,6 +532,7 @@ ZGetMultiLockMembers(Relation rel, ZHeapTuple zhtup, Buffer buf,
 			 */
 			if (TransactionIdEquals(urec->uur_xid, GetTopTransactionIdIfAny()))
 			{
+				own_undo_seen = true;
 				urec_ptr = urec->uur_blkprev;
 				UndoRecordRelease(urec);
 				urec = NULL;
@@ -303,6 +541,9 @@ ZGetMultiLockMembers(Relation rel, ZHeapTuple zhtup, Buffer buf,
 
 			uur_type = urec->uur_type;
 
+			/* See ZGetMultiLockMembersForCurrentXact. */
+			Assert(uur_type != UNDO_MULTI_DELETE);
+
 			if (uur_type == UNDO_INSERT || uur_type == UNDO_MULTI_INSERT)
 			{
 				/*
@@ -323,7 +564,7 @@ ZGetMultiLockMembers(Relation rel, ZHeapTuple zhtup, Buffer buf,
 				mlmember->xid = urec->uur_xid;
 				mlmember->trans_slot_id = prev_trans_slot_id;
 				mlmember->mode = *((LockTupleMode *) urec->uur_payload.data);
-				multilockmembers = lappend(multilockmembers, mlmember);
+				slot_members = lappend(slot_members, mlmember);
 			}
 			else if (uur_type == UNDO_UPDATE ||
 					 uur_type == UNDO_INPLACE_UPDATE)
@@ -337,7 +578,7 @@ ZGetMultiLockMembers(Relation rel, ZHeapTuple zhtup, Buffer buf,
 				else
 					mlmember->mode = LockTupleNoKeyExclusive;
 
-				multilockmembers = lappend(multilockmembers, mlmember);
+				slot_members = lappend(slot_members, mlmember);
 			}
 			else if (uur_type == UNDO_DELETE)
 			{
@@ -345,7 +586,7 @@ ZGetMultiLockMembers(Relation rel, ZHeapTuple zhtup, Buffer buf,
 				mlmember->xid = urec->uur_xid;
 				mlmember->trans_slot_id = prev_trans_slot_id;
 				mlmember->mode = LockTupleExclusive;
-				multilockmembers = lappend(multilockmembers, mlmember);
+				slot_members = lappend(slot_members, mlmember);
 			}
 			else
 			{
@@ -383,6 +624,15 @@ ZGetMultiLockMembers(Relation rel, ZHeapTuple zhtup, Buffer buf,
 
 		if (undo_tup && undo_tup != zhtup)
 			pfree(undo_tup);
+
+		/*
+		 * The lockers found depend on who is asking if we skipped our own
+		 * undo records, so don't share them in that case.
+		 */
+		if (!own_undo_seen)
+			ZMultiLockCacheInsert(rel, &zhtup->t_self, start_trans_slot_id,
+								  start_urec_ptr, slot_members);
+		multilockmembers = list_concat(multilockmembers, slot_members);
 	}
 
 	/* be tidy */
@@ -428,7 +678,7 @@ ZMultiLockMembersWait(Relation rel, List *mlmembers, ZHeapTuple zhtup,
 		if (!DoLockModesConflict(HWLOCKMODE_from_locktupmode(memmode),
 								 HWLOCKMODE_from_locktupmode(required_mode)))
 		{
-			if (remaining && TransactionIdIsInProgress(memxid))
+			if (remaining && ZTransactionIdIsInProgress(memxid))
 				remain++;
 			continue;
 		}
@@ -450,7 +700,7 @@ ZMultiLockMembersWait(Relation rel, List *mlmembers, ZHeapTuple zhtup,
 		 * For aborted transaction, if the undo actions are not applied yet,
 		 * then apply them before modifying the page.
 		 */
-		if (TransactionIdDidAbort(memxid))
+		if (ZTransactionIdDidAbort(memxid))
 		{
 			LockBuffer(buf, BUFFER_LOCK_SHARE);
 			zheap_exec_pending_rollback(rel, buf, mlmember->trans_slot_id, memxid);
@@ -526,7 +776,7 @@ ZIsAnyMultiLockMemberRunning(List *mlmembers, ZHeapTuple zhtup, Buffer buf)
 		ZMultiLockMember *mlmember = (ZMultiLockMember *) lfirst(lc);
 		TransactionId	memxid = mlmember->xid;
 
-		if (TransactionIdIsInProgress(memxid))
+		if (ZTransactionIdIsInProgress(memxid))
 		{
 			elog(DEBUG2, "ZIsRunning: member %d is running", memxid);
 			return true;
@@ -736,7 +986,7 @@ GetLockerTransInfo(Relation rel, ZHeapTuple zhtup, Buffer buf,
 		 * transactions.
 		 */
 		if (epoch_xid < pg_atomic_read_u64(&ProcGlobal->oldestXidWithEpochHavingUndo) ||
-			(!TransactionIdIsInProgress(xid) && TransactionIdDidCommit(xid)))
+			(!ZTransactionIdIsInProgress(xid) && ZTransactionIdDidCommit(xid)))
 			continue;
 
 		save_urec_ptr = urec_ptr = trans_slots[slot_no].urec_ptr;
@@ -1374,11 +1374,16 @@ heap_create_with_catalog(const char *relname,
 
 	/*
 	 * Initialize the metapage for zheap, except for partitioned relations as
-	 * they do not have any storage
+	 * they do not have any storage, and remember in undo that the storage is
+	 * to be dropped if we abort.
 	 */
 	if (RelationStorageOptIsZHeap(relkind, rdopts) &&
 		relkind != 'p')
+	{
 		ZheapInitMetaPage(new_rel_desc, MAIN_FORKNUM);
+		ZheapInsertRelfilenodeUndo(new_rel_desc, UNDO_RELFILENODE_DROP,
+								   InvalidOid);
+	}
 
 	/*
 	 * Unlogged objects need an init fork, except for partitioned tables which
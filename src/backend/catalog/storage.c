@@ -169,6 +169,28 @@ RelationDropStorage(Relation rel)
 	RelationCloseSmgr(rel);
 }
 
+/*
+ * RelFileNodeDropStorage
+ *		Schedule unlinking of storage at transaction commit, for callers that
+ *		have no relcache entry for it, namely undo actions.
+ *
+ * The storage must not belong to a temporary relation.
+ */
+void
+RelFileNodeDropStorage(RelFileNode rnode)
+{
+	PendingRelDelete *pending;
+
+	pending = (PendingRelDelete *)
+		MemoryContextAlloc(TopMemoryContext, sizeof(PendingRelDelete));
+	pending->relnode = rnode;
+	pending->backend = InvalidBackendId;
+	pending->atCommit = true;	/* delete if commit */
+	pending->nestLevel = GetCurrentTransactionNestLevel();
+	pending->next = pendingDeletes;
+	pendingDeletes = pending;
+}
+
 /*
  * RelationPreserveStorage
  *		Mark a relation as not to be deleted after all.
@@ -539,6 +539,26 @@ CREATE VIEW pg_stat_all_tables AS
     WHERE C.relkind IN ('r', 't', 'm')
     GROUP BY C.oid, N.nspname, C.relname;
 
+CREATE VIEW pg_stat_zheap_tables AS
+    SELECT
+            C.oid AS relid,
+            N.nspname AS schemaname,
+            C.relname AS relname,
+            pg_stat_get_tuples_inplace_updated(C.oid) AS n_tup_inplace_upd,
+            pg_stat_get_tuples_updated(C.oid) AS n_tup_noninplace_upd,
+            pg_stat_get_zheap_trans_slot_waits(C.oid) AS trans_slot_waits,
+            pg_stat_get_zheap_trans_slot_freezes(C.oid) AS trans_slot_freezes,
+            pg_stat_get_zheap_tpd_entries_allocated(C.oid) AS tpd_entries_allocated,
+            pg_stat_get_zheap_tpd_entries_extended(C.oid) AS tpd_entries_extended,
+            pg_stat_get_zheap_undo_bytes(C.oid) AS undo_bytes,
+            pg_stat_get_zheap_undo_records_fetched(C.oid) AS undo_records_fetched,
+            pg_stat_get_zheap_page_prunes(C.oid) AS page_prunes,
+            pg_stat_get_zheap_tuples_pruned(C.oid) AS tuples_pruned
+    FROM pg_class C LEFT JOIN
+         pg_namespace N ON (N.oid = C.relnamespace)
+    WHERE C.relkind IN ('r', 't', 'm') AND
+          'storage_engine=zheap' = ANY (C.reloptions);
+
 CREATE VIEW pg_stat_xact_all_tables AS
     SELECT
             C.oid AS relid,
@@ -943,6 +963,10 @@ CREATE VIEW pg_stat_undo_logs AS
     SELECT *
     FROM pg_stat_get_undo_logs();
 
+CREATE VIEW pg_stat_undo_deferred_discard AS
+    SELECT *
+    FROM pg_stat_get_undo_deferred_discard();
+
 --
 -- We have a few function definitions in here, too.
 -- At some point there might be enough to justify breaking them out into
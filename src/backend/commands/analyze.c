@@ -22,8 +22,10 @@
 #include "access/transam.h"
 #include "access/tupconvert.h"
 #include "access/tuptoaster.h"
+#include "access/undoinsert.h"
 #include "access/visibilitymap.h"
 #include "access/xact.h"
+#include "access/zheap.h"
 #include "access/zheaputils.h"
 #include "catalog/catalog.h"
 #include "catalog/index.h"
@@ -82,6 +84,23 @@ int			default_statistics_target = 100;
 static MemoryContext anl_context = NULL;
 static BufferAccessStrategy vac_strategy;
 
+/*
+ * Undo and TPD statistics of a zheap relation, computed by
+ * acquire_sample_rows; see zheap_sample_undo_stats.
+ */
+typedef struct ZHeapSampleStats
+{
+	double		active_frac;	/* fraction of pages with undo retained */
+	double		undo_depth;		/* avg. # of undo records per tuple on them */
+	double		tpd_frac;		/* fraction of pages with slots in TPD */
+} ZHeapSampleStats;
+
+/*
+ * Don't follow the undo chain of a tuple further than this; a longer chain
+ * is expensive enough to visit that the exact length doesn't matter much.
+ */
+#define ZHEAP_SAMPLE_MAX_UNDO_DEPTH		100
+
 
 static void do_analyze_rel(Relation onerel, int options,
 			   VacuumParams *params, List *va_cols,
@@ -95,7 +114,15 @@ static VacAttrStats *examine_attribute(Relation onerel, int attnum,
 				  Node *index_expr);
 static int acquire_sample_rows(Relation onerel, int elevel,
 					HeapTuple *rows, int targrows,
-					double *totalrows, double *totaldeadrows);
+					double *totalrows, double *totaldeadrows,
+					ZHeapSampleStats *zstats);
+static int acquire_sample_rows_nostats(Relation onerel, int elevel,
+							HeapTuple *rows, int targrows,
+							double *totalrows, double *totaldeadrows);
+static bool zheap_sample_undo_stats(Buffer buffer, BlockNumber blkno,
+						TransactionId oldestXidHavingUndo,
+						int *undo_budget,
+						double *undo_tuples, double *undo_records);
 static int	compare_rows(const void *a, const void *b);
 static int acquire_inherited_sample_rows(Relation onerel, int elevel,
 							  HeapTuple *rows, int targrows,
@@ -251,7 +278,7 @@ analyze_rel(Oid relid, RangeVar *relation, int options,
 		onerel->rd_rel->relkind == RELKIND_MATVIEW)
 	{
 		/* Regular table, so we'll use the regular row acquisition function */
-		acquirefunc = acquire_sample_rows;
+		acquirefunc = acquire_sample_rows_nostats;
 		/* Also get regular table's size */
 		relpages = RelationGetNumberOfBlocks(onerel);
 	}
@@ -363,6 +390,7 @@ do_analyze_rel(Relation onerel, int options, VacuumParams *params,
 	double		totalrows,
 				totaldeadrows;
 	HeapTuple  *rows;
+	ZHeapSampleStats zstats;
 	PGRUsage	ru0;
 	TimestampTz starttime = 0;
 	MemoryContext caller_context;
@@ -550,6 +578,11 @@ do_analyze_rel(Relation onerel, int options, VacuumParams *params,
 		numrows = acquire_inherited_sample_rows(onerel, elevel,
 												rows, targrows,
 												&totalrows, &totaldeadrows);
+	else if (RelationStorageIsZHeap(onerel))
+		numrows = acquire_sample_rows(onerel, elevel,
+									  rows, targrows,
+									  &totalrows, &totaldeadrows,
+									  &zstats);
 	else
 		numrows = (*acquirefunc) (onerel, elevel,
 								  rows, targrows,
@@ -648,6 +681,13 @@ do_analyze_rel(Relation onerel, int options, VacuumParams *params,
 							InvalidTransactionId,
 							InvalidMultiXactId,
 							in_outer_xact);
+
+		/* acquire_sample_rows has also computed these for a zheap table */
+		if (RelationStorageIsZHeap(onerel))
+			zheap_update_meta_stats(onerel,
+									(float4) zstats.active_frac,
+									(float4) zstats.undo_depth,
+									(float4) zstats.tpd_frac);
 	}
 
 	/*
@@ -1015,6 +1055,8 @@ examine_attribute(Relation onerel, int attnum, Node *index_expr)
  * The actual number of rows selected is returned as the function result.
  * We also estimate the total numbers of live and dead rows in the table,
  * and return them into *totalrows and *totaldeadrows, respectively.
+ * For a zheap table, if zstats isn't NULL, the statistics on the cost of
+ * visibility checks are computed from the same pages and returned there.
  *
  * The returned list of tuples is in order by physical position in the table.
  * (We will rely on this later to derive correlation estimates.)
@@ -1043,15 +1085,23 @@ examine_attribute(Relation onerel, int attnum, Node *index_expr)
 static int
 acquire_sample_rows(Relation onerel, int elevel,
 					HeapTuple *rows, int targrows,
-					double *totalrows, double *totaldeadrows)
+					double *totalrows, double *totaldeadrows,
+					ZHeapSampleStats *zstats)
 {
 	int			numrows = 0;	/* # rows now in reservoir */
 	double		samplerows = 0; /* total # rows collected */
 	double		liverows = 0;	/* # live rows seen */
 	double		deadrows = 0;	/* # dead rows seen */
 	double		rowstoskip = -1;	/* -1 means not set yet */
+	double		zheap_pages = 0;	/* # zheap data pages seen */
+	double		active_pages = 0;	/* # of those with undo retained */
+	double		tpd_pages = 0;	/* # of those with slots in TPD */
+	double		undo_tuples = 0;	/* # tuples on those pages */
+	double		undo_records = 0;	/* # undo records retained for them */
+	int			undo_budget = targrows; /* # undo records left to fetch */
 	BlockNumber totalblocks;
 	TransactionId OldestXmin;
+	TransactionId oldestXidHavingUndo = InvalidTransactionId;
 	BlockSamplerData bs;
 	ReservoirStateData rstate;
 
@@ -1062,6 +1112,11 @@ acquire_sample_rows(Relation onerel, int elevel,
 	/* Need a cutoff xmin for HeapTupleSatisfiesVacuum */
 	OldestXmin = GetOldestXmin(onerel, PROCARRAY_FLAGS_VACUUM);
 
+	/* Transactions older than this are all-visible for zheap */
+	if (zstats != NULL)
+		oldestXidHavingUndo = GetXidFromEpochXid(
+						pg_atomic_read_u64(&ProcGlobal->oldestXidWithEpochHavingUndo));
+
 	/* Prepare for sampling block numbers */
 	BlockSampler_Init(&bs, totalblocks, targrows, random());
 	/* Prepare for sampling rows */
@@ -1104,6 +1159,18 @@ acquire_sample_rows(Relation onerel, int elevel,
 			continue;
 		}
 
+		/* Gather the statistics for costing zheap visibility checks. */
+		if (zstats != NULL)
+		{
+			zheap_pages += 1;
+			if (ZHeapPageHasTPDSlot((PageHeader) targpage))
+				tpd_pages += 1;
+			if (zheap_sample_undo_stats(targbuffer, targblock,
+										oldestXidHavingUndo, &undo_budget,
+										&undo_tuples, &undo_records))
+				active_pages += 1;
+		}
+
 		maxoffset = PageGetMaxOffsetNumber(targpage);
 
 		/* Inner loop over all tuples on the selected page */
@@ -1336,6 +1403,19 @@ acquire_sample_rows(Relation onerel, int elevel,
 		*totaldeadrows = 0.0;
 	}
 
+	/*
+	 * The zheap statistics are kept as fractions and averages, so they need
+	 * no extrapolation.
+	 */
+	if (zstats != NULL)
+	{
+		zstats->active_frac = (zheap_pages > 0) ?
+			active_pages / zheap_pages : 0.0;
+		zstats->tpd_frac = (zheap_pages > 0) ? tpd_pages / zheap_pages : 0.0;
+		zstats->undo_depth = (undo_tuples > 0) ?
+			undo_records / undo_tuples : 0.0;
+	}
+
 	/*
 	 * Emit some interesting relation info
 	 */
@@ -1351,6 +1431,126 @@ acquire_sample_rows(Relation onerel, int elevel,
 	return numrows;
 }
 
+/*
+ * acquire_sample_rows_nostats -- acquire_sample_rows as an
+ *		AcquireSampleRowsFunc, for when no zheap statistics are needed
+ */
+static int
+acquire_sample_rows_nostats(Relation onerel, int elevel,
+							HeapTuple *rows, int targrows,
+							double *totalrows, double *totaldeadrows)
+{
+	return acquire_sample_rows(onerel, elevel, rows, targrows,
+							   totalrows, totaldeadrows, NULL);
+}
+
+/*
+ * zheap_sample_undo_stats -- examine the transaction slots of a zheap page
+ *
+ * A visibility check on a zheap tuple may have to fetch the tuple's prior
+ * versions from undo, as long as the transaction that modified it isn't
+ * all-visible, and to look up its transaction slot in the page's TPD entry.
+ * To let the planner cost that, count the undo records still retained for
+ * the tuples on the page.  Returns true if the page has any tuple whose undo
+ * is retained.
+ *
+ * Fetching undo records is expensive, so at most *undo_budget of them are
+ * fetched over all the pages, and the budget is decreased accordingly.  The
+ * number of tuples on the page and of their undo records are added to
+ * *undo_tuples and *undo_records only if the whole page could be examined
+ * within the budget.
+ *
+ * The caller must hold a pin and share lock on the buffer.
+ */
+static bool
+zheap_sample_undo_stats(Buffer buffer, BlockNumber blkno,
+						TransactionId oldestXidHavingUndo,
+						int *undo_budget,
+						double *undo_tuples, double *undo_records)
+{
+	Page		page = BufferGetPage(buffer);
+	OffsetNumber offnum,
+				maxoff;
+	double		page_tuples = 0;
+	double		page_records = 0;
+	bool		active = false;
+	bool		complete = true;
+
+	maxoff = PageGetMaxOffsetNumber(page);
+	for (offnum = FirstOffsetNumber; offnum <= maxoff; offnum++)
+	{
+		ItemId		itemid = PageGetItemId(page, offnum);
+		ZHeapTupleHeader tuphdr;
+		int			trans_slot;
+		TransactionId xid;
+		UndoRecPtr	urec_ptr;
+		int			depth = 0;
+
+		if (!ItemIdIsNormal(itemid))
+			continue;
+
+		page_tuples += 1;
+		tuphdr = (ZHeapTupleHeader) PageGetItem(page, itemid);
+		trans_slot = ZHeapTupleHeaderGetXactSlot(tuphdr);
+		if (trans_slot == ZHTUP_SLOT_FROZEN ||
+			ZHeapTupleHasInvalidXact(tuphdr->t_infomask))
+			continue;
+
+		(void) GetTransactionSlotInfo(buffer, offnum, trans_slot, NULL, &xid,
+									  &urec_ptr, true, false);
+		if (!TransactionIdIsValid(xid) ||
+			TransactionIdPrecedes(xid, oldestXidHavingUndo))
+			continue;
+
+		active = true;
+
+		/* Out of budget, we only need to know that the page is active. */
+		if (*undo_budget <= 0)
+		{
+			complete = false;
+			break;
+		}
+
+		/* Walk the undo chain of the tuple until it becomes all-visible. */
+		while (UndoRecPtrIsValid(urec_ptr) &&
+			   depth < ZHEAP_SAMPLE_MAX_UNDO_DEPTH)
+		{
+			UnpackedUndoRecord *urec;
+
+			if (*undo_budget <= 0)
+			{
+				complete = false;
+				break;
+			}
+			(*undo_budget)--;
+
+			urec = UndoFetchRecord(urec_ptr, blkno, offnum,
+								   InvalidTransactionId, NULL,
+								   ZHeapSatisfyUndoRecord);
+			if (urec == NULL)
+				break;
+			if (TransactionIdPrecedes(urec->uur_xid, oldestXidHavingUndo))
+			{
+				UndoRecordRelease(urec);
+				break;
+			}
+			depth++;
+			urec_ptr = urec->uur_blkprev;
+			UndoRecordRelease(urec);
+		}
+
+		page_records += depth;
+	}
+
+	if (active && complete)
+	{
+		*undo_tuples += page_tuples;
+		*undo_records += page_records;
+	}
+
+	return active;
+}
+
 /*
  * qsort comparator for sorting rows[] array
  */
@@ -1461,7 +1661,7 @@ acquire_inherited_sample_rows(Relation onerel, int elevel,
 			childrel->rd_rel->relkind == RELKIND_MATVIEW)
 		{
 			/* Regular table, so use the regular row acquisition function */
-			acquirefunc = acquire_sample_rows;
+			acquirefunc = acquire_sample_rows_nostats;
 			relpages = RelationGetNumberOfBlocks(childrel);
 		}
 		else if (childrel->rd_rel->relkind == RELKIND_FOREIGN_TABLE)
@@ -21,10 +21,14 @@
 #include "access/multixact.h"
 #include "access/relscan.h"
 #include "access/rewriteheap.h"
+#include "access/rewritezheap.h"
 #include "access/transam.h"
 #include "access/tuptoaster.h"
+#include "access/undodiscard.h"
 #include "access/xact.h"
 #include "access/xlog.h"
+#include "access/zheap.h"
+#include "access/zheaputils.h"
 #include "catalog/pg_am.h"
 #include "catalog/catalog.h"
 #include "catalog/dependency.h"
@@ -41,6 +45,8 @@
 #include "storage/bufmgr.h"
 #include "storage/lmgr.h"
 #include "storage/predicate.h"
+#include "storage/proc.h"
+#include "storage/procarray.h"
 #include "storage/smgr.h"
 #include "utils/acl.h"
 #include "utils/fmgroids.h"
@@ -71,11 +77,18 @@ static void rebuild_relation(Relation OldHeap, Oid indexOid, bool verbose);
 static void copy_heap_data(Oid OIDNewHeap, Oid OIDOldHeap, Oid OIDOldIndex,
 			   bool verbose, bool *pSwapToastByContent,
 			   TransactionId *pFreezeXid, MultiXactId *pCutoffMulti);
+static void check_zheap_rewrite(Relation OldHeap);
+static void copy_zheap_data(Oid OIDNewHeap, Oid OIDOldHeap, Oid OIDOldIndex,
+				bool verbose);
 static List *get_tables_to_cluster(MemoryContext cluster_context);
 static void reform_and_rewrite_tuple(HeapTuple tuple,
 						 TupleDesc oldTupDesc, TupleDesc newTupDesc,
 						 Datum *values, bool *isnull,
 						 bool newRelHasOids, RewriteState rwstate);
+static void reform_and_rewrite_ztuple(ZHeapTuple tuple,
+						  TupleDesc oldTupDesc, TupleDesc newTupDesc,
+						  Datum *values, bool *isnull,
+						  bool newRelHasOids, ZRewriteState rwstate);
 
 
 /*---------------------------------------------------------------------------
@@ -128,16 +141,6 @@ cluster(ClusterStmt *stmt, bool isTopLevel)
 					(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
 					 errmsg("cannot cluster temporary tables of other sessions")));
 
-		/*
-		 * FIXME: We need to write a mechanism to support clustering of zheap
-		 * tables. Currently, we just throw an error message if clustering is
-		 * performed on zheap tables.
-		 */
-		if (RelationStorageIsZHeap(rel))
-			ereport(ERROR,
-					(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
-					 errmsg("cannot cluster a zheap table")));
-
 		/*
 		 * Reject clustering a partitioned table.
 		 */
@@ -586,6 +589,7 @@ rebuild_relation(Relation OldHeap, Oid indexOid, bool verbose)
 	Oid			OIDNewHeap;
 	char		relpersistence;
 	bool		is_system_catalog;
+	bool		is_zheap;
 	bool		swap_toast_by_content;
 	TransactionId frozenXid;
 	MultiXactId cutoffMulti;
@@ -597,6 +601,10 @@ rebuild_relation(Relation OldHeap, Oid indexOid, bool verbose)
 	/* Remember info about rel before closing OldHeap */
 	relpersistence = OldHeap->rd_rel->relpersistence;
 	is_system_catalog = IsSystemRelation(OldHeap);
+	is_zheap = RelationStorageIsZHeap(OldHeap);
+
+	if (is_zheap)
+		check_zheap_rewrite(OldHeap);
 
 	/* Close relcache entry, but keep lock until transaction commit */
 	heap_close(OldHeap, NoLock);
@@ -607,8 +615,25 @@ rebuild_relation(Relation OldHeap, Oid indexOid, bool verbose)
 							   AccessExclusiveLock);
 
 	/* Copy the heap data into the new table in the desired order */
-	copy_heap_data(OIDNewHeap, tableOid, indexOid, verbose,
-				   &swap_toast_by_content, &frozenXid, &cutoffMulti);
+	if (is_zheap)
+	{
+		/*
+		 * zheap tuples are never frozen, so there is no relfrozenxid or
+		 * relminmxid to set.  The toast table is rewritten along with the
+		 * main table, so swap it by links.
+		 */
+		copy_zheap_data(OIDNewHeap, tableOid, indexOid, verbose);
+		swap_toast_by_content = false;
+		frozenXid = InvalidTransactionId;
+		cutoffMulti = InvalidMultiXactId;
+	}
+	else
+	{
+		copy_heap_data(OIDNewHeap, tableOid, indexOid, verbose,
+					   &swap_toast_by_content, &frozenXid, &cutoffMulti);
+		Assert(TransactionIdIsNormal(frozenXid));
+		Assert(MultiXactIdIsValid(cutoffMulti));
+	}
 
 	/*
 	 * Swap the physical files of the target and transient tables, then
@@ -1159,6 +1184,311 @@ copy_heap_data(Oid OIDNewHeap, Oid OIDOldHeap, Oid OIDOldIndex, bool verbose,
 	CommandCounterIncrement();
 }
 
+/*
+ * Check that a zheap table can be rewritten.
+ *
+ * copy_zheap_data writes the rows without undo, so that they are visible to
+ * every snapshot, and the prior versions of the rows can't be reached from
+ * the new relation anymore.  That's only correct if no snapshot could still
+ * need those prior versions, so refuse if another backend has a snapshot
+ * that doesn't see every transaction that has finished, which covers all
+ * the ones that modified the table as we have it locked.  Likewise refuse
+ * if undo is being kept for flashback queries beyond what the running
+ * transactions need.  Autovacuum is ignored: it can't be processing this
+ * table, and its snapshots don't outlive the table it processes.
+ */
+static void
+check_zheap_rewrite(Relation OldHeap)
+{
+	Snapshot	snapshot = GetLatestSnapshot();
+	TransactionId limitXmin = snapshot->xmax;
+	VirtualTransactionId *old_snapshots;
+	int			n_old_snapshots;
+
+	TransactionIdRetreat(limitXmin);
+	old_snapshots = GetCurrentVirtualXIDs(limitXmin, true, false,
+										  PROC_IS_AUTOVACUUM | PROC_IN_VACUUM,
+										  &n_old_snapshots);
+	pfree(old_snapshots);
+	if (n_old_snapshots > 0)
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				 errmsg("cannot rewrite zheap table \"%s\" while older snapshots are in use",
+						RelationGetRelationName(OldHeap)),
+				 errdetail("The rewritten rows would be visible to transactions that should see their prior versions."),
+				 errhint("Retry once the concurrent transactions have finished.")));
+
+	if (TransactionIdPrecedes(UndoRetentionGetDiscardHorizon(snapshot->xmin),
+							  snapshot->xmin))
+		ereport(ERROR,
+				(errcode(ERRCODE_OBJECT_NOT_IN_PREREQUISITE_STATE),
+				 errmsg("cannot rewrite zheap table \"%s\" while undo is retained for flashback queries",
+						RelationGetRelationName(OldHeap)),
+				 errhint("Set undo_retention to zero to allow the rewrite.")));
+}
+
+/*
+ * Do the physical copying of zheap data.
+ *
+ * zheap keeps only the latest version of each row in the table, the older
+ * ones being in undo, so unlike copy_heap_data there are no recently-dead
+ * tuples or update chains to carry over: we copy just the rows visible to a
+ * fresh snapshot, and the rewrite module writes them frozen, without undo.
+ * check_zheap_rewrite has made sure that no snapshot needs anything else.
+ */
+static void
+copy_zheap_data(Oid OIDNewHeap, Oid OIDOldHeap, Oid OIDOldIndex,
+				bool verbose)
+{
+	Relation	NewHeap,
+				OldHeap,
+				OldIndex;
+	Relation	relRelation;
+	HeapTuple	reltup;
+	Form_pg_class relform;
+	TupleDesc	oldTupDesc;
+	TupleDesc	newTupDesc;
+	int			natts;
+	Datum	   *values;
+	bool	   *isnull;
+	IndexScanDesc indexScan;
+	HeapScanDesc heapScan;
+	Snapshot	snapshot;
+	bool		use_wal;
+	ZRewriteState rwstate;
+	bool		use_sort;
+	Tuplesortstate *tuplesort;
+	double		num_tuples = 0;
+	BlockNumber num_pages;
+	int			elevel = verbose ? INFO : DEBUG2;
+	PGRUsage	ru0;
+
+	pg_rusage_init(&ru0);
+
+	/*
+	 * Open the relations we need.
+	 */
+	NewHeap = heap_open(OIDNewHeap, AccessExclusiveLock);
+	OldHeap = heap_open(OIDOldHeap, AccessExclusiveLock);
+	if (OidIsValid(OIDOldIndex))
+		OldIndex = index_open(OIDOldIndex, AccessExclusiveLock);
+	else
+		OldIndex = NULL;
+
+	Assert(RelationStorageIsZHeap(NewHeap));
+
+	oldTupDesc = RelationGetDescr(OldHeap);
+	newTupDesc = RelationGetDescr(NewHeap);
+	Assert(newTupDesc->natts == oldTupDesc->natts);
+
+	/* Preallocate values/isnull arrays */
+	natts = newTupDesc->natts;
+	values = (Datum *) palloc(natts * sizeof(Datum));
+	isnull = (bool *) palloc(natts * sizeof(bool));
+
+	/* Lock the toast table too, as in copy_heap_data. */
+	if (OldHeap->rd_rel->reltoastrelid)
+		LockRelationOid(OldHeap->rd_rel->reltoastrelid, AccessExclusiveLock);
+
+	/*
+	 * We need to log the copied data in WAL iff WAL archiving/streaming is
+	 * enabled AND it's a WAL-logged rel.
+	 */
+	use_wal = XLogIsNeeded() && RelationNeedsWAL(NewHeap);
+
+	/* use_wal off requires smgr_targblock be initially invalid */
+	Assert(RelationGetTargetBlock(NewHeap) == InvalidBlockNumber);
+
+	/*
+	 * The new table has its own toast table, if it needs one at all, and the
+	 * toast links are swapped along with the main table.  Values toasted in
+	 * the old toast table are fetched and stored anew into the new one by
+	 * the insertion.
+	 */
+	Assert(!OidIsValid(NewHeap->rd_toastoid));
+
+	/* Initialize the rewrite operation */
+	rwstate = begin_zheap_rewrite(NewHeap, use_wal);
+
+	/* Same choice of scan as in copy_heap_data. */
+	if (OldIndex != NULL && OldIndex->rd_rel->relam == BTREE_AM_OID)
+		use_sort = plan_cluster_use_sort(OIDOldHeap, OIDOldIndex);
+	else
+		use_sort = false;
+
+	/* Set up sorting if wanted */
+	if (use_sort)
+		tuplesort = tuplesort_begin_cluster(oldTupDesc, OldIndex,
+											maintenance_work_mem,
+											NULL, false);
+	else
+		tuplesort = NULL;
+
+	/*
+	 * Prepare to scan the OldHeap.  We hold AccessExclusiveLock, so nobody
+	 * else can modify the table anymore, and a fresh snapshot sees every row
+	 * that will ever be visible again, including the ones inserted or
+	 * updated earlier in our own transaction.
+	 */
+	snapshot = RegisterSnapshot(GetLatestSnapshot());
+	if (OldIndex != NULL && !use_sort)
+	{
+		heapScan = NULL;
+		indexScan = index_beginscan(OldHeap, OldIndex, snapshot, 0, 0);
+		index_rescan(indexScan, NULL, 0, NULL, 0);
+	}
+	else
+	{
+		heapScan = zheap_beginscan(OldHeap, snapshot, 0, (ScanKey) NULL);
+		indexScan = NULL;
+	}
+
+	/* Log what we're doing */
+	if (indexScan != NULL)
+		ereport(elevel,
+				(errmsg("clustering \"%s.%s\" using index scan on \"%s\"",
+						get_namespace_name(RelationGetNamespace(OldHeap)),
+						RelationGetRelationName(OldHeap),
+						RelationGetRelationName(OldIndex))));
+	else if (tuplesort != NULL)
+		ereport(elevel,
+				(errmsg("clustering \"%s.%s\" using sequential scan and sort",
+						get_namespace_name(RelationGetNamespace(OldHeap)),
+						RelationGetRelationName(OldHeap))));
+	else
+		ereport(elevel,
+				(errmsg("vacuuming \"%s.%s\"",
+						get_namespace_name(RelationGetNamespace(OldHeap)),
+						RelationGetRelationName(OldHeap))));
+
+	/*
+	 * Scan through the OldHeap, either in OldIndex order or sequentially;
+	 * copy each visible tuple into the NewHeap, or transiently to the
+	 * tuplesort module.
+	 */
+	for (;;)
+	{
+		ZHeapTuple	tuple;
+
+		CHECK_FOR_INTERRUPTS();
+
+		if (indexScan != NULL)
+		{
+			tuple = index_getnext_ztuple(indexScan, ForwardScanDirection);
+			if (tuple == NULL)
+				break;
+
+			/* Since we used no scan keys, should never need to recheck */
+			if (indexScan->xs_recheck)
+				elog(ERROR, "CLUSTER does not support lossy index conditions");
+		}
+		else
+		{
+			tuple = zheap_getnext(heapScan, ForwardScanDirection);
+			if (tuple == NULL)
+				break;
+		}
+
+		num_tuples += 1;
+		if (tuplesort != NULL)
+		{
+			HeapTuple	htup = zheap_to_heap(tuple, oldTupDesc);
+
+			tuplesort_putheaptuple(tuplesort, htup);
+			heap_freetuple(htup);
+		}
+		else
+			reform_and_rewrite_ztuple(tuple,
+									  oldTupDesc, newTupDesc,
+									  values, isnull,
+									  NewHeap->rd_rel->relhasoids, rwstate);
+
+		/* Tuples fetched through the index belong to us. */
+		if (indexScan != NULL)
+			zheap_freetuple(tuple);
+	}
+
+	if (indexScan != NULL)
+		index_endscan(indexScan);
+	if (heapScan != NULL)
+		heap_endscan(heapScan);
+
+	/*
+	 * In scan-and-sort mode, complete the sort, then read out all tuples
+	 * from the tuplestore and write them to the new relation.
+	 */
+	if (tuplesort != NULL)
+	{
+		tuplesort_performsort(tuplesort);
+
+		for (;;)
+		{
+			HeapTuple	htup;
+			ZHeapTuple	tuple;
+
+			CHECK_FOR_INTERRUPTS();
+
+			htup = tuplesort_getheaptuple(tuplesort, true);
+			if (htup == NULL)
+				break;
+
+			tuple = heap_to_zheap(htup, oldTupDesc);
+			reform_and_rewrite_ztuple(tuple,
+									  oldTupDesc, newTupDesc,
+									  values, isnull,
+									  NewHeap->rd_rel->relhasoids, rwstate);
+			zheap_freetuple(tuple);
+		}
+
+		tuplesort_end(tuplesort);
+	}
+
+	UnregisterSnapshot(snapshot);
+
+	/* Write out any remaining tuples, and fsync if needed */
+	end_zheap_rewrite(rwstate);
+
+	num_pages = RelationGetNumberOfBlocks(NewHeap);
+
+	/* Log what we did */
+	ereport(elevel,
+			(errmsg("\"%s\": found %.0f removable, %.0f nonremovable row versions in %u pages",
+					RelationGetRelationName(OldHeap),
+					0.0, num_tuples,
+					RelationGetNumberOfBlocks(OldHeap)),
+			 errdetail("%s.",
+					   pg_rusage_show(&ru0))));
+
+	/* Clean up */
+	pfree(values);
+	pfree(isnull);
+
+	if (OldIndex != NULL)
+		index_close(OldIndex, NoLock);
+	heap_close(OldHeap, NoLock);
+	heap_close(NewHeap, NoLock);
+
+	/* Update pg_class to reflect the correct values of pages and tuples. */
+	relRelation = heap_open(RelationRelationId, RowExclusiveLock);
+
+	reltup = SearchSysCacheCopy1(RELOID, ObjectIdGetDatum(OIDNewHeap));
+	if (!HeapTupleIsValid(reltup))
+		elog(ERROR, "cache lookup failed for relation %u", OIDNewHeap);
+	relform = (Form_pg_class) GETSTRUCT(reltup);
+
+	relform->relpages = num_pages;
+	relform->reltuples = num_tuples;
+
+	CatalogTupleUpdate(relRelation, &reltup->t_self, reltup);
+
+	/* Clean up. */
+	heap_freetuple(reltup);
+	heap_close(relRelation, RowExclusiveLock);
+
+	/* Make the update visible */
+	CommandCounterIncrement();
+}
+
 /*
  * Swap the physical files of two given relations.
  *
@@ -1306,12 +1636,17 @@ swap_relation_files(Oid r1, Oid r2, bool target_is_pg_class,
 	 * and then fail to commit the pg_class update.
 	 */
 
-	/* set rel1's frozen Xid and minimum MultiXid */
+	/*
+	 * set rel1's frozen Xid and minimum MultiXid; these are invalid for
+	 * zheap, whose tuples never need freezing
+	 */
 	if (relform1->relkind != RELKIND_INDEX)
 	{
-		Assert(TransactionIdIsNormal(frozenXid));
+		Assert(TransactionIdIsNormal(frozenXid) ||
+			   !TransactionIdIsValid(frozenXid));
 		relform1->relfrozenxid = frozenXid;
-		Assert(MultiXactIdIsValid(cutoffMulti));
+		Assert(MultiXactIdIsValid(cutoffMulti) ||
+			   !TransactionIdIsValid(frozenXid));
 		relform1->relminmxid = cutoffMulti;
 	}
 
@@ -1798,3 +2133,37 @@ reform_and_rewrite_tuple(HeapTuple tuple,
 
 	heap_freetuple(copiedTuple);
 }
+
+/*
+ * Reconstruct a zheap tuple for the new table, for the same reasons as
+ * reform_and_rewrite_tuple, and pass it to the zheap rewrite module.
+ */
+static void
+reform_and_rewrite_ztuple(ZHeapTuple tuple,
+						  TupleDesc oldTupDesc, TupleDesc newTupDesc,
+						  Datum *values, bool *isnull,
+						  bool newRelHasOids, ZRewriteState rwstate)
+{
+	ZHeapTuple	copiedTuple;
+	int			i;
+
+	zheap_deform_tuple(tuple, oldTupDesc, values, isnull);
+
+	/* Be sure to null out any dropped columns */
+	for (i = 0; i < newTupDesc->natts; i++)
+	{
+		if (TupleDescAttr(newTupDesc, i)->attisdropped)
+			isnull[i] = true;
+	}
+
+	copiedTuple = zheap_form_tuple(newTupDesc, values, isnull);
+
+	/* Preserve OID, if any */
+	if (newRelHasOids)
+		ZHeapTupleSetOid(copiedTuple, ZHeapTupleGetOid(tuple));
+
+	/* The zheap rewrite module does the rest */
+	rewrite_zheap_tuple(rwstate, copiedTuple);
+
+	zheap_freetuple(copiedTuple);
+}
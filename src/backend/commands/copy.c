@@ -2424,11 +2424,7 @@ CopyFrom(CopyState cstate)
 		cstate->rel->rd_newRelfilenodeSubid != InvalidSubTransactionId)
 	{
 		hi_options |= HEAP_INSERT_SKIP_FSM;
-		/*
-		 * In zheap, we don't support the optimization for HEAP_INSERT_SKIP_WAL.
-		 * See zheap_prepare_insert for details.
-		 */
-		if (!RelationStorageIsZHeap(cstate->rel) && !XLogIsNeeded())
+		if (!XLogIsNeeded())
 			hi_options |= HEAP_INSERT_SKIP_WAL;
 	}
 
@@ -2468,6 +2464,19 @@ CopyFrom(CopyState cstate)
 		hi_options |= HEAP_INSERT_FROZEN;
 	}
 
+	/*
+	 * In zheap, skipping WAL is supported only when we skip undo as well,
+	 * which only FREEZE does.  Frozen rows need no undo, because if the
+	 * subtransaction aborts the relfilenode they are in goes away.  We don't
+	 * freeze on our own for zheap even though that would make the load
+	 * cheaper: like for heap, it would make the rows visible to snapshots
+	 * that other sessions took before we commit.  See zheap_prepare_insert
+	 * for details.
+	 */
+	if (RelationStorageIsZHeap(cstate->rel) &&
+		!(hi_options & HEAP_INSERT_FROZEN))
+		hi_options &= ~HEAP_INSERT_SKIP_WAL;
+
 	/*
 	 * We need a ResultRelInfo so we can use the regular executor's
 	 * index-entry-making machinery.  (There used to be a huge amount of code
@@ -581,8 +581,10 @@ intorel_startup(DestReceiver *self, int operation, TupleDesc typeinfo)
 	/*
 	 * We can skip WAL-logging the insertions, unless PITR or streaming
 	 * replication is in use. We can skip the FSM in any case.
-	 * In zheap, we don't support the optimization for HEAP_INSERT_SKIP_WAL.
-	 * See zheap_prepare_insert for details.
+	 * In zheap, skipping WAL requires inserting the tuples frozen, without
+	 * undo, and we don't do that here: frozen rows would be visible to
+	 * snapshots that other sessions took before we commit, which heap
+	 * allows only for an explicit COPY FREEZE.  See zheap_prepare_insert.
 	 */
 	myState->hi_options = HEAP_INSERT_SKIP_FSM |
 		(RelationStorageIsZHeap(myState->rel) || XLogIsNeeded() ? 0
@@ -1670,68 +1670,8 @@ ExecuteTruncateGuts(List *explicit_rels, List *relids, List *relids_logged,
 		}
 		else
 		{
-			Oid			heap_relid;
-			Oid			toast_relid;
-			MultiXactId minmulti;
-
-			/*
-			 * This effectively deletes all rows in the table, and may be done
-			 * in a serializable transaction.  In that case we must record a
-			 * rw-conflict in to this transaction from each transaction
-			 * holding a predicate lock on the table.
-			 */
-			CheckTableForSerializableConflictIn(rel);
-
-			minmulti = GetOldestMultiXactId();
-
-			/*
-			 * Need the full transaction-safe pushups.
-			 *
-			 * Create a new empty storage file for the relation, and assign it
-			 * as the relfilenode value. The old storage file is scheduled for
-			 * deletion at commit.
-			 */
-			if (RelationStorageIsZHeap(rel))
-				RelationSetNewRelfilenode(rel, rel->rd_rel->relpersistence,
-										  InvalidTransactionId, InvalidMultiXactId);
-			else
-				RelationSetNewRelfilenode(rel, rel->rd_rel->relpersistence,
-										  RecentXmin, minmulti);
-			if (rel->rd_rel->relpersistence == RELPERSISTENCE_UNLOGGED)
-			{
-				heap_create_init_fork(rel);
-				if (RelationStorageIsZHeap(rel))
-					ZheapInitMetaPage(rel, INIT_FORKNUM);
-			}
-
-			heap_relid = RelationGetRelid(rel);
-			toast_relid = rel->rd_rel->reltoastrelid;
-
-			/*
-			 * The same for the toast table, if any.
-			 */
-			if (OidIsValid(toast_relid))
-			{
-				rel = relation_open(toast_relid, AccessExclusiveLock);
-				if (RelationStorageIsZHeap(rel))
-					RelationSetNewRelfilenode(rel, rel->rd_rel->relpersistence,
-											  InvalidTransactionId, InvalidMultiXactId);
-				else
-					RelationSetNewRelfilenode(rel, rel->rd_rel->relpersistence,
-											  RecentXmin, minmulti);
-				if (rel->rd_rel->relpersistence == RELPERSISTENCE_UNLOGGED)
-				{
-					heap_create_init_fork(rel);
-					if (RelationStorageIsZHeap(rel))
-						ZheapInitMetaPage(rel, INIT_FORKNUM);
-				}
-				heap_close(rel, NoLock);
-			}
-
-			/*
-			 * Reconstruct the indexes to match, and we're done.
-			 */
-			reindex_relation(heap_relid, REINDEX_REL_PROCESS_TOAST, 0);
+			/* Need the full transaction-safe pushups. */
+			TruncateRelationStorage(rel);
 		}
 
 		pgstat_count_truncate(rel);
@@ -1813,6 +1753,81 @@ ExecuteTruncateGuts(List *explicit_rels, List *relids, List *relids_logged,
 	}
 }
 
+/*
+ * TruncateRelationStorage
+ *		Give a relation, its toast table and its indexes new, empty storage.
+ *
+ * This is the transaction-safe way of removing all the rows of a table: the
+ * old storage files are only deleted at commit, and a rollback brings them
+ * back.  The caller must hold AccessExclusiveLock on the relation.
+ */
+void
+TruncateRelationStorage(Relation rel)
+{
+	Oid			heap_relid;
+	Oid			toast_relid;
+	MultiXactId minmulti;
+
+	/*
+	 * This effectively deletes all rows in the table, and may be done in a
+	 * serializable transaction.  In that case we must record a rw-conflict in
+	 * to this transaction from each transaction holding a predicate lock on
+	 * the table.
+	 */
+	CheckTableForSerializableConflictIn(rel);
+
+	minmulti = GetOldestMultiXactId();
+
+	/*
+	 * Create a new empty storage file for the relation, and assign it as the
+	 * relfilenode value. The old storage file is scheduled for deletion at
+	 * commit.
+	 */
+	if (RelationStorageIsZHeap(rel))
+		RelationSetNewRelfilenode(rel, rel->rd_rel->relpersistence,
+								  InvalidTransactionId, InvalidMultiXactId);
+	else
+		RelationSetNewRelfilenode(rel, rel->rd_rel->relpersistence,
+								  RecentXmin, minmulti);
+	if (rel->rd_rel->relpersistence == RELPERSISTENCE_UNLOGGED)
+	{
+		heap_create_init_fork(rel);
+		if (RelationStorageIsZHeap(rel))
+			ZheapInitMetaPage(rel, INIT_FORKNUM);
+	}
+
+	heap_relid = RelationGetRelid(rel);
+	toast_relid = rel->rd_rel->reltoastrelid;
+
+	/*
+	 * The same for the toast table, if any.
+	 */
+	if (OidIsValid(toast_relid))
+	{
+		Relation	toastrel;
+
+		toastrel = relation_open(toast_relid, AccessExclusiveLock);
+		if (RelationStorageIsZHeap(toastrel))
+			RelationSetNewRelfilenode(toastrel, toastrel->rd_rel->relpersistence,
+									  InvalidTransactionId, InvalidMultiXactId);
+		else
+			RelationSetNewRelfilenode(toastrel, toastrel->rd_rel->relpersistence,
+									  RecentXmin, minmulti);
+		if (toastrel->rd_rel->relpersistence == RELPERSISTENCE_UNLOGGED)
+		{
+			heap_create_init_fork(toastrel);
+			if (RelationStorageIsZHeap(toastrel))
+				ZheapInitMetaPage(toastrel, INIT_FORKNUM);
+		}
+		heap_close(toastrel, NoLock);
+	}
+
+	/*
+	 * Reconstruct the indexes to match, and we're done.
+	 */
+	reindex_relation(heap_relid, REINDEX_REL_PROCESS_TOAST, 0);
+}
+
 /*
  * Check that a given rel is safe to truncate.  Subroutine for ExecuteTruncate
  */
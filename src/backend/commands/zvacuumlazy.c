@@ -33,6 +33,7 @@
 #include "access/tpd.h"
 #include "access/visibilitymap.h"
 #include "access/xact.h"
+#include "access/zheap.h"
 #include "access/zhtup.h"
 #include "access/zheapam_xlog.h"
 #include "access/zheaputils.h"
@@ -234,6 +235,7 @@ reacquire_slot:
 	{
 		LockBuffer(buffer, BUFFER_LOCK_UNLOCK);
 
+		pgstat_count_zheap_trans_slot_wait(onerel);
 		pgstat_report_wait_start(PG_WAIT_PAGE_TRANS_SLOT);
 		pg_usleep(10000L);	/* 10 ms */
 		pgstat_report_wait_end();
@@ -268,6 +270,7 @@ reacquire_slot:
 								UndoPersistenceForRelation(onerel),
 								InvalidTransactionId,
 								&undometa);
+	pgstat_count_zheap_undo_bytes(onerel, UndoRecordExpectedSize(&undorecord));
 
 	START_CRIT_SECTION();
 
@@ -1102,7 +1105,8 @@ lazy_vacuum_zheap_rel(Relation onerel, int options, VacuumParams *params,
 	 * like other backends operating on zheap, lazy vacuum also reserves a
 	 * transaction slot in the page for pruning purpose.
 	 */
-	OldestXmin = GetOldestXmin(onerel, PROCARRAY_FLAGS_DEFAULT);
+	OldestXmin = ZHeapGetPruneHorizon(GetOldestXmin(onerel,
+													 PROCARRAY_FLAGS_DEFAULT));
 
 	Assert(TransactionIdIsNormal(OldestXmin));
 
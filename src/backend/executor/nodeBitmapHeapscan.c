@@ -760,6 +760,11 @@ bitgetzpage(HeapScanDesc scan, TBMIterateResult *tbmres)
 
 	ntup = 0;
 
+	/*
+	 * Free up the transaction slots of all-visible transactions, if possible.
+	 */
+	zheap_page_freeze_slots_opt(scan->rs_rd, buffer);
+
 	/*
 	 * We must hold share lock on the buffer content while examining tuple
 	 * visibility.  Afterwards, however, the tuples we have found to be
@@ -812,6 +817,10 @@ bitgetzpage(HeapScanDesc scan, TBMIterateResult *tbmres)
 		 */
 		OffsetNumber maxoff = PageGetMaxOffsetNumber(dp);
 		OffsetNumber offnum;
+		ZHeapPageVisibility vis;
+
+		/* Resolve the visibility of each transaction slot only once. */
+		ZHeapPageInitVisibility(&vis, buffer, snapshot);
 
 		for (offnum = FirstOffsetNumber; offnum <= maxoff; offnum = OffsetNumberNext(offnum))
 		{
@@ -842,7 +851,7 @@ bitgetzpage(HeapScanDesc scan, TBMIterateResult *tbmres)
 			 */
 			memcpy(loctup->t_data, ((ZHeapTupleHeader) PageGetItem((Page) dp, lpp)), loctup->t_len);
 
-			resulttup = ZHeapTupleSatisfiesVisibility(loctup, snapshot, buffer, NULL);
+			resulttup = ZHeapTupleSatisfiesMVCCPage(loctup, &vis);
 			valid = resulttup ? true : false;
 
 			/*
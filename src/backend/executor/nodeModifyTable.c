@@ -42,6 +42,8 @@
 #include "access/zheap.h"
 #include "access/zheaputils.h"
 #include "access/zhtup.h"
+#include "catalog/catalog.h"
+#include "commands/tablecmds.h"
 #include "commands/trigger.h"
 #include "executor/execPartition.h"
 #include "executor/executor.h"
@@ -49,11 +51,14 @@
 #include "foreign/fdwapi.h"
 #include "miscadmin.h"
 #include "nodes/nodeFuncs.h"
+#include "pgstat.h"
 #include "storage/bufmgr.h"
 #include "storage/lmgr.h"
+#include "tcop/pquery.h"
 #include "utils/builtins.h"
 #include "utils/memutils.h"
 #include "utils/rel.h"
+#include "utils/snapmgr.h"
 #include "utils/tqual.h"
 
 
@@ -1118,6 +1123,184 @@ ldelete:;
 	return NULL;
 }
 
+/*
+ * ExecZHeapCanBatchDelete
+ *
+ * Can the rows of the current subplan be deleted with zheap_multi_delete?
+ * That skips everything ExecDelete does apart from zheap_delete itself, so
+ * it's only allowed when there is nothing else to do for each row: no row
+ * triggers (that includes the foreign key checks on tables referencing
+ * this one), transition tables, RETURNING or row marks to lock.
+ */
+static bool
+ExecZHeapCanBatchDelete(ModifyTableState *mtstate, EState *estate)
+{
+	ResultRelInfo *resultRelInfo = mtstate->resultRelInfo + mtstate->mt_whichplan;
+	Relation	rel = resultRelInfo->ri_RelationDesc;
+	TriggerDesc *trigdesc = resultRelInfo->ri_TrigDesc;
+
+	if (mtstate->operation != CMD_DELETE)
+		return false;
+	if (rel->rd_rel->relkind != RELKIND_RELATION ||
+		!RelationStorageIsZHeap(rel))
+		return false;
+	if (resultRelInfo->ri_FdwRoutine != NULL ||
+		resultRelInfo->ri_projectReturning != NULL)
+		return false;
+	if (trigdesc &&
+		(trigdesc->trig_delete_before_row ||
+		 trigdesc->trig_delete_after_row ||
+		 trigdesc->trig_delete_instead_row))
+		return false;
+	if (mtstate->mt_transition_capture != NULL)
+		return false;
+	if (mtstate->mt_arowmarks[mtstate->mt_whichplan] != NIL)
+		return false;
+	if (estate->es_crosscheck_snapshot != InvalidSnapshot)
+		return false;
+
+	return true;
+}
+
+/*
+ * ExecZHeapCanDeleteAll
+ *
+ * Can a DELETE that removes every row of a zheap table be done by giving
+ * the table new, empty storage, as TRUNCATE does?  That writes no undo or
+ * WAL for the rows; rollback brings the old storage back, and after a crash
+ * the UNDO_RELFILENODE record written along with the new storage gets it
+ * dropped.  The rows would then vanish even for snapshots that shouldn't see
+ * the delete, so this is only allowed if no other session can have a
+ * snapshot that sees them: the table is temporary, or its storage was
+ * created by the current transaction.  Holding a lock on the table isn't
+ * enough, since snapshots taken before the lock still see the rows.  We must
+ * also get AccessExclusiveLock on it without waiting.
+ *
+ * Within this session, the rows must not vanish from under scans that are
+ * still open or snapshots that should still see them.  So the DELETE must be
+ * the statement the active portal runs, not one executed from within another
+ * query, and there must be no cursors or older snapshots around.
+ */
+static bool
+ExecZHeapCanDeleteAll(ModifyTableState *mtstate, EState *estate)
+{
+	ModifyTable *node = (ModifyTable *) mtstate->ps.plan;
+	Plan	   *subplan = mtstate->mt_plans[0]->plan;
+	Relation	rel = mtstate->resultRelInfo->ri_RelationDesc;
+
+	/* There must be nothing to do for each row. */
+	if (!mtstate->mt_zdelete_batch || mtstate->mt_nplans != 1 ||
+		!mtstate->canSetTag)
+		return false;
+
+	/* A DELETE without WHERE, and nothing else in the query. */
+	if (estate->es_plannedstmt->planTree != (Plan *) node ||
+		estate->es_plannedstmt->subplans != NIL)
+		return false;
+	if (!IsA(subplan, SeqScan) || subplan->qual != NIL ||
+		((Scan *) subplan)->scanrelid != linitial_int(node->resultRelations))
+		return false;
+
+	if (!RelationUsesLocalBuffers(rel) &&
+		rel->rd_createSubid == InvalidSubTransactionId &&
+		rel->rd_newRelfilenodeSubid == InvalidSubTransactionId)
+		return false;
+
+	/* Logical decoding would not see the rows go away. */
+	if (RelationIsLogicallyLogged(rel))
+		return false;
+
+	if (ActivePortal == NULL ||
+		!list_member_ptr(ActivePortal->stmts, estate->es_plannedstmt))
+		return false;
+
+	/* See the similar checks for COPY FREEZE. */
+	InvalidateCatalogSnapshot();
+	if (!ThereAreNoPriorRegisteredSnapshots() || !ThereAreNoReadyPortals())
+		return false;
+
+	if (AfterTriggerPendingOnRel(RelationGetRelid(rel)))
+		return false;
+
+	return ConditionalLockRelation(rel, AccessExclusiveLock);
+}
+
+/*
+ * ExecZHeapFlushDeletes
+ *
+ * Delete the tuples collected by ExecZHeapDeleteBatch.  The ones that
+ * zheap_multi_delete leaves alone, because they are locked or concurrently
+ * modified, are deleted one by one with ExecDelete, which knows how to wait
+ * for them and recheck the quals.
+ */
+static void
+ExecZHeapFlushDeletes(ModifyTableState *mtstate, EState *estate)
+{
+	ResultRelInfo *resultRelInfo = estate->es_result_relation_info;
+	bool		deleted[MaxZHeapTuplesPerPage];
+	int			ndeleted;
+	int			i;
+
+	if (mtstate->mt_zdelete_ntids == 0)
+		return;
+
+	ndeleted = zheap_multi_delete(resultRelInfo->ri_RelationDesc,
+								  mtstate->mt_zdelete_tids,
+								  mtstate->mt_zdelete_ntids,
+								  estate->es_output_cid,
+								  estate->es_snapshot,
+								  deleted);
+	if (mtstate->canSetTag)
+		(estate->es_processed) += ndeleted;
+
+	for (i = 0; i < mtstate->mt_zdelete_ntids; i++)
+	{
+		if (deleted[i])
+			continue;
+
+		/* No RETURNING, so the plan slot isn't needed. */
+		ExecDelete(mtstate, &mtstate->mt_zdelete_tids[i], NULL, NULL,
+				   &mtstate->mt_epqstate, estate,
+				   false, mtstate->canSetTag,
+				   false /* changingPart */ , NULL, NULL);
+	}
+
+	mtstate->mt_zdelete_ntids = 0;
+}
+
+/*
+ * ExecZHeapDeleteBatch
+ *
+ * Queue a tuple to be deleted.  The rows of a DELETE mostly come in
+ * physical order, so we collect the tids of one page and delete them all
+ * at once, which writes one WAL record for the page instead of one per row
+ * and prepares the undo of all of them together.
+ */
+static void
+ExecZHeapDeleteBatch(ModifyTableState *mtstate, ItemPointer tupleid,
+					 EState *estate)
+{
+	int			i;
+
+	if (mtstate->mt_zdelete_ntids > 0 &&
+		(mtstate->mt_zdelete_ntids == MaxZHeapTuplesPerPage ||
+		 ItemPointerGetBlockNumber(tupleid) !=
+		 ItemPointerGetBlockNumber(&mtstate->mt_zdelete_tids[0])))
+		ExecZHeapFlushDeletes(mtstate, estate);
+
+	/*
+	 * A join can return the same row more than once.  ExecDelete silently
+	 * ignores rows already deleted by this command, so do the same.
+	 */
+	for (i = 0; i < mtstate->mt_zdelete_ntids; i++)
+	{
+		if (ItemPointerEquals(&mtstate->mt_zdelete_tids[i], tupleid))
+			return;
+	}
+
+	mtstate->mt_zdelete_tids[mtstate->mt_zdelete_ntids++] = *tupleid;
+}
+
 /* ----------------------------------------------------------------
  *		ExecUpdate
  *
@@ -2507,6 +2690,14 @@ ExecModifyTable(PlanState *pstate)
 
 		if (TupIsNull(planSlot))
 		{
+			/* delete any rows still batched for this subplan's relation */
+			ExecZHeapFlushDeletes(node, estate);
+			if (node->mt_zdelete_all)
+			{
+				TruncateRelationStorage(resultRelInfo->ri_RelationDesc);
+				pgstat_count_truncate(resultRelInfo->ri_RelationDesc);
+			}
+
 			/* advance to next subplan if any */
 			node->mt_whichplan++;
 			if (node->mt_whichplan < node->mt_nplans)
@@ -2517,6 +2708,8 @@ ExecModifyTable(PlanState *pstate)
 				estate->es_result_relation_info = resultRelInfo;
 				EvalPlanQualSetPlan(&node->mt_epqstate, subplanstate->plan,
 									node->mt_arowmarks[node->mt_whichplan]);
+				if (node->mt_zdelete_tids != NULL)
+					node->mt_zdelete_batch = ExecZHeapCanBatchDelete(node, estate);
 				/* Prepare to convert transition tuples from this child. */
 				if (node->mt_transition_capture != NULL)
 				{
@@ -2648,6 +2841,20 @@ ExecModifyTable(PlanState *pstate)
 								  &node->mt_epqstate, estate, node->canSetTag);
 				break;
 			case CMD_DELETE:
+				if (node->mt_zdelete_all)
+				{
+					/* Just count the rows; they all go away at the end. */
+					(estate->es_processed)++;
+					slot = NULL;
+					break;
+				}
+				if (node->mt_zdelete_batch && tupleid != NULL &&
+					oldtuple == NULL)
+				{
+					ExecZHeapDeleteBatch(node, tupleid, estate);
+					slot = NULL;
+					break;
+				}
 				slot = ExecDelete(node, tupleid, oldtuple, planSlot,
 								  &node->mt_epqstate, estate,
 								  true, node->canSetTag,
@@ -3028,6 +3235,21 @@ ExecInitModifyTable(ModifyTable *node, EState *estate, int eflags)
 	EvalPlanQualSetPlan(&mtstate->mt_epqstate, subplan,
 						mtstate->mt_arowmarks[0]);
 
+	/*
+	 * DELETEs from zheap tables are batched by page, or done by truncating
+	 * the table, where possible; see ExecZHeapDeleteBatch and
+	 * ExecZHeapCanDeleteAll.
+	 */
+	if (operation == CMD_DELETE)
+	{
+		mtstate->mt_zdelete_tids = (ItemPointerData *)
+			palloc(sizeof(ItemPointerData) * MaxZHeapTuplesPerPage);
+		mtstate->mt_zdelete_ntids = 0;
+		mtstate->mt_zdelete_batch = ExecZHeapCanBatchDelete(mtstate, estate);
+		if (!(eflags & EXEC_FLAG_EXPLAIN_ONLY))
+			mtstate->mt_zdelete_all = ExecZHeapCanDeleteAll(mtstate, estate);
+	}
+
 	/*
 	 * Initialize the junk filter(s) if needed.  INSERT queries need a filter
 	 * if there are any junk attrs in the tlist.  UPDATE and DELETE always
@@ -2347,6 +2347,9 @@ _outRelOptInfo(StringInfo str, const RelOptInfo *node)
 	WRITE_UINT_FIELD(pages);
 	WRITE_FLOAT_FIELD(tuples, "%.0f");
 	WRITE_FLOAT_FIELD(allvisfrac, "%.6f");
+	WRITE_FLOAT_FIELD(zactivefrac, "%.6f");
+	WRITE_FLOAT_FIELD(zundodepth, "%.6f");
+	WRITE_FLOAT_FIELD(ztpdfrac, "%.6f");
 	WRITE_NODE_FIELD(subroot);
 	WRITE_NODE_FIELD(subplan_params);
 	WRITE_INT_FIELD(rel_parallel_workers);
@@ -175,6 +175,7 @@ static void set_rel_width(PlannerInfo *root, RelOptInfo *rel);
 static double relation_byte_size(double tuples, int width);
 static double page_size(double tuples, int width);
 static double get_parallel_divisor(Path *path);
+static Cost zheap_undo_cost(RelOptInfo *baserel, double tuples);
 
 
 /*
@@ -245,6 +246,7 @@ cost_seqscan(Path *path, PlannerInfo *root,
 	startup_cost += qpqual_cost.startup;
 	cpu_per_tuple = cpu_tuple_cost + qpqual_cost.per_tuple;
 	cpu_run_cost = cpu_per_tuple * baserel->tuples;
+	cpu_run_cost += zheap_undo_cost(baserel, baserel->tuples);
 	/* tlist eval costs are paid per output row, not per tuple scanned */
 	startup_cost += path->pathtarget->cost.startup;
 	cpu_run_cost += path->pathtarget->cost.per_tuple * path->rows;
@@ -710,6 +712,14 @@ cost_index(IndexPath *path, PlannerInfo *root, double loop_count,
 	 */
 	csquared = indexCorrelation * indexCorrelation;
 
+	/*
+	 * The visibility checks on a zheap page that keeps transaction slots in
+	 * TPD need the TPD page as well.  Count that as one more page fetch per
+	 * such page when the heap is visited at random; in index order,
+	 * consecutive pages mostly share their TPD page.
+	 */
+	max_IO_cost += max_IO_cost * baserel->ztpdfrac;
+
 	run_cost += max_IO_cost + csquared * (min_IO_cost - max_IO_cost);
 
 	/*
@@ -725,6 +735,13 @@ cost_index(IndexPath *path, PlannerInfo *root, double loop_count,
 
 	cpu_run_cost += cpu_per_tuple * tuples_fetched;
 
+	/* Index-only scans check visibility only for the heap tuples fetched */
+	if (indexonly)
+		cpu_run_cost += zheap_undo_cost(baserel, tuples_fetched *
+										(1.0 - baserel->allvisfrac));
+	else
+		cpu_run_cost += zheap_undo_cost(baserel, tuples_fetched);
+
 	/* tlist eval costs are paid per output row, not per tuple scanned */
 	startup_cost += path->path.pathtarget->cost.startup;
 	cpu_run_cost += path->path.pathtarget->cost.per_tuple * path->path.rows;
@@ -998,6 +1015,9 @@ cost_bitmap_heap_scan(Path *path, PlannerInfo *root, RelOptInfo *baserel,
 
 	run_cost += pages_fetched * cost_per_page;
 
+	/* TPD pages needed for zheap visibility checks; see cost_index */
+	run_cost += pages_fetched * baserel->ztpdfrac * cost_per_page;
+
 	/*
 	 * Estimate CPU costs per tuple.
 	 *
@@ -1012,6 +1032,7 @@ cost_bitmap_heap_scan(Path *path, PlannerInfo *root, RelOptInfo *baserel,
 	startup_cost += qpqual_cost.startup;
 	cpu_per_tuple = cpu_tuple_cost + qpqual_cost.per_tuple;
 	cpu_run_cost = cpu_per_tuple * tuples_fetched;
+	cpu_run_cost += zheap_undo_cost(baserel, tuples_fetched);
 
 	/* Adjust costing for parallelism, if used. */
 	if (path->parallel_workers > 0)
@@ -5475,3 +5496,23 @@ compute_bitmap_pages(PlannerInfo *root, RelOptInfo *baserel, Path *bitmapqual,
 
 	return pages_fetched;
 }
+
+/*
+ * zheap_undo_cost
+ *	  Estimate the cost of fetching prior tuple versions from undo while
+ *	  checking the visibility of 'tuples' tuples of a zheap relation.
+ *
+ * ANALYZE measures the fraction of the relation's pages holding tuples whose
+ * undo is still retained, and the average number of undo records retained
+ * per tuple on those pages; a visibility check may have to go through them.
+ * We charge cpu_tuple_cost for each record, as for a tuple version read from
+ * the heap, but no I/O: undo that hasn't been discarded yet belongs to
+ * recent transactions and is nearly always still in shared buffers.
+ *
+ * This is zero for relations other than zheap tables.
+ */
+static Cost
+zheap_undo_cost(RelOptInfo *baserel, double tuples)
+{
+	return tuples * baserel->zactivefrac * baserel->zundodepth * cpu_tuple_cost;
+}
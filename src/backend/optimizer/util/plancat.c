@@ -24,6 +24,7 @@
 #include "access/sysattr.h"
 #include "access/transam.h"
 #include "access/xlog.h"
+#include "access/zheap.h"
 #include "catalog/catalog.h"
 #include "catalog/dependency.h"
 #include "catalog/heap.h"
@@ -146,6 +147,14 @@ get_relation_info(PlannerInfo *root, Oid relationObjectId, bool inhparent,
 		estimate_rel_size(relation, rel->attr_widths - rel->min_attr,
 						  &rel->pages, &rel->tuples, &rel->allvisfrac);
 
+	/*
+	 * For zheap, also get the statistics ANALYZE gathered on the cost of
+	 * visibility checks; see cost_index and zheap_undo_cost.
+	 */
+	if (!inhparent && RelationStorageIsZHeap(relation))
+		zheap_get_meta_stats(relation, &rel->zactivefrac, &rel->zundodepth,
+							 &rel->ztpdfrac);
+
 	/* Retrieve the parallel_workers reloption, or -1 if not set. */
 	rel->rel_parallel_workers = RelationGetParallelWorkers(relation, -1);
 
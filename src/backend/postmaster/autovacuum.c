@@ -327,7 +327,7 @@ static autovac_table *table_recheck_autovac(Oid relid, HTAB *table_toast_map,
 					  TupleDesc pg_class_desc,
 					  int effective_multixact_freeze_max_age);
 static void relation_needs_vacanalyze(Oid relid, AutoVacOpts *relopts,
-						  Form_pg_class classForm,
+						  Form_pg_class classForm, bool is_zheap,
 						  PgStat_StatTabEntry *tabentry,
 						  int effective_multixact_freeze_max_age,
 						  bool *dovacuum, bool *doanalyze, bool *wraparound);
@@ -335,7 +335,7 @@ static void relation_needs_vacanalyze(Oid relid, AutoVacOpts *relopts,
 static void autovacuum_do_vac_analyze(autovac_table *tab,
 						  BufferAccessStrategy bstrategy);
 static AutoVacOpts *extract_autovac_opts(HeapTuple tup,
-					 TupleDesc pg_class_desc);
+					 TupleDesc pg_class_desc, bool *is_zheap);
 static PgStat_StatTabEntry *get_pgstat_tabentry_relid(Oid relid, bool isshared,
 						  PgStat_StatDBEntry *shared,
 						  PgStat_StatDBEntry *dbentry);
@@ -2064,6 +2064,7 @@ do_autovacuum(void)
 		PgStat_StatTabEntry *tabentry;
 		AutoVacOpts *relopts;
 		Oid			relid;
+		bool		is_zheap;
 		bool		dovacuum;
 		bool		doanalyze;
 		bool		wraparound;
@@ -2102,12 +2103,12 @@ do_autovacuum(void)
 		}
 
 		/* Fetch reloptions and the pgstat entry for this table */
-		relopts = extract_autovac_opts(tuple, pg_class_desc);
+		relopts = extract_autovac_opts(tuple, pg_class_desc, &is_zheap);
 		tabentry = get_pgstat_tabentry_relid(relid, classForm->relisshared,
 											 shared, dbentry);
 
 		/* Check if it needs vacuum or analyze */
-		relation_needs_vacanalyze(relid, relopts, classForm, tabentry,
+		relation_needs_vacanalyze(relid, relopts, classForm, is_zheap, tabentry,
 								  effective_multixact_freeze_max_age,
 								  &dovacuum, &doanalyze, &wraparound);
 
@@ -2159,6 +2160,7 @@ do_autovacuum(void)
 		PgStat_StatTabEntry *tabentry;
 		Oid			relid;
 		AutoVacOpts *relopts = NULL;
+		bool		is_zheap;
 		bool		dovacuum;
 		bool		doanalyze;
 		bool		wraparound;
@@ -2175,7 +2177,7 @@ do_autovacuum(void)
 		 * fetch reloptions -- if this toast table does not have them, try the
 		 * main rel
 		 */
-		relopts = extract_autovac_opts(tuple, pg_class_desc);
+		relopts = extract_autovac_opts(tuple, pg_class_desc, &is_zheap);
 		if (relopts == NULL)
 		{
 			av_relation *hentry;
@@ -2190,7 +2192,7 @@ do_autovacuum(void)
 		tabentry = get_pgstat_tabentry_relid(relid, classForm->relisshared,
 											 shared, dbentry);
 
-		relation_needs_vacanalyze(relid, relopts, classForm, tabentry,
+		relation_needs_vacanalyze(relid, relopts, classForm, is_zheap, tabentry,
 								  effective_multixact_freeze_max_age,
 								  &dovacuum, &doanalyze, &wraparound);
 
@@ -2727,10 +2729,11 @@ deleted2:
  * extract_autovac_opts
  *
  * Given a relation's pg_class tuple, return the AutoVacOpts portion of
- * reloptions, if set; otherwise, return NULL.
+ * reloptions, if set; otherwise, return NULL.  *is_zheap is set to whether
+ * the reloptions say the relation is stored in zheap.
  */
 static AutoVacOpts *
-extract_autovac_opts(HeapTuple tup, TupleDesc pg_class_desc)
+extract_autovac_opts(HeapTuple tup, TupleDesc pg_class_desc, bool *is_zheap)
 {
 	bytea	   *relopts;
 	AutoVacOpts *av;
@@ -2739,10 +2742,15 @@ extract_autovac_opts(HeapTuple tup, TupleDesc pg_class_desc)
 		   ((Form_pg_class) GETSTRUCT(tup))->relkind == RELKIND_MATVIEW ||
 		   ((Form_pg_class) GETSTRUCT(tup))->relkind == RELKIND_TOASTVALUE);
 
+	*is_zheap = false;
+
 	relopts = extractRelOptions(tup, pg_class_desc, NULL);
 	if (relopts == NULL)
 		return NULL;
 
+	*is_zheap = RelationStorageOptIsZHeap(((Form_pg_class) GETSTRUCT(tup))->relkind,
+										  relopts);
+
 	av = palloc(sizeof(AutoVacOpts));
 	memcpy(av, &(((StdRdOptions *) relopts)->autovacuum), sizeof(AutoVacOpts));
 
@@ -2797,6 +2805,7 @@ table_recheck_autovac(Oid relid, HTAB *table_toast_map,
 	PgStat_StatDBEntry *shared;
 	PgStat_StatDBEntry *dbentry;
 	bool		wraparound;
+	bool		is_zheap;
 	AutoVacOpts *avopts;
 
 	/* use fresh stats */
@@ -2815,7 +2824,7 @@ table_recheck_autovac(Oid relid, HTAB *table_toast_map,
 	 * Get the applicable reloptions.  If it is a TOAST table, try to get the
 	 * main table reloptions if the toast table itself doesn't have.
 	 */
-	avopts = extract_autovac_opts(classTup, pg_class_desc);
+	avopts = extract_autovac_opts(classTup, pg_class_desc, &is_zheap);
 	if (classForm->relkind == RELKIND_TOASTVALUE &&
 		avopts == NULL && table_toast_map != NULL)
 	{
@@ -2831,7 +2840,7 @@ table_recheck_autovac(Oid relid, HTAB *table_toast_map,
 	tabentry = get_pgstat_tabentry_relid(relid, classForm->relisshared,
 										 shared, dbentry);
 
-	relation_needs_vacanalyze(relid, avopts, classForm, tabentry,
+	relation_needs_vacanalyze(relid, avopts, classForm, is_zheap, tabentry,
 							  effective_multixact_freeze_max_age,
 							  &dovacuum, &doanalyze, &wraparound);
 
@@ -2955,6 +2964,12 @@ table_recheck_autovac(Oid relid, HTAB *table_toast_map,
  * transactions back, and if its relminmxid is more than
  * multixact_freeze_max_age multixacts back.
  *
+ * zheap tables (is_zheap) never need freezing, so they are never vacuumed for
+ * wraparound.  A delete or non-in-place update frees the tuple's space once
+ * it commits, and in-place updates leave nothing behind at all, so what
+ * vacuum has to clean up is the deleted and dead line pointers and their
+ * index entries.  Their dead tuple count is exactly that; see below.
+ *
  * A table whose autovacuum_enabled option is false is
  * automatically skipped (unless we have to vacuum it due to freeze_max_age).
  * Thus autovacuum can be disabled for specific tables. Also, when the stats
@@ -2969,6 +2984,7 @@ static void
 relation_needs_vacanalyze(Oid relid,
 						  AutoVacOpts *relopts,
 						  Form_pg_class classForm,
+						  bool is_zheap,
 						  PgStat_StatTabEntry *tabentry,
 						  int effective_multixact_freeze_max_age,
  /* output params below */
@@ -3036,14 +3052,19 @@ relation_needs_vacanalyze(Oid relid,
 
 	av_enabled = (relopts ? relopts->enabled : true);
 
-	/* Force vacuum if table is at risk of wraparound */
+	/*
+	 * Force vacuum if table is at risk of wraparound.  zheap tables keep
+	 * their transaction information in undo, which is discarded rather than
+	 * frozen, so their relfrozenxid and relminmxid are invalid and must not
+	 * be compared against the limits.
+	 */
 	xidForceLimit = recentXid - freeze_max_age;
 	if (xidForceLimit < FirstNormalTransactionId)
 		xidForceLimit -= FirstNormalTransactionId;
 	force_vacuum = (TransactionIdIsNormal(classForm->relfrozenxid) &&
 					TransactionIdPrecedes(classForm->relfrozenxid,
 										  xidForceLimit));
-	if (!force_vacuum)
+	if (!force_vacuum && !is_zheap)
 	{
 		multiForceLimit = recentMulti - multixact_freeze_max_age;
 		if (multiForceLimit < FirstMultiXactId)
@@ -3071,6 +3092,17 @@ relation_needs_vacanalyze(Oid relid,
 	if (PointerIsValid(tabentry) && AutoVacuumingActive())
 	{
 		reltuples = classForm->reltuples;
+
+		/*
+		 * For zheap, the dead tuples are the line pointers that vacuum must
+		 * reclaim: each committed delete or non-in-place update and each
+		 * rolled-back insert leaves one behind, along with index entries
+		 * pointing to it.  In-place updates keep the line pointer and index
+		 * entries and are counted separately, so a table that sees only
+		 * in-place updates is never vacuumed.  Pruning subtracts only what it
+		 * frees outright; the line pointers it leaves dead or deleted still
+		 * need vacuum and stay counted.
+		 */
 		vactuples = tabentry->n_dead_tuples;
 		anltuples = tabentry->changes_since_analyze;
 
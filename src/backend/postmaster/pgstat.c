@@ -4698,6 +4698,14 @@ pgstat_get_tab_entry(PgStat_StatDBEntry *dbentry, Oid tableoid, bool create)
 		result->changes_since_analyze = 0;
 		result->blocks_fetched = 0;
 		result->blocks_hit = 0;
+		result->trans_slot_waits = 0;
+		result->trans_slot_freezes = 0;
+		result->tpd_entries_allocated = 0;
+		result->tpd_entries_extended = 0;
+		result->undo_bytes = 0;
+		result->undo_records_fetched = 0;
+		result->page_prunes = 0;
+		result->tuples_pruned = 0;
 		result->vacuum_timestamp = 0;
 		result->vacuum_count = 0;
 		result->autovac_vacuum_timestamp = 0;
@@ -5828,6 +5836,14 @@ pgstat_recv_tabstat(PgStat_MsgTabstat *msg, int len)
 			tabentry->changes_since_analyze = tabmsg->t_counts.t_changed_tuples;
 			tabentry->blocks_fetched = tabmsg->t_counts.t_blocks_fetched;
 			tabentry->blocks_hit = tabmsg->t_counts.t_blocks_hit;
+			tabentry->trans_slot_waits = tabmsg->t_counts.t_trans_slot_waits;
+			tabentry->trans_slot_freezes = tabmsg->t_counts.t_trans_slot_freezes;
+			tabentry->tpd_entries_allocated = tabmsg->t_counts.t_tpd_entries_allocated;
+			tabentry->tpd_entries_extended = tabmsg->t_counts.t_tpd_entries_extended;
+			tabentry->undo_bytes = tabmsg->t_counts.t_undo_bytes;
+			tabentry->undo_records_fetched = tabmsg->t_counts.t_undo_records_fetched;
+			tabentry->page_prunes = tabmsg->t_counts.t_page_prunes;
+			tabentry->tuples_pruned = tabmsg->t_counts.t_tuples_pruned;
 
 			tabentry->vacuum_timestamp = 0;
 			tabentry->vacuum_count = 0;
@@ -5861,6 +5877,14 @@ pgstat_recv_tabstat(PgStat_MsgTabstat *msg, int len)
 			tabentry->changes_since_analyze += tabmsg->t_counts.t_changed_tuples;
 			tabentry->blocks_fetched += tabmsg->t_counts.t_blocks_fetched;
 			tabentry->blocks_hit += tabmsg->t_counts.t_blocks_hit;
+			tabentry->trans_slot_waits += tabmsg->t_counts.t_trans_slot_waits;
+			tabentry->trans_slot_freezes += tabmsg->t_counts.t_trans_slot_freezes;
+			tabentry->tpd_entries_allocated += tabmsg->t_counts.t_tpd_entries_allocated;
+			tabentry->tpd_entries_extended += tabmsg->t_counts.t_tpd_entries_extended;
+			tabentry->undo_bytes += tabmsg->t_counts.t_undo_bytes;
+			tabentry->undo_records_fetched += tabmsg->t_counts.t_undo_records_fetched;
+			tabentry->page_prunes += tabmsg->t_counts.t_page_prunes;
+			tabentry->tuples_pruned += tabmsg->t_counts.t_tuples_pruned;
 		}
 
 		/* Clamp n_live_tuples in case of negative delta_live_tuples */
@@ -31,12 +31,14 @@
 #include "postmaster/undoloop.h"
 
 static void undoworker_sigterm_handler(SIGNAL_ARGS);
+static void undoworker_sighup_handler(SIGNAL_ARGS);
 
 /* max sleep time between cycles (100 milliseconds) */
 #define MIN_NAPTIME_PER_CYCLE 100L
 #define DELAYED_NAPTIME 10 * MIN_NAPTIME_PER_CYCLE
 #define MAX_NAPTIME_PER_CYCLE 100 * MIN_NAPTIME_PER_CYCLE
 
+static volatile sig_atomic_t got_SIGHUP = false;
 static bool got_SIGTERM = false;
 static bool hibernate = false;
 static	long		wait_time = MIN_NAPTIME_PER_CYCLE;
@@ -51,6 +53,18 @@ undoworker_sigterm_handler(SIGNAL_ARGS)
 	SetLatch(MyLatch);
 }
 
+/* SIGHUP: set flag to reload the configuration file */
+static void
+undoworker_sighup_handler(SIGNAL_ARGS)
+{
+	int			save_errno = errno;
+
+	got_SIGHUP = true;
+	SetLatch(MyLatch);
+
+	errno = save_errno;
+}
+
 /*
  * UndoLauncherRegister -- Register a undo worker.
  */
@@ -86,6 +100,7 @@ UndoWorkerMain(Datum main_arg)
 
 	/* Establish signal handlers. */
 	pqsignal(SIGTERM, undoworker_sigterm_handler);
+	pqsignal(SIGHUP, undoworker_sighup_handler);
 	BackgroundWorkerUnblockSignals();
 
 	/* Make it easy to identify our processes. */
@@ -113,7 +128,20 @@ UndoWorkerMain(Datum main_arg)
 		int			rc;
 		TransactionId OldestXmin, oldestXidHavingUndo;
 
-		OldestXmin = GetOldestXmin(NULL, PROCARRAY_FLAGS_DEFAULT);
+		/* Pick up changes to undo_retention. */
+		if (got_SIGHUP)
+		{
+			got_SIGHUP = false;
+			ProcessConfigFile(PGC_SIGHUP);
+		}
+
+		/*
+		 * Keep the undo of transactions started within the undo_retention
+		 * window, for flashback queries, even if nobody else needs it.
+		 */
+		UndoRetentionRecordXid();
+		OldestXmin = UndoRetentionGetDiscardHorizon(
+						GetOldestXmin(NULL, PROCARRAY_FLAGS_DEFAULT));
 		oldestXidHavingUndo = GetXidFromEpochXid(
 						pg_atomic_read_u64(&ProcGlobal->oldestXidWithEpochHavingUndo));
 
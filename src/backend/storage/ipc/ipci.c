@@ -23,6 +23,7 @@
 #include "access/twophase.h"
 #include "access/undolog.h"
 #include "access/undodiscard.h"
+#include "access/zmultilocker.h"
 #include "commands/async.h"
 #include "miscadmin.h"
 #include "pgstat.h"
@@ -154,6 +155,8 @@ CreateSharedMemoryAndSemaphores(bool makePrivate, int port)
 		size = add_size(size, AsyncShmemSize());
 		size = add_size(size, BackendRandomShmemSize());
 		size = add_size(size, RollbackHTSize());
+		size = add_size(size, UndoRetentionShmemSize());
+		size = add_size(size, ZMultiLockCacheShmemSize());
 #ifdef EXEC_BACKEND
 		size = add_size(size, ShmemBackendArraySize());
 #endif
@@ -229,6 +232,8 @@ CreateSharedMemoryAndSemaphores(bool makePrivate, int port)
 	MultiXactShmemInit();
 	InitBufferPool();
 	InitRollbackHashTable();
+	UndoRetentionShmemInit();
+	ZMultiLockCacheShmemInit();
 
 	/*
 	 * Set up lock manager
@@ -314,6 +314,39 @@ ResolveRecoveryConflictWithSnapshot(TransactionId latestRemovedXid, RelFileNode
 										   PROCSIG_RECOVERY_CONFLICT_SNAPSHOT);
 }
 
+/*
+ * Like ResolveRecoveryConflictWithSnapshot, but cancel the conflicting
+ * queries right away rather than letting them run on for up to
+ * max_standby_streaming_delay.  For callers that have already delayed replay
+ * for as long as they're willing to.
+ */
+void
+CancelRecoveryConflictWithSnapshot(TransactionId latestRemovedXid, RelFileNode node)
+{
+	VirtualTransactionId *backends;
+
+	if (!TransactionIdIsValid(latestRemovedXid))
+		return;
+
+	backends = GetConflictingVirtualXIDs(latestRemovedXid,
+										 node.dbNode);
+
+	while (VirtualTransactionIdIsValid(*backends))
+	{
+		while (!VirtualXactLock(*backends, false))
+		{
+			CHECK_FOR_INTERRUPTS();
+
+			(void) CancelVirtualTransaction(*backends,
+											PROCSIG_RECOVERY_CONFLICT_SNAPSHOT);
+
+			/* Wait a little bit for it to die. */
+			pg_usleep(5000L);
+		}
+		backends++;
+	}
+}
+
 void
 ResolveRecoveryConflictWithTablespace(Oid tsid)
 {
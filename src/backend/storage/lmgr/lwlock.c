@@ -523,6 +523,7 @@ RegisterLWLockTranches(void)
 	LWLockRegisterTranche(LWTRANCHE_PARALLEL_HASH_JOIN, "parallel_hash_join");
 	LWLockRegisterTranche(LWTRANCHE_UNDOLOG, "undo_log");
 	LWLockRegisterTranche(LWTRANCHE_UNDODISCARD, "undo_discard");
+	LWLockRegisterTranche(LWTRANCHE_ZMULTILOCK_CACHE, "zheap_multilock_cache");
 
 	/* Register named tranches. */
 	for (i = 0; i < NamedLWLockTrancheRequests; i++)
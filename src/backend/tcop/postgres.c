@@ -38,6 +38,7 @@
 
 #include "access/parallel.h"
 #include "access/printtup.h"
+#include "access/undolog.h"
 #include "access/xact.h"
 #include "catalog/pg_type.h"
 #include "commands/async.h"
@@ -4073,6 +4074,7 @@ PostgresMain(int argc, char *argv[],
 			{
 				ProcessCompletedNotifies();
 				pgstat_report_stat(false);
+				UndoLogDetachIdle();
 
 				set_ps_display("idle", false);
 				pgstat_report_activity(STATE_IDLE, NULL);
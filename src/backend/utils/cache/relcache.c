@@ -2276,6 +2276,9 @@ RelationDestroyRelation(Relation relation, bool remember_tupdesc)
 		pfree(relation->rd_options);
 	if (relation->rd_indextuple)
 		pfree(relation->rd_indextuple);
+	/* zheap tables keep rd_amcache in CacheMemoryContext */
+	if (relation->rd_amcache)
+		pfree(relation->rd_amcache);
 	if (relation->rd_indexcxt)
 		MemoryContextDelete(relation->rd_indexcxt);
 	if (relation->rd_rulescxt)
@@ -3335,6 +3338,8 @@ RelationSetNewRelfilenode(Relation relation, char persistence,
 						  TransactionId freezeXid, MultiXactId minmulti)
 {
 	Oid			newrelfilenode;
+	Oid			oldrelfilenode = relation->rd_node.relNode;
+	uint8		relundo_action = UNDO_RELFILENODE_RESTORE;
 	RelFileNodeBackend newrnode;
 	Relation	pg_class;
 	HeapTuple	tuple;
@@ -3420,6 +3425,15 @@ RelationSetNewRelfilenode(Relation relation, char persistence,
 	 */
 	CommandCounterIncrement();
 
+	/*
+	 * If the old storage was itself created by this transaction, the
+	 * relation has no storage to go back to after a crash, so the new one is
+	 * simply to be dropped.  Check that before we update the hint below.
+	 */
+	if (relation->rd_createSubid != InvalidSubTransactionId ||
+		relation->rd_newRelfilenodeSubid != InvalidSubTransactionId)
+		relundo_action = UNDO_RELFILENODE_DROP;
+
 	/*
 	 * Mark the rel as having been given a new relfilenode in the current
 	 * (sub) transaction.  This is a hint that can be used to optimize later
@@ -3430,9 +3444,16 @@ RelationSetNewRelfilenode(Relation relation, char persistence,
 	/* Flag relation as needing eoxact cleanup (to remove the hint) */
 	EOXactListAdd(relation);
 
-	/* Initialize the metapage for zheap relation. */
+	/*
+	 * Initialize the metapage for zheap relation, and remember in undo what
+	 * becomes of the new storage if we abort, so that it's dropped even if
+	 * we crash.
+	 */
 	if (RelationStorageIsZHeap(relation))
+	{
 		ZheapInitMetaPage(relation, MAIN_FORKNUM);
+		ZheapInsertRelfilenodeUndo(relation, relundo_action, oldrelfilenode);
+	}
 }
 
 
@@ -31,6 +31,8 @@
 #include "access/rmgr.h"
 #include "access/transam.h"
 #include "access/twophase.h"
+#include "access/undodiscard.h"
+#include "access/undolog.h"
 #include "access/xact.h"
 #include "access/xlog_internal.h"
 #include "access/zheap.h"
@@ -1980,6 +1982,17 @@ static struct config_int ConfigureNamesInt[] =
 		NULL, NULL, NULL
 	},
 
+	{
+		{"max_standby_undo_discard_delay", PGC_SIGHUP, REPLICATION_STANDBY,
+			gettext_noop("Sets the maximum delay before applying a replayed undo discard that hot standby queries may still need."),
+			NULL,
+			GUC_UNIT_MS
+		},
+		&max_standby_undo_discard_delay,
+		30 * 1000, -1, INT_MAX,
+		NULL, NULL, NULL
+	},
+
 	{
 		{"wal_receiver_status_interval", PGC_SIGHUP, REPLICATION_STANDBY,
 			gettext_noop("Sets the maximum interval between WAL receiver status reports to the primary."),
@@ -2143,6 +2156,27 @@ static struct config_int ConfigureNamesInt[] =
 		check_max_stack_depth, assign_max_stack_depth, NULL
 	},
 
+	{
+		{"max_active_undo_logs", PGC_SIGHUP, RESOURCES_DISK,
+			gettext_noop("Sets the maximum number of undo logs of each persistence level kept for reuse."),
+			gettext_noop("If nonzero, sessions give back their undo logs when idle, and undo logs in excess of this number are dropped once their undo is discarded. Zero keeps one undo log per session.")
+		},
+		&max_active_undo_logs,
+		0, 0, INT_MAX,
+		NULL, NULL, NULL
+	},
+
+	{
+		{"undo_retention", PGC_SIGHUP, RESOURCES_DISK,
+			gettext_noop("Sets how long undo is kept for flashback queries after it is no longer needed."),
+			gettext_noop("Zero discards undo as soon as no snapshot needs it."),
+			GUC_UNIT_S
+		},
+		&undo_retention,
+		0, 0, INT_MAX,
+		NULL, NULL, NULL
+	},
+
 	{
 		{"temp_file_limit", PGC_SUSET, RESOURCES_DISK,
 			gettext_noop("Limits the total size of all temporary files used by each process."),
@@ -49,6 +49,189 @@ static ZHeapTuple
 GetTupleFromUndoForAbortedXact(UndoRecPtr urec_ptr, Buffer buffer, int trans_slot,
 							   ZHeapTuple ztuple,TransactionId *xid);
 
+/*
+ * Backend-local cache of the final status of the transactions we have seen
+ * in transaction slots and undo records.  Unlike heap, zheap has no hint bits
+ * to remember that a transaction has committed or aborted, so without this
+ * every visibility check of a recently modified tuple would go back to the
+ * procarray and clog.
+ *
+ * Only transactions that are known to be committed or aborted and that are no
+ * longer in the procarray are cached, so an entry never changes.  The cache is
+ * keyed by epoch and xid.  As explained atop this file, the xids we look up
+ * are within 2-billion transactions of oldestXidWithEpochHavingUndo, which
+ * gives us their epoch.  Entries older than oldestXidWithEpochHavingUndo are
+ * ignored; their transactions are all-visible anyway.
+ */
+#define ZXACT_STATUS_CACHE_SIZE	128		/* must be a power of 2 */
+
+#define ZXACT_STATUS_COMMITTED	1
+#define ZXACT_STATUS_ABORTED	2
+
+typedef struct ZXactStatusCacheEntry
+{
+	uint64		epoch_xid;
+	uint8		status;
+} ZXactStatusCacheEntry;
+
+static ZXactStatusCacheEntry zxact_status_cache[ZXACT_STATUS_CACHE_SIZE];
+
+/* The last xid ZTransactionIdIsInProgress found not to be running. */
+static TransactionId zxact_last_not_in_progress = InvalidTransactionId;
+
+/*
+ * Compute the cache key of xid, or return false if it can't be cached.
+ */
+static inline bool
+ZXactStatusCacheKey(TransactionId xid, uint64 *epoch_xid)
+{
+	uint64		oldest;
+	TransactionId oldest_xid;
+	uint32		epoch;
+
+	if (!TransactionIdIsNormal(xid))
+		return false;
+
+	oldest = pg_atomic_read_u64(&ProcGlobal->oldestXidWithEpochHavingUndo);
+	oldest_xid = (TransactionId) oldest;
+	epoch = (uint32) (oldest >> 32);
+
+	if (!TransactionIdIsNormal(oldest_xid) ||
+		TransactionIdPrecedes(xid, oldest_xid))
+		return false;
+
+	/* The xid has wrapped around into the next epoch. */
+	if (xid < oldest_xid)
+		epoch++;
+
+	*epoch_xid = MakeEpochXid((uint64) epoch, xid);
+	return true;
+}
+
+/*
+ * Return the cached status of xid, or 0 if it's not cached.
+ */
+static inline uint8
+ZXactStatusCacheLookup(TransactionId xid, uint64 *epoch_xid)
+{
+	ZXactStatusCacheEntry *entry;
+
+	if (!ZXactStatusCacheKey(xid, epoch_xid))
+	{
+		*epoch_xid = 0;
+		return 0;
+	}
+
+	entry = &zxact_status_cache[xid & (ZXACT_STATUS_CACHE_SIZE - 1)];
+	if (entry->epoch_xid == *epoch_xid)
+		return entry->status;
+
+	return 0;
+}
+
+/*
+ * Remember the final status of xid, if it's known to be no longer running.
+ */
+static inline void
+ZXactStatusCacheInsert(TransactionId xid, uint64 epoch_xid, uint8 status)
+{
+	ZXactStatusCacheEntry *entry;
+
+	if (epoch_xid == 0)
+		return;
+
+	/*
+	 * The transaction can be marked committed or aborted in clog before it
+	 * leaves the procarray, so cache it only once it's known to be gone from
+	 * there; see the comments atop tqual.c.  We don't probe the procarray
+	 * ourselves: either the xid precedes RecentXmin, or the caller has just
+	 * checked it with ZTransactionIdIsInProgress, as visibility checks with
+	 * a non-MVCC snapshot do.  Anything else is simply not cached.
+	 */
+	if (!TransactionIdPrecedes(xid, RecentXmin) &&
+		!TransactionIdEquals(xid, zxact_last_not_in_progress))
+		return;
+
+	entry = &zxact_status_cache[xid & (ZXACT_STATUS_CACHE_SIZE - 1)];
+	entry->epoch_xid = epoch_xid;
+	entry->status = status;
+}
+
+/*
+ * ZTransactionIdDidCommit
+ *		Same as TransactionIdDidCommit, but uses the transaction status cache.
+ */
+bool
+ZTransactionIdDidCommit(TransactionId xid)
+{
+	uint64		epoch_xid;
+
+	switch (ZXactStatusCacheLookup(xid, &epoch_xid))
+	{
+		case ZXACT_STATUS_COMMITTED:
+			return true;
+		case ZXACT_STATUS_ABORTED:
+			return false;
+	}
+
+	if (TransactionIdDidCommit(xid))
+	{
+		ZXactStatusCacheInsert(xid, epoch_xid, ZXACT_STATUS_COMMITTED);
+		return true;
+	}
+
+	if (TransactionIdDidAbort(xid))
+		ZXactStatusCacheInsert(xid, epoch_xid, ZXACT_STATUS_ABORTED);
+
+	return false;
+}
+
+/*
+ * ZTransactionIdDidAbort
+ *		Same as TransactionIdDidAbort, but uses the transaction status cache.
+ */
+bool
+ZTransactionIdDidAbort(TransactionId xid)
+{
+	uint64		epoch_xid;
+
+	switch (ZXactStatusCacheLookup(xid, &epoch_xid))
+	{
+		case ZXACT_STATUS_COMMITTED:
+			return false;
+		case ZXACT_STATUS_ABORTED:
+			return true;
+	}
+
+	if (TransactionIdDidAbort(xid))
+	{
+		ZXactStatusCacheInsert(xid, epoch_xid, ZXACT_STATUS_ABORTED);
+		return true;
+	}
+
+	return false;
+}
+
+/*
+ * ZTransactionIdIsInProgress
+ *		Same as TransactionIdIsInProgress, but a transaction found in the
+ *		transaction status cache is known to have finished.
+ */
+bool
+ZTransactionIdIsInProgress(TransactionId xid)
+{
+	uint64		epoch_xid;
+
+	if (ZXactStatusCacheLookup(xid, &epoch_xid) != 0)
+		return false;
+
+	if (TransactionIdIsInProgress(xid))
+		return true;
+
+	zxact_last_not_in_progress = xid;
+	return false;
+}
+
 /*
  * FetchTransInfoFromUndo - Retrieve transaction information of transaction
  *			that has modified the undo tuple.
@@ -277,7 +460,7 @@ GetVisibleTupleIfAny(UndoRecPtr prev_urec_ptr, ZHeapTuple undo_tup,
 									NULL,
 									trans_slot_id,
 									xid);
-		else if (!IsMVCCSnapshot(snapshot) && TransactionIdIsInProgress(xid))
+		else if (!IsMVCCSnapshot(snapshot) && ZTransactionIdIsInProgress(xid))
 			return GetTupleFromUndo(prev_urec_ptr,
 									undo_tup,
 									snapshot,
@@ -285,7 +468,7 @@ GetVisibleTupleIfAny(UndoRecPtr prev_urec_ptr, ZHeapTuple undo_tup,
 									NULL,
 									trans_slot_id,
 									xid);
-		else if (TransactionIdDidCommit(xid))
+		else if (ZTransactionIdDidCommit(xid))
 			return undo_tup;
 		else
 			return GetTupleFromUndo(prev_urec_ptr,
@@ -307,9 +490,9 @@ GetVisibleTupleIfAny(UndoRecPtr prev_urec_ptr, ZHeapTuple undo_tup,
 		}
 		else if (IsMVCCSnapshot(snapshot) && XidInMVCCSnapshot(xid, snapshot))
 			return NULL;
-		else if (!IsMVCCSnapshot(snapshot) && TransactionIdIsInProgress(xid))
+		else if (!IsMVCCSnapshot(snapshot) && ZTransactionIdIsInProgress(xid))
 			return NULL;
-		else if (TransactionIdDidCommit(xid))
+		else if (ZTransactionIdDidCommit(xid))
 			return undo_tup;
 		else
 			return NULL;
@@ -392,7 +575,7 @@ fetch_prior_undo_record:
 	/*
 	 * If we got a tuple modified by a committed transaction, return it.
 	 */
-	if (TransactionIdDidCommit(*xid))
+	if (ZTransactionIdDidCommit(*xid))
 		return undo_tup;
 
 	/*
@@ -419,7 +602,7 @@ fetch_prior_undo_record:
 									  true);
 		FetchTransInfoFromUndo(undo_tup, NULL, xid, NULL, &prev_urec_ptr, false);
 
-		Assert(TransactionIdDidCommit(*xid) ||
+		Assert(ZTransactionIdDidCommit(*xid) ||
 			   ZHEAP_XID_IS_LOCKED_ONLY(undo_tup->t_data->t_infomask));
 
 		return undo_tup;
@@ -427,8 +610,8 @@ fetch_prior_undo_record:
 
 	/* transaction must be aborted. */
 	Assert(!TransactionIdIsCurrentTransactionId(*xid));
-	Assert(!TransactionIdIsInProgress(*xid));
-	Assert(TransactionIdDidAbort(*xid));
+	Assert(!ZTransactionIdIsInProgress(*xid));
+	Assert(ZTransactionIdDidAbort(*xid));
 
 	/*
 	 * We can't have two aborted transaction with pending rollback state for
@@ -638,7 +821,7 @@ fetch_prior_undo_record:
 
 			goto fetch_prior_undo_record;
 		}
-		else if (!IsMVCCSnapshot(snapshot) && TransactionIdIsInProgress(xid))
+		else if (!IsMVCCSnapshot(snapshot) && ZTransactionIdIsInProgress(xid))
 		{
 			urec_ptr = prev_urec_ptr;
 			zhtup = undo_tup;
@@ -647,7 +830,7 @@ fetch_prior_undo_record:
 
 			goto fetch_prior_undo_record;
 		}
-		else if (TransactionIdDidCommit(xid))
+		else if (ZTransactionIdDidCommit(xid))
 			return undo_tup;
 		else
 		{
@@ -670,9 +853,9 @@ fetch_prior_undo_record:
 		}
 		else if (IsMVCCSnapshot(snapshot) && XidInMVCCSnapshot(xid, snapshot))
 			return NULL;
-		else if (!IsMVCCSnapshot(snapshot) && TransactionIdIsInProgress(xid))
+		else if (!IsMVCCSnapshot(snapshot) && ZTransactionIdIsInProgress(xid))
 			return NULL;
-		else if (TransactionIdDidCommit(xid))
+		else if (ZTransactionIdDidCommit(xid))
 			return undo_tup;
 		else
 			return NULL;
@@ -921,7 +1104,7 @@ fetch_prior_undo_record:
 			else
 				result = true;	/* updated before scan started */
 		}
-		else if (TransactionIdIsInProgress(xid))
+		else if (ZTransactionIdIsInProgress(xid))
 		{
 			/* Note the values required to fetch prior tuple in undo chain. */
 			urec_ptr = prev_urec_ptr;
@@ -932,7 +1115,7 @@ fetch_prior_undo_record:
 
 			goto fetch_prior_undo_record;
 		}
-		else if (TransactionIdDidCommit(xid))
+		else if (ZTransactionIdDidCommit(xid))
 			result = true;
 		else
 		{
@@ -955,9 +1138,9 @@ fetch_prior_undo_record:
 			else
 				result = true;	/* inserted before scan started */
 		}
-		else if (TransactionIdIsInProgress(xid))
+		else if (ZTransactionIdIsInProgress(xid))
 			result = false;
-		else if (TransactionIdDidCommit(xid))
+		else if (ZTransactionIdDidCommit(xid))
 			result = true;
 		else
 			result = false;
@@ -1073,7 +1256,7 @@ ZHeapTupleSatisfiesMVCC(ZHeapTuple zhtup, Snapshot snapshot,
 									ctid,
 									trans_slot,
 									InvalidTransactionId);
-		else if (TransactionIdDidCommit(xid))
+		else if (ZTransactionIdDidCommit(xid))
 		{
 			/*
 			 * For non-inplace-updates, ctid needs to be retrieved from undo
@@ -1132,7 +1315,7 @@ ZHeapTupleSatisfiesMVCC(ZHeapTuple zhtup, Snapshot snapshot,
 									ctid,
 									trans_slot,
 									InvalidTransactionId);
-		else if (TransactionIdDidCommit(xid))
+		else if (ZTransactionIdDidCommit(xid))
 			return zhtup;	/* tuple is updated */
 		else	/* transaction is aborted */
 			return GetTupleFromUndo(urec_ptr,
@@ -1162,7 +1345,7 @@ ZHeapTupleSatisfiesMVCC(ZHeapTuple zhtup, Snapshot snapshot,
 	}
 	else if (XidInMVCCSnapshot(xid, snapshot))
 		return NULL;
-	else if (TransactionIdDidCommit(xid))
+	else if (ZTransactionIdDidCommit(xid))
 		return zhtup;
 	else
 		return NULL;
@@ -1294,13 +1477,13 @@ check_trans_slot:
 										  buffer,
 										  off,
 										  trans_slot);
-	else if (!IsMVCCSnapshot(snapshot) && TransactionIdIsInProgress(xid))
+	else if (!IsMVCCSnapshot(snapshot) && ZTransactionIdIsInProgress(xid))
 		return GetTupleFromUndoWithOffset(urec_ptr,
 										  snapshot,
 										  buffer,
 										  off,
 										  trans_slot);
-	else if (TransactionIdDidCommit(xid))
+	else if (ZTransactionIdDidCommit(xid))
 		return NULL;	/* tuple is deleted */
 	else	/* transaction is aborted */
 		return GetTupleFromUndoWithOffset(urec_ptr,
@@ -1312,6 +1495,151 @@ check_trans_slot:
 	return NULL;
 }
 
+/*
+ * Possible states of a transaction slot in ZHeapPageVisibility.  A slot is
+ * resolved the first time a tuple pointing to it is checked.
+ */
+#define ZSLOT_VIS_UNKNOWN		0	/* not resolved yet */
+#define ZSLOT_VIS_VISIBLE		1	/* changes are visible to the snapshot */
+#define ZSLOT_VIS_INVISIBLE		2	/* changes are invisible to the snapshot */
+#define ZSLOT_VIS_CHECK			3	/* needs the full per-tuple check */
+
+/*
+ * ZHeapPageInitVisibility
+ *
+ *	Prepare to check the visibility of the tuples of a page for a
+ *	page-at-a-time scan.  The caller must hold a lock on the buffer for as long
+ *	as it uses vis.
+ */
+void
+ZHeapPageInitVisibility(ZHeapPageVisibility *vis, Buffer buffer,
+						Snapshot snapshot)
+{
+	vis->snapshot = snapshot;
+	vis->buffer = buffer;
+	vis->enabled = (snapshot->zsatisfies == ZHeapTupleSatisfiesMVCC);
+	vis->oldestXidHavingUndo =
+		pg_atomic_read_u64(&ProcGlobal->oldestXidWithEpochHavingUndo);
+	memset(vis->slot_status, ZSLOT_VIS_UNKNOWN, sizeof(vis->slot_status));
+}
+
+/*
+ * ZHeapPageSlotVisibility
+ *
+ *	Return the state of the given transaction slot of the page, resolving it
+ *	against the snapshot if not done already.  This makes the same decisions as
+ *	ZHeapTupleSatisfiesMVCC, except that anything needing the command id or
+ *	the undo is left to the per-tuple check.
+ */
+static int
+ZHeapPageSlotVisibility(ZHeapPageVisibility *vis, int trans_slot)
+{
+	Page		page = BufferGetPage(vis->buffer);
+	ZHeapPageOpaque opaque;
+	TransInfo  *transinfo;
+	TransactionId xid;
+	int			status;
+
+	/* Slots that live in the TPD entry can differ for each tuple. */
+	if (trans_slot == ZHEAP_PAGE_TRANS_SLOTS &&
+		ZHeapPageHasTPDSlot((PageHeader) page))
+		return ZSLOT_VIS_CHECK;
+
+	Assert(trans_slot > ZHTUP_SLOT_FROZEN &&
+		   trans_slot <= ZHEAP_PAGE_TRANS_SLOTS);
+
+	if (vis->slot_status[trans_slot - 1] != ZSLOT_VIS_UNKNOWN)
+		return vis->slot_status[trans_slot - 1];
+
+	opaque = (ZHeapPageOpaque) PageGetSpecialPointer(page);
+	transinfo = &opaque->transinfo[trans_slot - 1];
+	xid = transinfo->xid;
+
+	if (MakeEpochXid((uint64) transinfo->xid_epoch, xid) <
+		vis->oldestXidHavingUndo)
+		status = ZSLOT_VIS_VISIBLE;
+	else if (TransactionIdIsCurrentTransactionId(xid))
+		status = ZSLOT_VIS_CHECK;
+	else if (XidInMVCCSnapshot(xid, vis->snapshot))
+		status = ZSLOT_VIS_INVISIBLE;
+	else if (ZTransactionIdDidCommit(xid))
+		status = ZSLOT_VIS_VISIBLE;
+	else
+		status = ZSLOT_VIS_CHECK;	/* aborted, needs undo */
+
+	vis->slot_status[trans_slot - 1] = status;
+
+	return status;
+}
+
+/*
+ * ZHeapTupleSatisfiesMVCCPage
+ *
+ *	Same as ZHeapTupleSatisfiesVisibility with the snapshot vis was prepared
+ *	for, but resolves each transaction slot of the page only once.  The undo
+ *	chain is visited only for tuples whose latest change is not visible.
+ */
+ZHeapTuple
+ZHeapTupleSatisfiesMVCCPage(ZHeapTuple zhtup, ZHeapPageVisibility *vis)
+{
+	ZHeapTupleHeader tuple = zhtup->t_data;
+	int			trans_slot;
+	int			status;
+
+	if (!vis->enabled ||
+		ZHeapTupleHasInvalidXact(tuple->t_infomask) ||
+		ZHeapTupleHasMultiLockers(tuple->t_infomask))
+		goto full_check;
+
+	trans_slot = ZHeapTupleHeaderGetXactSlot(tuple);
+	if (trans_slot == ZHTUP_SLOT_FROZEN)
+		status = ZSLOT_VIS_VISIBLE;
+	else
+		status = ZHeapPageSlotVisibility(vis, trans_slot);
+
+	if (status == ZSLOT_VIS_VISIBLE)
+	{
+		if (tuple->t_infomask & (ZHEAP_DELETED | ZHEAP_UPDATED))
+			return NULL;		/* tuple is deleted */
+		return zhtup;
+	}
+	else if (status == ZSLOT_VIS_INVISIBLE &&
+			 !(tuple->t_infomask & (ZHEAP_DELETED | ZHEAP_UPDATED |
+									ZHEAP_INPLACE_UPDATED |
+									ZHEAP_XID_LOCK_ONLY)))
+		return NULL;			/* inserted by a concurrent transaction */
+
+full_check:
+	return ZHeapTupleSatisfiesVisibility(zhtup, vis->snapshot, vis->buffer,
+										 NULL);
+}
+
+/*
+ * ZHeapGetVisibleTuplePage
+ *
+ *	Same as ZHeapGetVisibleTuple with the snapshot vis was prepared for, but
+ *	resolves each transaction slot of the page only once.
+ */
+ZHeapTuple
+ZHeapGetVisibleTuplePage(OffsetNumber off, ZHeapPageVisibility *vis)
+{
+	ItemId		lp = PageGetItemId(BufferGetPage(vis->buffer), off);
+	int			trans_slot;
+
+	Assert(ItemIdIsDeleted(lp));
+
+	if (vis->enabled &&
+		!(ItemIdGetVisibilityInfo(lp) & ITEMID_XACT_INVALID))
+	{
+		trans_slot = ItemIdGetTransactionSlot(lp);
+		if (trans_slot == ZHTUP_SLOT_FROZEN ||
+			ZHeapPageSlotVisibility(vis, trans_slot) == ZSLOT_VIS_VISIBLE)
+			return NULL;		/* tuple is deleted */
+	}
+
+	return ZHeapGetVisibleTuple(off, vis->snapshot, vis->buffer, NULL);
+}
+
 /*
  * ZHeapTupleSatisfiesUpdate
  *
@@ -1398,7 +1726,7 @@ ZHeapTupleSatisfiesUpdate(Relation rel, ZHeapTuple zhtup, CommandId curcid,
 			else
 				return HeapTupleInvisible;	/* deleted before scan started */
 		}
-		else if (TransactionIdIsInProgress(*xid))
+		else if (ZTransactionIdIsInProgress(*xid))
 		{
 			visible = UndoTupleSatisfiesUpdate(urec_ptr,
 											   zhtup,
@@ -1415,7 +1743,7 @@ ZHeapTupleSatisfiesUpdate(Relation rel, ZHeapTuple zhtup, CommandId curcid,
 			else
 				return HeapTupleInvisible;
 		}
-		else if (TransactionIdDidCommit(*xid))
+		else if (ZTransactionIdDidCommit(*xid))
 		{
 			/*
 			 * For non-inplace-updates, ctid needs to be retrieved from undo
@@ -1528,7 +1856,7 @@ ZHeapTupleSatisfiesUpdate(Relation rel, ZHeapTuple zhtup, CommandId curcid,
 					return HeapTupleMayBeUpdated;	/* updated before scan started */
 			}
 		}
-		else if (TransactionIdIsInProgress(*xid))
+		else if (ZTransactionIdIsInProgress(*xid))
 		{
 			visible = UndoTupleSatisfiesUpdate(urec_ptr,
 											   zhtup,
@@ -1545,7 +1873,7 @@ ZHeapTupleSatisfiesUpdate(Relation rel, ZHeapTuple zhtup, CommandId curcid,
 			else
 				return HeapTupleInvisible;
 		}
-		else if (TransactionIdDidCommit(*xid))
+		else if (ZTransactionIdDidCommit(*xid))
 		{
 			/* if tuple is updated and not in our snapshot, then allow to update it. */
 			if (lock_allowed || !XidInMVCCSnapshot(*xid, snapshot))
@@ -1593,9 +1921,9 @@ ZHeapTupleSatisfiesUpdate(Relation rel, ZHeapTuple zhtup, CommandId curcid,
 		else
 			return HeapTupleMayBeUpdated;	/* inserted before scan started */
 	}
-	else if (TransactionIdIsInProgress(*xid))
+	else if (ZTransactionIdIsInProgress(*xid))
 		return HeapTupleInvisible;
-	else if (TransactionIdDidCommit(*xid))
+	else if (ZTransactionIdDidCommit(*xid))
 		return HeapTupleMayBeUpdated;
 	else
 		return HeapTupleInvisible;
@@ -1686,7 +2014,7 @@ ZHeapTupleSatisfiesSelf(ZHeapTuple zhtup, Snapshot snapshot,
 
 		if (TransactionIdIsCurrentTransactionId(xid))
 			return NULL;
-		else if (TransactionIdIsInProgress(xid))
+		else if (ZTransactionIdIsInProgress(xid))
 			return GetTupleFromUndo(urec_ptr,
 									zhtup,
 									snapshot,
@@ -1694,7 +2022,7 @@ ZHeapTupleSatisfiesSelf(ZHeapTuple zhtup, Snapshot snapshot,
 									ctid,
 									trans_slot_id,
 									InvalidTransactionId);
-		else if (TransactionIdDidCommit(xid))
+		else if (ZTransactionIdDidCommit(xid))
 		{
 			/* tuple is deleted or non-inplace-updated */
 			return NULL;
@@ -1726,7 +2054,7 @@ ZHeapTupleSatisfiesSelf(ZHeapTuple zhtup, Snapshot snapshot,
 		{
 			return zhtup;
 		}
-		else if (TransactionIdIsInProgress(xid))
+		else if (ZTransactionIdIsInProgress(xid))
 		{
 			return GetTupleFromUndo(urec_ptr,
 									zhtup,
@@ -1736,7 +2064,7 @@ ZHeapTupleSatisfiesSelf(ZHeapTuple zhtup, Snapshot snapshot,
 									trans_slot_id,
 									InvalidTransactionId);
 		}
-		else if (TransactionIdDidCommit(xid))
+		else if (ZTransactionIdDidCommit(xid))
 		{
 			return zhtup;
 		}
@@ -1763,11 +2091,11 @@ ZHeapTupleSatisfiesSelf(ZHeapTuple zhtup, Snapshot snapshot,
 
 	if (TransactionIdIsCurrentTransactionId(xid))
 		return zhtup;
-	else if (TransactionIdIsInProgress(xid))
+	else if (ZTransactionIdIsInProgress(xid))
 	{
 		return NULL;
 	}
-	else if (TransactionIdDidCommit(xid))
+	else if (ZTransactionIdDidCommit(xid))
 		return zhtup;
 	else
 	{
@@ -1841,12 +2169,12 @@ ZHeapTupleSatisfiesDirty(ZHeapTuple zhtup, Snapshot snapshot,
 				ZHeapTupleGetCtid(zhtup, buffer, urec_ptr, ctid);
 			return NULL;
 		}
-		else if (TransactionIdIsInProgress(xid))
+		else if (ZTransactionIdIsInProgress(xid))
 		{
 			snapshot->xmax = xid;
 			return zhtup;		/* in deletion by other */
 		}
-		else if (TransactionIdDidCommit(xid))
+		else if (ZTransactionIdDidCommit(xid))
 		{
 			/*
 			 * For non-inplace-updates, ctid needs to be retrieved from undo
@@ -1878,13 +2206,13 @@ ZHeapTupleSatisfiesDirty(ZHeapTuple zhtup, Snapshot snapshot,
 
 		if (TransactionIdIsCurrentTransactionId(xid))
 			return zhtup;
-		else if (TransactionIdIsInProgress(xid))
+		else if (ZTransactionIdIsInProgress(xid))
 		{
 			if (!ZHEAP_XID_IS_LOCKED_ONLY(tuple->t_infomask))
 				snapshot->xmax = xid;
 			return zhtup;		/* being updated */
 		}
-		else if (TransactionIdDidCommit(xid))
+		else if (ZTransactionIdDidCommit(xid))
 			return zhtup;	/* tuple is updated by someone else */
 		else	/* transaction is aborted */
 		{
@@ -1905,7 +2233,7 @@ ZHeapTupleSatisfiesDirty(ZHeapTuple zhtup, Snapshot snapshot,
 
 	if (TransactionIdIsCurrentTransactionId(xid))
 		return zhtup;
-	else if (TransactionIdIsInProgress(xid))
+	else if (ZTransactionIdIsInProgress(xid))
 	{
 		/* Return the speculative token to caller. */
 		if (ZHeapTupleHeaderIsSpeculative(tuple))
@@ -1919,7 +2247,7 @@ ZHeapTupleSatisfiesDirty(ZHeapTuple zhtup, Snapshot snapshot,
 		snapshot->xmin = xid;
 		return zhtup;		/* in insertion by other */
 	}
-	else if (TransactionIdDidCommit(xid))
+	else if (ZTransactionIdDidCommit(xid))
 		return zhtup;
 	else
 	{
@@ -2018,11 +2346,11 @@ ZHeapTupleSatisfiesOldestXmin(ZHeapTuple *ztuple, TransactionId OldestXmin,
 
 		if (TransactionIdIsCurrentTransactionId(*xid))
 			return HEAPTUPLE_DELETE_IN_PROGRESS;
-		else if (TransactionIdIsInProgress(*xid))
+		else if (ZTransactionIdIsInProgress(*xid))
 		{
 			return HEAPTUPLE_DELETE_IN_PROGRESS;
 		}
-		else if (TransactionIdDidCommit(*xid))
+		else if (ZTransactionIdDidCommit(*xid))
 		{
 			/*
 			 * Deleter committed, but perhaps it was recent enough that some open
@@ -2081,9 +2409,9 @@ ZHeapTupleSatisfiesOldestXmin(ZHeapTuple *ztuple, TransactionId OldestXmin,
 
 	if (TransactionIdIsCurrentTransactionId(*xid))
 		return HEAPTUPLE_INSERT_IN_PROGRESS;
-	else if (TransactionIdIsInProgress(*xid))
+	else if (ZTransactionIdIsInProgress(*xid))
 		return HEAPTUPLE_INSERT_IN_PROGRESS;		/* in insertion by other */
-	else if (TransactionIdDidCommit(*xid))
+	else if (ZTransactionIdDidCommit(*xid))
 		return HEAPTUPLE_LIVE;
 	else	/* transaction is aborted */
 	{
@@ -2167,11 +2495,11 @@ ZHeapTupleSatisfiesVacuum(ZHeapTuple zhtup, TransactionId OldestXmin,
 
 		if (TransactionIdIsCurrentTransactionId(*xid))
 			return ZHEAPTUPLE_DELETE_IN_PROGRESS;
-		else if (TransactionIdIsInProgress(*xid))
+		else if (ZTransactionIdIsInProgress(*xid))
 		{
 			return ZHEAPTUPLE_DELETE_IN_PROGRESS;
 		}
-		else if (TransactionIdDidCommit(*xid))
+		else if (ZTransactionIdDidCommit(*xid))
 		{
 			/*
 			 * Deleter committed, but perhaps it was recent enough that some open
@@ -2210,9 +2538,9 @@ ZHeapTupleSatisfiesVacuum(ZHeapTuple zhtup, TransactionId OldestXmin,
 
 	if (TransactionIdIsCurrentTransactionId(*xid))
 		return ZHEAPTUPLE_INSERT_IN_PROGRESS;
-	else if (TransactionIdIsInProgress(*xid))
+	else if (ZTransactionIdIsInProgress(*xid))
 		return ZHEAPTUPLE_INSERT_IN_PROGRESS;		/* in insertion by other */
-	else if (TransactionIdDidCommit(*xid))
+	else if (ZTransactionIdDidCommit(*xid))
 		return ZHEAPTUPLE_LIVE;
 	else	/* transaction is aborted */
 	{
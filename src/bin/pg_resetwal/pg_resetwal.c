@@ -1341,8 +1341,7 @@ WriteEmptyXLOG(void)
 }
 
 /*
- * Find the latest modified undo checkpoint file under pg_undo directory and
- * delete all other files.
+ * Find the latest modified undo checkpoint file under pg_undo directory.
  */
 static bool
 FindLatestUndoCheckPointFile(char *latest_undo_checkpoint_file)
@@ -1359,7 +1358,9 @@ FindLatestUndoCheckPointFile(char *latest_undo_checkpoint_file)
 
 	/*
 	 * Start reading each file under pg_undo to identify the latest
-	 * modified file and remove the older files that are not required.
+	 * modified file.  The older files are left alone, because the latest
+	 * file may only hold the changes since one of them; the server removes
+	 * them once they're no longer needed.
 	 */
 	for (filename = filenames; *filename; filename++)
 	{
@@ -1368,14 +1369,6 @@ FindLatestUndoCheckPointFile(char *latest_undo_checkpoint_file)
 
 		if (UndoCheckPointFilenamePrecedes(latest, *filename))
 		{
-			if (latest[0] != '\0')
-			{
-				snprintf(latest_undo_checkpoint_file, MAXPGPATH, "pg_undo/%s",
-						 latest);
-				if (unlink(latest_undo_checkpoint_file) != 0)
-					fprintf(stderr, _("could not unlink file \"%s\": %s\n"),
-							*filename, strerror(errno));
-			}
 			memcpy(latest, *filename, UNDO_CHECKPOINT_FILENAME_LENGTH);
 			latest[UNDO_CHECKPOINT_FILENAME_LENGTH] = '\0';
 			result = true;
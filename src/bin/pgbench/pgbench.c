@@ -156,6 +156,11 @@ int64		latency_limit = 0;
 char	   *tablespace = NULL;
 char	   *index_tablespace = NULL;
 
+/*
+ * storage engine selection, NULL means the server default
+ */
+char	   *storage_engine = NULL;
+
 /* random seed used when calling srandom() */
 int64		random_seed = -1;
 
@@ -188,6 +193,7 @@ int			nclients = 1;		/* number of clients */
 int			nthreads = 1;		/* number of threads */
 bool		is_connect;			/* establish connection for each transaction */
 bool		is_latencies;		/* report per-command latencies */
+bool		latency_histogram;	/* report per-command latency histograms */
 int			main_pid;			/* main process id used in log filename */
 
 char	   *pghost = "";
@@ -436,6 +442,13 @@ typedef enum QueryMode
 static QueryMode querymode = QUERY_SIMPLE;
 static const char *QUERYMODE[] = {"simple", "extended", "prepared"};
 
+/*
+ * Per-command latency histograms have power-of-two buckets: bucket i counts
+ * the executions that took less than 2^i microseconds, but not less than
+ * 2^(i-1).  The last bucket also takes everything slower.
+ */
+#define LATENCY_HISTOGRAM_BUCKETS	32
+
 typedef struct
 {
 	char	   *line;			/* text of command line */
@@ -446,6 +459,7 @@ typedef struct
 	char	   *argv[MAX_ARGS]; /* command word list */
 	PgBenchExpr *expr;			/* parsed expression, if needed */
 	SimpleStats stats;			/* time spent in this command */
+	int64		histogram[LATENCY_HISTOGRAM_BUCKETS];	/* same, by latency */
 } Command;
 
 typedef struct ParsedScript
@@ -506,6 +520,67 @@ static const BuiltinScript builtin_script[] =
 		"<builtin: select only>",
 		"\\set aid random(1, " CppAsString2(naccounts) " * :scale)\n"
 		"SELECT abalance FROM pgbench_accounts WHERE aid = :aid;\n"
+	},
+
+	/*
+	 * The remaining scripts exercise the paths that are specific to zheap
+	 * tables, see --storage-engine.  They run against plain heap tables as
+	 * well, for comparison.
+	 */
+	{
+		"zheap-slot-contention",
+		"<builtin: zheap transaction slot contention>",
+		"\\set aid random(1, 64)\n"
+		"\\set delta random(-5000, 5000)\n"
+		"BEGIN;\n"
+		"UPDATE pgbench_accounts SET abalance = abalance + :delta WHERE aid = :aid;\n"
+		"\\sleep 1 ms\n"
+		"END;\n"
+	},
+	{
+		"zheap-long-snapshot",
+		"<builtin: zheap long snapshot>",
+		"\\set aid random(1, " CppAsString2(naccounts) " * :scale - 99)\n"
+		"BEGIN ISOLATION LEVEL REPEATABLE READ;\n"
+		"SELECT sum(abalance) FROM pgbench_accounts WHERE aid BETWEEN :aid AND :aid + 99;\n"
+		"\\sleep 100 ms\n"
+		"SELECT sum(abalance) FROM pgbench_accounts WHERE aid BETWEEN :aid AND :aid + 99;\n"
+		"END;\n"
+	},
+	{
+		"zheap-savepoint",
+		"<builtin: zheap savepoint rollback>",
+		"\\set aid random(1, " CppAsString2(naccounts) " * :scale)\n"
+		"\\set bid random(1, " CppAsString2(nbranches) " * :scale)\n"
+		"\\set tid random(1, " CppAsString2(ntellers) " * :scale)\n"
+		"\\set delta random(-5000, 5000)\n"
+		"BEGIN;\n"
+		"UPDATE pgbench_accounts SET abalance = abalance + :delta WHERE aid = :aid;\n"
+		"SAVEPOINT s1;\n"
+		"UPDATE pgbench_tellers SET tbalance = tbalance + :delta WHERE tid = :tid;\n"
+		"INSERT INTO pgbench_history (tid, bid, aid, delta, mtime) VALUES (:tid, :bid, :aid, :delta, CURRENT_TIMESTAMP);\n"
+		"ROLLBACK TO SAVEPOINT s1;\n"
+		"SELECT abalance FROM pgbench_accounts WHERE aid = :aid;\n"
+		"END;\n"
+	},
+	{
+		"zheap-large-abort",
+		"<builtin: zheap large abort>",
+		"\\set aid random(1, " CppAsString2(naccounts) " * :scale - 19999)\n"
+		"\\set delta random(-5000, 5000)\n"
+		"SET rollback_overflow_size = 1;\n"
+		"BEGIN;\n"
+		"UPDATE pgbench_accounts SET abalance = abalance + :delta WHERE aid BETWEEN :aid AND :aid + 19999;\n"
+		"ROLLBACK;\n"
+	},
+	{
+		"zheap-share-lock",
+		"<builtin: zheap SELECT FOR SHARE>",
+		"\\set aid random(1, 64)\n"
+		"BEGIN;\n"
+		"SELECT abalance FROM pgbench_accounts WHERE aid BETWEEN :aid AND :aid + 9 FOR SHARE;\n"
+		"\\sleep 1 ms\n"
+		"END;\n"
 	}
 };
 
@@ -551,6 +626,8 @@ usage(void)
 		   "  --foreign-keys           create foreign key constraints between tables\n"
 		   "  --index-tablespace=TABLESPACE\n"
 		   "                           create indexes in the specified tablespace\n"
+		   "  --storage-engine=heap|zheap\n"
+		   "                           create tables with the specified storage engine\n"
 		   "  --tablespace=TABLESPACE  create tables in the specified tablespace\n"
 		   "  --unlogged-tables        create tables as unlogged tables\n"
 		   "\nOptions to select what to run:\n"
@@ -580,6 +657,7 @@ usage(void)
 		   "  -T, --time=NUM           duration of benchmark test in seconds\n"
 		   "  -v, --vacuum-all         vacuum all four standard tables before tests\n"
 		   "  --aggregate-interval=NUM aggregate data over NUM seconds\n"
+		   "  --latency-histogram      report a latency histogram per command\n"
 		   "  --log-prefix=PREFIX      prefix for transaction time log file\n"
 		   "                           (default: \"pgbench_log\")\n"
 		   "  --progress-timestamp     use Unix epoch timestamps for progress\n"
@@ -1025,6 +1103,23 @@ mergeSimpleStats(SimpleStats *acc, SimpleStats *ss)
 	acc->sum2 += ss->sum2;
 }
 
+/*
+ * Count one latency, in seconds, in a per-command latency histogram.
+ */
+static void
+addToLatencyHistogram(int64 *histogram, double latency)
+{
+	int64		usec = (int64) (latency * 1000000.0);
+	int			bucket = 0;
+
+	while (usec > 0 && bucket < LATENCY_HISTOGRAM_BUCKETS - 1)
+	{
+		usec >>= 1;
+		bucket++;
+	}
+	histogram[bucket]++;
+}
+
 /*
  * Initialize a StatsData struct to mostly zeroes, with its start time set to
  * the given value.
@@ -3233,6 +3328,10 @@ doCustom(TState *thread, CState *st, StatsData *agg)
 					addToSimpleStats(&command->stats,
 									 INSTR_TIME_GET_DOUBLE(now) -
 									 INSTR_TIME_GET_DOUBLE(st->stmt_begin));
+					if (latency_histogram)
+						addToLatencyHistogram(command->histogram,
+											  INSTR_TIME_GET_DOUBLE(now) -
+											  INSTR_TIME_GET_DOUBLE(st->stmt_begin));
 				}
 
 				/* Go ahead with next command, to be executed or skipped */
@@ -3538,9 +3637,16 @@ initCreateTables(PGconn *con)
 
 		/* Construct new create table statement. */
 		opts[0] = '\0';
-		if (ddl->declare_fillfactor)
+		if (ddl->declare_fillfactor && storage_engine != NULL)
+			snprintf(opts + strlen(opts), sizeof(opts) - strlen(opts),
+					 " with (fillfactor=%d, storage_engine=%s)",
+					 fillfactor, storage_engine);
+		else if (ddl->declare_fillfactor)
 			snprintf(opts + strlen(opts), sizeof(opts) - strlen(opts),
 					 " with (fillfactor=%d)", fillfactor);
+		else if (storage_engine != NULL)
+			snprintf(opts + strlen(opts), sizeof(opts) - strlen(opts),
+					 " with (storage_engine=%s)", storage_engine);
 		if (tablespace != NULL)
 		{
 			char	   *escape_tablespace;
@@ -4546,6 +4652,31 @@ addScript(ParsedScript script)
 	num_scripts++;
 }
 
+/*
+ * Print the non-empty buckets of a per-command latency histogram, whose
+ * entries add up to count.
+ */
+static void
+printLatencyHistogram(int64 *histogram, int64 count)
+{
+	int			i;
+
+	for (i = 0; i < LATENCY_HISTOGRAM_BUCKETS; i++)
+	{
+		if (histogram[i] == 0)
+			continue;
+
+		if (i < LATENCY_HISTOGRAM_BUCKETS - 1)
+			printf("                 < %11.3f ms: " INT64_FORMAT " (%.3f%%)\n",
+				   (double) ((int64) 1 << i) / 1000.0, histogram[i],
+				   100.0 * histogram[i] / count);
+		else
+			printf("                >= %11.3f ms: " INT64_FORMAT " (%.3f%%)\n",
+				   (double) ((int64) 1 << (i - 1)) / 1000.0, histogram[i],
+				   100.0 * histogram[i] / count);
+	}
+}
+
 static void
 printSimpleStats(const char *prefix, SimpleStats *ss)
 {
@@ -4694,6 +4825,9 @@ printResults(TState *threads, StatsData *total, instr_time total_time,
 						   (cstats->count > 0) ?
 						   1000.0 * cstats->sum / cstats->count : 0.0,
 						   (*commands)->line);
+					if (latency_histogram && cstats->count > 0)
+						printLatencyHistogram((*commands)->histogram,
+											  cstats->count);
 				}
 			}
 		}
@@ -4793,6 +4927,8 @@ main(int argc, char **argv)
 		{"log-prefix", required_argument, NULL, 7},
 		{"foreign-keys", no_argument, NULL, 8},
 		{"random-seed", required_argument, NULL, 9},
+		{"storage-engine", required_argument, NULL, 10},
+		{"latency-histogram", no_argument, NULL, 11},
 		{NULL, 0, NULL, 0}
 	};
 
@@ -5148,6 +5284,20 @@ main(int argc, char **argv)
 					exit(1);
 				}
 				break;
+			case 10:			/* storage-engine */
+				initialization_option_set = true;
+				if (strcmp(optarg, "heap") != 0 && strcmp(optarg, "zheap") != 0)
+				{
+					fprintf(stderr, "invalid storage engine: \"%s\"\n", optarg);
+					exit(1);
+				}
+				storage_engine = pg_strdup(optarg);
+				break;
+			case 11:			/* latency-histogram */
+				benchmarking_option_set = true;
+				is_latencies = true;
+				latency_histogram = true;
+				break;
 			default:
 				fprintf(stderr, _("Try \"%s --help\" for more information.\n"), progname);
 				exit(1);
@@ -848,6 +848,40 @@ pgbench(
 check_pgbench_logs("$bdir/001_pgbench_log_3", 1, 10, 10,
 	qr{^\d \d{1,2} \d+ \d \d+ \d+$});
 
+# zheap tables and the zheap builtin scripts
+pgbench(
+	'--initialize --scale=1 --storage-engine=zheap --fillfactor=90',
+	0,
+	[qr{^$}],
+	[ qr{creating tables}, qr{creating primary keys}, qr{done\.} ],
+	'pgbench zheap initialization');
+
+$node->command_like(
+	[
+		'psql', '-XAt', '-c',
+		"SELECT count(*) FROM pg_class WHERE relname LIKE 'pgbench\\_%' AND relkind = 'r' AND 'storage_engine=zheap' = ANY (reloptions)"
+	],
+	qr{^4$},
+	'pgbench zheap tables');
+
+foreach my $script (
+	'zheap-slot-contention', 'zheap-long-snapshot',
+	'zheap-savepoint',       'zheap-large-abort',
+	'zheap-share-lock')
+{
+	pgbench(
+		"-n -t 4 -c 4 -j $nthreads --builtin=$script --latency-histogram",
+		0,
+		[
+			qr{builtin: zheap},
+			qr{processed: 16/16},
+			qr{statement latencies in milliseconds},
+			qr{< +\d+\.\d+ ms: \d+ \(}
+		],
+		[qr{^$}],
+		"pgbench $script");
+}
+
 # done
 $node->stop;
 done_testing();
@@ -112,6 +112,10 @@ my @options = (
 	],
 	[ 'bad variable', '--define foobla', [qr{invalid variable definition}] ],
 	[ 'invalid fillfactor', '-F 1',            [qr{invalid fillfactor}] ],
+	[
+		'invalid storage engine', '-i --storage-engine=columnar',
+		[qr{invalid storage engine}]
+	],
 	[ 'invalid query mode', '-M no-such-mode', [qr{invalid query mode}] ],
 	[
 		'invalid progress', '--progress=0',
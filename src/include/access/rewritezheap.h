@@ -0,0 +1,26 @@
+/*-------------------------------------------------------------------------
+ *
+ * rewritezheap.h
+ *	  Declarations for zheap rewrite support functions
+ *
+ * Portions Copyright (c) 1996-2018, PostgreSQL Global Development Group
+ * Portions Copyright (c) 1994-5, Regents of the University of California
+ *
+ * src/include/access/rewritezheap.h
+ *
+ *-------------------------------------------------------------------------
+ */
+#ifndef REWRITE_ZHEAP_H
+#define REWRITE_ZHEAP_H
+
+#include "access/zhtup.h"
+#include "utils/relcache.h"
+
+/* struct definition is private to rewritezheap.c */
+typedef struct ZRewriteStateData *ZRewriteState;
+
+extern ZRewriteState begin_zheap_rewrite(Relation NewHeap, bool use_wal);
+extern void rewrite_zheap_tuple(ZRewriteState state, ZHeapTuple tuple);
+extern void end_zheap_rewrite(ZRewriteState state);
+
+#endif							/* REWRITE_ZHEAP_H */
@@ -17,6 +17,11 @@
 #include "access/xlogdefs.h"
 #include "catalog/pg_class.h"
 #include "storage/lwlock.h"
+#include "utils/snapshot.h"
+#include "utils/timestamp.h"
+
+/* GUC options */
+extern int	undo_retention;
 
 /*
  * Discard the undo for all the transaction whose xid is smaller than xmin
@@ -28,6 +33,20 @@
  */
 extern void UndoDiscard(TransactionId xmin, bool *hibernate);
 
+/*
+ * Undo retention: the undo worker samples the running transactions over time
+ * so that undo of transactions started within the last undo_retention seconds
+ * is kept for flashback queries, which scan with the snapshot of a sample.
+ */
+#define UNDO_RETENTION_MAX_RUNNING	64
+
+extern Size UndoRetentionShmemSize(void);
+extern void UndoRetentionShmemInit(void);
+extern void UndoRetentionRecordXid(void);
+extern TransactionId UndoRetentionGetDiscardHorizon(TransactionId oldestXmin);
+extern bool UndoRetentionGetSnapshot(TimestampTz time, uint64 epoch_xid,
+						 Snapshot snapshot, uint64 *epoch_xmin);
+
 /* To calculate the size of the hash table size for rollabcks. */
 extern int RollbackHTSize(void);
 
@@ -69,6 +69,11 @@ extern UnpackedUndoRecord* UndoFetchRecord(UndoRecPtr urp,
 										   TransactionId xid,
 										   UndoRecPtr *urec_ptr_out,
 										   SatisfyUndoRecordCallback callback);
+/*
+ * Number of undo records fetched by this backend, for statistics.
+ */
+extern uint64 UndoRecordsFetched;
+
 /*
  * Release the resources allocated by UndoFetchRecord.
  */
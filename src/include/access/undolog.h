@@ -19,6 +19,7 @@
 #include "access/xlogreader.h"
 #include "catalog/pg_class.h"
 #include "common/relpath.h"
+#include "datatype/timestamp.h"
 #include "storage/bufpage.h"
 
 #ifndef FRONTEND
@@ -272,6 +273,23 @@ typedef struct UndoLogControl
 	UndoRecPtr	oldest_data;
 	LWLock		discard_lock;		/* prevents discarding while reading */
 
+	/*
+	 * Discard replayed on a hot standby whose application has been deferred
+	 * because standby queries may still need the undo.  Valid if
+	 * deferred_discard is ahead of meta.discard; protected by mutex.
+	 */
+	UndoLogOffset	deferred_discard;
+	TransactionId	deferred_latestxid;
+	TimestampTz		deferred_since;
+	bool			deferred_drop;	/* drop the log once discard is applied */
+
+	/*
+	 * Meta data as of the last undo checkpoint file that included this log,
+	 * valid if meta_checkpointed.  Protected by UndoCheckPointLock.
+	 */
+	UndoLogMetaData checkpointed_meta;
+	bool		meta_checkpointed;
+
 	UndoLogNumber next_free;		/* protected by UndoLogLock */
 } UndoLogControl;
 
@@ -288,6 +306,7 @@ extern void UndoLogAdvance(UndoRecPtr insertion_point,
 						   UndoPersistence persistence);
 extern void UndoLogDiscard(UndoRecPtr discard_point, TransactionId xid);
 extern bool UndoLogIsDiscarded(UndoRecPtr point);
+extern void UndoLogDetachIdle(void);
 
 /* Initialization interfaces. */
 extern void StartupUndoLogs(XLogRecPtr checkPointRedo);
@@ -302,6 +321,8 @@ extern void ResetUndoLogs(UndoPersistence persistence);
 extern bool DropUndoLogsInTablespace(Oid tablespace);
 
 /* GUC interfaces. */
+extern int	max_standby_undo_discard_delay;
+extern int	max_active_undo_logs;
 extern void assign_undo_tablespaces(const char *newval, void *extra);
 
 /* Checkpointing interfaces. */
@@ -313,6 +334,7 @@ extern void CheckPointUndoLogs(XLogRecPtr checkPointRedo,
 extern UndoLogControl *UndoLogGet(UndoLogNumber logno);
 extern UndoLogControl *UndoLogNext(UndoLogControl *log);
 extern bool AmAttachedToUndoLog(UndoLogControl *log);
+extern void UndoLogDropExhausted(UndoLogControl *log);
 
 #endif
 
@@ -332,6 +354,9 @@ extern void LogUndoMetaData(xl_undolog_meta *xlrec);
 void UndoLogNewSegment(UndoLogNumber logno, Oid tablespace, int segno);
 /* Redo interface. */
 extern void undolog_redo(XLogReaderState *record);
+extern void undolog_cleanup(void);
+extern void UndoLogApplyDeferredDiscards(void);
+extern void UndoLogReplayOldestXidHavingUndo(uint64 oldestXidWithEpochHavingUndo);
 /* Discard the undo logs for temp tables */
 extern void TempUndoDiscard(UndoLogNumber);
 
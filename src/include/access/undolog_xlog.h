@@ -24,6 +24,7 @@
 #define XLOG_UNDOLOG_DISCARD	0x30
 #define XLOG_UNDOLOG_REWIND		0x40
 #define XLOG_UNDOLOG_META		0x50
+#define XLOG_UNDOLOG_DROP		0x60
 
 /* Create a new undo log. */
 typedef struct xl_undolog_create
@@ -56,6 +57,12 @@ typedef struct xl_undolog_discard
 	TransactionId latestxid;	/* latest xid whose undolog are discarded. */
 } xl_undolog_discard;
 
+/* Drop an exhausted undo log whose undo has been entirely discarded. */
+typedef struct xl_undolog_drop
+{
+	UndoLogNumber logno;
+} xl_undolog_drop;
+
 /* Rewind insert location of the undo log. */
 typedef struct xl_undolog_rewind
 {
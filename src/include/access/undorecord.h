@@ -25,11 +25,13 @@ typedef enum undorectype
 	UNDO_INSERT,
 	UNDO_MULTI_INSERT,
 	UNDO_DELETE,
+	UNDO_MULTI_DELETE,
 	UNDO_INPLACE_UPDATE,
 	UNDO_UPDATE,
 	UNDO_XID_LOCK_ONLY,
 	UNDO_XID_MULTI_LOCK_ONLY,
-	UNDO_ITEMID_UNUSED
+	UNDO_ITEMID_UNUSED,
+	UNDO_RELFILENODE
 } undorectype;
 
 /*
@@ -141,6 +143,28 @@ typedef struct UndoRecordPayload
 #define SizeOfUndoRecordPayload \
 	(offsetof(UndoRecordPayload, urec_tuple_len) + sizeof(uint16))
 
+/*
+ * An UNDO_RELFILENODE record is about the storage of a whole relation rather
+ * than about a page: uur_tsid and uur_relfilenode identify the storage that
+ * was created, uur_block is InvalidBlockNumber and the payload is an
+ * UndoRecordRelfilenode.  UNDO_RELFILENODE_DROP says the storage belongs to
+ * a relation created by the transaction and is to be dropped if it aborts;
+ * UNDO_RELFILENODE_RESTORE says it replaced old_relfilenode as the storage
+ * of reloid, which goes back to old_relfilenode if the transaction aborts.
+ */
+#define UNDO_RELFILENODE_DROP		1
+#define UNDO_RELFILENODE_RESTORE	2
+
+typedef struct UndoRecordRelfilenode
+{
+	uint8		action;			/* UNDO_RELFILENODE_xxx */
+	Oid			reloid;			/* relation the storage belongs to */
+	Oid			old_relfilenode;	/* storage to go back to, for RESTORE */
+} UndoRecordRelfilenode;
+
+#define SizeOfUndoRecordRelfilenode \
+	(offsetof(UndoRecordRelfilenode, old_relfilenode) + sizeof(Oid))
+
 /*
  * Information that can be used to create an undo record or that can be
  * extracted from one previously created.  The raw undo record format is
@@ -65,6 +65,17 @@ typedef struct ZHeapMetaPageData
 	uint32          zhm_version;    /* version ID */
 	uint32          zhm_first_used_tpd_page;
 	uint32          zhm_last_used_tpd_page;
+
+	/*
+	 * Statistics set by ANALYZE for the planner to cost visibility checks;
+	 * see zheap_update_meta_stats.
+	 */
+	float4			zhm_active_frac;	/* fraction of pages with tuples whose
+										 * undo is retained */
+	float4			zhm_undo_depth;		/* avg. # of undo records retained
+										 * per tuple on such pages */
+	float4			zhm_tpd_frac;		/* fraction of pages with slots in
+										 * TPD */
 } ZHeapMetaPageData;
 
 typedef ZHeapMetaPageData *ZHeapMetaPage;
@@ -79,6 +90,12 @@ typedef ZHeapMetaPageData *ZHeapMetaPage;
 extern void zheap_init_meta_page(Buffer metabuf, BlockNumber first_blkno,
 					BlockNumber last_blkno);
 extern void ZheapInitMetaPage(Relation rel, ForkNumber forkNum);
+extern void zheap_update_meta_stats(Relation rel, float4 active_frac,
+						float4 undo_depth, float4 tpd_frac);
+extern void zheap_get_meta_stats(Relation rel, double *active_frac,
+					 double *undo_depth, double *tpd_frac);
+extern void ZheapInsertRelfilenodeUndo(Relation rel, uint8 action,
+						   Oid old_relfilenode);
 extern bool zheap_exec_pending_rollback(Relation rel, Buffer buffer,
 										int slot_no, TransactionId xwait);
 extern Oid zheap_insert(Relation relation, ZHeapTuple tup, CommandId cid,
@@ -87,6 +104,8 @@ extern void simple_zheap_delete(Relation relation, ItemPointer tid, Snapshot sna
 extern HTSU_Result zheap_delete(Relation relation, ItemPointer tid,
 						CommandId cid, Snapshot crosscheck, Snapshot snapshot,
 						bool wait, HeapUpdateFailureData *hufd);
+extern int zheap_multi_delete(Relation relation, ItemPointer tids, int ntids,
+				   CommandId cid, Snapshot snapshot, bool *deleted);
 extern HTSU_Result zheap_update(Relation relation, ItemPointer otid, ZHeapTuple newtup,
 					CommandId cid, Snapshot crosscheck, Snapshot snapshot, bool wait,
 					HeapUpdateFailureData *hufd, LockTupleMode *lockmode);
@@ -125,6 +144,7 @@ extern void PageSetUNDO(UnpackedUndoRecord undorecord, Buffer buffer,
 				int ucnt);
 extern UndoRecPtr PageGetUNDO(Page page, int trans_slot_id);
 extern void zheap_page_prune_opt(Relation relation, Buffer buffer);
+extern TransactionId ZHeapGetPruneHorizon(TransactionId OldestXmin);
 extern int zheap_page_prune_guts(Relation relation, Buffer buffer,
 								 TransactionId OldestXmin, bool report_stats,
 								 TransactionId *latestRemovedXid);
@@ -173,6 +193,7 @@ extern void zheap_freeze_or_invalidate_tuples(Buffer buf, int nSlots, int *slots
 extern bool PageFreezeTransSlots(Relation relation, Buffer buf,
 								 bool *lock_reacquired, TransInfo *transinfo,
 								 int num_slots);
+extern void zheap_page_freeze_slots_opt(Relation relation, Buffer buffer);
 extern void GetCompletedSlotOffsets(Page page, int nCompletedXactSlots,
 									int *completed_slots,
 									OffsetNumber *offset_completed_slots,
@@ -185,6 +206,11 @@ CopyTupleFromUndoRecord(UnpackedUndoRecord	*urec, ZHeapTuple zhtup,
 extern bool
 ZHeapSatisfyUndoRecord(UnpackedUndoRecord* uurec, BlockNumber blkno,
 								OffsetNumber offset, TransactionId xid);
+extern void ZHeapUndoMultiDeleteForm(UnpackedUndoRecord *urec,
+						 ZHeapTupleData *tuples, TransactionId *prevxids,
+						 int ntuples);
+extern bool ZHeapUndoMultiDeleteNext(UnpackedUndoRecord *urec, Size *pos,
+						 UnpackedUndoRecord *delrec);
 extern bool
 ValidateTuplesXact(ZHeapTuple tuple, Snapshot snapshot, Buffer buf,
 					TransactionId priorXmax, bool nobuflock);
@@ -57,6 +57,9 @@
 #define XLOG_ZHEAP_CONFIRM		0x00
 #define XLOG_ZHEAP_UNUSED		0x10
 #define XLOG_ZHEAP_VISIBLE		0x20
+#define XLOG_ZHEAP_MULTI_DELETE	0x30
+#define XLOG_ZHEAP_RELFILENODE	0x40
+#define XLOG_ZHEAP_META_STATS	0x50
 
 /*
  * All that we need to regenerate the meta-data page
@@ -277,6 +280,40 @@ typedef struct xl_zheap_clean
 
 #define SizeOfZHeapClean (offsetof(xl_zheap_clean, ndead) + sizeof(uint16))
 
+/*
+ * xl_zheap_multi_delete flag values, 8 bits are available.
+ */
+/* PD_ALL_VISIBLE was cleared */
+#define XLZ_MULTI_DELETE_ALL_VISIBLE_CLEARED	(1<<0)
+/* undo tuples are present in xlog record? */
+#define XLZ_HAS_MULTI_DELETE_UNDOTUPLES			(1<<1)
+
+/*
+ * This is what we need to know about deleting several tuples from a page.
+ *
+ * The main data of the record consists of this header, an xl_multi_delete_ztuple
+ * for each deleted tuple and, if XLZ_HAS_MULTI_DELETE_UNDOTUPLES is set, the
+ * tuple data of the undo record, which holds the old version of each tuple.
+ */
+typedef struct xl_zheap_multi_delete
+{
+	uint16		ntuples;
+	uint8		trans_slot_id;	/* transaction slot id */
+	uint8		flags;
+} xl_zheap_multi_delete;
+
+#define SizeOfZHeapMultiDelete	(offsetof(xl_zheap_multi_delete, flags) + sizeof(uint8))
+
+typedef struct xl_multi_delete_ztuple
+{
+	/* transaction id that has modified the tuple, for the undo record */
+	TransactionId prevxid;
+	OffsetNumber offnum;		/* deleted tuple's offset */
+	uint16		infomask;		/* infomask of the deleted tuple */
+} xl_multi_delete_ztuple;
+
+#define SizeOfMultiDeleteZTuple	(offsetof(xl_multi_delete_ztuple, infomask) + sizeof(uint16))
+
 typedef struct xl_zheap_unused
 {
 
@@ -316,6 +353,32 @@ typedef struct xl_zheap_visible
 
 #define SizeOfZHeapVisible (offsetof(xl_zheap_visible, flags) + sizeof(uint8))
 
+/*
+ * This is what we need to know about new storage for a zheap relation, to
+ * regenerate its UNDO_RELFILENODE undo record.  It follows an xl_undo_header.
+ */
+typedef struct xl_zheap_relfilenode
+{
+	Oid			reloid;
+	Oid			old_relfilenode;
+	uint8		action;			/* UNDO_RELFILENODE_xxx */
+} xl_zheap_relfilenode;
+
+#define SizeOfZHeapRelfilenode	(offsetof(xl_zheap_relfilenode, action) + sizeof(uint8))
+
+/*
+ * This is what we need to know about the ANALYZE statistics stored in the
+ * metapage, which is block 0.
+ */
+typedef struct xl_zheap_meta_stats
+{
+	float4		active_frac;
+	float4		undo_depth;
+	float4		tpd_frac;
+} xl_zheap_meta_stats;
+
+#define SizeOfZHeapMetaStats	(offsetof(xl_zheap_meta_stats, tpd_frac) + sizeof(float4))
+
 extern void zheap_redo(XLogReaderState *record);
 extern void zheap_desc(StringInfo buf, XLogReaderState *record);
 extern const char *zheap_identify(uint8 info);
@@ -24,6 +24,8 @@
 #define HWLOCKMODE_from_locktupmode(lockmode) \
 			(tupleLockExtraInfo[lockmode].hwlock)
 
+extern Size ZMultiLockCacheShmemSize(void);
+extern void ZMultiLockCacheShmemInit(void);
 extern List *ZGetMultiLockMembersForCurrentXact(ZHeapTuple zhtup,
 							int trans_slot, UndoRecPtr urec_ptr);
 extern List *ZGetMultiLockMembers(Relation rel, ZHeapTuple zhtup, Buffer buf,
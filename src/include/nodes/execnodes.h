@@ -1062,6 +1062,12 @@ typedef struct ModifyTableState
 
 	/* Per plan map for tuple conversion from child to root */
 	TupleConversionMap **mt_per_subplan_tupconv_maps;
+
+	/* DELETEs from a zheap page batched together; see ExecZHeapDeleteBatch */
+	bool		mt_zdelete_batch;	/* can current subplan's rows be batched? */
+	ItemPointerData *mt_zdelete_tids;	/* tids waiting to be deleted */
+	int			mt_zdelete_ntids;	/* number of valid entries in that */
+	bool		mt_zdelete_all; /* truncate instead; see ExecZHeapCanDeleteAll */
 } ModifyTableState;
 
 /* ----------------
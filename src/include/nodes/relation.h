@@ -488,6 +488,9 @@ typedef struct PartitionSchemeData *PartitionScheme;
  *		pages - number of disk pages in relation (zero if not a table)
  *		tuples - number of tuples in relation (not considering restrictions)
  *		allvisfrac - fraction of disk pages that are marked all-visible
+ *		zactivefrac - fraction of zheap pages with tuples having undo
+ *		zundodepth - avg. # of undo records per tuple on such zheap pages
+ *		ztpdfrac - fraction of zheap pages with transaction slots in TPD
  *		subroot - PlannerInfo for subquery (NULL if it's not a subquery)
  *		subplan_params - list of PlannerParamItems to be passed to subquery
  *
@@ -661,6 +664,9 @@ typedef struct RelOptInfo
 	BlockNumber pages;			/* size estimates derived from pg_class */
 	double		tuples;
 	double		allvisfrac;
+	double		zactivefrac;	/* zheap undo/TPD stats, zero otherwise */
+	double		zundodepth;
+	double		ztpdfrac;
 	PlannerInfo *subroot;		/* if subquery */
 	List	   *subplan_params; /* if subquery */
 	int			rel_parallel_workers;	/* wanted number of parallel workers */
@@ -117,6 +117,16 @@ typedef struct PgStat_TableCounts
 
 	PgStat_Counter t_blocks_fetched;
 	PgStat_Counter t_blocks_hit;
+
+	/* the rest are only counted for zheap tables */
+	PgStat_Counter t_trans_slot_waits;
+	PgStat_Counter t_trans_slot_freezes;
+	PgStat_Counter t_tpd_entries_allocated;
+	PgStat_Counter t_tpd_entries_extended;
+	PgStat_Counter t_undo_bytes;
+	PgStat_Counter t_undo_records_fetched;
+	PgStat_Counter t_page_prunes;
+	PgStat_Counter t_tuples_pruned;
 } PgStat_TableCounts;
 
 /* Possible targets for resetting cluster-wide shared values */
@@ -570,7 +580,7 @@ typedef union PgStat_Msg
  * ------------------------------------------------------------
  */
 
-#define PGSTAT_FILE_FORMAT_ID	0x01A5BC9D
+#define PGSTAT_FILE_FORMAT_ID	0x01A5BC9E
 
 /* ----------
  * PgStat_StatDBEntry			The collector's data per database
@@ -642,6 +652,16 @@ typedef struct PgStat_StatTabEntry
 	PgStat_Counter blocks_fetched;
 	PgStat_Counter blocks_hit;
 
+	/* zheap only, see PgStat_TableCounts */
+	PgStat_Counter trans_slot_waits;
+	PgStat_Counter trans_slot_freezes;
+	PgStat_Counter tpd_entries_allocated;
+	PgStat_Counter tpd_entries_extended;
+	PgStat_Counter undo_bytes;
+	PgStat_Counter undo_records_fetched;
+	PgStat_Counter page_prunes;
+	PgStat_Counter tuples_pruned;
+
 	TimestampTz vacuum_timestamp;	/* user initiated vacuum */
 	PgStat_Counter vacuum_count;
 	TimestampTz autovac_vacuum_timestamp;	/* autovacuum initiated */
@@ -1327,6 +1347,44 @@ pgstat_report_wait_end(void)
 		if ((rel)->pgstat_info != NULL)								\
 			(rel)->pgstat_info->t_counts.t_blocks_hit++;			\
 	} while (0)
+#define pgstat_count_zheap_trans_slot_wait(rel)						\
+	do {															\
+		if ((rel)->pgstat_info != NULL)								\
+			(rel)->pgstat_info->t_counts.t_trans_slot_waits++;		\
+	} while (0)
+#define pgstat_count_zheap_trans_slot_freeze(rel)					\
+	do {															\
+		if ((rel)->pgstat_info != NULL)								\
+			(rel)->pgstat_info->t_counts.t_trans_slot_freezes++;	\
+	} while (0)
+#define pgstat_count_zheap_tpd_entry_allocated(rel)					\
+	do {															\
+		if ((rel)->pgstat_info != NULL)								\
+			(rel)->pgstat_info->t_counts.t_tpd_entries_allocated++;	\
+	} while (0)
+#define pgstat_count_zheap_tpd_entry_extended(rel)					\
+	do {															\
+		if ((rel)->pgstat_info != NULL)								\
+			(rel)->pgstat_info->t_counts.t_tpd_entries_extended++;	\
+	} while (0)
+#define pgstat_count_zheap_undo_bytes(rel, n)						\
+	do {															\
+		if ((rel)->pgstat_info != NULL)								\
+			(rel)->pgstat_info->t_counts.t_undo_bytes += (n);		\
+	} while (0)
+#define pgstat_count_zheap_undo_fetches(rel, n)						\
+	do {															\
+		if ((rel)->pgstat_info != NULL)								\
+			(rel)->pgstat_info->t_counts.t_undo_records_fetched += (n); \
+	} while (0)
+#define pgstat_count_zheap_prune(rel, n)								\
+	do {															\
+		if ((rel)->pgstat_info != NULL)								\
+		{															\
+			(rel)->pgstat_info->t_counts.t_page_prunes++;			\
+			(rel)->pgstat_info->t_counts.t_tuples_pruned += (n);	\
+		}															\
+	} while (0)
 #define pgstat_count_buffer_read_time(n)							\
 	(pgStatBlockReadTime += (n))
 #define pgstat_count_buffer_write_time(n)							\
@@ -221,6 +221,7 @@ typedef enum BuiltinTrancheIds
 	LWTRANCHE_PARALLEL_APPEND,
 	LWTRANCHE_UNDOLOG,
 	LWTRANCHE_UNDODISCARD,
+	LWTRANCHE_ZMULTILOCK_CACHE,
 	LWTRANCHE_FIRST_USER_DEFINED
 }			BuiltinTrancheIds;
 
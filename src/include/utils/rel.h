@@ -145,7 +145,8 @@ typedef struct RelationData
 	 * (in particular, it will get reset by a relcache inval message for the
 	 * index).  If used, it must point to a single memory chunk palloc'd in
 	 * rd_indexcxt.  A relcache reset will include freeing that chunk and
-	 * setting rd_amcache = NULL.
+	 * setting rd_amcache = NULL.  zheap tables, which have no rd_indexcxt,
+	 * use it the same way with a chunk in CacheMemoryContext.
 	 */
 	Oid			rd_amhandler;	/* OID of index AM's handler function */
 	MemoryContext rd_indexcxt;	/* private memory cxt for this stuff */
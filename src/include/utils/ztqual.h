@@ -25,6 +25,20 @@
 #define ZHeapTupleSatisfiesVisibility(tuple, snapshot, buffer, ctid) \
 	((*(snapshot)->zsatisfies) (tuple, snapshot, buffer, ctid))
 
+/*
+ * Visibility of the transaction slots of a page to an MVCC snapshot, resolved
+ * at most once per slot while a page-at-a-time scan checks the tuples of the
+ * page.  See ZHeapTupleSatisfiesMVCCPage.
+ */
+typedef struct ZHeapPageVisibility
+{
+	Snapshot	snapshot;
+	Buffer		buffer;
+	bool		enabled;		/* is snapshot an MVCC snapshot? */
+	uint64		oldestXidHavingUndo;
+	uint8		slot_status[ZHEAP_PAGE_TRANS_SLOTS];
+} ZHeapPageVisibility;
+
 extern void FetchTransInfoFromUndo(ZHeapTuple undo_tup, uint64 *epoch,
 								   TransactionId *xid, CommandId *cid,
 								   UndoRecPtr *urec_ptr, bool skip_lockers);
@@ -32,11 +46,22 @@ extern void FetchTransInfoFromUndo(ZHeapTuple undo_tup, uint64 *epoch,
 extern void ZHeapPageGetNewCtid(Buffer buffer, ItemPointer ctid,
 								TransactionId *xid, CommandId *cid);
 
+/* Transaction status lookups using the backend-local status cache */
+extern bool ZTransactionIdDidCommit(TransactionId xid);
+extern bool ZTransactionIdDidAbort(TransactionId xid);
+extern bool ZTransactionIdIsInProgress(TransactionId xid);
+
 /* These are the "satisfies" test routines for the zheap. */
 extern ZHeapTuple ZHeapTupleSatisfiesMVCC(ZHeapTuple zhtup,
 					   Snapshot snapshot, Buffer buffer, ItemPointer ctid);
 extern ZHeapTuple ZHeapGetVisibleTuple(OffsetNumber off, Snapshot snapshot,
 									   Buffer buffer, bool *all_dead);
+extern void ZHeapPageInitVisibility(ZHeapPageVisibility *vis, Buffer buffer,
+						Snapshot snapshot);
+extern ZHeapTuple ZHeapTupleSatisfiesMVCCPage(ZHeapTuple zhtup,
+							ZHeapPageVisibility *vis);
+extern ZHeapTuple ZHeapGetVisibleTuplePage(OffsetNumber off,
+						 ZHeapPageVisibility *vis);
 extern HTSU_Result ZHeapTupleSatisfiesUpdate(Relation rel, ZHeapTuple zhtup,
 						CommandId curcid, Buffer buffer, ItemPointer ctid,
 						int *trans_slot, TransactionId *xid, CommandId *cid,
@@ -0,0 +1,18 @@
+# A zheap table filled by CREATE TABLE AS is not loaded frozen, so its rows
+# stay invisible to snapshots taken before the creating transaction commits
+
+teardown
+{
+  DROP TABLE IF EXISTS bulkload;
+}
+
+session "s1"
+step "s1b"	{ BEGIN ISOLATION LEVEL REPEATABLE READ; }
+step "s1x"	{ SELECT 1 AS snapshot; }
+step "s1s"	{ SELECT count(*) FROM bulkload; }
+step "s1c"	{ COMMIT; }
+
+session "s2"
+step "s2ctas"	{ CREATE TABLE bulkload WITH (storage_engine = 'zheap') AS SELECT generate_series(1, 10) AS a; }
+
+permutation "s1b" "s1x" "s2ctas" "s1s" "s1c" "s1s"
@@ -0,0 +1,35 @@
+# VACUUM FULL and CLUSTER write zheap rows without undo, so they must not run
+# while another session has a snapshot that needs the prior versions
+
+setup
+{
+  CREATE TABLE clust (a int) WITH (storage_engine = 'zheap');
+  CREATE INDEX clust_a_idx ON clust (a);
+  INSERT INTO clust SELECT generate_series(1, 10);
+  CREATE TABLE other (a int);
+}
+
+teardown
+{
+  DROP TABLE clust;
+  DROP TABLE other;
+}
+
+session "s1"
+step "s1b"	{ BEGIN ISOLATION LEVEL REPEATABLE READ; }
+step "s1o"	{ SELECT count(*) FROM other; }
+step "s1s"	{ SELECT count(*), sum(a) FROM clust; }
+step "s1c"	{ COMMIT; }
+
+session "s2"
+step "s2u"	{ UPDATE clust SET a = a + 10 WHERE a <= 5; }
+step "s2v"	{ VACUUM FULL clust; }
+step "s2cl"	{ CLUSTER clust USING clust_a_idx; }
+step "s2s"	{ SELECT count(*), sum(a) FROM clust; }
+
+# the older snapshot still sees the rows as before the update, so the
+# rewrite is refused until it's gone
+permutation "s1b" "s1o" "s2u" "s2v" "s2cl" "s1s" "s1c" "s2v" "s2cl" "s2s"
+
+# a snapshot that sees all the changes doesn't prevent the rewrite
+permutation "s2u" "s1b" "s1o" "s2v" "s1c" "s2s"
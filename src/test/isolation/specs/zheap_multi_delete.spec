@@ -0,0 +1,41 @@
+# Scenarios that test a DELETE that zheap batches per page, when other
+# sessions hold older snapshots or are modifying some of the rows
+
+setup
+{
+  CREATE TABLE multidel (a int) WITH (storage_engine = 'zheap');
+  INSERT INTO multidel SELECT generate_series(1, 10);
+}
+
+teardown
+{
+  DROP TABLE multidel;
+}
+
+session "s1"
+step "s1b"	{ BEGIN ISOLATION LEVEL REPEATABLE READ; }
+step "s1x"	{ SELECT 1 AS snapshot; }
+step "s1s"	{ SELECT count(*), sum(a) FROM multidel; }
+step "s1c"	{ COMMIT; }
+
+session "s2"
+step "s2b"	{ BEGIN; }
+step "s2u"	{ UPDATE multidel SET a = a + 100 WHERE a = 5; }
+step "s2c"	{ COMMIT; }
+step "s2r"	{ ROLLBACK; }
+
+session "s3"
+step "s3d"	{ DELETE FROM multidel WHERE a < 10; }
+step "s3l"	{ BEGIN; LOCK TABLE multidel IN ACCESS EXCLUSIVE MODE; DELETE FROM multidel; COMMIT; }
+
+# an older snapshot still sees the deleted rows
+permutation "s1b" "s1s" "s3d" "s1s" "s1c" "s1s"
+
+# a DELETE of all rows under an explicit lock can't just give the table new
+# storage: a snapshot taken before the lock still sees the rows
+permutation "s1b" "s1x" "s3l" "s1s" "s1c" "s1s"
+
+# a row being updated concurrently is left to the per-row path, which waits
+# for the updater and rechecks the qual
+permutation "s2b" "s2u" "s3d" "s2c" "s1s"
+permutation "s2b" "s2u" "s3d" "s2r" "s1s"
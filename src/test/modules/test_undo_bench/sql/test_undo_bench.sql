@@ -0,0 +1,24 @@
+CREATE EXTENSION test_undo_bench;
+
+-- Timings vary from run to run, so only check what was done.
+SELECT records, bytes >= records * 100 AS bytes_ok, pages_spanned
+  FROM undo_bench_insert(1000, 100, 'single-page');
+SELECT records, bytes > 0 AS bytes_ok, pages_spanned
+  FROM undo_bench_insert(100, 100, 'page-spanning');
+SELECT records, bytes > 0 AS bytes_ok
+  FROM undo_bench_insert(1000, 100, 'multi-log');
+SELECT records, bytes > 0 AS bytes_ok, pages_spanned
+  FROM undo_bench_fetch(1000, 100, 'backward-chain');
+SELECT records, bytes > 0 AS bytes_ok, pages_spanned
+  FROM undo_bench_fetch(1000, 100, 'random');
+
+-- A rolled back benchmark leaves nothing to undo.
+BEGIN;
+SELECT records FROM undo_bench_insert(100, 100, 'single-page');
+ROLLBACK;
+
+SELECT records FROM undo_bench_insert(10, 100, 'sideways');
+SELECT records FROM undo_bench_fetch(10, 100, 'sideways');
+SELECT records FROM undo_bench_insert(0, 100, 'single-page');
+SELECT records FROM undo_bench_insert(10, 100000, 'single-page');
+SELECT records FROM undo_bench_insert(10, 100, 'single-page', 'permanent');
@@ -0,0 +1,17 @@
+\echo Use "CREATE EXTENSION test_undo_bench" to load this file. \quit
+
+CREATE FUNCTION undo_bench_insert(nrecords int, record_size int,
+	pattern text DEFAULT 'single-page', persistence text DEFAULT 'unlogged',
+	OUT records bigint, OUT bytes bigint, OUT pages_spanned bigint,
+	OUT seconds float8, OUT records_per_sec float8, OUT bytes_per_sec float8)
+RETURNS record
+AS 'MODULE_PATHNAME'
+LANGUAGE C STRICT;
+
+CREATE FUNCTION undo_bench_fetch(nrecords int, record_size int,
+	pattern text DEFAULT 'backward-chain', persistence text DEFAULT 'unlogged',
+	OUT records bigint, OUT bytes bigint, OUT pages_spanned bigint,
+	OUT seconds float8, OUT records_per_sec float8, OUT bytes_per_sec float8)
+RETURNS record
+AS 'MODULE_PATHNAME'
+LANGUAGE C STRICT;
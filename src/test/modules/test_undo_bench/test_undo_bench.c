@@ -0,0 +1,471 @@
+/*--------------------------------------------------------------------------
+ *
+ * test_undo_bench.c
+ *		Microbenchmarks for undo record insertion and fetch.
+ *
+ * Copyright (c) 2018, PostgreSQL Global Development Group
+ *
+ * IDENTIFICATION
+ *		src/test/modules/test_undo_bench/test_undo_bench.c
+ *
+ * -------------------------------------------------------------------------
+ */
+
+#include "postgres.h"
+
+#include "access/htup_details.h"
+#include "access/undoinsert.h"
+#include "access/undolog.h"
+#include "access/undorecord.h"
+#include "access/xact.h"
+#include "catalog/pg_tablespace.h"
+#include "fmgr.h"
+#include "funcapi.h"
+#include "miscadmin.h"
+#include "portability/instr_time.h"
+#include "utils/builtins.h"
+
+#include <stdlib.h>
+
+PG_MODULE_MAGIC;
+
+PG_FUNCTION_INFO_V1(undo_bench_insert);
+PG_FUNCTION_INFO_V1(undo_bench_fetch);
+
+/* What a benchmark did, and how long it took. */
+typedef struct UndoBenchResult
+{
+	int64		records;
+	int64		bytes;
+	int64		pages_spanned;
+	double		seconds;
+} UndoBenchResult;
+
+/* The records we're writing into one undo log. */
+typedef struct UndoBenchLog
+{
+	UndoPersistence persistence;
+	UndoRecPtr	last;			/* latest timed record, for the blkprev chain */
+	UndoLogOffset next;			/* where the next record should go */
+} UndoBenchLog;
+
+/*
+ * Size of a record less its payload, and the size of the smallest record we
+ * write, which has one byte of payload.
+ */
+static Size bench_overhead;
+static Size bench_min_size;
+
+/* Payload bytes; no record we write has more than a page's worth. */
+static char bench_payload[BLCKSZ];
+
+/*
+ * The records are not WAL-logged, so we can't write them into the permanent
+ * undo log: its pages would be dirtied without WAL and diverge on a standby
+ * or after crash recovery.
+ */
+static UndoPersistence
+undo_persistence_from_text(text *t)
+{
+	char *str = text_to_cstring(t);
+
+	if (strcmp(str, "permanent") == 0)
+		ereport(ERROR,
+				(errcode(ERRCODE_FEATURE_NOT_SUPPORTED),
+				 errmsg("permanent undo is not supported, because the records are not WAL-logged")));
+	else if (strcmp(str, "temporary") == 0)
+		return UNDO_TEMP;
+	else if (strcmp(str, "unlogged") == 0)
+		return UNDO_UNLOGGED;
+	else
+		elog(ERROR, "unknown undo persistence level: %s", str);
+}
+
+/*
+ * Make the undo of a zheap insert into block 0 of a relation that does not
+ * exist, so that rolling back our transaction skips it.
+ */
+static void
+undo_bench_init_record(UnpackedUndoRecord *urec, Size payload_len,
+					   UndoRecPtr blkprev)
+{
+	Assert(payload_len <= sizeof(bench_payload));
+
+	memset(urec, 0, sizeof(UnpackedUndoRecord));
+	urec->uur_type = UNDO_INSERT;
+	urec->uur_relfilenode = InvalidOid;
+	urec->uur_prevxid = FrozenTransactionId;
+	urec->uur_xid = GetTopTransactionId();
+	urec->uur_cid = GetCurrentCommandId(false);
+	urec->uur_tsid = DEFAULTTABLESPACE_OID;
+	urec->uur_fork = MAIN_FORKNUM;
+	urec->uur_blkprev = blkprev;
+	urec->uur_block = 0;
+	urec->uur_offset = FirstOffsetNumber;
+	urec->uur_buffer = InvalidBuffer;
+	urec->uur_payload.data = bench_payload;
+	urec->uur_payload.len = payload_len;
+}
+
+static void
+undo_bench_init_sizes(void)
+{
+	UnpackedUndoRecord urec;
+
+	memset(bench_payload, 'x', sizeof(bench_payload));
+
+	undo_bench_init_record(&urec, 1, InvalidUndoRecPtr);
+	bench_overhead = UndoRecordExpectedSize(&urec) - 1;
+	bench_min_size = bench_overhead + 1;
+}
+
+/* Does the record of the given size at urp continue on the next page? */
+static bool
+undo_bench_spans(UndoRecPtr urp, Size size)
+{
+	UndoLogOffset last_byte;
+
+	last_byte = UndoLogOffsetPlusUsableBytes(UndoRecPtrGetOffset(urp),
+											 size - 1);
+	return last_byte / BLCKSZ != UndoRecPtrGetBlockNum(urp);
+}
+
+/*
+ * Insert one record of the given size into the log, the way zheap does, and
+ * account for it in result unless that's NULL.  Returns the record's
+ * location and sets *actual_size to its size, which is larger than asked
+ * for if it's the first of the transaction in its log and so carries the
+ * transaction header.
+ */
+static UndoRecPtr
+undo_bench_write(UndoBenchLog *log, Size size, UndoRecPtr blkprev,
+				 UndoBenchResult *result, Size *actual_size)
+{
+	UnpackedUndoRecord urec;
+	UndoRecPtr	urp;
+	Size		actual;
+
+	undo_bench_init_record(&urec, size - bench_overhead, blkprev);
+
+	urp = PrepareUndoInsert(&urec, log->persistence, InvalidTransactionId,
+							NULL);
+
+	START_CRIT_SECTION();
+	InsertPreparedUndo();
+	END_CRIT_SECTION();
+
+	UnlockReleaseUndoBuffers();
+
+	actual = UndoRecordExpectedSize(&urec);
+	log->next = UndoLogOffsetPlusUsableBytes(UndoRecPtrGetOffset(urp), actual);
+
+	if (result)
+	{
+		result->records++;
+		result->bytes += actual;
+		if (undo_bench_spans(urp, actual))
+			result->pages_spanned++;
+	}
+	if (actual_size)
+		*actual_size = actual;
+
+	return urp;
+}
+
+/*
+ * Get the log ready for the timed records: write the record that carries the
+ * transaction header, which also tells us where in the log we are, then pad
+ * so that the next record starts at the given usable byte of a page.  With a
+ * negative target, don't pad.
+ */
+static void
+undo_bench_position(UndoBenchLog *log, int target)
+{
+	int			cur;
+	Size		pad;
+
+	undo_bench_write(log, bench_min_size, InvalidUndoRecPtr, NULL, NULL);
+	if (target < 0)
+		return;
+
+	cur = log->next % BLCKSZ - UndoLogBlockHeaderSize;
+	pad = (target - cur + UndoLogUsableBytesPerPage) % UndoLogUsableBytesPerPage;
+	if (pad == 0)
+		return;
+	if (pad < bench_min_size)
+		pad += UndoLogUsableBytesPerPage;
+
+	/* An undo record can be spread over at most two pages. */
+	Assert(pad <= 2 * UndoLogUsableBytesPerPage - cur);
+
+	undo_bench_write(log, pad, InvalidUndoRecPtr, NULL, NULL);
+}
+
+/*
+ * Size of the next record of the single-page layout: record_size, unless
+ * that would cross the page boundary, in which case the record ends at the
+ * boundary.  A record that would leave too little room on the page for
+ * another one takes the rest of the page as well.
+ */
+static Size
+undo_bench_single_page_size(UndoBenchLog *log, Size record_size)
+{
+	Size		rem;
+
+	rem = BLCKSZ - log->next % BLCKSZ;
+	if (record_size > rem || rem - record_size < bench_min_size)
+		return rem;
+	return record_size;
+}
+
+static void
+undo_bench_check_size(int record_size)
+{
+	if (record_size < bench_min_size ||
+		record_size > UndoLogUsableBytesPerPage)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("record_size must be between %d and %d bytes",
+						(int) bench_min_size, (int) UndoLogUsableBytesPerPage)));
+}
+
+static void
+undo_bench_check_nrecords(int nrecords)
+{
+	if (nrecords <= 0)
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("nrecords must be positive")));
+}
+
+/* Build the result row. */
+static Datum
+undo_bench_result(FunctionCallInfo fcinfo, UndoBenchResult *result)
+{
+	TupleDesc	tupdesc;
+	Datum		values[6];
+	bool		nulls[6];
+
+	if (get_call_result_type(fcinfo, NULL, &tupdesc) != TYPEFUNC_COMPOSITE)
+		elog(ERROR, "return type must be a row type");
+
+	memset(nulls, 0, sizeof(nulls));
+	values[0] = Int64GetDatum(result->records);
+	values[1] = Int64GetDatum(result->bytes);
+	values[2] = Int64GetDatum(result->pages_spanned);
+	values[3] = Float8GetDatum(result->seconds);
+	if (result->seconds > 0)
+	{
+		values[4] = Float8GetDatum(result->records / result->seconds);
+		values[5] = Float8GetDatum(result->bytes / result->seconds);
+	}
+	else
+		nulls[4] = nulls[5] = true;
+
+	PG_RETURN_DATUM(HeapTupleGetDatum(heap_form_tuple(tupdesc, values, nulls)));
+}
+
+/*
+ * undo_bench_insert(nrecords, record_size, pattern, persistence)
+ *
+ * Time the insertion of nrecords undo records.  See the README for the
+ * patterns.
+ */
+Datum
+undo_bench_insert(PG_FUNCTION_ARGS)
+{
+	int			nrecords = PG_GETARG_INT32(0);
+	int			record_size = PG_GETARG_INT32(1);
+	char	   *pattern = text_to_cstring(PG_GETARG_TEXT_PP(2));
+	UndoPersistence persistence = undo_persistence_from_text(PG_GETARG_TEXT_PP(3));
+	UndoBenchLog logs[2];
+	int			nlogs = 1;
+	bool		spanning = false;
+	UndoBenchResult result;
+	instr_time	start_time;
+	instr_time	duration;
+	int			i;
+
+	undo_bench_init_sizes();
+	undo_bench_check_nrecords(nrecords);
+
+	logs[0].persistence = persistence;
+	if (strcmp(pattern, "single-page") == 0)
+		undo_bench_check_size(record_size);
+	else if (strcmp(pattern, "page-spanning") == 0)
+		spanning = true;
+	else if (strcmp(pattern, "multi-log") == 0)
+	{
+		undo_bench_check_size(record_size);
+		logs[0].persistence = UNDO_UNLOGGED;
+		logs[1].persistence = UNDO_TEMP;
+		nlogs = 2;
+	}
+	else
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("unknown insert pattern: %s", pattern)));
+
+	for (i = 0; i < nlogs; i++)
+	{
+		logs[i].last = InvalidUndoRecPtr;
+		if (spanning)
+			undo_bench_position(&logs[i], UndoLogUsableBytesPerPage / 2);
+		else
+			undo_bench_position(&logs[i], nlogs > 1 ? -1 : 0);
+	}
+
+	memset(&result, 0, sizeof(result));
+	INSTR_TIME_SET_CURRENT(start_time);
+
+	for (i = 0; i < nrecords; i++)
+	{
+		UndoBenchLog *log = &logs[i % nlogs];
+		Size		size;
+
+		CHECK_FOR_INTERRUPTS();
+
+		if (spanning)
+			size = UndoLogUsableBytesPerPage;
+		else if (nlogs > 1)
+			size = record_size;
+		else
+			size = undo_bench_single_page_size(log, record_size);
+
+		log->last = undo_bench_write(log, size, log->last, &result, NULL);
+	}
+
+	INSTR_TIME_SET_CURRENT(duration);
+	INSTR_TIME_SUBTRACT(duration, start_time);
+	result.seconds = INSTR_TIME_GET_DOUBLE(duration);
+
+	return undo_bench_result(fcinfo, &result);
+}
+
+/*
+ * Callback for UndoFetchRecord that follows the chain to its oldest record.
+ */
+static bool
+undo_bench_chain_end(UnpackedUndoRecord *urec, BlockNumber blkno,
+					 OffsetNumber offset, TransactionId xid)
+{
+	return !UndoRecPtrIsValid(urec->uur_blkprev);
+}
+
+/*
+ * undo_bench_fetch(nrecords, record_size, pattern, persistence)
+ *
+ * Insert nrecords undo records using the single-page layout, then time
+ * fetching them.  See the README for the patterns.
+ */
+Datum
+undo_bench_fetch(PG_FUNCTION_ARGS)
+{
+	int			nrecords = PG_GETARG_INT32(0);
+	int			record_size = PG_GETARG_INT32(1);
+	char	   *pattern = text_to_cstring(PG_GETARG_TEXT_PP(2));
+	UndoPersistence persistence = undo_persistence_from_text(PG_GETARG_TEXT_PP(3));
+	bool		random_access;
+	UndoBenchLog log;
+	UndoRecPtr *urps;
+	Size	   *sizes;
+	UnpackedUndoRecord *urec;
+	UndoBenchResult result;
+	instr_time	start_time;
+	instr_time	duration;
+	int			i;
+
+	undo_bench_init_sizes();
+	undo_bench_check_nrecords(nrecords);
+	undo_bench_check_size(record_size);
+
+	if (strcmp(pattern, "backward-chain") == 0)
+		random_access = false;
+	else if (strcmp(pattern, "random") == 0)
+		random_access = true;
+	else
+		ereport(ERROR,
+				(errcode(ERRCODE_INVALID_PARAMETER_VALUE),
+				 errmsg("unknown fetch pattern: %s", pattern)));
+
+	if ((Size) nrecords > MaxAllocSize / sizeof(UndoRecPtr))
+		ereport(ERROR,
+				(errcode(ERRCODE_PROGRAM_LIMIT_EXCEEDED),
+				 errmsg("nrecords is too large")));
+	urps = palloc(nrecords * sizeof(UndoRecPtr));
+	sizes = palloc(nrecords * sizeof(Size));
+
+	log.persistence = persistence;
+	log.last = InvalidUndoRecPtr;
+	undo_bench_position(&log, 0);
+	for (i = 0; i < nrecords; i++)
+	{
+		CHECK_FOR_INTERRUPTS();
+
+		log.last = undo_bench_write(&log,
+									undo_bench_single_page_size(&log, record_size),
+									log.last, NULL, &sizes[i]);
+		urps[i] = log.last;
+	}
+
+	memset(&result, 0, sizeof(result));
+	INSTR_TIME_SET_CURRENT(start_time);
+
+	if (!random_access)
+	{
+		uint64		fetched = UndoRecordsFetched;
+
+		urec = UndoFetchRecord(urps[nrecords - 1], 0, FirstOffsetNumber,
+							   GetTopTransactionId(), NULL,
+							   undo_bench_chain_end);
+		if (urec == NULL)
+			elog(ERROR, "undo chain has been discarded");
+		UndoRecordRelease(urec);
+
+		result.records = UndoRecordsFetched - fetched;
+		if (result.records != nrecords)
+			elog(ERROR, "walked " INT64_FORMAT " undo records, expected %d",
+				 result.records, nrecords);
+		for (i = 0; i < nrecords; i++)
+		{
+			result.bytes += sizes[i];
+			if (undo_bench_spans(urps[i], sizes[i]))
+				result.pages_spanned++;
+		}
+	}
+	else
+	{
+		for (i = 0; i < nrecords; i++)
+		{
+			int			j = random() % nrecords;
+
+			CHECK_FOR_INTERRUPTS();
+
+			urec = UndoFetchRecord(urps[j], InvalidBlockNumber,
+								   InvalidOffsetNumber, InvalidTransactionId,
+								   NULL, NULL);
+			if (urec == NULL)
+				elog(ERROR, "undo record at " UndoRecPtrFormat " has been discarded",
+					 urps[j]);
+			if (urec->uur_payload.len != sizes[j] - bench_overhead)
+				elog(ERROR, "undo record at " UndoRecPtrFormat " has %d payload bytes, expected %d",
+					 urps[j], urec->uur_payload.len,
+					 (int) (sizes[j] - bench_overhead));
+			UndoRecordRelease(urec);
+
+			result.records++;
+			result.bytes += sizes[j];
+			if (undo_bench_spans(urps[j], sizes[j]))
+				result.pages_spanned++;
+		}
+	}
+
+	INSTR_TIME_SET_CURRENT(duration);
+	INSTR_TIME_SUBTRACT(duration, start_time);
+	result.seconds = INSTR_TIME_GET_DOUBLE(duration);
+
+	pfree(urps);
+	pfree(sizes);
+
+	return undo_bench_result(fcinfo, &result);
+}
@@ -0,0 +1,177 @@
+# Checks that a hot standby defers undo discards needed by its queries
+use strict;
+use warnings;
+
+use PostgresNode;
+use TestLib;
+use Test::More tests => 9;
+
+my $psql_timeout = IPC::Run::timer(180);
+
+# Initialize master node
+my $node_master = get_new_node('master');
+$node_master->init(allows_streaming => 1);
+$node_master->start;
+
+$node_master->safe_psql('postgres',
+	"CREATE TABLE tab_zheap (a int) WITH (storage_engine = 'zheap')");
+$node_master->safe_psql('postgres',
+	"INSERT INTO tab_zheap SELECT generate_series(1, 100)");
+
+my $backup_name = 'my_backup';
+$node_master->backup($backup_name);
+
+# Create streaming standby from backup.  Conflicting queries are never
+# cancelled for the ordinary max_standby_streaming_delay, so any
+# cancellation below comes from max_standby_undo_discard_delay.
+my $node_standby = get_new_node('standby');
+$node_standby->init_from_backup($node_master, $backup_name,
+	has_streaming => 1);
+$node_standby->append_conf(
+	'postgresql.conf', qq(
+hot_standby_feedback = off
+max_standby_streaming_delay = -1
+max_standby_undo_discard_delay = -1
+));
+$node_standby->start;
+
+sub wait_for_catchup
+{
+	my $until_lsn =
+	  $node_master->safe_psql('postgres', "SELECT pg_current_wal_lsn()");
+	$node_standby->poll_query_until('postgres',
+		"SELECT (pg_last_wal_replay_lsn() - '$until_lsn'::pg_lsn) >= 0")
+	  or die "standby never caught up";
+}
+
+sub pump_until
+{
+	my ($proc, $stream, $untl) = @_;
+	$proc->pump_nb();
+	while (1)
+	{
+		# The reader may have exited after printing what we're waiting for.
+		last if $$stream =~ /$untl/;
+		if ($psql_timeout->is_expired)
+		{
+			diag("aborting wait: program timed out");
+			diag("stream contents: >>", $$stream, "<<");
+			diag("pattern searched for: ", $untl);
+
+			return 0;
+		}
+		if (not $proc->pumpable())
+		{
+			diag("aborting wait: program died");
+			diag("stream contents: >>", $$stream, "<<");
+			diag("pattern searched for: ", $untl);
+
+			return 0;
+		}
+		$proc->pump();
+	}
+	return 1;
+}
+
+wait_for_catchup();
+
+# Hold a snapshot on the standby that needs the undo of the update below.
+my ($reader_stdin, $reader_stdout, $reader_stderr) = ('', '', '');
+my $reader = IPC::Run::start(
+	[
+		'psql', '-X', '-qAt', '-f', '-', '-d',
+		$node_standby->connstr('postgres')
+	],
+	'<',
+	\$reader_stdin,
+	'>',
+	\$reader_stdout,
+	'2>',
+	\$reader_stderr,
+	$psql_timeout);
+
+$reader_stdin .= q[
+BEGIN ISOLATION LEVEL REPEATABLE READ;
+SELECT sum(a) FROM tab_zheap;
+];
+ok(pump_until($reader, \$reader_stdout, qr/^5050$/m),
+	'standby reader took its snapshot');
+$reader_stdout = '';
+
+$node_master->safe_psql('postgres', "UPDATE tab_zheap SET a = a + 1");
+
+# Once the master discards the undo, replay must defer the discard.
+$node_standby->poll_query_until('postgres',
+	"SELECT count(*) > 0 FROM pg_stat_undo_deferred_discard")
+  or die "standby never deferred an undo discard";
+pass('undo discard deferred while the standby reader needs it');
+
+$reader_stdin .= q[
+SELECT sum(a) FROM tab_zheap;
+];
+ok(pump_until($reader, \$reader_stdout, qr/^5050$/m),
+	'standby reader still sees the old rows');
+$reader_stdout = '';
+
+# Once the reader is done, the discard must be applied without waiting for
+# further undo log records.
+$reader_stdin .= q[
+COMMIT;
+SELECT $$reader-committed$$;
+];
+ok(pump_until($reader, \$reader_stdout, qr/reader-committed/m),
+	'standby reader committed');
+$reader_stdout = '';
+
+is( $node_standby->safe_psql(
+		'postgres',
+		"SELECT confl_snapshot FROM pg_stat_database_conflicts WHERE datname = 'postgres'"
+	),
+	'0',
+	'standby reader was not cancelled');
+
+$node_standby->poll_query_until('postgres',
+	"SELECT count(*) = 0 FROM pg_stat_undo_deferred_discard")
+  or die "deferred undo discard never applied";
+pass('deferred undo discard applied once the reader is done');
+
+# With a finite max_standby_undo_discard_delay, a reader that keeps needing
+# the undo is cancelled once the delay expires.
+$node_standby->append_conf('postgresql.conf',
+	"max_standby_undo_discard_delay = 1s");
+$node_standby->reload;
+
+$reader_stdin .= q[
+BEGIN ISOLATION LEVEL REPEATABLE READ;
+SELECT sum(a) FROM tab_zheap;
+];
+ok(pump_until($reader, \$reader_stdout, qr/^5150$/m),
+	'standby reader took another snapshot');
+$reader_stdout = '';
+
+$node_master->safe_psql('postgres', "UPDATE tab_zheap SET a = a + 1");
+
+# The reader is cancelled without waiting for max_standby_streaming_delay.
+$node_standby->poll_query_until('postgres',
+	"SELECT confl_snapshot > 0 FROM pg_stat_database_conflicts
+	 WHERE datname = 'postgres'")
+  or die "standby reader never cancelled";
+$node_standby->poll_query_until('postgres',
+	"SELECT count(*) = 0 FROM pg_stat_undo_deferred_discard")
+  or die "deferred undo discard never applied after the delay";
+pass('deferred undo discard applied after max_standby_undo_discard_delay');
+
+$reader_stdin .= q[
+SELECT sum(a) FROM tab_zheap;
+];
+ok( pump_until(
+		$reader, \$reader_stderr,
+		qr/canceling statement due to conflict with recovery|terminating connection due to conflict with recovery/m
+	),
+	'standby reader was cancelled');
+
+$reader_stdin .= "\\q\n";
+$reader->finish;
+
+$node_standby->stop;
+$node_master->stop;
@@ -0,0 +1,86 @@
+# Checks that rolling back a transaction interrupted by a crash drops the
+# zheap storage it created
+use strict;
+use warnings;
+
+use PostgresNode;
+use TestLib;
+use Test::More tests => 6;
+
+my $psql_timeout = IPC::Run::timer(60);
+
+my $node = get_new_node('master');
+$node->init;
+$node->start;
+
+$node->safe_psql('postgres',
+	"CREATE TABLE tab_old (a int) WITH (storage_engine = 'zheap')");
+$node->safe_psql('postgres',
+	"INSERT INTO tab_old SELECT generate_series(1, 100)");
+
+# Leave a transaction in progress that modified an existing table, then
+# created a table and truncated it in a subtransaction, which gives it new
+# storage.
+my ($xact_stdin, $xact_stdout, $xact_stderr) = ('', '', '');
+my $xact = IPC::Run::start(
+	[
+		'psql', '-X', '-qAt', '-v', 'ON_ERROR_STOP=1', '-f', '-', '-d',
+		$node->connstr('postgres')
+	],
+	'<',
+	\$xact_stdin,
+	'>',
+	\$xact_stdout,
+	'2>',
+	\$xact_stderr,
+	$psql_timeout);
+
+$xact_stdin .= q[
+BEGIN;
+UPDATE tab_old SET a = a + 1000;
+CREATE TABLE tab_new (a int) WITH (storage_engine = 'zheap');
+INSERT INTO tab_new SELECT generate_series(1, 1000);
+SELECT pg_relation_filepath('tab_new');
+SAVEPOINT s1;
+TRUNCATE tab_new;
+INSERT INTO tab_new SELECT generate_series(1, 1000);
+SELECT pg_relation_filepath('tab_new');
+];
+$xact->pump until $xact_stdout =~ /\n.*\n/ || $psql_timeout->is_expired;
+my @paths = split(/\n/, $xact_stdout);
+is(scalar(@paths), 2, 'got the storage of the new table');
+isnt($paths[0], $paths[1], 'truncation gave the new table new storage');
+
+# Make sure everything the transaction did reaches disk, then crash.
+$node->safe_psql('postgres', 'CHECKPOINT');
+my $pgdata = $node->data_dir;
+ok(-s "$pgdata/$paths[0]" && -s "$pgdata/$paths[1]",
+	'new storage exists before the crash');
+
+$node->stop('immediate');
+$xact->kill_kill;
+$node->start;
+
+# The undo worker rolls back the interrupted transaction.  The storage is
+# unlinked at the next checkpoint after that.
+my $dropped = 0;
+for (my $i = 0; $i < 180; $i++)
+{
+	$node->safe_psql('postgres', 'CHECKPOINT');
+	if (!-e "$pgdata/$paths[0]" && !-e "$pgdata/$paths[1]")
+	{
+		$dropped = 1;
+		last;
+	}
+	sleep(1);
+}
+ok($dropped, 'storage created by the interrupted transaction was dropped');
+
+is($node->safe_psql('postgres', 'SELECT sum(a) FROM tab_old'),
+	'5050', 'changes to the existing table were rolled back');
+is( $node->safe_psql(
+		'postgres', "SELECT count(*) FROM pg_class WHERE relname = 'tab_new'"),
+	'0',
+	'new table is gone');
+
+$node->stop;
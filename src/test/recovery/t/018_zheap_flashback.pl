@@ -0,0 +1,99 @@
+# Checks that zheap flashback queries see the transactions that were running
+# at the time as not yet committed
+use strict;
+use warnings;
+
+use PostgresNode;
+use TestLib;
+use Test::More tests => 5;
+
+my $psql_timeout = IPC::Run::timer(180);
+
+my $node = get_new_node('master');
+$node->init;
+$node->append_conf(
+	'postgresql.conf', qq(
+autovacuum = off
+undo_retention = 600
+));
+$node->start;
+
+$node->safe_psql('postgres',
+	"CREATE TABLE tab_flash (a int, b text) WITH (storage_engine = 'zheap')");
+$node->safe_psql('postgres',
+	"INSERT INTO tab_flash VALUES (1, 'one'), (2, 'two'), (3, 'three')");
+
+# Leave a transaction in progress that updated a row.
+my ($xact_stdin, $xact_stdout, $xact_stderr) = ('', '', '');
+my $xact = IPC::Run::start(
+	[
+		'psql', '-X', '-qAt', '-v', 'ON_ERROR_STOP=1', '-f', '-', '-d',
+		$node->connstr('postgres')
+	],
+	'<',
+	\$xact_stdin,
+	'>',
+	\$xact_stdout,
+	'2>',
+	\$xact_stderr,
+	$psql_timeout);
+
+$xact_stdin .= q[
+BEGIN;
+UPDATE tab_flash SET b = 'uno' WHERE a = 1;
+SELECT 'updated';
+];
+$xact->pump until $xact_stdout =~ /updated/ || $psql_timeout->is_expired;
+
+# Wait for the undo worker to sample the running transactions after a later
+# commit, so that the sample has the update above in progress.
+$node->safe_psql('postgres', "INSERT INTO tab_flash VALUES (10, 'marker')");
+$node->poll_query_until('postgres',
+	"SELECT count(*) = 1 FROM zheap_flashback(NULL::tab_flash, now()) WHERE a = 10")
+  or die "undo worker never sampled the running transactions";
+pass('undo worker sampled the running transactions');
+my $xid = $node->safe_psql('postgres', 'SELECT txid_current()');
+
+# Now another transaction changes a row and commits, then so does the one
+# that was in progress.
+$node->safe_psql('postgres', "UPDATE tab_flash SET b = 'dos' WHERE a = 2");
+$xact_stdin .= q[
+COMMIT;
+SELECT 'committed';
+];
+$xact->pump until $xact_stdout =~ /committed/ || $psql_timeout->is_expired;
+$xact_stdin .= "\\q\n";
+$xact->finish;
+
+is( $node->safe_psql(
+		'postgres',
+		"SELECT a, b FROM zheap_flashback(NULL::tab_flash, '$xid'::xid) ORDER BY a"
+	),
+	"1|one\n2|two\n3|three\n10|marker",
+	'flashback sees neither the transaction running then nor later ones');
+
+# Our own changes are not visible as of our own transaction.
+$node->poll_query_until('postgres',
+	"SELECT count(*) = 1 FROM zheap_flashback(NULL::tab_flash, now()) WHERE b = 'uno'")
+  or die "undo worker never sampled after the commits";
+is( $node->safe_psql(
+		'postgres', q[
+BEGIN;
+DELETE FROM tab_flash WHERE a = 3;
+SELECT a, b FROM zheap_flashback(NULL::tab_flash, txid_current()::text::xid) ORDER BY a;
+ROLLBACK;
+]),
+	"1|uno\n2|dos\n3|three\n10|marker",
+	'flashback to our own transaction sees the committed changes only');
+
+# Flashback can't see past a change of storage.
+$node->safe_psql('postgres', 'TRUNCATE tab_flash');
+my ($ret, $stdout, $stderr) = $node->psql('postgres',
+	"SELECT * FROM zheap_flashback(NULL::tab_flash, '$xid'::xid)");
+isnt($ret, 0, 'flashback past a TRUNCATE fails');
+like(
+	$stderr,
+	qr/cannot flash back table "tab_flash" past a change to its definition or storage/,
+	'flashback past a TRUNCATE reports the storage change');
+
+$node->stop;
@@ -216,3 +216,164 @@ CREATE MATERIALIZED VIEW mvtest_mv AS SELECT * FROM cursor_zheap;
 
 DROP MATERIALIZED VIEW mvtest_mv;
 DROP TABLE cursor_zheap;
+
+--
+-- 9. verify flashback query.
+--
+CREATE TABLE flashback_zheap
+(
+	a int,
+	b text
+) WITH (storage_engine = 'zheap');
+
+INSERT INTO flashback_zheap VALUES (1, 'one'), (2, 'two'), (3, 'three');
+
+BEGIN;
+	UPDATE flashback_zheap SET b = 'uno' WHERE a = 1;
+	DELETE FROM flashback_zheap WHERE a = 2;
+	INSERT INTO flashback_zheap VALUES (4, 'four');
+	SELECT * FROM flashback_zheap ORDER BY a;
+ROLLBACK;
+
+-- undo_retention is off, so the undo worker hasn't sampled any snapshots
+SELECT * FROM zheap_flashback(NULL::flashback_zheap, txid_current()::text::xid);
+SELECT * FROM zheap_flashback(NULL::flashback_zheap, now());
+
+-- the first argument must identify a table
+SELECT * FROM zheap_flashback(NULL::int, '3'::xid);
+
+DROP TABLE flashback_zheap;
+
+--
+-- 10. verify cluster and vacuum full.
+--
+CREATE TABLE cluster_zheap
+(
+	a int,
+	b text,
+	c int
+) WITH (storage_engine = 'zheap');
+CREATE INDEX cluster_zheap_a_idx ON cluster_zheap(a);
+
+INSERT INTO cluster_zheap VALUES (3, 'three', 3), (1, 'one', 1), (4, 'four', 4), (2, 'two', 2);
+DELETE FROM cluster_zheap WHERE a = 4;
+UPDATE cluster_zheap SET b = 'uno' WHERE a = 1;
+ALTER TABLE cluster_zheap DROP COLUMN c;
+
+CLUSTER cluster_zheap USING cluster_zheap_a_idx;
+SELECT * FROM cluster_zheap;
+
+UPDATE cluster_zheap SET b = 'dos' WHERE a = 2;
+VACUUM FULL cluster_zheap;
+SET enable_seqscan = off;
+SELECT * FROM cluster_zheap WHERE a = 2;
+RESET enable_seqscan;
+
+DROP TABLE cluster_zheap;
+
+--
+-- 11. verify DELETE without WHERE on a table created in the same transaction.
+--
+BEGIN;
+CREATE TABLE delete_all_zheap
+(
+	a int,
+	b text
+) WITH (storage_engine = 'zheap');
+CREATE INDEX delete_all_zheap_a_idx ON delete_all_zheap(a);
+INSERT INTO delete_all_zheap SELECT i, 'row ' || i FROM generate_series(1, 100) i;
+SAVEPOINT s1;
+DELETE FROM delete_all_zheap;
+SELECT count(*) FROM delete_all_zheap;
+ROLLBACK TO SAVEPOINT s1;
+SELECT count(*) FROM delete_all_zheap;
+DELETE FROM delete_all_zheap;
+INSERT INTO delete_all_zheap VALUES (1, 'one');
+COMMIT;
+SET enable_seqscan = off;
+SELECT * FROM delete_all_zheap WHERE a = 1;
+RESET enable_seqscan;
+
+-- a table the transaction truncated gets new storage too; an explicit lock
+-- isn't enough, and with a cursor open the rows are deleted one by one
+SELECT relfilenode AS delete_all_relfilenode FROM pg_class WHERE relname = 'delete_all_zheap' \gset
+BEGIN;
+LOCK TABLE delete_all_zheap IN ACCESS EXCLUSIVE MODE;
+DELETE FROM delete_all_zheap;
+SELECT relfilenode = :delete_all_relfilenode AS same_storage FROM pg_class WHERE relname = 'delete_all_zheap';
+ROLLBACK;
+BEGIN;
+TRUNCATE delete_all_zheap;
+INSERT INTO delete_all_zheap VALUES (2, 'two');
+SELECT relfilenode AS delete_all_relfilenode FROM pg_class WHERE relname = 'delete_all_zheap' \gset
+DECLARE c CURSOR FOR SELECT * FROM delete_all_zheap;
+DELETE FROM delete_all_zheap;
+SELECT relfilenode = :delete_all_relfilenode AS same_storage FROM pg_class WHERE relname = 'delete_all_zheap';
+FETCH ALL FROM c;
+ROLLBACK;
+BEGIN;
+TRUNCATE delete_all_zheap;
+INSERT INTO delete_all_zheap VALUES (2, 'two');
+SELECT relfilenode AS delete_all_relfilenode FROM pg_class WHERE relname = 'delete_all_zheap' \gset
+DELETE FROM delete_all_zheap;
+SELECT relfilenode = :delete_all_relfilenode AS same_storage FROM pg_class WHERE relname = 'delete_all_zheap';
+SELECT count(*) FROM delete_all_zheap;
+ROLLBACK;
+SELECT * FROM delete_all_zheap;
+
+DROP TABLE delete_all_zheap;
+
+--
+-- 12. verify rollback of a transaction that gave tables new storage.
+--
+CREATE TABLE relundo_zheap1 (a int) WITH (storage_engine = 'zheap');
+CREATE TABLE relundo_zheap2 (a int) WITH (storage_engine = 'zheap');
+INSERT INTO relundo_zheap1 VALUES (1), (2), (3);
+INSERT INTO relundo_zheap2 VALUES (1), (2), (3);
+BEGIN;
+UPDATE relundo_zheap1 SET a = a + 10;
+TRUNCATE relundo_zheap2;
+COPY relundo_zheap2 FROM stdin;
+4
+5
+\.
+INSERT INTO relundo_zheap2 VALUES (6);
+CREATE TABLE relundo_zheap3 (a int) WITH (storage_engine = 'zheap');
+INSERT INTO relundo_zheap3 VALUES (1);
+SAVEPOINT s1;
+TRUNCATE relundo_zheap3;
+INSERT INTO relundo_zheap3 VALUES (2);
+SELECT * FROM relundo_zheap2 ORDER BY a;
+ROLLBACK;
+SELECT * FROM relundo_zheap1 ORDER BY a;
+SELECT * FROM relundo_zheap2 ORDER BY a;
+
+DROP TABLE relundo_zheap1, relundo_zheap2;
+
+--
+-- 13. verify batched DELETE, its rollback and older snapshots.
+--
+CREATE TABLE multi_delete_zheap (a int, b text) WITH (storage_engine = 'zheap');
+INSERT INTO multi_delete_zheap SELECT i, 'row ' || i FROM generate_series(1, 200) i;
+BEGIN;
+DELETE FROM multi_delete_zheap WHERE a % 2 = 0;
+SELECT count(*), sum(a) FROM multi_delete_zheap;
+ROLLBACK;
+SELECT count(*), sum(a) FROM multi_delete_zheap;
+BEGIN;
+DECLARE c CURSOR FOR SELECT count(*), sum(a) FROM multi_delete_zheap;
+DELETE FROM multi_delete_zheap WHERE a <= 50;
+FETCH ALL FROM c;
+SAVEPOINT s1;
+DELETE FROM multi_delete_zheap WHERE a > 150;
+SELECT count(*), sum(a) FROM multi_delete_zheap;
+ROLLBACK TO SAVEPOINT s1;
+SELECT count(*), sum(a) FROM multi_delete_zheap;
+UPDATE multi_delete_zheap SET b = 'updated' WHERE a <= 60;
+DELETE FROM multi_delete_zheap WHERE a <= 75;
+SELECT a FROM multi_delete_zheap WHERE a = 100 FOR SHARE;
+SELECT a FROM multi_delete_zheap WHERE a = 100 FOR UPDATE;
+COMMIT;
+SELECT count(*), sum(a) FROM multi_delete_zheap;
+
+DROP TABLE multi_delete_zheap;